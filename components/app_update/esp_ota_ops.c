@@ -40,6 +40,7 @@ typedef struct ota_ops_entry_ {
     uint32_t wrote_size;
     uint8_t partial_bytes;
     WORD_ALIGNED_ATTR uint8_t partial_data[16];
+    esp_image_stream_verify_t *verify;  /* Verifies the image as it is written, NULL after non-sequential writes */
     LIST_ENTRY(ota_ops_entry_) entries;
 } ota_ops_entry_t;
 
@@ -165,13 +166,31 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
     new_entry->part = partition;
     new_entry->handle = ++s_ota_ops_last_handle;
     new_entry->need_erase = (image_size == OTA_WITH_SEQUENTIAL_WRITES);
+
+    const esp_partition_pos_t part_pos = {
+        .offset = partition->address,
+        .size = partition->size,
+    };
+    if (esp_image_verify_stream_begin(ESP_IMAGE_VERIFY, &part_pos, &new_entry->verify) != ESP_OK) {
+        // esp_ota_end() will verify the image by reading it back from the partition
+        new_entry->verify = NULL;
+    }
     *out_handle = new_entry->handle;
     return ESP_OK;
 }
 
+static void ota_verify_data(ota_ops_entry_t *it, const void *data, size_t size)
+{
+    if (it->verify != NULL) {
+        // An invalid image is reported by esp_ota_end()
+        esp_image_verify_stream_data(it->verify, data, size);
+    }
+}
+
 esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
 {
     const uint8_t *data_bytes = (const uint8_t *)data;
+    const size_t data_size = size;
     esp_err_t ret;
     ota_ops_entry_t *it;
 
@@ -214,6 +233,7 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
                     memcpy(it->partial_data + it->partial_bytes, data_bytes, copy_len);
                     it->partial_bytes += copy_len;
                     if (it->partial_bytes != 16) {
+                        ota_verify_data(it, data, data_size);
                         return ESP_OK; /* nothing to write yet, just filling buffer */
                     }
                     /* write 16 byte to partition */
@@ -239,6 +259,7 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
             ret = esp_partition_write(it->part, it->wrote_size, data_bytes, size);
             if(ret == ESP_OK){
                 it->wrote_size += size;
+                ota_verify_data(it, data, data_size);
             }
             return ret;
         }
@@ -273,6 +294,11 @@ esp_err_t esp_ota_write_with_offset(esp_ota_handle_t handle, const void *data, s
                 ESP_LOGE(TAG, "Size should be 16byte aligned for flash encryption case");
                 return ESP_ERR_INVALID_ARG;
             }
+            if (it->verify != NULL) {
+                // The image isn't written in order, esp_ota_end() reads it back to verify it
+                esp_image_verify_stream_abort(it->verify);
+                it->verify = NULL;
+            }
             ret = esp_partition_write(it->part, offset, data_bytes, size);
             if (ret == ESP_OK) {
                 it->wrote_size += size;
@@ -305,6 +331,7 @@ esp_err_t esp_ota_abort(esp_ota_handle_t handle)
         return ESP_ERR_NOT_FOUND;
     }
     LIST_REMOVE(it, entries);
+    esp_image_verify_stream_abort(it->verify);
     free(it);
     return ESP_OK;
 }
@@ -343,13 +370,22 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
       .size = it->part->size,
     };
 
-    if (esp_image_verify(ESP_IMAGE_VERIFY, &part_pos, &data) != ESP_OK) {
+    if (it->verify != NULL) {
+        // Headers, checksum and SHA-256 were processed while the image was written
+        esp_err_t err = esp_image_verify_stream_end(it->verify, &data);
+        it->verify = NULL;
+        if (err != ESP_OK) {
+            ret = ESP_ERR_OTA_VALIDATE_FAILED;
+            goto cleanup;
+        }
+    } else if (esp_image_verify(ESP_IMAGE_VERIFY, &part_pos, &data) != ESP_OK) {
         ret = ESP_ERR_OTA_VALIDATE_FAILED;
         goto cleanup;
     }
 
  cleanup:
     LIST_REMOVE(it, entries);
+    esp_image_verify_stream_abort(it->verify);
     free(it);
     return ret;
 }
@@ -98,6 +98,66 @@ _Static_assert(sizeof(rtc_retain_mem_t) <= ESP_BOOTLOADER_RESERVE_RTC, "Reserved
  */
 esp_err_t esp_image_verify(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_metadata_t *data);
 
+/**
+ * @brief Context of an app image verification done while the image is being written
+ */
+typedef struct esp_image_stream_verify esp_image_stream_verify_t;
+
+/**
+ * @brief Start verifying an app image as it is written to a partition.
+ *
+ * The image data is passed to esp_image_verify_stream_data() in the order it is written,
+ * so headers, segment checksums and SHA-256 are processed without reading the image back from flash.
+ * Only available in the app.
+ *
+ * @param mode Mode of operation (ESP_IMAGE_VERIFY or ESP_IMAGE_VERIFY_SILENT).
+ * @param part Partition the image is written to.
+ * @param[out] out_ctx On success, returns the verification context.
+ *
+ * @return
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the partition is invalid
+ * - ESP_ERR_NO_MEM if the context can't be allocated
+ */
+esp_err_t esp_image_verify_stream_begin(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_stream_verify_t **out_ctx);
+
+/**
+ * @brief Pass the next chunk of image data to the verification.
+ *
+ * Data after the image checksum (appended hash, signature) is ignored, it is read from flash
+ * by esp_image_verify_stream_end().
+ *
+ * @param ctx Verification context.
+ * @param src Image data, continuing from the previous call.
+ * @param len Length of the data.
+ *
+ * @return
+ * - ESP_OK if the data received so far is valid
+ * - ESP_ERR_IMAGE_INVALID or another error if the image appears invalid.
+ *   The same error is returned by all following calls.
+ */
+esp_err_t esp_image_verify_stream_data(esp_image_stream_verify_t *ctx, const void *src, size_t len);
+
+/**
+ * @brief Finish verifying an image and free the context.
+ *
+ * Checks the image checksum, the appended SHA-256 and the signature (if signature verification is enabled).
+ * The image must have been fully written to the partition.
+ *
+ * @param ctx Verification context, freed by this function.
+ * @param[out] data Optional, image metadata filled in same as by esp_image_verify().
+ *
+ * @return Same as esp_image_verify(). ESP_ERR_IMAGE_INVALID if the image is incomplete.
+ */
+esp_err_t esp_image_verify_stream_end(esp_image_stream_verify_t *ctx, esp_image_metadata_t *data);
+
+/**
+ * @brief Free a verification context without finishing the verification.
+ *
+ * @param ctx Verification context, can be NULL.
+ */
+void esp_image_verify_stream_abort(esp_image_stream_verify_t *ctx);
+
 /**
  * @brief Get metadata of app
  *
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <string.h>
+#include <stdlib.h>
 #include <sys/param.h>
 #include <esp_cpu.h>
 #include <bootloader_utility.h>
@@ -304,6 +305,263 @@ err:
     return err;
 }
 
+#ifndef BOOTLOADER_BUILD
+
+typedef enum {
+    STREAM_IMAGE_HEADER,
+    STREAM_SEGMENT_HEADER,
+    STREAM_SEGMENT_DATA,
+    STREAM_CHECKSUM,
+    STREAM_DONE,
+} stream_state_t;
+
+struct esp_image_stream_verify {
+    esp_image_metadata_t data;      /* Metadata collected so far, as in image_load() */
+    bootloader_sha256_handle_t sha_handle;
+    uint32_t checksum_word;
+    uint32_t part_size;
+    bool silent;
+    esp_err_t err;                  /* First error found in the stream */
+    stream_state_t state;
+    int segment;                    /* Index of the current segment */
+    uint32_t remain;                /* Bytes left in the current header, segment or checksum block */
+    WORD_ALIGNED_ATTR uint8_t buf[sizeof(esp_image_header_t)]; /* Header or checksum block being received */
+    size_t buf_len;
+    uint8_t word[4];                /* Segment data word split between two calls */
+    size_t word_len;
+};
+
+static void stream_next_segment(esp_image_stream_verify_t *ctx)
+{
+    esp_image_metadata_t *data = &ctx->data;
+    ctx->buf_len = 0;
+    if (ctx->segment < data->image.segment_count) {
+        ctx->state = STREAM_SEGMENT_HEADER;
+        ctx->remain = sizeof(esp_image_segment_header_t);
+    } else {
+        // Checksum is the last byte of the padding up to the next full 16 byte block
+        uint32_t unpadded_length = data->image_len;
+        uint32_t length = (unpadded_length + 1 + 15) & ~15;
+        ctx->state = STREAM_CHECKSUM;
+        ctx->remain = length - unpadded_length;
+    }
+}
+
+static void stream_checksum_data(esp_image_stream_verify_t *ctx, const uint8_t *src, size_t len)
+{
+    uint32_t w;
+    // Segment data starts word aligned relative to the image start, only the split between calls is unaligned
+    while (ctx->word_len != 0 && len > 0) {
+        ctx->word[ctx->word_len++] = *src++;
+        len--;
+        if (ctx->word_len == 4) {
+            memcpy(&w, ctx->word, 4);
+            ctx->checksum_word ^= w;
+            ctx->word_len = 0;
+        }
+    }
+    for (; len >= 4; src += 4, len -= 4) {
+        memcpy(&w, src, 4);
+        ctx->checksum_word ^= w;
+    }
+    if (len > 0) {
+        memcpy(ctx->word, src, len);
+        ctx->word_len = len;
+    }
+}
+
+static esp_err_t stream_process_block(esp_image_stream_verify_t *ctx)
+{
+    esp_err_t err = ESP_OK;
+    bool silent = ctx->silent;
+    esp_image_metadata_t *data = &ctx->data;
+
+    switch (ctx->state) {
+    case STREAM_IMAGE_HEADER:
+        memcpy(&data->image, ctx->buf, sizeof(esp_image_header_t));
+        // Calculate SHA-256 of image if secure boot is on, or if image has a hash appended
+        if (SECURE_BOOT_CHECK_SIGNATURE || data->image.hash_appended) {
+            ctx->sha_handle = bootloader_sha256_start();
+            if (ctx->sha_handle == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+            bootloader_sha256_data(ctx->sha_handle, &data->image, sizeof(esp_image_header_t));
+        }
+        CHECK_ERR(verify_image_header(data->start_addr, &data->image, silent));
+        data->image_len = sizeof(esp_image_header_t);
+        stream_next_segment(ctx);
+        break;
+    case STREAM_SEGMENT_HEADER: {
+        esp_image_segment_header_t *header = &data->segments[ctx->segment];
+        memcpy(header, ctx->buf, sizeof(esp_image_segment_header_t));
+        if (ctx->sha_handle != NULL) {
+            bootloader_sha256_data(ctx->sha_handle, header, sizeof(esp_image_segment_header_t));
+        }
+        uint32_t data_addr = data->start_addr + data->image_len + sizeof(esp_image_segment_header_t);
+        CHECK_ERR(verify_segment_header(ctx->segment, header, data_addr, silent));
+        if (header->data_len % 4 != 0) {
+            FAIL_LOAD("unaligned segment length 0x%x", header->data_len);
+        }
+        if (data_addr + header->data_len < data_addr) {
+            FAIL_LOAD("image offset has wrapped");
+        }
+        if (!silent) {
+            ESP_LOGI(TAG, "segment %d: paddr=%08x vaddr=%08x size=%05xh (%6d) %s",
+                     ctx->segment, data_addr, header->load_addr,
+                     header->data_len, header->data_len,
+                     should_map(header->load_addr) ? "map" : "");
+        }
+        data->segment_data[ctx->segment] = data_addr;
+        data->image_len += sizeof(esp_image_segment_header_t);
+        if (data->image_len > ctx->part_size || header->data_len > ctx->part_size - data->image_len) {
+            FAIL_LOAD("segment %d doesn't fit in partition length %d", ctx->segment, ctx->part_size);
+        }
+        ctx->state = STREAM_SEGMENT_DATA;
+        ctx->remain = header->data_len;
+        break;
+    }
+    case STREAM_SEGMENT_DATA:
+        data->image_len += data->segments[ctx->segment].data_len;
+        ctx->segment++;
+        stream_next_segment(ctx);
+        break;
+    case STREAM_CHECKSUM:
+        if (ctx->sha_handle != NULL) {
+            bootloader_sha256_data(ctx->sha_handle, ctx->buf, ctx->buf_len);
+        }
+        data->image_len += ctx->buf_len;
+        // The appended hash and signature are read from flash when the stream ends
+        ctx->state = STREAM_DONE;
+        break;
+    case STREAM_DONE:
+        break;
+    }
+    return ESP_OK;
+err:
+    if (err == ESP_OK) {
+        err = ESP_ERR_IMAGE_INVALID;
+    }
+    return err;
+}
+
+esp_err_t esp_image_verify_stream_begin(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_stream_verify_t **out_ctx)
+{
+    if (part == NULL || out_ctx == NULL || part->size > SIXTEEN_MB) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_image_stream_verify_t *ctx = calloc(1, sizeof(esp_image_stream_verify_t));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->data.start_addr = part->offset;
+    ctx->part_size = part->size;
+    ctx->silent = (mode == ESP_IMAGE_VERIFY_SILENT);
+    ctx->checksum_word = ESP_ROM_CHECKSUM_INITIAL;
+    ctx->state = STREAM_IMAGE_HEADER;
+    ctx->remain = sizeof(esp_image_header_t);
+    *out_ctx = ctx;
+    return ESP_OK;
+}
+
+esp_err_t esp_image_verify_stream_data(esp_image_stream_verify_t *ctx, const void *src, size_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)src;
+    while (ctx->err == ESP_OK && ctx->state != STREAM_DONE && len > 0) {
+        size_t n = MIN(len, ctx->remain);
+        if (ctx->state == STREAM_SEGMENT_DATA) {
+            stream_checksum_data(ctx, bytes, n);
+            if (ctx->sha_handle != NULL) {
+                bootloader_sha256_data(ctx->sha_handle, bytes, n);
+            }
+        } else {
+            memcpy(ctx->buf + ctx->buf_len, bytes, n);
+            ctx->buf_len += n;
+        }
+        bytes += n;
+        len -= n;
+        ctx->remain -= n;
+        // A segment may be empty, so several blocks can end here
+        while (ctx->err == ESP_OK && ctx->remain == 0 && ctx->state != STREAM_DONE) {
+            ctx->err = stream_process_block(ctx);
+        }
+    }
+    return ctx->err;
+}
+
+esp_err_t esp_image_verify_stream_end(esp_image_stream_verify_t *ctx, esp_image_metadata_t *data)
+{
+    esp_err_t err = ctx->err;
+    bool silent = ctx->silent;
+    bootloader_sha256_handle_t sha_handle = ctx->sha_handle;
+#if (SECURE_BOOT_CHECK_SIGNATURE == 1)
+    uint8_t image_digest[HASH_LEN] = { [ 0 ... 31] = 0xEE };
+    uint8_t verified_digest[HASH_LEN] = { [ 0 ... 31 ] = 0x01 };
+#endif
+
+    if (err != ESP_OK) {
+        goto err;
+    }
+    if (ctx->state != STREAM_DONE) {
+        FAIL_LOAD("image is truncated (%d bytes of segment %d missing)", ctx->remain, ctx->segment);
+    }
+
+    uint32_t checksum_word = ctx->checksum_word;
+    uint8_t read_checksum = ctx->buf[ctx->buf_len - 1];
+    uint8_t calc_checksum = (checksum_word >> 24) ^ (checksum_word >> 16) ^ (checksum_word >> 8) ^ (checksum_word >> 0);
+    if (!esp_cpu_in_ocd_debug_mode() && calc_checksum != read_checksum) {
+        FAIL_LOAD("Checksum failed. Calculated 0x%x read 0x%x", calc_checksum, read_checksum);
+    }
+    CHECK_ERR(process_appended_hash(&ctx->data, ctx->part_size, true, silent));
+
+    // Only the appended hash, the padding and the signature are read back from flash here
+#if (SECURE_BOOT_CHECK_SIGNATURE == 1)
+    err = verify_secure_boot_signature(sha_handle, &ctx->data, image_digest, verified_digest);
+    sha_handle = NULL; // verify_secure_boot_signature finishes sha_handle
+#else
+    if (sha_handle != NULL && !esp_cpu_in_ocd_debug_mode()) {
+        err = verify_simple_hash(sha_handle, &ctx->data);
+        sha_handle = NULL; // calling verify_simple_hash finishes sha_handle
+    }
+#endif
+    if (err != ESP_OK) {
+        goto err;
+    }
+    if (sha_handle != NULL) {
+        bootloader_sha256_finish(sha_handle, NULL);
+    }
+    if (data != NULL) {
+        memcpy(data, &ctx->data, sizeof(esp_image_metadata_t));
+    }
+    free(ctx);
+    return ESP_OK;
+
+err:
+    if (err == ESP_OK) {
+        err = ESP_ERR_IMAGE_INVALID;
+    }
+    if (sha_handle != NULL) {
+        bootloader_sha256_finish(sha_handle, NULL);
+    }
+    if (data != NULL) {
+        bzero(data, sizeof(esp_image_metadata_t));
+    }
+    free(ctx);
+    return err;
+}
+
+void esp_image_verify_stream_abort(esp_image_stream_verify_t *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+    if (ctx->sha_handle != NULL) {
+        bootloader_sha256_finish(ctx->sha_handle, NULL);
+    }
+    free(ctx);
+}
+
+#endif // !BOOTLOADER_BUILD
+
 static esp_err_t verify_image_header(uint32_t src_addr, const esp_image_header_t *image, bool silent)
 {
     esp_err_t err = ESP_OK;
@@ -9,6 +9,9 @@
 
 #include <esp_types.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/param.h>
 #include "string.h"
 
 #include "freertos/FreeRTOS.h"
@@ -53,6 +56,91 @@ TEST_CASE("Verify unit test app image", "[bootloader_support]")
     TEST_ASSERT_NOT_EQUAL(0, data.image_len);
     TEST_ASSERT_TRUE(data.image_len <= running->size);
 }
+
+static esp_err_t verify_image_stream(const esp_partition_t *part, size_t chunk_size, size_t corrupt_offset, esp_image_metadata_t *data)
+{
+    const esp_partition_pos_t pos = {
+        .offset = part->address,
+        .size = part->size,
+    };
+    esp_image_stream_verify_t *ctx = NULL;
+    TEST_ESP_OK(esp_image_verify_stream_begin(ESP_IMAGE_VERIFY, &pos, &ctx));
+    uint8_t *buf = malloc(chunk_size);
+    TEST_ASSERT_NOT_NULL(buf);
+    for (size_t offs = 0; offs < data->image_len; offs += chunk_size) {
+        size_t len = MIN(chunk_size, data->image_len - offs);
+        TEST_ESP_OK(esp_partition_read(part, offs, buf, len));
+        if (corrupt_offset >= offs && corrupt_offset < offs + len) {
+            buf[corrupt_offset - offs] ^= 0x01;
+        }
+        esp_image_verify_stream_data(ctx, buf, len);
+    }
+    free(buf);
+    return esp_image_verify_stream_end(ctx, data);
+}
+
+TEST_CASE("Verify unit test app image while streaming it", "[bootloader_support]")
+{
+    esp_image_metadata_t data = { 0 };
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    TEST_ASSERT_NOT_EQUAL(NULL, running);
+    const esp_partition_pos_t running_pos  = {
+        .offset = running->address,
+        .size = running->size,
+    };
+    TEST_ASSERT_EQUAL_HEX(ESP_OK, esp_image_verify(ESP_IMAGE_VERIFY, &running_pos, &data));
+
+    /* Chunk sizes which split headers and words of segment data */
+    const size_t chunk_sizes[] = { 4096, 1023, 7 };
+    for (int i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+        esp_image_metadata_t stream_data = { .image_len = data.image_len };
+        TEST_ASSERT_EQUAL_HEX(ESP_OK, verify_image_stream(running, chunk_sizes[i], SIZE_MAX, &stream_data));
+        TEST_ASSERT_EQUAL(data.image_len, stream_data.image_len);
+        TEST_ASSERT_EQUAL(data.image.segment_count, stream_data.image.segment_count);
+        TEST_ASSERT_EQUAL_MEMORY(data.segment_data, stream_data.segment_data, sizeof(data.segment_data));
+    }
+
+    /* A flipped bit in a segment is detected */
+    esp_image_metadata_t stream_data = { .image_len = data.image_len };
+    size_t corrupt_offset = data.segment_data[0] - running->address + data.segments[0].data_len / 2;
+    TEST_ASSERT_EQUAL_HEX(ESP_ERR_IMAGE_INVALID, verify_image_stream(running, 4096, corrupt_offset, &stream_data));
+
+    /* A truncated image is detected */
+    esp_image_metadata_t truncated_data = { .image_len = data.segment_data[0] - running->address };
+    TEST_ASSERT_EQUAL_HEX(ESP_ERR_IMAGE_INVALID, verify_image_stream(running, 4096, SIZE_MAX, &truncated_data));
+}
+
+/* Stream the image header and the first segment header of the running app, with the segment length replaced */
+static esp_err_t verify_stream_with_segment_len(uint32_t data_len)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    TEST_ASSERT_NOT_EQUAL(NULL, running);
+    const esp_partition_pos_t pos = {
+        .offset = running->address,
+        .size = running->size,
+    };
+    uint8_t headers[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)];
+    TEST_ESP_OK(esp_partition_read(running, 0, headers, sizeof(headers)));
+    esp_image_segment_header_t *segment = (esp_image_segment_header_t *)(headers + sizeof(esp_image_header_t));
+    segment->data_len = data_len;
+
+    esp_image_stream_verify_t *ctx = NULL;
+    TEST_ESP_OK(esp_image_verify_stream_begin(ESP_IMAGE_VERIFY, &pos, &ctx));
+    esp_err_t err = esp_image_verify_stream_data(ctx, headers, sizeof(headers));
+    esp_image_metadata_t data;
+    TEST_ASSERT_EQUAL_HEX(ESP_ERR_IMAGE_INVALID, esp_image_verify_stream_end(ctx, &data));
+    return err;
+}
+
+TEST_CASE("Streaming verification rejects invalid segment lengths", "[bootloader_support]")
+{
+    /* A valid length, the image is truncated after the header */
+    TEST_ASSERT_EQUAL_HEX(ESP_OK, verify_stream_with_segment_len(0x100));
+    /* Segment data must be made of words */
+    TEST_ASSERT_EQUAL_HEX(ESP_ERR_IMAGE_INVALID, verify_stream_with_segment_len(0x101));
+    /* The end of the segment would wrap around the address space, and the partition size check with it */
+    TEST_ASSERT_EQUAL_HEX(ESP_ERR_IMAGE_INVALID, verify_stream_with_segment_len(0xFFFFFFF0));
+}
 #endif //!TEMPORARY_DISABLED_FOR_TARGETS(ESP32C2)
 
 void check_label_search (int num_test, const char *list, const char *t_label, bool result)
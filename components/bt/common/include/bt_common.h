@@ -58,6 +58,18 @@
 #define BT_BLE_DYNAMIC_ENV_MEMORY  FALSE
 #endif
 
+#if UC_BT_OSI_ARRAY_CONTAINERS
+#define OSI_ARRAY_CONTAINERS       TRUE
+#else
+#define OSI_ARRAY_CONTAINERS       FALSE
+#endif
+
+#if UC_BT_CONFIG_NVS_PER_SECTION
+#define BT_CONFIG_NVS_PER_SECTION  TRUE
+#else
+#define BT_CONFIG_NVS_PER_SECTION  FALSE
+#endif
+
 /* OS Configuration from User config (eg: sdkconfig) */
 #define TASK_PINNED_TO_CORE         UC_TASK_PINNED_TO_CORE
 #define BT_TASK_MAX_PRIORITIES      configMAX_PRIORITIES
@@ -23,6 +23,18 @@
 #define UC_BT_BLE_DYNAMIC_ENV_MEMORY            FALSE
 #endif
 
+#ifdef CONFIG_BT_OSI_ARRAY_CONTAINERS
+#define UC_BT_OSI_ARRAY_CONTAINERS              CONFIG_BT_OSI_ARRAY_CONTAINERS
+#else
+#define UC_BT_OSI_ARRAY_CONTAINERS              FALSE
+#endif
+
+#ifdef CONFIG_BT_CONFIG_NVS_PER_SECTION
+#define UC_BT_CONFIG_NVS_PER_SECTION            CONFIG_BT_CONFIG_NVS_PER_SECTION
+#else
+#define UC_BT_CONFIG_NVS_PER_SECTION            FALSE
+#endif
+
 #ifdef CONFIG_BT_STACK_NO_LOG
 #define UC_BT_STACK_NO_LOG               CONFIG_BT_STACK_NO_LOG
 #else
@@ -19,10 +19,27 @@
 #include "osi/allocator.h"
 #include "osi/config.h"
 #include "osi/list.h"
+#include "osi/hash_map.h"
+#include "osi/hash_functions.h"
 
 #define CONFIG_FILE_MAX_SIZE             (1536)//1.5k
 #define CONFIG_FILE_DEFAULE_LENGTH       (2048)
 #define CONFIG_KEY                       "bt_cfg_key"
+// With BT_CONFIG_NVS_PER_SECTION, each section is saved in the entry
+// CONFIG_SECTION_KEY<slot>, and CONFIG_INDEX_KEY holds the slots in order
+#define CONFIG_INDEX_KEY                 "bt_cfg_idx"
+#define CONFIG_SECTION_KEY               "bt_cfg_s"
+#define CONFIG_KEYNAME_SIZE              (16)
+#define CONFIG_SLOT_NONE                 (0xFFFF)
+#define CONFIG_SECTION_INDEX_BUCKETS     (32)
+
+// Format of the config in NVS
+enum {
+    CONFIG_FORMAT_NONE,
+    CONFIG_FORMAT_BLOB,
+    CONFIG_FORMAT_SECTIONS,
+};
+
 typedef struct {
     char *key;
     char *value;
@@ -31,10 +48,18 @@ typedef struct {
 typedef struct {
     char *name;
     list_t *entries;
+    uint16_t slot;          // NVS entry of the section, CONFIG_SLOT_NONE if not saved yet
+    bool dirty;             // modified since the config was saved
 } section_t;
 
 struct config_t {
     list_t *sections;
+    hash_map_t *section_index;  // section name to section_t
+    bool sections_dirty;        // sections added or removed since the config was saved
+    uint8_t format;             // format of the config in NVS
+    uint16_t *removed_slots;    // NVS entries of the removed sections, erased on save
+    size_t num_removed_slots;
+    size_t max_removed_slots;
 };
 
 // Empty definition; this type is aliased to list_node_t.
@@ -45,6 +70,7 @@ static void config_parse(nvs_handle_t fp, config_t *config);
 static section_t *section_new(const char *name);
 static void section_free(void *ptr);
 static section_t *section_find(const config_t *config, const char *section);
+static bool section_name_equal(const void *x, const void *y);
 
 static entry_t *entry_new(const char *key, const char *value);
 static void entry_free(void *ptr);
@@ -64,6 +90,14 @@ config_t *config_new_empty(void)
         goto error;
     }
 
+    config->section_index = hash_map_new(CONFIG_SECTION_INDEX_BUCKETS, hash_function_string,
+                                         NULL, NULL, section_name_equal);
+    if (!config->section_index) {
+        OSI_TRACE_ERROR("%s unable to allocate index for sections.\n", __func__);
+        goto error;
+    }
+    config->sections_dirty = true;
+
     return config;
 
 error:;
@@ -105,7 +139,9 @@ void config_free(config_t *config)
         return;
     }
 
+    hash_map_free(config->section_index);
     list_free(config->sections);
+    osi_free(config->removed_slots);
     osi_free(config);
 }
 
@@ -221,24 +257,53 @@ void config_set_string(config_t *config, const char *section, const char *key, c
     section_t *sec = section_find(config, section);
     if (!sec) {
         sec = section_new(section);
+        if (!sec || !hash_map_set(config->section_index, sec->name, sec)) {
+            OSI_TRACE_ERROR("%s unable to allocate section %s.\n", __func__, section);
+            section_free(sec);
+            return;
+        }
         if (insert_back) {
             list_append(config->sections, sec);
         } else {
             list_prepend(config->sections, sec);
         }
+        config->sections_dirty = true;
     }
 
     for (const list_node_t *node = list_begin(sec->entries); node != list_end(sec->entries); node = list_next(node)) {
         entry_t *entry = list_node(node);
         if (!strcmp(entry->key, key)) {
-            osi_free(entry->value);
-            entry->value = osi_strdup(value);
+            if (strcmp(entry->value, value)) {
+                osi_free(entry->value);
+                entry->value = osi_strdup(value);
+                sec->dirty = true;
+            }
             return;
         }
     }
 
     entry_t *entry = entry_new(key, value);
     list_append(sec->entries, entry);
+    sec->dirty = true;
+}
+
+static void config_add_removed_slot(config_t *config, uint16_t slot)
+{
+    if (config->num_removed_slots == config->max_removed_slots) {
+        size_t max = config->max_removed_slots ? config->max_removed_slots * 2 : 4;
+        uint16_t *slots = osi_malloc(sizeof(uint16_t) * max);
+        if (!slots) {
+            // The entry stays in NVS, unused, until the slot is reused
+            return;
+        }
+        if (config->num_removed_slots) {
+            memcpy(slots, config->removed_slots, sizeof(uint16_t) * config->num_removed_slots);
+        }
+        osi_free(config->removed_slots);
+        config->removed_slots = slots;
+        config->max_removed_slots = max;
+    }
+    config->removed_slots[config->num_removed_slots++] = slot;
 }
 
 bool config_remove_section(config_t *config, const char *section)
@@ -251,6 +316,11 @@ bool config_remove_section(config_t *config, const char *section)
         return false;
     }
 
+    if (sec->slot != CONFIG_SLOT_NONE) {
+        config_add_removed_slot(config, sec->slot);
+    }
+    config->sections_dirty = true;
+    hash_map_erase(config->section_index, sec->name);
     return list_remove(config->sections, sec);
 }
 
@@ -268,6 +338,7 @@ bool config_remove_key(config_t *config, const char *section, const char *key)
     }
 
     ret = list_remove(sec->entries, entry);
+    sec->dirty = true;
     if (list_length(sec->entries) == 0) {
         OSI_TRACE_DEBUG("%s remove section name:%s",__func__, section);
         ret &= config_remove_section(config, section);
@@ -301,6 +372,287 @@ const char *config_section_name(const config_section_node_t *node)
     return section->name;
 }
 
+static void config_mark_saved(config_t *config, uint8_t format)
+{
+    for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
+        section_t *section = list_node(node);
+        section->dirty = false;
+    }
+    config->sections_dirty = false;
+    config->format = format;
+}
+
+static bool config_is_dirty(const config_t *config)
+{
+    if (config->sections_dirty) {
+        return true;
+    }
+    for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
+        const section_t *section = list_node(node);
+        if (section->dirty) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Erases the config saved one section per entry
+static esp_err_t config_erase_sections(nvs_handle_t fp)
+{
+    char keyname[CONFIG_KEYNAME_SIZE];
+    size_t length = 0;
+    uint16_t *slots;
+    esp_err_t err;
+
+    err = nvs_get_blob(fp, CONFIG_INDEX_KEY, NULL, &length);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    slots = osi_malloc(length + 1);
+    if (!slots) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = nvs_get_blob(fp, CONFIG_INDEX_KEY, slots, &length);
+    if (err == ESP_OK) {
+        // Without the index, the sections are not loaded anymore
+        err = nvs_erase_key(fp, CONFIG_INDEX_KEY);
+    }
+    for (size_t i = 0; err == ESP_OK && i < length / sizeof(uint16_t); i++) {
+        if (slots[i] == CONFIG_SLOT_NONE) {
+            continue;
+        }
+        snprintf(keyname, sizeof(keyname), "%s%u", CONFIG_SECTION_KEY, slots[i]);
+        err = nvs_erase_key(fp, keyname);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    osi_free(slots);
+    return err;
+}
+
+// Erases the config saved in the legacy format
+static esp_err_t config_erase_blob(nvs_handle_t fp)
+{
+    char keyname[CONFIG_KEYNAME_SIZE];
+    esp_err_t err;
+
+    for (uint16_t i = 0; i <= 0xFF; i++) {
+        snprintf(keyname, sizeof(keyname), "%s%d", CONFIG_KEY, i);
+        err = nvs_erase_key(fp, keyname);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            break;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+#if (BT_CONFIG_NVS_PER_SECTION == TRUE)
+static size_t section_size(const section_t *section)
+{
+    size_t size = strlen(section->name) + strlen("[]\n") + 1;// format "[section->name]\n" and '\0'
+
+    for (const list_node_t *enode = list_begin(section->entries); enode != list_end(section->entries); enode = list_next(enode)) {
+        const entry_t *entry = (const entry_t *)list_node(enode);
+        size += strlen(entry->key) + strlen(entry->value) + strlen(" = \n");// format "entry->key = entry->value\n"
+    }
+    return size;
+}
+
+// |size| must be at least section_size(|section|)
+static size_t section_write(const section_t *section, char *buf, size_t size)
+{
+    size_t len = snprintf(buf, size, "[%s]\n", section->name);
+
+    for (const list_node_t *enode = list_begin(section->entries); enode != list_end(section->entries); enode = list_next(enode)) {
+        const entry_t *entry = (const entry_t *)list_node(enode);
+        len += snprintf(buf + len, size - len, "%s = %s\n", entry->key, entry->value);
+    }
+    return len;
+}
+
+static bool config_slot_in_use(const config_t *config, uint16_t slot)
+{
+    for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
+        const section_t *section = list_node(node);
+        if (section->slot == slot) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Gives the lowest free slots to the sections which don't have one yet
+static bool config_assign_slots(config_t *config)
+{
+    size_t num_slots = list_length(config->sections) + 1;
+    uint8_t *used = osi_calloc((num_slots + 7) / 8);
+    uint16_t slot = 0;
+
+    if (!used) {
+        return false;
+    }
+    for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
+        const section_t *section = list_node(node);
+        if (section->slot < num_slots) {
+            used[section->slot / 8] |= 1 << (section->slot % 8);
+        }
+    }
+    for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
+        section_t *section = list_node(node);
+        if (section->slot != CONFIG_SLOT_NONE) {
+            continue;
+        }
+        while (used[slot / 8] & (1 << (slot % 8))) {
+            slot++;
+        }
+        used[slot / 8] |= 1 << (slot % 8);
+        section->slot = slot;
+        section->dirty = true;
+    }
+    osi_free(used);
+    return true;
+}
+
+static bool config_save_sections(config_t *config, const char *filename)
+{
+    esp_err_t err;
+    int err_code = 0;
+    nvs_handle_t fp;
+    char keyname[CONFIG_KEYNAME_SIZE];
+    // Everything is written if the config wasn't loaded from this format
+    const bool rewrite = (config->format != CONFIG_FORMAT_SECTIONS);
+    uint16_t *slots = NULL;
+    char *buf = NULL;
+    size_t buf_size = 0;
+
+    if (!rewrite && !config_is_dirty(config) && config->num_removed_slots == 0) {
+        return true;
+    }
+
+    err = nvs_open(filename, NVS_READWRITE, &fp);
+    if (err != ESP_OK) {
+        if (err == ESP_ERR_NVS_NOT_INITIALIZED) {
+            OSI_TRACE_ERROR("%s: NVS not initialized. "
+                      "Call nvs_flash_init before initializing bluetooth.", __func__);
+        }
+        OSI_TRACE_ERROR("%s, err_code: 0x%x\n", __func__, 0x02);
+        return false;
+    }
+
+    if (rewrite) {
+        // Sections left by a config which was freed without being loaded
+        err = config_erase_sections(fp);
+        if (err != ESP_OK) {
+            err_code |= 0x04;
+            goto error;
+        }
+        for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
+            section_t *section = list_node(node);
+            section->slot = CONFIG_SLOT_NONE;
+        }
+        config->num_removed_slots = 0;
+    }
+    if (!config_assign_slots(config)) {
+        err_code |= 0x01;
+        goto error;
+    }
+
+    for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
+        const section_t *section = list_node(node);
+        if (!rewrite && !section->dirty) {
+            continue;
+        }
+        size_t size = section_size(section);
+        if (size > buf_size) {
+            osi_free(buf);
+            buf = osi_malloc(size);
+            if (!buf) {
+                err_code |= 0x01;
+                goto error;
+            }
+            buf_size = size;
+        }
+        size_t length = section_write(section, buf, size);
+        snprintf(keyname, sizeof(keyname), "%s%u", CONFIG_SECTION_KEY, section->slot);
+        OSI_TRACE_DEBUG("save section %s in %s, %d\n", section->name, keyname, (int)length);
+        err = nvs_set_blob(fp, keyname, buf, length);
+        if (err != ESP_OK) {
+            err_code |= 0x04;
+            goto error;
+        }
+    }
+
+    // The index is written after the sections it refers to
+    if (rewrite || config->sections_dirty) {
+        size_t num_slots = 0;
+        slots = osi_malloc(sizeof(uint16_t) * (list_length(config->sections) + 1));
+        if (!slots) {
+            err_code |= 0x01;
+            goto error;
+        }
+        for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
+            const section_t *section = list_node(node);
+            slots[num_slots++] = section->slot;
+        }
+        if (num_slots == 0) {
+            // Keep the index of an empty config, so that it isn't loaded from the legacy format
+            slots[num_slots++] = CONFIG_SLOT_NONE;
+        }
+        err = nvs_set_blob(fp, CONFIG_INDEX_KEY, slots, sizeof(uint16_t) * num_slots);
+        if (err != ESP_OK) {
+            err_code |= 0x04;
+            goto error;
+        }
+    }
+
+    for (size_t i = 0; i < config->num_removed_slots; i++) {
+        if (config_slot_in_use(config, config->removed_slots[i])) {
+            continue;
+        }
+        snprintf(keyname, sizeof(keyname), "%s%u", CONFIG_SECTION_KEY, config->removed_slots[i]);
+        err = nvs_erase_key(fp, keyname);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            err_code |= 0x04;
+            goto error;
+        }
+    }
+    config->num_removed_slots = 0;
+
+    if (rewrite) {
+        err = config_erase_blob(fp);
+        if (err != ESP_OK) {
+            err_code |= 0x04;
+            goto error;
+        }
+    }
+
+    err = nvs_commit(fp);
+    if (err != ESP_OK) {
+        err_code |= 0x08;
+        goto error;
+    }
+
+    nvs_close(fp);
+    osi_free(buf);
+    osi_free(slots);
+    config_mark_saved(config, CONFIG_FORMAT_SECTIONS);
+    return true;
+
+error:
+    nvs_close(fp);
+    osi_free(buf);
+    osi_free(slots);
+    OSI_TRACE_ERROR("%s, err_code: 0x%x\n", __func__, err_code);
+    return false;
+}
+#else
 static int get_config_size(const config_t *config)
 {
     assert(config != NULL);
@@ -329,66 +681,38 @@ static int get_config_size(const config_t *config)
     return total_size;
 }
 
-static int get_config_size_from_flash(nvs_handle_t fp)
+// Writes the config text in the legacy format, split in blobs of CONFIG_FILE_MAX_SIZE
+static esp_err_t config_write_blob(nvs_handle_t fp, const char *buf, int length)
 {
-    assert(fp != 0);
-
-    esp_err_t err;
-    const size_t keyname_bufsz = sizeof(CONFIG_KEY) + 5 + 1; // including log10(sizeof(i))
-    char *keyname = osi_calloc(keyname_bufsz);
-    if (!keyname){
-        OSI_TRACE_ERROR("%s, malloc error\n", __func__);
-        return 0;
+    char keyname[CONFIG_KEYNAME_SIZE];
+    esp_err_t err = ESP_OK;
+    int count = length / CONFIG_FILE_MAX_SIZE;
+
+    assert(count <= 0xFF);
+    for (int i = 0; err == ESP_OK && i <= count; i++) {
+        int w_len = (i == count) ? length - i * CONFIG_FILE_MAX_SIZE : CONFIG_FILE_MAX_SIZE;
+        snprintf(keyname, sizeof(keyname), "%s%d", CONFIG_KEY, i);
+        err = nvs_set_blob(fp, keyname, buf + i * CONFIG_FILE_MAX_SIZE, w_len);
+        OSI_TRACE_DEBUG("save keyname = %s, i = %d, %d\n", keyname, i, w_len);
     }
-    size_t length = CONFIG_FILE_DEFAULE_LENGTH;
-    size_t total_length = 0;
-    uint16_t i = 0;
-    snprintf(keyname, keyname_bufsz, "%s%d", CONFIG_KEY, 0);
-    err = nvs_get_blob(fp, keyname, NULL, &length);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        osi_free(keyname);
-        return 0;
-    }
-    if (err != ESP_OK) {
-        OSI_TRACE_ERROR("%s, error %d\n", __func__, err);
-        osi_free(keyname);
-        return 0;
-    }
-    total_length += length;
-    while (length == CONFIG_FILE_MAX_SIZE) {
-        length = CONFIG_FILE_DEFAULE_LENGTH;
-        snprintf(keyname, keyname_bufsz, "%s%d", CONFIG_KEY, ++i);
-        err = nvs_get_blob(fp, keyname, NULL, &length);
-
-        if (err == ESP_ERR_NVS_NOT_FOUND) {
-            break;
-        }
-        if (err != ESP_OK) {
-            OSI_TRACE_ERROR("%s, error %d\n", __func__, err);
-            osi_free(keyname);
-            return 0;
-        }
-        total_length += length;
-    }
-    osi_free(keyname);
-    return total_length;
+    return err;
 }
 
-bool config_save(const config_t *config, const char *filename)
+static bool config_save_blob(config_t *config, const char *filename)
 {
-    assert(config != NULL);
-    assert(filename != NULL);
-    assert(*filename != '\0');
-
     esp_err_t err;
     int err_code = 0;
     nvs_handle_t fp;
     char *line = osi_calloc(1024);
-    const size_t keyname_bufsz = sizeof(CONFIG_KEY) + 5 + 1; // including log10(sizeof(i))
-    char *keyname = osi_calloc(keyname_bufsz);
     int config_size = get_config_size(config);
-    char *buf = osi_calloc(config_size);
-    if (!line || !buf || !keyname) {
+    char *buf = NULL;
+
+    if (config->format == CONFIG_FORMAT_BLOB && !config_is_dirty(config)) {
+        osi_free(line);
+        return true;
+    }
+    buf = osi_calloc(config_size);
+    if (!line || !buf) {
         err_code |= 0x01;
         goto error;
     }
@@ -449,33 +773,39 @@ bool config_save(const config_t *config, const char *filename)
         }
     }
     buf[w_cnt_total] = '\0';
-    if (w_cnt_total < CONFIG_FILE_MAX_SIZE) {
-        snprintf(keyname, keyname_bufsz, "%s%d", CONFIG_KEY, 0);
-        err = nvs_set_blob(fp, keyname, buf, w_cnt_total);
+    err = config_write_blob(fp, buf, w_cnt_total);
+    if (err == ESP_ERR_NVS_NOT_ENOUGH_SPACE && config->format != CONFIG_FORMAT_BLOB) {
+        // The sections still take their room. Free it and write the blob again,
+        // the config is not in flash until this write completes.
+        OSI_TRACE_WARNING("%s, not enough space to convert the config, erasing the sections first\n", __func__);
+        err = config_erase_blob(fp);
+        if (err == ESP_OK) {
+            err = config_erase_sections(fp);
+        }
+        if (err == ESP_OK) {
+            err = config_write_blob(fp, buf, w_cnt_total);
+        }
+    }
+    if (err == ESP_ERR_NVS_NOT_ENOUGH_SPACE) {
+        nvs_close(fp);
+        err_code |= 0x40;
+        goto error;
+    }
+    if (err != ESP_OK) {
+        nvs_close(fp);
+        err_code |= 0x04;
+        goto error;
+    }
+
+    // The index takes precedence over the blob when loading, so the sections are only
+    // erased once the blob is written: an interrupted conversion loads them again
+    if (config->format != CONFIG_FORMAT_BLOB) {
+        err = config_erase_sections(fp);
         if (err != ESP_OK) {
             nvs_close(fp);
             err_code |= 0x04;
             goto error;
         }
-    }else {
-        int count = (w_cnt_total / CONFIG_FILE_MAX_SIZE);
-        assert(count <= 0xFF);
-        for (uint8_t i = 0; i <= count; i++)
-        {
-            snprintf(keyname, keyname_bufsz, "%s%d", CONFIG_KEY, i);
-            if (i == count) {
-                err = nvs_set_blob(fp, keyname, buf + i*CONFIG_FILE_MAX_SIZE, w_cnt_total - i*CONFIG_FILE_MAX_SIZE);
-                OSI_TRACE_DEBUG("save keyname = %s, i = %d, %d\n", keyname, i, w_cnt_total - i*CONFIG_FILE_MAX_SIZE);
-            }else {
-                err = nvs_set_blob(fp, keyname, buf + i*CONFIG_FILE_MAX_SIZE, CONFIG_FILE_MAX_SIZE);
-                OSI_TRACE_DEBUG("save keyname = %s, i = %d, %d\n", keyname, i, CONFIG_FILE_MAX_SIZE);
-            }
-            if (err != ESP_OK) {
-                nvs_close(fp);
-                err_code |= 0x04;
-                goto error;
-            }
-        }
     }
 
     err = nvs_commit(fp);
@@ -488,7 +818,7 @@ bool config_save(const config_t *config, const char *filename)
     nvs_close(fp);
     osi_free(line);
     osi_free(buf);
-    osi_free(keyname);
+    config_mark_saved(config, CONFIG_FORMAT_BLOB);
     return true;
 
 error:
@@ -498,89 +828,99 @@ error:
     if (line) {
         osi_free(line);
     }
-    if (keyname) {
-        osi_free(keyname);
-    }
     if (err_code) {
         OSI_TRACE_ERROR("%s, err_code: 0x%x\n", __func__, err_code);
     }
     return false;
 }
+#endif /* BT_CONFIG_NVS_PER_SECTION == TRUE */
 
-static char *trim(char *str)
-{
-    while (isspace((unsigned char)(*str))) {
-        ++str;
-    }
-
-    if (!*str) {
-        return str;
-    }
-
-    char *end_str = str + strlen(str) - 1;
-    while (end_str > str && isspace((unsigned char)(*end_str))) {
-        --end_str;
-    }
-
-    end_str[1] = '\0';
-    return str;
-}
-
-static void config_parse(nvs_handle_t fp, config_t *config)
+static int get_config_size_from_flash(nvs_handle_t fp)
 {
     assert(fp != 0);
-    assert(config != NULL);
 
     esp_err_t err;
-    int line_num = 0;
-    int err_code = 0;
-    uint16_t i = 0;
-    size_t length = CONFIG_FILE_DEFAULE_LENGTH;
-    size_t total_length = 0;
-    char *line = osi_calloc(1024);
-    char *section = osi_calloc(1024);
     const size_t keyname_bufsz = sizeof(CONFIG_KEY) + 5 + 1; // including log10(sizeof(i))
     char *keyname = osi_calloc(keyname_bufsz);
-    int buf_size = get_config_size_from_flash(fp);
-    char *buf = NULL;
-
-    if(buf_size == 0) { //First use nvs
-        goto error;
-    }
-    buf = osi_calloc(buf_size);
-    if (!line || !section || !buf || !keyname) {
-        err_code |= 0x01;
-        goto error;
+    if (!keyname){
+        OSI_TRACE_ERROR("%s, malloc error\n", __func__);
+        return 0;
     }
+    size_t length = CONFIG_FILE_DEFAULE_LENGTH;
+    size_t total_length = 0;
+    uint16_t i = 0;
     snprintf(keyname, keyname_bufsz, "%s%d", CONFIG_KEY, 0);
-    err = nvs_get_blob(fp, keyname, buf, &length);
+    err = nvs_get_blob(fp, keyname, NULL, &length);
     if (err == ESP_ERR_NVS_NOT_FOUND) {
-        goto error;
+        osi_free(keyname);
+        return 0;
     }
     if (err != ESP_OK) {
-        err_code |= 0x02;
-        goto error;
+        OSI_TRACE_ERROR("%s, error %d\n", __func__, err);
+        osi_free(keyname);
+        return 0;
     }
     total_length += length;
     while (length == CONFIG_FILE_MAX_SIZE) {
         length = CONFIG_FILE_DEFAULE_LENGTH;
         snprintf(keyname, keyname_bufsz, "%s%d", CONFIG_KEY, ++i);
-        err = nvs_get_blob(fp, keyname, buf + CONFIG_FILE_MAX_SIZE * i, &length);
+        err = nvs_get_blob(fp, keyname, NULL, &length);
 
         if (err == ESP_ERR_NVS_NOT_FOUND) {
             break;
         }
         if (err != ESP_OK) {
-            err_code |= 0x02;
-            goto error;
+            OSI_TRACE_ERROR("%s, error %d\n", __func__, err);
+            osi_free(keyname);
+            return 0;
         }
         total_length += length;
     }
+    osi_free(keyname);
+    return total_length;
+}
+
+bool config_save(config_t *config, const char *filename)
+{
+    assert(config != NULL);
+    assert(filename != NULL);
+    assert(*filename != '\0');
+
+#if (BT_CONFIG_NVS_PER_SECTION == TRUE)
+    return config_save_sections(config, filename);
+#else
+    return config_save_blob(config, filename);
+#endif
+}
+
+static char *trim(char *str)
+{
+    while (isspace((unsigned char)(*str))) {
+        ++str;
+    }
+
+    if (!*str) {
+        return str;
+    }
+
+    char *end_str = str + strlen(str) - 1;
+    while (end_str > str && isspace((unsigned char)(*end_str))) {
+        --end_str;
+    }
+
+    end_str[1] = '\0';
+    return str;
+}
+
+// Parses the |length| characters of |buf|, NUL terminated. |line| and |section| are 1024 bytes buffers
+static void config_parse_text(config_t *config, char *buf, size_t length, char *line, char *section)
+{
+    int line_num = 0;
     char *p_line_end;
     char *p_line_bgn = buf;
     strcpy(section, CONFIG_DEFAULT_SECTION);
 
-    while ( (p_line_bgn < buf + total_length - 1) && (p_line_end = strchr(p_line_bgn, '\n'))) {
+    while ( (p_line_bgn < buf + length - 1) && (p_line_end = strchr(p_line_bgn, '\n'))) {
 
         // get one line
         int line_len = p_line_end - p_line_bgn;
@@ -617,6 +957,147 @@ static void config_parse(nvs_handle_t fp, config_t *config)
             config_set_string(config, section, trim(line_ptr), trim(split + 1), true);
         }
     }
+}
+
+static void config_parse_sections(nvs_handle_t fp, config_t *config, size_t length)
+{
+    esp_err_t err;
+    int err_code = 0;
+    bool damaged = false;
+    char keyname[CONFIG_KEYNAME_SIZE];
+    uint16_t *slots = osi_malloc(length + 1);
+    char *line = osi_calloc(1024);
+    char *section = osi_calloc(1024);
+    char *buf = NULL;
+    size_t buf_size = 0;
+
+    if (!slots || !line || !section) {
+        err_code |= 0x01;
+        goto error;
+    }
+    err = nvs_get_blob(fp, CONFIG_INDEX_KEY, slots, &length);
+    if (err != ESP_OK) {
+        err_code |= 0x02;
+        goto error;
+    }
+
+    for (size_t i = 0; i < length / sizeof(uint16_t); i++) {
+        size_t size = 0;
+        if (slots[i] == CONFIG_SLOT_NONE) {
+            continue;
+        }
+        snprintf(keyname, sizeof(keyname), "%s%u", CONFIG_SECTION_KEY, slots[i]);
+        err = nvs_get_blob(fp, keyname, NULL, &size);
+        if (err == ESP_OK && size + 1 > buf_size) {
+            osi_free(buf);
+            buf = osi_malloc(size + 1);
+            if (!buf) {
+                err_code |= 0x01;
+                goto error;
+            }
+            buf_size = size + 1;
+        }
+        if (err == ESP_OK) {
+            err = nvs_get_blob(fp, keyname, buf, &size);
+        }
+        if (err != ESP_OK) {
+            OSI_TRACE_WARNING("%s unable to read %s, error %d\n", __func__, keyname, err);
+            damaged = true;
+            continue;
+        }
+        buf[size] = '\0';
+
+        size_t num_sections = list_length(config->sections);
+        config_parse_text(config, buf, size, line, section);
+        if (list_length(config->sections) > num_sections) {
+            section_t *sec = list_back(config->sections);
+            sec->slot = slots[i];
+        } else {
+            // Empty, or merged into an existing section
+            config_add_removed_slot(config, slots[i]);
+            damaged = true;
+        }
+    }
+
+    if (damaged) {
+        // Sections stay dirty, all of them are written back on the next save
+        config->format = CONFIG_FORMAT_SECTIONS;
+    } else {
+        config_mark_saved(config, CONFIG_FORMAT_SECTIONS);
+    }
+
+error:
+    osi_free(buf);
+    osi_free(slots);
+    osi_free(line);
+    osi_free(section);
+    if (err_code) {
+        OSI_TRACE_ERROR("%s returned with err code: %d\n", __func__, err_code);
+    }
+}
+
+static void config_parse(nvs_handle_t fp, config_t *config)
+{
+    assert(fp != 0);
+    assert(config != NULL);
+
+    esp_err_t err;
+    int err_code = 0;
+    uint16_t i = 0;
+    size_t length = 0;
+    size_t total_length = 0;
+    char *line = NULL;
+    char *section = NULL;
+    const size_t keyname_bufsz = sizeof(CONFIG_KEY) + 5 + 1; // including log10(sizeof(i))
+    char *keyname = NULL;
+    int buf_size;
+    char *buf = NULL;
+
+    // The index is only present if the config was saved one section per entry
+    if (nvs_get_blob(fp, CONFIG_INDEX_KEY, NULL, &length) == ESP_OK) {
+        config_parse_sections(fp, config, length);
+        return;
+    }
+
+    length = CONFIG_FILE_DEFAULE_LENGTH;
+    buf_size = get_config_size_from_flash(fp);
+    if(buf_size == 0) { //First use nvs
+        goto error;
+    }
+    line = osi_calloc(1024);
+    section = osi_calloc(1024);
+    keyname = osi_calloc(keyname_bufsz);
+    buf = osi_calloc(buf_size);
+    if (!line || !section || !buf || !keyname) {
+        err_code |= 0x01;
+        goto error;
+    }
+    snprintf(keyname, keyname_bufsz, "%s%d", CONFIG_KEY, 0);
+    err = nvs_get_blob(fp, keyname, buf, &length);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        goto error;
+    }
+    if (err != ESP_OK) {
+        err_code |= 0x02;
+        goto error;
+    }
+    total_length += length;
+    while (length == CONFIG_FILE_MAX_SIZE) {
+        length = CONFIG_FILE_DEFAULE_LENGTH;
+        snprintf(keyname, keyname_bufsz, "%s%d", CONFIG_KEY, ++i);
+        err = nvs_get_blob(fp, keyname, buf + CONFIG_FILE_MAX_SIZE * i, &length);
+
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            break;
+        }
+        if (err != ESP_OK) {
+            err_code |= 0x02;
+            goto error;
+        }
+        total_length += length;
+    }
+    config_parse_text(config, buf, total_length, line, section);
+    config_mark_saved(config, CONFIG_FORMAT_BLOB);
 
 error:
     if (buf) {
@@ -645,6 +1126,12 @@ static section_t *section_new(const char *name)
 
     section->name = osi_strdup(name);
     section->entries = list_new(entry_free);
+    section->slot = CONFIG_SLOT_NONE;
+    section->dirty = true;
+    if (!section->name || !section->entries) {
+        section_free(section);
+        return NULL;
+    }
     return section;
 }
 
@@ -662,14 +1149,12 @@ static void section_free(void *ptr)
 
 static section_t *section_find(const config_t *config, const char *section)
 {
-    for (const list_node_t *node = list_begin(config->sections); node != list_end(config->sections); node = list_next(node)) {
-        section_t *sec = list_node(node);
-        if (!strcmp(sec->name, section)) {
-            return sec;
-        }
-    }
+    return hash_map_get(config->section_index, section);
+}
 
-    return NULL;
+static bool section_name_equal(const void *x, const void *y)
+{
+    return !strcmp((const char *)x, (const char *)y);
 }
 
 static entry_t *entry_new(const char *key, const char *value)
@@ -16,6 +16,7 @@
  *
  ******************************************************************************/
 
+#include "bt_common.h"
 #include "osi/allocator.h"
 #include "osi/fixed_queue.h"
 #include "osi/list.h"
@@ -23,9 +24,22 @@
 #include "osi/mutex.h"
 #include "osi/semaphore.h"
 
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+// Initial number of ring buffer slots, the ring doubles up to the capacity
+// of the queue when it is full.
+#define FIXED_QUEUE_RING_INITIAL_SIZE   8
+#endif
+
 typedef struct fixed_queue_t {
 
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    void **ring;
+    size_t ring_size;
+    size_t head;
+    size_t length;
+#else
     list_t *list;
+#endif
     osi_sem_t enqueue_sem;
     osi_sem_t dequeue_sem;
     osi_mutex_t lock;
@@ -34,6 +48,59 @@ typedef struct fixed_queue_t {
     fixed_queue_cb dequeue_ready;
 } fixed_queue_t;
 
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+static inline void **ring_slot(const fixed_queue_t *queue, size_t index)
+{
+    index += queue->head;
+    if (index >= queue->ring_size) {
+        index -= queue->ring_size;
+    }
+    return &queue->ring[index];
+}
+
+static bool ring_grow(fixed_queue_t *queue)
+{
+    size_t size = queue->ring_size * 2;
+    if (size > queue->capacity) {
+        size = queue->capacity;
+    }
+
+    void **ring = osi_malloc(sizeof(void *) * size);
+    if (ring == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < queue->length; i++) {
+        ring[i] = *ring_slot(queue, i);
+    }
+    osi_free(queue->ring);
+    queue->ring = ring;
+    queue->ring_size = size;
+    queue->head = 0;
+    return true;
+}
+
+static size_t ring_find(const fixed_queue_t *queue, const void *data)
+{
+    size_t i;
+
+    for (i = 0; i < queue->length; i++) {
+        if (*ring_slot(queue, i) == data) {
+            break;
+        }
+    }
+    return i;
+}
+
+static void ring_remove(fixed_queue_t *queue, size_t index)
+{
+    for (size_t i = index + 1; i < queue->length; i++) {
+        *ring_slot(queue, i - 1) = *ring_slot(queue, i);
+    }
+    queue->length--;
+}
+#endif
+
 
 fixed_queue_t *fixed_queue_new(size_t capacity)
 {
@@ -45,10 +112,18 @@ fixed_queue_t *fixed_queue_new(size_t capacity)
     osi_mutex_new(&ret->lock);
     ret->capacity = capacity;
 
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    ret->ring_size = capacity < FIXED_QUEUE_RING_INITIAL_SIZE ? capacity : FIXED_QUEUE_RING_INITIAL_SIZE;
+    ret->ring = osi_malloc(sizeof(void *) * (ret->ring_size ? ret->ring_size : 1));
+    if (!ret->ring) {
+        goto error;
+    }
+#else
     ret->list = list_new(NULL);
     if (!ret->list) {
         goto error;
     }
+#endif
 
 
     osi_sem_new(&ret->enqueue_sem, capacity, capacity);
@@ -70,7 +145,9 @@ error:;
 
 void fixed_queue_free(fixed_queue_t *queue, fixed_queue_free_cb free_cb)
 {
+#if (OSI_ARRAY_CONTAINERS == FALSE)
     const list_node_t *node;
+#endif
 
     if (queue == NULL) {
 	    return;
@@ -78,6 +155,15 @@ void fixed_queue_free(fixed_queue_t *queue, fixed_queue_free_cb free_cb)
 
     fixed_queue_unregister_dequeue(queue);
 
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    if (free_cb && queue->ring) {
+        for (size_t i = 0; i < queue->length; i++) {
+            free_cb(*ring_slot(queue, i));
+        }
+    }
+
+    osi_free(queue->ring);
+#else
     if (free_cb) {
         for (node = list_begin(queue->list); node != list_end(queue->list); node = list_next(node)) {
             free_cb(list_node(node));
@@ -85,6 +171,7 @@ void fixed_queue_free(fixed_queue_t *queue, fixed_queue_free_cb free_cb)
     }
 
     list_free(queue->list);
+#endif
     osi_sem_free(&queue->enqueue_sem);
     osi_sem_free(&queue->dequeue_sem);
     osi_mutex_free(&queue->lock);
@@ -100,7 +187,11 @@ bool fixed_queue_is_empty(fixed_queue_t *queue)
     }
 
     osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    is_empty = (queue->length == 0);
+#else
     is_empty = list_is_empty(queue->list);
+#endif
     osi_mutex_unlock(&queue->lock);
 
     return is_empty;
@@ -115,7 +206,11 @@ size_t fixed_queue_length(fixed_queue_t *queue)
     }
 
     osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    length = queue->length;
+#else
     length = list_length(queue->list);
+#endif
     osi_mutex_unlock(&queue->lock);
 
     return length;
@@ -139,11 +234,23 @@ bool fixed_queue_enqueue(fixed_queue_t *queue, void *data, uint32_t timeout)
     }
 
     osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    if (queue->length < queue->ring_size || ring_grow(queue)) {
+        *ring_slot(queue, queue->length) = data;
+        queue->length++;
+        status = true;
+    }
+#else
     status = list_append(queue->list, data); //Check whether enqueued success
+#endif
     osi_mutex_unlock(&queue->lock);
 
     if(status == true )
         osi_sem_give(&queue->dequeue_sem);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    else
+        osi_sem_give(&queue->enqueue_sem);
+#endif
 
     return status;
 }
@@ -159,8 +266,14 @@ void *fixed_queue_dequeue(fixed_queue_t *queue, uint32_t timeout)
     }
 
     osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    ret = *ring_slot(queue, 0);
+    queue->head = (queue->head + 1 == queue->ring_size) ? 0 : queue->head + 1;
+    queue->length--;
+#else
     ret = list_front(queue->list);
     list_remove(queue->list, ret);
+#endif
     osi_mutex_unlock(&queue->lock);
 
     osi_sem_give(&queue->enqueue_sem);
@@ -177,7 +290,11 @@ void *fixed_queue_try_peek_first(fixed_queue_t *queue)
     }
 
     osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    ret = queue->length ? *ring_slot(queue, 0) : NULL;
+#else
     ret = list_is_empty(queue->list) ? NULL : list_front(queue->list);
+#endif
     osi_mutex_unlock(&queue->lock);
 
     return ret;
@@ -192,7 +309,11 @@ void *fixed_queue_try_peek_last(fixed_queue_t *queue)
     }
 
     osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    ret = queue->length ? *ring_slot(queue, queue->length - 1) : NULL;
+#else
     ret = list_is_empty(queue->list) ? NULL : list_back(queue->list);
+#endif
     osi_mutex_unlock(&queue->lock);
 
     return ret;
@@ -207,11 +328,20 @@ void *fixed_queue_try_remove_from_queue(fixed_queue_t *queue, void *data)
     }
 
     osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    size_t index = ring_find(queue, data);
+    if (index < queue->length &&
+            osi_sem_take(&queue->dequeue_sem, 0) == 0) {
+        ring_remove(queue, index);
+        removed = true;
+    }
+#else
     if (list_contains(queue->list, data) &&
             osi_sem_take(&queue->dequeue_sem, 0) == 0) {
         removed = list_remove(queue->list, data);
         assert(removed);
     }
+#endif
     osi_mutex_unlock(&queue->lock);
 
     if (removed) {
@@ -222,6 +352,64 @@ void *fixed_queue_try_remove_from_queue(fixed_queue_t *queue, void *data)
     return NULL;
 }
 
+void *fixed_queue_iter_begin(fixed_queue_t *queue, fixed_queue_iter_t *iter)
+{
+    void *ret = NULL;
+
+    assert(queue != NULL);
+    assert(iter != NULL);
+
+    osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    // |pos| is the element returned last, at |index|
+    ret = queue->length ? *ring_slot(queue, 0) : NULL;
+    iter->pos = ret;
+    iter->index = 0;
+#else
+    // |pos| is the node following the element returned last, so that the
+    // element can be removed
+    const list_node_t *node = list_begin(queue->list);
+    if (node != list_end(queue->list)) {
+        ret = list_node(node);
+        node = list_next(node);
+    }
+    iter->pos = node;
+#endif
+    osi_mutex_unlock(&queue->lock);
+
+    return ret;
+}
+
+void *fixed_queue_iter_next(fixed_queue_t *queue, fixed_queue_iter_t *iter)
+{
+    void *ret = NULL;
+
+    assert(queue != NULL);
+    assert(iter != NULL);
+
+    osi_mutex_lock(&queue->lock, OSI_MUTEX_MAX_TIMEOUT);
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+    if (iter->pos != NULL) {
+        // If the element returned last was removed, the next one took its slot
+        if (iter->index < queue->length && *ring_slot(queue, iter->index) == iter->pos) {
+            iter->index++;
+        }
+        ret = iter->index < queue->length ? *ring_slot(queue, iter->index) : NULL;
+        iter->pos = ret;
+    }
+#else
+    const list_node_t *node = iter->pos;
+    if (node != list_end(queue->list)) {
+        ret = list_node(node);
+        iter->pos = list_next(node);
+    }
+#endif
+    osi_mutex_unlock(&queue->lock);
+
+    return ret;
+}
+
+#if (OSI_ARRAY_CONTAINERS == FALSE)
 list_t *fixed_queue_get_list(fixed_queue_t *queue)
 {
     assert(queue != NULL);
@@ -230,6 +418,7 @@ list_t *fixed_queue_get_list(fixed_queue_t *queue)
     // calling osi_mutex_lock() / osi_mutex_unlock()
     return queue->list;
 }
+#endif
 
 void fixed_queue_register_dequeue(fixed_queue_t *queue, fixed_queue_cb ready_cb)
 {
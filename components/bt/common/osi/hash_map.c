@@ -21,6 +21,236 @@
 #include "osi/hash_map.h"
 #include "osi/allocator.h"
 
+static bool default_key_equality(const void *x, const void *y);
+
+#if (OSI_ARRAY_CONTAINERS == TRUE)
+
+// Open addressing with linear probing. The entries are stored in a table of
+// a power of two size, which doubles when it is three quarters full. A free
+// slot has NULL data, as NULL data can't be set.
+#define HASH_MAP_MIN_ENTRIES_BITS   2
+#define HASH_MAP_MIN_ENTRIES        (1 << HASH_MAP_MIN_ENTRIES_BITS)
+
+typedef struct hash_map_t {
+    hash_map_entry_t *entry;
+    size_t num_entry;
+    uint8_t num_entry_bits;
+    size_t hash_size;
+    hash_index_fn hash_fn;
+    key_free_fn key_fn;
+    data_free_fn data_fn;
+    key_equality_fn keys_are_equal;
+} hash_map_t;
+
+static inline size_t entry_index_(const hash_map_t *hash_map, const void *key)
+{
+    // The hash functions don't spread their values, e.g. aligned pointers, so
+    // take the top bits of a multiplicative hash
+    return ((uint32_t)hash_map->hash_fn(key) * 0x9E3779B1U) >> (32 - hash_map->num_entry_bits);
+}
+
+// Returns the entry of |key|, or the free entry where it would be set.
+static hash_map_entry_t *find_entry_(const hash_map_t *hash_map, const void *key)
+{
+    size_t i = entry_index_(hash_map, key);
+
+    while (hash_map->entry[i].data != NULL &&
+            !hash_map->keys_are_equal(hash_map->entry[i].key, key)) {
+        i = (i + 1) & (hash_map->num_entry - 1);
+    }
+    return &hash_map->entry[i];
+}
+
+static bool grow_(hash_map_t *hash_map)
+{
+    hash_map_entry_t *old = hash_map->entry;
+    size_t old_num = hash_map->num_entry;
+
+    hash_map->entry = osi_calloc(sizeof(hash_map_entry_t) * old_num * 2);
+    if (hash_map->entry == NULL) {
+        hash_map->entry = old;
+        return false;
+    }
+    hash_map->num_entry = old_num * 2;
+    hash_map->num_entry_bits++;
+
+    for (size_t i = 0; i < old_num; i++) {
+        if (old[i].data != NULL) {
+            *find_entry_(hash_map, old[i].key) = old[i];
+        }
+    }
+    osi_free(old);
+    return true;
+}
+
+hash_map_t *hash_map_new_internal(
+    size_t num_bucket,
+    hash_index_fn hash_fn,
+    key_free_fn key_fn,
+    data_free_fn data_fn,
+    key_equality_fn equality_fn)
+{
+    assert(hash_fn != NULL);
+    assert(num_bucket > 0);
+    hash_map_t *hash_map = osi_calloc(sizeof(hash_map_t));
+    if (hash_map == NULL) {
+        return NULL;
+    }
+
+    hash_map->hash_fn = hash_fn;
+    hash_map->key_fn = key_fn;
+    hash_map->data_fn = data_fn;
+    hash_map->keys_are_equal = equality_fn ? equality_fn : default_key_equality;
+
+    hash_map->num_entry = HASH_MAP_MIN_ENTRIES;
+    hash_map->num_entry_bits = HASH_MAP_MIN_ENTRIES_BITS;
+    while (hash_map->num_entry < num_bucket) {
+        hash_map->num_entry *= 2;
+        hash_map->num_entry_bits++;
+    }
+    hash_map->entry = osi_calloc(sizeof(hash_map_entry_t) * hash_map->num_entry);
+    if (hash_map->entry == NULL) {
+        osi_free(hash_map);
+        return NULL;
+    }
+    return hash_map;
+}
+
+void hash_map_free(hash_map_t *hash_map)
+{
+    if (hash_map == NULL) {
+        return;
+    }
+    hash_map_clear(hash_map);
+    osi_free(hash_map->entry);
+    osi_free(hash_map);
+}
+
+bool hash_map_has_key(const hash_map_t *hash_map, const void *key)
+{
+    assert(hash_map != NULL);
+
+    return (find_entry_(hash_map, key)->data != NULL);
+}
+
+bool hash_map_set(hash_map_t *hash_map, const void *key, void *data)
+{
+    assert(hash_map != NULL);
+    assert(data != NULL);
+
+    hash_map_entry_t *hash_map_entry = find_entry_(hash_map, key);
+
+    if (hash_map_entry->data != NULL) {
+        // Same as removing the previous entry
+        if (hash_map->key_fn) {
+            hash_map->key_fn((void *)hash_map_entry->key);
+        }
+        if (hash_map->data_fn) {
+            hash_map->data_fn(hash_map_entry->data);
+        }
+    } else {
+        if ((hash_map->hash_size + 1) * 4 > hash_map->num_entry * 3) {
+            if (!grow_(hash_map)) {
+                return false;
+            }
+            hash_map_entry = find_entry_(hash_map, key);
+        }
+        hash_map->hash_size++;
+    }
+
+    hash_map_entry->key = key;
+    hash_map_entry->data = data;
+    hash_map_entry->hash_map = hash_map;
+
+    return true;
+}
+
+bool hash_map_erase(hash_map_t *hash_map, const void *key)
+{
+    assert(hash_map != NULL);
+
+    hash_map_entry_t *hash_map_entry = find_entry_(hash_map, key);
+    if (hash_map_entry->data == NULL) {
+        return false;
+    }
+
+    hash_map_entry_t removed = *hash_map_entry;
+    size_t mask = hash_map->num_entry - 1;
+    size_t i = hash_map_entry - hash_map->entry;
+    size_t j = i;
+
+    // Move back the following entries of the probe sequence which can't be
+    // found any more once entry |i| is free
+    for (;;) {
+        j = (j + 1) & mask;
+        if (hash_map->entry[j].data == NULL) {
+            break;
+        }
+        size_t k = entry_index_(hash_map, hash_map->entry[j].key);
+        if (((j - k) & mask) >= ((j - i) & mask)) {
+            hash_map->entry[i] = hash_map->entry[j];
+            i = j;
+        }
+    }
+    hash_map->entry[i].key = NULL;
+    hash_map->entry[i].data = NULL;
+    hash_map->hash_size--;
+
+    if (hash_map->key_fn) {
+        hash_map->key_fn((void *)removed.key);
+    }
+    if (hash_map->data_fn) {
+        hash_map->data_fn(removed.data);
+    }
+
+    return true;
+}
+
+void *hash_map_get(const hash_map_t *hash_map, const void *key)
+{
+    assert(hash_map != NULL);
+
+    return find_entry_(hash_map, key)->data;
+}
+
+void hash_map_clear(hash_map_t *hash_map)
+{
+    assert(hash_map != NULL);
+
+    for (size_t i = 0; i < hash_map->num_entry; i++) {
+        hash_map_entry_t removed = hash_map->entry[i];
+        if (removed.data == NULL) {
+            continue;
+        }
+        hash_map->entry[i].key = NULL;
+        hash_map->entry[i].data = NULL;
+        if (hash_map->key_fn) {
+            hash_map->key_fn((void *)removed.key);
+        }
+        if (hash_map->data_fn) {
+            hash_map->data_fn(removed.data);
+        }
+    }
+    hash_map->hash_size = 0;
+}
+
+void hash_map_foreach(hash_map_t *hash_map, hash_map_iter_cb callback, void *context)
+{
+    assert(hash_map != NULL);
+    assert(callback != NULL);
+
+    for (size_t i = 0; i < hash_map->num_entry; ++i) {
+        if (hash_map->entry[i].data == NULL) {
+            continue;
+        }
+        if (!callback(&hash_map->entry[i], context)) {
+            return;
+        }
+    }
+}
+
+#else
+
 struct hash_map_t;
 
 typedef struct hash_map_bucket_t {
@@ -41,7 +271,6 @@ typedef struct hash_map_t {
 list_t *list_new_internal(list_free_cb callback);
 
 static void bucket_free_(void *data);
-static bool default_key_equality(const void *x, const void *y);
 static hash_map_entry_t *find_bucket_entry_(list_t *hash_bucket_list,
         const void *key);
 
@@ -75,16 +304,6 @@ hash_map_t *hash_map_new_internal(
     return hash_map;
 }
 
-hash_map_t *hash_map_new(
-    size_t num_bucket,
-    hash_index_fn hash_fn,
-    key_free_fn key_fn,
-    data_free_fn data_fn,
-    key_equality_fn equality_fn)
-{
-    return hash_map_new_internal(num_bucket, hash_fn, key_fn, data_fn, equality_fn);
-}
-
 void hash_map_free(hash_map_t *hash_map)
 {
     if (hash_map == NULL) {
@@ -264,6 +483,18 @@ static hash_map_entry_t *find_bucket_entry_(list_t *hash_bucket_list,
     return NULL;
 }
 
+#endif /* OSI_ARRAY_CONTAINERS */
+
+hash_map_t *hash_map_new(
+    size_t num_bucket,
+    hash_index_fn hash_fn,
+    key_free_fn key_fn,
+    data_free_fn data_fn,
+    key_equality_fn equality_fn)
+{
+    return hash_map_new_internal(num_bucket, hash_fn, key_fn, data_fn, equality_fn);
+}
+
 static bool default_key_equality(const void *x, const void *y)
 {
     return x == y;
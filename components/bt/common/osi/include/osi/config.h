@@ -135,6 +135,8 @@ const char *config_section_name(const config_section_node_t *iter);
 // with |config_new| and subsequently overwritten with |config_save|, all comments
 // and special formatting in the original file will be lost. Neither |config| nor
 // |filename| may be NULL.
-bool config_save(const config_t *config, const char *filename);
+// With BT_CONFIG_NVS_PER_SECTION, each section is saved in its own NVS entry and
+// only the sections modified since |config| was loaded or saved are written.
+bool config_save(config_t *config, const char *filename);
 
 #endif /* #ifndef __CONFIG_H__ */
@@ -37,6 +37,12 @@ typedef struct fixed_queue_t fixed_queue_t;
 typedef void (*fixed_queue_free_cb)(void *data);
 typedef void (*fixed_queue_cb)(fixed_queue_t *queue);
 
+// Position of an iteration over a queue, see |fixed_queue_iter_begin|.
+typedef struct fixed_queue_iter_t {
+    const void *pos;
+    size_t index;
+} fixed_queue_iter_t;
+
 // Creates a new fixed queue with the given |capacity|. If more elements than
 // |capacity| are added to the queue, the caller is blocked until space is
 // made available in the queue. Returns NULL on failure. The caller must free
@@ -85,11 +91,26 @@ void *fixed_queue_try_peek_last(fixed_queue_t *queue);
 // otherwise NULL.
 void *fixed_queue_try_remove_from_queue(fixed_queue_t *queue, void *data);
 
+// Starts an iteration over the elements of |queue|, from the first one to the
+// last one, and returns the first element. Returns NULL if the queue is empty.
+// Neither |queue| nor |iter| may be NULL. This function will never block the
+// caller.
+//
+// NOTE: Like a list iterator, |iter| is not thread safe. The element returned
+// last may be removed from the queue before calling |fixed_queue_iter_next|,
+// other changes of the queue make the rest of the iteration unpredictable.
+void *fixed_queue_iter_begin(fixed_queue_t *queue, fixed_queue_iter_t *iter);
+
+// Returns the element following the one returned last for |iter|, or NULL at
+// the end of the queue. Neither |queue| nor |iter| may be NULL.
+void *fixed_queue_iter_next(fixed_queue_t *queue, fixed_queue_iter_t *iter);
+
 // Returns the iterateable list with all entries in the |queue|. This function
 // will never block the caller. |queue| may not be NULL.
 //
 // NOTE: The return result of this function is not thread safe: the list could
 // be modified by another thread, and the result would be unpredictable.
+// Not available with CONFIG_BT_OSI_ARRAY_CONTAINERS, use |fixed_queue_iter_begin|.
 // TODO: The usage of this function should be refactored, and the function
 // itself should be removed.
 list_t *fixed_queue_get_list(fixed_queue_t *queue);
@@ -120,6 +141,4 @@ void fixed_queue_unregister_dequeue(fixed_queue_t *queue);
 
 void fixed_queue_process(fixed_queue_t *queue);
 
-list_t *fixed_queue_get_list(fixed_queue_t *queue);
-
 #endif
@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/* Host build of the OSI containers, OSI_ARRAY_CONTAINERS is set by the Makefile */
+
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRUE    true
+#define FALSE   false
+
+#define OSI_TRACE_ERROR(fmt, ...)
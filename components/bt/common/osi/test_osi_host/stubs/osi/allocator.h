@@ -0,0 +1,13 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#pragma once
+
+#include <stdlib.h>
+
+#define osi_malloc(size)    malloc(size)
+#define osi_calloc(size)    calloc(1, size)
+#define osi_free(ptr)       free(ptr)
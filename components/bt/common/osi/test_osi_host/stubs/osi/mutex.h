@@ -0,0 +1,18 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#pragma once
+
+#include "osi/semaphore.h"
+
+#define OSI_MUTEX_MAX_TIMEOUT OSI_SEM_MAX_TIMEOUT
+
+typedef osi_sem_t osi_mutex_t;
+
+int osi_mutex_new(osi_mutex_t *mutex);
+int osi_mutex_lock(osi_mutex_t *mutex, uint32_t timeout);
+void osi_mutex_unlock(osi_mutex_t *mutex);
+void osi_mutex_free(osi_mutex_t *mutex);
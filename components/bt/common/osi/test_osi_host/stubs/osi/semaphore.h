@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <semaphore.h>
+
+#define OSI_SEM_MAX_TIMEOUT 0xffffffffUL
+
+typedef sem_t *osi_sem_t;
+
+int osi_sem_new(osi_sem_t *sem, uint32_t max_count, uint32_t init_count);
+void osi_sem_free(osi_sem_t *sem);
+int osi_sem_take(osi_sem_t *sem, uint32_t timeout);
+void osi_sem_give(osi_sem_t *sem);
@@ -0,0 +1,62 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/* POSIX semaphores in place of the FreeRTOS ones of semaphore.c and mutex.c */
+
+#include <stdlib.h>
+#include "osi/mutex.h"
+
+int osi_sem_new(osi_sem_t *sem, uint32_t max_count, uint32_t init_count)
+{
+    *sem = malloc(sizeof(sem_t));
+    if (*sem == NULL) {
+        return -1;
+    }
+    return sem_init(*sem, 0, init_count);
+}
+
+void osi_sem_free(osi_sem_t *sem)
+{
+    if (*sem) {
+        sem_destroy(*sem);
+        free(*sem);
+        *sem = NULL;
+    }
+}
+
+int osi_sem_take(osi_sem_t *sem, uint32_t timeout)
+{
+    if (timeout == OSI_SEM_MAX_TIMEOUT) {
+        return sem_wait(*sem);
+    }
+    /* Only the non-blocking calls are used by the test */
+    return sem_trywait(*sem) == 0 ? 0 : -1;
+}
+
+void osi_sem_give(osi_sem_t *sem)
+{
+    sem_post(*sem);
+}
+
+int osi_mutex_new(osi_mutex_t *mutex)
+{
+    return osi_sem_new(mutex, 1, 1);
+}
+
+int osi_mutex_lock(osi_mutex_t *mutex, uint32_t timeout)
+{
+    return osi_sem_take(mutex, timeout);
+}
+
+void osi_mutex_unlock(osi_mutex_t *mutex)
+{
+    osi_sem_give(mutex);
+}
+
+void osi_mutex_free(osi_mutex_t *mutex)
+{
+    osi_sem_free(mutex);
+}
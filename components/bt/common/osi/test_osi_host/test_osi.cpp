@@ -0,0 +1,190 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <random>
+#include "catch.hpp"
+
+extern "C" {
+#include "osi/fixed_queue.h"
+#include "osi/hash_map.h"
+#include "osi/hash_functions.h"
+}
+
+static int s_key_freed;
+static int s_data_freed;
+
+static void key_free(void *key)
+{
+    s_key_freed++;
+}
+
+static void data_free(void *data)
+{
+    s_data_freed++;
+}
+
+static bool collect_entry(hash_map_entry_t *entry, void *context)
+{
+    auto *entries = static_cast<std::map<uintptr_t, uintptr_t> *>(context);
+    (*entries)[(uintptr_t)entry->key] = (uintptr_t)entry->data;
+    return true;
+}
+
+static void check_queue(fixed_queue_t *queue, const std::deque<uintptr_t> &model)
+{
+    REQUIRE(fixed_queue_length(queue) == model.size());
+    REQUIRE(fixed_queue_is_empty(queue) == model.empty());
+    REQUIRE(fixed_queue_try_peek_first(queue) == (model.empty() ? NULL : (void *)model.front()));
+    REQUIRE(fixed_queue_try_peek_last(queue) == (model.empty() ? NULL : (void *)model.back()));
+}
+
+TEST_CASE("fixed_queue matches a deque", "[osi][fixed_queue]")
+{
+    fixed_queue_t *queue = fixed_queue_new(QUEUE_SIZE_MAX);
+    std::deque<uintptr_t> model;
+    std::mt19937 rng(1);
+
+    for (int i = 0; i < 1000000; i++) {
+        unsigned op = rng() % 10;
+
+        if (op < 4) {
+            /* Values repeat, removal takes the first one */
+            uintptr_t value = 1 + rng() % 512;
+            bool full = model.size() == QUEUE_SIZE_MAX;
+            REQUIRE(fixed_queue_enqueue(queue, (void *)value, 0) == !full);
+            if (!full) {
+                model.push_back(value);
+            }
+        } else if (op < 7) {
+            void *data = fixed_queue_dequeue(queue, 0);
+            if (model.empty()) {
+                REQUIRE(data == NULL);
+            } else {
+                REQUIRE((uintptr_t)data == model.front());
+                model.pop_front();
+            }
+        } else if (op < 8 && !model.empty()) {
+            uintptr_t value = model[rng() % model.size()];
+            REQUIRE(fixed_queue_try_remove_from_queue(queue, (void *)value) == (void *)value);
+            model.erase(std::find(model.begin(), model.end(), value));
+        } else if (op < 9) {
+            /* Remove some of the elements while iterating, as
+             * btm_sec_check_pending_enc_req() does. Only values which are
+             * in the queue once, so that the removed one is the current one.
+             */
+            std::deque<uintptr_t> kept;
+            fixed_queue_iter_t iter;
+            size_t n = 0;
+
+            for (void *data = fixed_queue_iter_begin(queue, &iter); data;
+                    data = fixed_queue_iter_next(queue, &iter)) {
+                REQUIRE(n < model.size());
+                REQUIRE((uintptr_t)data == model[n++]);
+                if (rng() % 3 == 0 && std::count(model.begin(), model.end(), (uintptr_t)data) == 1) {
+                    REQUIRE(fixed_queue_try_remove_from_queue(queue, data) == data);
+                    continue;
+                }
+                kept.push_back((uintptr_t)data);
+            }
+            REQUIRE(n == model.size());
+            model = kept;
+        }
+        check_queue(queue, model);
+    }
+
+    fixed_queue_free(queue, NULL);
+}
+
+TEST_CASE("hash_map matches a map", "[osi][hash_map]")
+{
+    const uintptr_t num_keys = 4096;
+    hash_map_t *map = hash_map_new(34, hash_function_naive, key_free, data_free, NULL);
+    std::map<uintptr_t, uintptr_t> model;
+    std::mt19937 rng(2);
+
+    for (int i = 0; i < 2000000; i++) {
+        uintptr_t key = rng() % num_keys;
+        bool has_key = model.count(key) != 0;
+        unsigned op = rng() % 100;
+
+        if (op < 30) {
+            uintptr_t data = 1 + rng() % 1000;
+            int key_freed = s_key_freed;
+            int data_freed = s_data_freed;
+            REQUIRE(hash_map_set(map, (void *)key, (void *)data));
+            /* Replacing an entry frees the previous key and data */
+            REQUIRE(s_key_freed == key_freed + has_key);
+            REQUIRE(s_data_freed == data_freed + has_key);
+            model[key] = data;
+        } else if (op < 60) {
+            int key_freed = s_key_freed;
+            REQUIRE(hash_map_erase(map, (void *)key) == has_key);
+            REQUIRE(s_key_freed == key_freed + has_key);
+            model.erase(key);
+        } else if (op < 99) {
+            REQUIRE(hash_map_get(map, (void *)key) == (has_key ? (void *)model[key] : NULL));
+            REQUIRE(hash_map_has_key(map, (void *)key) == has_key);
+        } else if (rng() % 100 == 0) {
+            std::map<uintptr_t, uintptr_t> entries;
+            hash_map_foreach(map, collect_entry, &entries);
+            REQUIRE(entries == model);
+        }
+
+        if (i % 500000 == 499999) {
+            int data_freed = s_data_freed;
+            hash_map_clear(map);
+            REQUIRE(s_data_freed == data_freed + (int)model.size());
+            model.clear();
+        }
+    }
+
+    hash_map_free(map);
+}
+
+/* Run with "make bench", once with OSI_ARRAY_CONTAINERS=FALSE and once with
+ * OSI_ARRAY_CONTAINERS=TRUE. Most of the queue time is in the semaphores.
+ */
+TEST_CASE("time of the fixed_queue and hash_map operations", "[.][bench]")
+{
+    typedef std::chrono::steady_clock clock;
+    const int rounds = 2000000;
+
+    fixed_queue_t *queue = fixed_queue_new(QUEUE_SIZE_MAX);
+    auto start = clock::now();
+    for (int i = 0; i < rounds; i++) {
+        fixed_queue_enqueue(queue, (void *)1, 0);
+        fixed_queue_enqueue(queue, (void *)2, 0);
+        fixed_queue_dequeue(queue, 0);
+        fixed_queue_dequeue(queue, 0);
+    }
+    auto elapsed = clock::now() - start;
+    fixed_queue_free(queue, NULL);
+    printf("fixed_queue enqueue+dequeue: %.1f ns\n",
+           std::chrono::duration<double, std::nano>(elapsed).count() / rounds / 2);
+
+    /* A map of 30 pointers, as the Bluedroid maps of alarms and connections */
+    static char objects[40][64];
+    hash_map_t *map = hash_map_new(34, hash_function_pointer, NULL, NULL, NULL);
+    for (int i = 0; i < 30; i++) {
+        hash_map_set(map, objects[i], objects[i]);
+    }
+    volatile size_t found = 0;
+    start = clock::now();
+    for (int i = 0; i < rounds; i++) {
+        void *key = objects[30 + i % 10];
+        hash_map_set(map, key, key);
+        found += hash_map_get(map, objects[i % 30]) != NULL;
+        hash_map_erase(map, key);
+    }
+    elapsed = clock::now() - start;
+    hash_map_free(map);
+    printf("hash_map set+get+erase: %.1f ns\n",
+           std::chrono::duration<double, std::nano>(elapsed).count() / rounds);
+}
@@ -65,6 +65,13 @@ static struct {
 } msg_cache[CONFIG_BLE_MESH_MSG_CACHE_SIZE];
 static uint16_t msg_cache_next;
 
+/* Hash index of the message cache, so that a lookup doesn't scan the whole
+ * cache. Buckets and chains hold the entry index plus one, 0 ends a chain.
+ * Unused entries (src 0) are not linked.
+ */
+static uint16_t msg_cache_bucket[CONFIG_BLE_MESH_MSG_CACHE_SIZE];
+static uint16_t msg_cache_chain[CONFIG_BLE_MESH_MSG_CACHE_SIZE];
+
 /* Singleton network context (the implementation only supports one) */
 struct bt_mesh_net bt_mesh = {
     .local_queue = SYS_SLIST_STATIC_INIT(&bt_mesh.local_queue),
@@ -107,14 +114,42 @@ static bool check_dup(struct net_buf_simple *data)
     return false;
 }
 
+static inline uint16_t msg_cache_hash(uint16_t src, uint32_t seq)
+{
+    return ((src * 0x9E3779B1U) ^ (seq * 0x85EBCA6BU)) % ARRAY_SIZE(msg_cache_bucket);
+}
+
+static void msg_cache_unlink(uint16_t idx)
+{
+    uint16_t *link = &msg_cache_bucket[msg_cache_hash(msg_cache[idx].src, msg_cache[idx].seq)];
+
+    while (*link) {
+        if (*link == idx + 1) {
+            *link = msg_cache_chain[idx];
+            break;
+        }
+        link = &msg_cache_chain[*link - 1];
+    }
+
+    msg_cache[idx].src = BLE_MESH_ADDR_UNASSIGNED;
+}
+
+static void msg_cache_reset(void)
+{
+    memset(msg_cache, 0, sizeof(msg_cache));
+    memset(msg_cache_bucket, 0, sizeof(msg_cache_bucket));
+    msg_cache_next = 0U;
+}
+
 static bool msg_cache_match(struct bt_mesh_net_rx *rx,
                             struct net_buf_simple *pdu)
 {
-    int i;
+    uint16_t src = SRC(pdu->data);
+    uint32_t seq = SEQ(pdu->data) & BIT_MASK(17);
+    uint16_t i;
 
-    for (i = 0; i < ARRAY_SIZE(msg_cache); i++) {
-        if (msg_cache[i].src == SRC(pdu->data) &&
-            msg_cache[i].seq == (SEQ(pdu->data) & BIT_MASK(17))) {
+    for (i = msg_cache_bucket[msg_cache_hash(src, seq)]; i; i = msg_cache_chain[i - 1]) {
+        if (msg_cache[i - 1].src == src && msg_cache[i - 1].seq == seq) {
             return true;
         }
     }
@@ -124,10 +159,20 @@ static bool msg_cache_match(struct bt_mesh_net_rx *rx,
 
 static void msg_cache_add(struct bt_mesh_net_rx *rx)
 {
+    uint16_t bucket;
+
     rx->msg_cache_idx = msg_cache_next++;
+    msg_cache_next %= ARRAY_SIZE(msg_cache);
+
+    if (msg_cache[rx->msg_cache_idx].src != BLE_MESH_ADDR_UNASSIGNED) {
+        msg_cache_unlink(rx->msg_cache_idx);
+    }
     msg_cache[rx->msg_cache_idx].src = rx->ctx.addr;
     msg_cache[rx->msg_cache_idx].seq = rx->seq;
-    msg_cache_next %= ARRAY_SIZE(msg_cache);
+
+    bucket = msg_cache_hash(msg_cache[rx->msg_cache_idx].src, msg_cache[rx->msg_cache_idx].seq);
+    msg_cache_chain[rx->msg_cache_idx] = msg_cache_bucket[bucket];
+    msg_cache_bucket[bucket] = rx->msg_cache_idx + 1;
 }
 
 #if CONFIG_BLE_MESH_PROVISIONER
@@ -138,7 +183,8 @@ void bt_mesh_msg_cache_clear(uint16_t unicast_addr, uint8_t elem_num)
     for (i = 0; i < ARRAY_SIZE(msg_cache); i++) {
         if (msg_cache[i].src >= unicast_addr &&
             msg_cache[i].src < unicast_addr + elem_num) {
-            memset(&msg_cache[i], 0, sizeof(msg_cache[i]));
+            msg_cache_unlink(i);
+            msg_cache[i].seq = 0U;
         }
     }
 }
@@ -449,8 +495,7 @@ int bt_mesh_net_create(uint16_t idx, uint8_t flags, const uint8_t key[16],
 
     BT_DBG("NetKey %s", bt_hex(key, 16));
 
-    (void)memset(msg_cache, 0, sizeof(msg_cache));
-    msg_cache_next = 0U;
+    msg_cache_reset();
 
     sub = &bt_mesh.sub[0];
 
@@ -598,6 +643,9 @@ void bt_mesh_rpl_reset(void)
             }
         }
     }
+
+    /* Entries after the discarded ones may not be reachable any more */
+    bt_mesh_rpl_rehash();
 }
 
 #if defined(CONFIG_BLE_MESH_IV_UPDATE_TEST)
@@ -1484,7 +1532,7 @@ void bt_mesh_net_recv(struct net_buf_simple *data, int8_t rssi,
     */
     if (bt_mesh_trans_recv(&buf, &rx) == -EAGAIN) {
         BT_WARN("Removing rejected message from Network Message Cache");
-        msg_cache[rx.msg_cache_idx].src = BLE_MESH_ADDR_UNASSIGNED;
+        msg_cache_unlink(rx.msg_cache_idx);
         /* Rewind the next index now that we're not using this entry */
         msg_cache_next = rx.msg_cache_idx;
     }
@@ -1585,8 +1633,7 @@ void bt_mesh_net_reset(void)
     memset(friend_cred, 0, sizeof(friend_cred));
 #endif
 
-    memset(msg_cache, 0, sizeof(msg_cache));
-    msg_cache_next = 0U;
+    msg_cache_reset();
 
     memset(dup_cache, 0, sizeof(dup_cache));
     dup_cache_next = 0U;
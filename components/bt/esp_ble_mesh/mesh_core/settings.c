@@ -316,33 +316,6 @@ static int seq_set(const char *name)
     return 0;
 }
 
-static struct bt_mesh_rpl *rpl_find(uint16_t src)
-{
-    int i;
-
-    for (i = 0; i < ARRAY_SIZE(bt_mesh.rpl); i++) {
-        if (bt_mesh.rpl[i].src == src) {
-            return &bt_mesh.rpl[i];
-        }
-    }
-
-    return NULL;
-}
-
-static struct bt_mesh_rpl *rpl_alloc(uint16_t src)
-{
-    int i;
-
-    for (i = 0; i < ARRAY_SIZE(bt_mesh.rpl); i++) {
-        if (bt_mesh.rpl[i].src == BLE_MESH_ADDR_UNASSIGNED) {
-            bt_mesh.rpl[i].src = src;
-            return &bt_mesh.rpl[i];
-        }
-    }
-
-    return NULL;
-}
-
 static int rpl_set(const char *name)
 {
     struct net_buf_simple *buf = NULL;
@@ -383,14 +356,11 @@ static int rpl_set(const char *name)
             continue;
         }
 
-        entry = rpl_find(src);
+        entry = bt_mesh_rpl_find(src);
         if (!entry) {
-            entry = rpl_alloc(src);
-            if (!entry) {
-                BT_ERR("No space for a new RPL 0x%04x", src);
-                err = -ENOMEM;
-                goto free;
-            }
+            BT_ERR("No space for a new RPL 0x%04x", src);
+            err = -ENOMEM;
+            goto free;
         }
 
         entry->src = src;
@@ -662,6 +662,66 @@ static void update_rpl(struct bt_mesh_rpl *rpl, struct bt_mesh_net_rx *rx)
     }
 }
 
+/* The RPL is an open addressing hash table keyed by the source address,
+ * with linear probing, so that the entry of a node is found without going
+ * through the whole list.
+ */
+static inline size_t rpl_hash(uint16_t src)
+{
+    return ((src * 0x9E3779B1U) >> 16) % ARRAY_SIZE(bt_mesh.rpl);
+}
+
+struct bt_mesh_rpl *bt_mesh_rpl_find(uint16_t src)
+{
+    size_t i = rpl_hash(src);
+    size_t n;
+
+    for (n = 0; n < ARRAY_SIZE(bt_mesh.rpl); n++) {
+        struct bt_mesh_rpl *rpl = &bt_mesh.rpl[i];
+
+        if (rpl->src == src || rpl->src == BLE_MESH_ADDR_UNASSIGNED) {
+            return rpl;
+        }
+
+        if (++i == ARRAY_SIZE(bt_mesh.rpl)) {
+            i = 0;
+        }
+    }
+
+    return NULL;
+}
+
+void bt_mesh_rpl_rehash(void)
+{
+    struct bt_mesh_rpl entry = {0};
+    struct bt_mesh_rpl *rpl = NULL;
+    bool moved = true;
+    size_t i;
+
+    /* Re-insert every entry, so that an entry whose probe sequence was
+     * broken by a removed entry moves back towards its hash slot. Each
+     * move shortens the probe sequence of the entry, and a pass without
+     * any move means every entry can be found again.
+     */
+    while (moved) {
+        moved = false;
+
+        for (i = 0; i < ARRAY_SIZE(bt_mesh.rpl); i++) {
+            if (bt_mesh.rpl[i].src == BLE_MESH_ADDR_UNASSIGNED) {
+                continue;
+            }
+
+            entry = bt_mesh.rpl[i];
+            (void)memset(&bt_mesh.rpl[i], 0, sizeof(bt_mesh.rpl[i]));
+            rpl = bt_mesh_rpl_find(entry.src);
+            *rpl = entry;
+            if (rpl != &bt_mesh.rpl[i]) {
+                moved = true;
+            }
+        }
+    }
+}
+
 /* Check the Replay Protection List for a replay attempt. If non-NULL match
  * parameter is given the RPL slot is returned but it is not immediately
  * updated (needed for segmented messages), whereas if a NULL match is given
@@ -669,7 +729,7 @@ static void update_rpl(struct bt_mesh_rpl *rpl, struct bt_mesh_net_rx *rx)
  */
 bool bt_mesh_rpl_check(struct bt_mesh_net_rx *rx, struct bt_mesh_rpl **match)
 {
-    int i;
+    struct bt_mesh_rpl *rpl = NULL;
 
     /* Don't bother checking messages from ourselves */
     if (rx->net_if == BLE_MESH_NET_IF_LOCAL) {
@@ -681,43 +741,31 @@ bool bt_mesh_rpl_check(struct bt_mesh_net_rx *rx, struct bt_mesh_rpl **match)
         return false;
     }
 
-    for (i = 0; i < ARRAY_SIZE(bt_mesh.rpl); i++) {
-        struct bt_mesh_rpl *rpl = &bt_mesh.rpl[i];
-
-        /* Empty slot */
-        if (!rpl->src) {
-            if (match) {
-                *match = rpl;
-            } else {
-                update_rpl(rpl, rx);
-            }
+    rpl = bt_mesh_rpl_find(rx->ctx.addr);
+    if (!rpl) {
+        BT_ERR("RPL is full!");
+        return true;
+    }
 
-            return false;
+    /* Existing slot for given address */
+    if (rpl->src == rx->ctx.addr) {
+        if (rx->old_iv && !rpl->old_iv) {
+            return true;
         }
 
-        /* Existing slot for given address */
-        if (rpl->src == rx->ctx.addr) {
-            if (rx->old_iv && !rpl->old_iv) {
-                return true;
-            }
-
-            if ((!rx->old_iv && rpl->old_iv) ||
-                    rpl->seq < rx->seq) {
-                if (match) {
-                    *match = rpl;
-                } else {
-                    update_rpl(rpl, rx);
-                }
-
-                return false;
-            } else {
-                return true;
-            }
+        if ((rx->old_iv || !rpl->old_iv) && rpl->seq >= rx->seq) {
+            return true;
         }
     }
 
-    BT_ERR("RPL is full!");
-    return true;
+    /* Empty slot, or a newer message from the address */
+    if (match) {
+        *match = rpl;
+    } else {
+        update_rpl(rpl, rx);
+    }
+
+    return false;
 }
 
 static int sdu_recv(struct bt_mesh_net_rx *rx, uint32_t seq, uint8_t hdr,
@@ -1822,13 +1870,12 @@ void bt_mesh_rx_reset_single(uint16_t src)
         }
     }
 
-    for (i = 0; i < ARRAY_SIZE(bt_mesh.rpl); i++) {
-        struct bt_mesh_rpl *rpl = &bt_mesh.rpl[i];
-        if (src == rpl->src) {
-            memset(rpl, 0, sizeof(struct bt_mesh_rpl));
-            if (IS_ENABLED(CONFIG_BLE_MESH_SETTINGS)) {
-                bt_mesh_clear_rpl_single(src);
-            }
+    struct bt_mesh_rpl *rpl = bt_mesh_rpl_find(src);
+    if (rpl && src == rpl->src) {
+        memset(rpl, 0, sizeof(struct bt_mesh_rpl));
+        bt_mesh_rpl_rehash();
+        if (IS_ENABLED(CONFIG_BLE_MESH_SETTINGS)) {
+            bt_mesh_clear_rpl_single(src);
         }
     }
 }
@@ -116,6 +116,10 @@ void bt_mesh_trans_deinit(bool erase);
 
 bool bt_mesh_rpl_check(struct bt_mesh_net_rx *rx, struct bt_mesh_rpl **match);
 
+struct bt_mesh_rpl *bt_mesh_rpl_find(uint16_t src);
+
+void bt_mesh_rpl_rehash(void);
+
 void bt_mesh_heartbeat_send(void);
 
 int bt_mesh_app_key_get(const struct bt_mesh_subnet *subnet, uint16_t app_idx,
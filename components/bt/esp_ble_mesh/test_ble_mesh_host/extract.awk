@@ -0,0 +1,38 @@
+# Print the definitions of the functions listed in "names" (space separated),
+# from the line holding the name of the function to the closing brace in
+# the first column, so that the host test builds the code of the stack.
+
+BEGIN {
+    n = split(names, list, " ")
+    for (i = 1; i <= n; i++) {
+        wanted[list[i]] = 1
+    }
+}
+
+!body && /^[a-z]/ && !/;[ \t]*$/ {
+    for (name in wanted) {
+        if (index($0, " " name "(") || index($0, "*" name "(")) {
+            body = 1
+            found[name] = 1
+            printf "#line %d \"%s\"\n", FNR, FILENAME
+            break
+        }
+    }
+}
+
+body {
+    print
+    if ($0 == "}") {
+        body = 0
+        print ""
+    }
+}
+
+END {
+    for (name in wanted) {
+        if (!(name in found)) {
+            print "extract.awk: " name " not found" > "/dev/stderr"
+            exit 1
+        }
+    }
+}
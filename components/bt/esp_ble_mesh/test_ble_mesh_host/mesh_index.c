@@ -0,0 +1,211 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/* Host build of the message cache and RPL code of the mesh stack. The
+ * functions are extracted from net.c and transport.c into mesh_index.inc,
+ * and this file provides just enough of the stack for them to build.
+ */
+
+#include <string.h>
+#include "mesh_index.h"
+
+#define ARRAY_SIZE(array)           (sizeof(array) / sizeof((array)[0]))
+#define BIT(n)                      (1UL << (n))
+#define BIT_MASK(n)                 (BIT(n) - 1)
+#define IS_ENABLED(config)          0
+#define BT_ERR(fmt, ...)
+
+#define BLE_MESH_ADDR_UNASSIGNED    0x0000
+#define BLE_MESH_NET_IF_ADV         0
+#define BLE_MESH_NET_IF_LOCAL       1
+
+#define SEQ(pdu)                    (sys_get_be24(&(pdu)[2]))
+#define SRC(pdu)                    (sys_get_be16(&(pdu)[5]))
+
+struct net_buf_simple {
+    uint8_t *data;
+    uint16_t len;
+};
+
+struct bt_mesh_msg_ctx {
+    uint16_t addr;
+};
+
+struct bt_mesh_net_rx {
+    struct bt_mesh_msg_ctx ctx;
+    uint32_t seq;
+    uint8_t  old_iv:1,
+             net_if:2,
+             local_match:1;
+    uint16_t msg_cache_idx;
+};
+
+struct bt_mesh_rpl {
+    uint16_t src;
+    bool     old_iv;
+    uint32_t seq;
+};
+
+static struct {
+    struct bt_mesh_rpl rpl[CONFIG_BLE_MESH_CRPL];
+} bt_mesh;
+
+static struct {
+    uint32_t src:15,
+             seq:17;
+} msg_cache[CONFIG_BLE_MESH_MSG_CACHE_SIZE];
+static uint16_t msg_cache_next;
+
+static uint16_t msg_cache_bucket[CONFIG_BLE_MESH_MSG_CACHE_SIZE];
+static uint16_t msg_cache_chain[CONFIG_BLE_MESH_MSG_CACHE_SIZE];
+
+static inline uint16_t sys_get_be16(const uint8_t src[2])
+{
+    return ((uint16_t)src[0] << 8) | src[1];
+}
+
+static inline uint32_t sys_get_be24(const uint8_t src[3])
+{
+    return ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+}
+
+static void bt_mesh_store_rpl(struct bt_mesh_rpl *rpl)
+{
+    (void)rpl;
+}
+
+void bt_mesh_msg_cache_clear(uint16_t unicast_addr, uint8_t elem_num);
+void bt_mesh_rpl_reset(void);
+struct bt_mesh_rpl *bt_mesh_rpl_find(uint16_t src);
+void bt_mesh_rpl_rehash(void);
+bool bt_mesh_rpl_check(struct bt_mesh_net_rx *rx, struct bt_mesh_rpl **match);
+
+#include "mesh_index.inc"
+
+size_t mesh_msg_cache_size(void)
+{
+    return ARRAY_SIZE(msg_cache);
+}
+
+void mesh_msg_cache_reset(void)
+{
+    msg_cache_reset();
+}
+
+bool mesh_msg_cache_match(uint16_t src, uint32_t seq)
+{
+    /* Network PDU header: IVI/NID, CTL/TTL, SEQ, SRC, DST */
+    uint8_t data[9] = {
+        0, 0, seq >> 16, seq >> 8, seq, src >> 8, src, 0, 0,
+    };
+    struct net_buf_simple pdu = {
+        .data = data,
+        .len = sizeof(data),
+    };
+    struct bt_mesh_net_rx rx = {
+        .ctx.addr = src,
+        .seq = seq,
+    };
+
+    return msg_cache_match(&rx, &pdu);
+}
+
+uint16_t mesh_msg_cache_add(uint16_t src, uint32_t seq)
+{
+    struct bt_mesh_net_rx rx = {
+        .ctx.addr = src,
+        .seq = seq,
+    };
+
+    msg_cache_add(&rx);
+
+    return rx.msg_cache_idx;
+}
+
+void mesh_msg_cache_reject(uint16_t idx)
+{
+    /* Same as a message rejected by the transport layer in bt_mesh_net_recv() */
+    msg_cache_unlink(idx);
+    msg_cache_next = idx;
+}
+
+void mesh_msg_cache_clear(uint16_t unicast_addr, uint8_t elem_num)
+{
+    bt_mesh_msg_cache_clear(unicast_addr, elem_num);
+}
+
+size_t mesh_rpl_size(void)
+{
+    return ARRAY_SIZE(bt_mesh.rpl);
+}
+
+void mesh_rpl_clear(void)
+{
+    memset(bt_mesh.rpl, 0, sizeof(bt_mesh.rpl));
+}
+
+bool mesh_rpl_check(uint16_t src, uint32_t seq, bool old_iv)
+{
+    struct bt_mesh_net_rx rx = {
+        .ctx.addr = src,
+        .seq = seq,
+        .old_iv = old_iv,
+        .net_if = BLE_MESH_NET_IF_ADV,
+        .local_match = 1,
+    };
+
+    return bt_mesh_rpl_check(&rx, NULL);
+}
+
+bool mesh_rpl_get(uint16_t src, uint32_t *seq, bool *old_iv)
+{
+    struct bt_mesh_rpl *rpl = bt_mesh_rpl_find(src);
+
+    if (!rpl || rpl->src != src) {
+        return false;
+    }
+
+    *seq = rpl->seq;
+    *old_iv = rpl->old_iv;
+    return true;
+}
+
+bool mesh_rpl_find(uint16_t src)
+{
+    struct bt_mesh_rpl *rpl = bt_mesh_rpl_find(src);
+
+    return rpl && rpl->src == src;
+}
+
+void mesh_rpl_remove(uint16_t src)
+{
+    /* Same as the removal of a node in bt_mesh_rx_reset_single() */
+    struct bt_mesh_rpl *rpl = bt_mesh_rpl_find(src);
+
+    if (rpl && src == rpl->src) {
+        memset(rpl, 0, sizeof(struct bt_mesh_rpl));
+        bt_mesh_rpl_rehash();
+    }
+}
+
+void mesh_rpl_iv_update(void)
+{
+    bt_mesh_rpl_reset();
+}
+
+size_t mesh_rpl_count(void)
+{
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(bt_mesh.rpl); i++) {
+        if (bt_mesh.rpl[i].src != BLE_MESH_ADDR_UNASSIGNED) {
+            count++;
+        }
+    }
+
+    return count;
+}
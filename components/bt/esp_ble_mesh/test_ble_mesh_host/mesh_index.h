@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Message cache, as used by the network layer */
+size_t mesh_msg_cache_size(void);
+void mesh_msg_cache_reset(void);
+bool mesh_msg_cache_match(uint16_t src, uint32_t seq);
+uint16_t mesh_msg_cache_add(uint16_t src, uint32_t seq);
+void mesh_msg_cache_reject(uint16_t idx);
+void mesh_msg_cache_clear(uint16_t unicast_addr, uint8_t elem_num);
+
+/* Replay Protection List, as used by the transport layer */
+size_t mesh_rpl_size(void);
+void mesh_rpl_clear(void);
+bool mesh_rpl_check(uint16_t src, uint32_t seq, bool old_iv);
+bool mesh_rpl_get(uint16_t src, uint32_t *seq, bool *old_iv);
+bool mesh_rpl_find(uint16_t src);
+void mesh_rpl_remove(uint16_t src);
+void mesh_rpl_iv_update(void);
+size_t mesh_rpl_count(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,275 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+#include "catch.hpp"
+#include "mesh_index.h"
+
+/* Linear message cache, as it was before the hash index was added */
+class ref_msg_cache {
+public:
+    explicit ref_msg_cache(size_t size) : entries(size), next(0) {}
+
+    bool match(uint16_t src, uint32_t seq) const
+    {
+        for (const entry &e : entries) {
+            if (e.src == src && e.seq == (seq & 0x1FFFF)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint16_t add(uint16_t src, uint32_t seq)
+    {
+        uint16_t idx = next;
+        entries[idx] = {src, seq & 0x1FFFF};
+        next = (next + 1) % entries.size();
+        return idx;
+    }
+
+    void reject(uint16_t idx)
+    {
+        entries[idx].src = 0;
+        next = idx;
+    }
+
+    void clear(uint16_t addr, uint8_t elem_num)
+    {
+        for (entry &e : entries) {
+            if (e.src >= addr && e.src < addr + elem_num) {
+                e = {0, 0};
+            }
+        }
+    }
+
+private:
+    struct entry {
+        uint16_t src;
+        uint32_t seq;
+    };
+    std::vector<entry> entries;
+    uint16_t next;
+};
+
+/* RPL as a map, with the replay rules of bt_mesh_rpl_check() */
+class ref_rpl {
+public:
+    explicit ref_rpl(size_t size) : size(size) {}
+
+    bool check(uint16_t src, uint32_t seq, bool old_iv)
+    {
+        auto it = entries.find(src);
+        if (it == entries.end()) {
+            if (entries.size() == size) {
+                return true;
+            }
+            entries[src] = {seq, old_iv};
+            return false;
+        }
+        if (old_iv && !it->second.old_iv) {
+            return true;
+        }
+        if ((old_iv || !it->second.old_iv) && it->second.seq >= seq) {
+            return true;
+        }
+        it->second = {seq, old_iv};
+        return false;
+    }
+
+    void remove(uint16_t src)
+    {
+        entries.erase(src);
+    }
+
+    void iv_update()
+    {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.old_iv) {
+                it = entries.erase(it);
+            } else {
+                it->second.old_iv = true;
+                ++it;
+            }
+        }
+    }
+
+    struct entry {
+        uint32_t seq;
+        bool old_iv;
+    };
+    std::map<uint16_t, entry> entries;
+
+private:
+    size_t size;
+};
+
+static void check_rpl(const ref_rpl &ref)
+{
+    REQUIRE(mesh_rpl_count() == ref.entries.size());
+    for (const auto &e : ref.entries) {
+        uint32_t seq;
+        bool old_iv;
+        REQUIRE(mesh_rpl_get(e.first, &seq, &old_iv));
+        CHECK(seq == e.second.seq);
+        CHECK(old_iv == e.second.old_iv);
+    }
+}
+
+TEST_CASE("message cache matches the linear cache", "[mesh][msg_cache]")
+{
+    const size_t size = mesh_msg_cache_size();
+    std::mt19937 rng(1);
+    ref_msg_cache ref(size);
+
+    mesh_msg_cache_reset();
+
+    for (int i = 0; i < 200000; i++) {
+        /* Few sources and sequence numbers, so that messages repeat */
+        uint16_t src = 1 + rng() % (size + 8);
+        uint32_t seq = rng() % (2 * size);
+        unsigned op = rng() % 100;
+
+        if (op < 2) {
+            uint16_t addr = 1 + rng() % (size + 8);
+            uint8_t elem_num = 1 + rng() % 4;
+            mesh_msg_cache_clear(addr, elem_num);
+            ref.clear(addr, elem_num);
+            continue;
+        }
+
+        /* Sequence numbers which only differ above the stored 17 bits match */
+        if (op < 5) {
+            seq |= 1 << 17;
+        }
+
+        bool matched = mesh_msg_cache_match(src, seq);
+        REQUIRE(matched == ref.match(src, seq));
+        if (matched) {
+            continue;
+        }
+
+        uint16_t idx = mesh_msg_cache_add(src, seq);
+        REQUIRE(idx == ref.add(src, seq));
+        if (op < 10) {
+            mesh_msg_cache_reject(idx);
+            ref.reject(idx);
+        }
+    }
+}
+
+TEST_CASE("RPL matches the replay rules and stays reachable", "[mesh][rpl]")
+{
+    const size_t size = mesh_rpl_size();
+    std::mt19937 rng(2);
+    ref_rpl ref(size);
+
+    mesh_rpl_clear();
+
+    for (int i = 0; i < 200000; i++) {
+        /* More sources than RPL entries, so that the RPL gets full */
+        uint16_t src = 1 + rng() % (size + size / 2 + 2);
+        unsigned op = rng() % 1000;
+
+        if (op < 20) {
+            mesh_rpl_remove(src);
+            ref.remove(src);
+            check_rpl(ref);
+        } else if (op < 22) {
+            mesh_rpl_iv_update();
+            ref.iv_update();
+            check_rpl(ref);
+        } else {
+            uint32_t seq = rng() % 64;
+            bool old_iv = rng() % 4 == 0;
+            REQUIRE(mesh_rpl_check(src, seq, old_iv) == ref.check(src, seq, old_iv));
+        }
+    }
+    check_rpl(ref);
+}
+
+/* Run with "make bench", with MSG_CACHE_SIZE and CRPL set to the sizes to
+ * compare. The linear lookups are the ones the stack did before the index.
+ */
+TEST_CASE("lookup time of the message cache and RPL", "[.][bench]")
+{
+    typedef std::chrono::steady_clock clock;
+    const int rounds = 1000;
+    std::mt19937 rng(3);
+    volatile size_t hits = 0;
+
+    const size_t cache_size = mesh_msg_cache_size();
+    std::vector<std::pair<uint16_t, uint32_t>> cache;
+    mesh_msg_cache_reset();
+    for (size_t i = 0; i < cache_size; i++) {
+        cache.push_back({1 + i % 0x7FFF, i});
+        mesh_msg_cache_add(cache.back().first, cache.back().second);
+    }
+
+    auto start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < cache_size; i++) {
+            hits += mesh_msg_cache_match(cache[i].first, cache[i].second + (r & 1));
+        }
+    }
+    auto hashed = clock::now() - start;
+
+    start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < cache_size; i++) {
+            for (size_t j = 0; j < cache_size; j++) {
+                if (cache[j].first == cache[i].first &&
+                        cache[j].second == cache[i].second + (r & 1)) {
+                    hits++;
+                    break;
+                }
+            }
+        }
+    }
+    auto linear = clock::now() - start;
+
+    printf("message cache, %zu entries: %.1f ns hashed, %.1f ns linear per lookup\n", cache_size,
+           std::chrono::duration<double, std::nano>(hashed).count() / (rounds * cache_size),
+           std::chrono::duration<double, std::nano>(linear).count() / (rounds * cache_size));
+
+    const size_t rpl_size = mesh_rpl_size();
+    std::vector<uint16_t> srcs;
+    mesh_rpl_clear();
+    for (size_t i = 0; i < rpl_size; i++) {
+        srcs.push_back(1 + rng() % 0x7FFF);
+        mesh_rpl_check(srcs.back(), 1, false);
+    }
+
+    start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (uint16_t src : srcs) {
+            hits += mesh_rpl_find(src);
+        }
+    }
+    hashed = clock::now() - start;
+
+    start = clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (uint16_t src : srcs) {
+            for (uint16_t other : srcs) {
+                if (other == src) {
+                    hits++;
+                    break;
+                }
+            }
+        }
+    }
+    linear = clock::now() - start;
+
+    printf("RPL, %zu entries: %.1f ns hashed, %.1f ns linear per lookup\n", rpl_size,
+           std::chrono::duration<double, std::nano>(hashed).count() / (rounds * rpl_size),
+           std::chrono::duration<double, std::nano>(linear).count() / (rounds * rpl_size));
+
+    mesh_rpl_clear();
+}
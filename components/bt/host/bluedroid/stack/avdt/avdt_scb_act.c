@@ -1331,12 +1331,9 @@ void avdt_scb_hdl_write_req_frag(tAVDT_SCB *p_scb, tAVDT_SCB_EVT *p_data)
     ssrc = avdt_scb_gen_ssrc(p_scb);
 
     if (! fixed_queue_is_empty(p_scb->frag_q)) {
-        list_t *list = fixed_queue_get_list(p_scb->frag_q);
-        const list_node_t *node = list_begin(list);
-        if (node != list_end(list)) {
-            BT_HDR *p_frag = (BT_HDR *)list_node(node);
-            node = list_next(node);
-
+        fixed_queue_iter_t iter;
+        BT_HDR *p_frag = (BT_HDR *)fixed_queue_iter_begin(p_scb->frag_q, &iter);
+        if (p_frag != NULL) {
             /* get first packet */
             /* posit on Adaptation Layer header */
             p_frag->len += AVDT_AL_HDR_SIZE + AVDT_MEDIA_HDR_SIZE;
@@ -1360,9 +1357,8 @@ void avdt_scb_hdl_write_req_frag(tAVDT_SCB *p_scb, tAVDT_SCB_EVT *p_data)
             p_scb->media_seq++;
         }
 
-        for ( ; node != list_end(list); node = list_next(node)) {
-            BT_HDR *p_frag = (BT_HDR *)list_node(node);
-
+        for (p_frag = (BT_HDR *)fixed_queue_iter_next(p_scb->frag_q, &iter); p_frag != NULL;
+             p_frag = (BT_HDR *)fixed_queue_iter_next(p_scb->frag_q, &iter)) {
             /* posit on Adaptation Layer header */
             p_frag->len += AVDT_AL_HDR_SIZE;
             p_frag->offset -= AVDT_AL_HDR_SIZE;
@@ -6038,11 +6038,9 @@ static void btm_sec_check_pending_enc_req (tBTM_SEC_DEV_REC  *p_dev_rec, tBT_TRA
     }
 
     UINT8 res = encr_enable ? BTM_SUCCESS : BTM_ERR_PROCESSING;
-    list_t *list = fixed_queue_get_list(btm_cb.sec_pending_q);
-    for (const list_node_t *node = list_begin(list); node != list_end(list); ) {
-        tBTM_SEC_QUEUE_ENTRY *p_e = (tBTM_SEC_QUEUE_ENTRY *)list_node(node);
-        node = list_next(node);
-
+    fixed_queue_iter_t iter;
+    for (tBTM_SEC_QUEUE_ENTRY *p_e = (tBTM_SEC_QUEUE_ENTRY *)fixed_queue_iter_begin(btm_cb.sec_pending_q, &iter);
+         p_e != NULL; p_e = (tBTM_SEC_QUEUE_ENTRY *)fixed_queue_iter_next(btm_cb.sec_pending_q, &iter)) {
         if (memcmp(p_e->bd_addr, p_dev_rec->bd_addr, BD_ADDR_LEN) == 0 && p_e->psm == 0
 #if BLE_INCLUDED == TRUE
             && p_e->transport == transport
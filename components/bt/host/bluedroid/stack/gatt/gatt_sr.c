@@ -201,22 +201,13 @@ static BOOLEAN process_read_multi_rsp (tGATT_SR_CMD *p_cmd, tGATT_STATUS status,
             p_buf->len = 1;
 
             /* Now walk through the buffers puting the data into the response in order */
-            list_t *list = NULL;
-            const list_node_t *node = NULL;
-            if (! fixed_queue_is_empty(p_cmd->multi_rsp_q)) {
-                list = fixed_queue_get_list(p_cmd->multi_rsp_q);
-			}
+            fixed_queue_iter_t iter;
             for (ii = 0; ii < p_cmd->multi_req.num_handles; ii++) {
                 tGATTS_RSP *p_rsp = NULL;
-                if (list != NULL) {
-                    if (ii == 0) {
-                        node = list_begin(list);
-                    } else {
-                        node = list_next(node);
-					}
-                    if (node != list_end(list)) {
-                        p_rsp = (tGATTS_RSP *)list_node(node);
-					}
+                if (ii == 0) {
+                    p_rsp = (tGATTS_RSP *)fixed_queue_iter_begin(p_cmd->multi_rsp_q, &iter);
+                } else {
+                    p_rsp = (tGATTS_RSP *)fixed_queue_iter_next(p_cmd->multi_rsp_q, &iter);
                 }
 
                 if (p_rsp != NULL) {
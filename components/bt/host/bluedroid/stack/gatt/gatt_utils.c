@@ -198,12 +198,11 @@ void gatt_set_srv_chg(void)
         return;
 	}
 
-    list_t *list = fixed_queue_get_list(gatt_cb.srv_chg_clt_q);
-    for (const list_node_t *node = list_begin(list); node != list_end(list);
-         node = list_next(node)) {
+    fixed_queue_iter_t iter;
+    for (tGATTS_SRV_CHG *p_buf = (tGATTS_SRV_CHG *)fixed_queue_iter_begin(gatt_cb.srv_chg_clt_q, &iter);
+         p_buf != NULL; p_buf = (tGATTS_SRV_CHG *)fixed_queue_iter_next(gatt_cb.srv_chg_clt_q, &iter)) {
         GATT_TRACE_DEBUG ("found a srv_chg clt");
 
-        tGATTS_SRV_CHG *p_buf = (tGATTS_SRV_CHG *)list_node(node);
         if (!p_buf->srv_changed) {
             GATT_TRACE_DEBUG("set srv_changed to TRUE");
             p_buf->srv_changed = TRUE;
@@ -233,10 +232,10 @@ tGATTS_PENDING_NEW_SRV_START *gatt_sr_is_new_srv_chg(tBT_UUID *p_app_uuid128, tB
         return NULL;
 	}
 
-    list_t *list = fixed_queue_get_list(gatt_cb.pending_new_srv_start_q);
-    for (const list_node_t *node = list_begin(list); node != list_end(list);
-         node = list_next(node)) {
-        p_buf = (tGATTS_PENDING_NEW_SRV_START *)list_node(node);
+    fixed_queue_iter_t iter;
+    for (p_buf = (tGATTS_PENDING_NEW_SRV_START *)fixed_queue_iter_begin(gatt_cb.pending_new_srv_start_q, &iter);
+         p_buf != NULL;
+         p_buf = (tGATTS_PENDING_NEW_SRV_START *)fixed_queue_iter_next(gatt_cb.pending_new_srv_start_q, &iter)) {
         tGATTS_HNDL_RANGE *p = p_buf->p_new_srv_start;
         if (gatt_uuid_compare(*p_app_uuid128, p->app_uuid128)
             && gatt_uuid_compare (*p_svc_uuid, p->svc_uuid)
@@ -824,11 +823,9 @@ BOOLEAN gatt_is_srv_chg_ind_pending (tGATT_TCB *p_tcb)
     if (p_tcb->indicate_handle == gatt_cb.handle_of_h_r) {
         srv_chg_ind_pending = TRUE;
     } else if (! fixed_queue_is_empty(p_tcb->pending_ind_q)) {
-        list_t *list = fixed_queue_get_list(p_tcb->pending_ind_q);
-        for (const list_node_t *node = list_begin(list);
-             node != list_end(list);
-             node = list_next(node)) {
-            tGATT_VALUE *p_buf = (tGATT_VALUE *)list_node(node);
+        fixed_queue_iter_t iter;
+        for (tGATT_VALUE *p_buf = (tGATT_VALUE *)fixed_queue_iter_begin(p_tcb->pending_ind_q, &iter);
+             p_buf != NULL; p_buf = (tGATT_VALUE *)fixed_queue_iter_next(p_tcb->pending_ind_q, &iter)) {
             if (p_buf->handle == gatt_cb.handle_of_h_r)
             {
                 srv_chg_ind_pending = TRUE;
@@ -862,10 +859,9 @@ tGATTS_SRV_CHG *gatt_is_bda_in_the_srv_chg_clt_list (BD_ADDR bda)
         return NULL;
 	}
 
-    list_t *list = fixed_queue_get_list(gatt_cb.srv_chg_clt_q);
-    for (const list_node_t *node = list_begin(list); node != list_end(list);
-         node = list_next(node)) {
-        p_buf = (tGATTS_SRV_CHG *)list_node(node);
+    fixed_queue_iter_t iter;
+    for (p_buf = (tGATTS_SRV_CHG *)fixed_queue_iter_begin(gatt_cb.srv_chg_clt_q, &iter);
+         p_buf != NULL; p_buf = (tGATTS_SRV_CHG *)fixed_queue_iter_next(gatt_cb.srv_chg_clt_q, &iter)) {
         if (!memcmp( bda, p_buf->bda, BD_ADDR_LEN)) {
             GATT_TRACE_DEBUG("bda is in the srv chg clt list");
             break;
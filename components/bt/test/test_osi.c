@@ -0,0 +1,369 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ Tests for the OSI hash map, fixed queue and config
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "unity.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "osi/config.h"
+#include "osi/fixed_queue.h"
+#include "osi/hash_map.h"
+#include "osi/hash_functions.h"
+
+#define TAG "osi_test"
+
+#define TEST_NUM_KEYS     200
+#define TEST_ITERATIONS   10000
+#define TEST_NUM_SECTIONS 15
+#define TEST_CONFIG_NS    "bt_cfg_test"
+#define TEST_LINK_KEY     "00112233445566778899aabbccddeeff"
+#define TEST_MAX_BLOBS    (TEST_NUM_SECTIONS + 4)
+
+static int s_data_freed;
+
+static void test_data_free(void *data)
+{
+    s_data_freed++;
+}
+
+static bool test_count_entries(hash_map_entry_t *entry, void *context)
+{
+    TEST_ASSERT_EQUAL_PTR(entry->key, entry->data);
+    (*(int *)context)++;
+    return true;
+}
+
+TEST_CASE("osi hash_map set, get and erase", "[bt_common]")
+{
+    static uint32_t keys[TEST_NUM_KEYS];
+    hash_map_t *map = hash_map_new(34, hash_function_pointer, NULL, test_data_free, NULL);
+    TEST_ASSERT_NOT_NULL(map);
+
+    s_data_freed = 0;
+    /* More keys than the initial size, the map has to grow */
+    for (int i = 0; i < TEST_NUM_KEYS; i++) {
+        TEST_ASSERT_TRUE(hash_map_set(map, &keys[i], &keys[i]));
+    }
+    for (int i = 0; i < TEST_NUM_KEYS; i++) {
+        TEST_ASSERT_EQUAL_PTR(&keys[i], hash_map_get(map, &keys[i]));
+    }
+
+    /* Replacing the data frees the previous one */
+    TEST_ASSERT_TRUE(hash_map_set(map, &keys[0], &keys[0]));
+    TEST_ASSERT_EQUAL(1, s_data_freed);
+
+    for (int i = 0; i < TEST_NUM_KEYS; i += 2) {
+        TEST_ASSERT_TRUE(hash_map_erase(map, &keys[i]));
+    }
+    TEST_ASSERT_EQUAL(1 + TEST_NUM_KEYS / 2, s_data_freed);
+    for (int i = 0; i < TEST_NUM_KEYS; i++) {
+        TEST_ASSERT_EQUAL(i % 2 != 0, hash_map_has_key(map, &keys[i]));
+        TEST_ASSERT_EQUAL_PTR(i % 2 ? &keys[i] : NULL, hash_map_get(map, &keys[i]));
+    }
+    TEST_ASSERT_FALSE(hash_map_erase(map, &keys[0]));
+
+    int count = 0;
+    hash_map_foreach(map, test_count_entries, &count);
+    TEST_ASSERT_EQUAL(TEST_NUM_KEYS / 2, count);
+
+    hash_map_clear(map);
+    TEST_ASSERT_EQUAL(1 + TEST_NUM_KEYS, s_data_freed);
+    TEST_ASSERT_NULL(hash_map_get(map, &keys[1]));
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < TEST_ITERATIONS; i++) {
+        hash_map_set(map, &keys[i % TEST_NUM_KEYS], &keys[i % TEST_NUM_KEYS]);
+        hash_map_get(map, &keys[(i * 7) % TEST_NUM_KEYS]);
+        hash_map_erase(map, &keys[(i + TEST_NUM_KEYS / 2) % TEST_NUM_KEYS]);
+    }
+    ESP_LOGI(TAG, "hash_map set, get and erase: %lld us per %d",
+             esp_timer_get_time() - start, TEST_ITERATIONS);
+
+    hash_map_free(map);
+}
+
+TEST_CASE("osi fixed_queue order, removal and iteration", "[bt_common]")
+{
+    static uint32_t items[QUEUE_SIZE_MAX];
+    fixed_queue_t *queue = fixed_queue_new(QUEUE_SIZE_MAX);
+    fixed_queue_iter_t iter;
+    void *data;
+    int i;
+
+    TEST_ASSERT_NOT_NULL(queue);
+    TEST_ASSERT_NULL(fixed_queue_iter_begin(queue, &iter));
+
+    /* Wrap around and grow the queue up to its capacity */
+    for (i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(fixed_queue_enqueue(queue, &items[i], 0));
+    }
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_PTR(&items[i], fixed_queue_dequeue(queue, 0));
+    }
+    for (i = 5; i < QUEUE_SIZE_MAX + 3; i++) {
+        TEST_ASSERT_TRUE(fixed_queue_enqueue(queue, &items[i % QUEUE_SIZE_MAX], 0));
+    }
+    TEST_ASSERT_FALSE(fixed_queue_enqueue(queue, &items[0], 0));
+    TEST_ASSERT_EQUAL(QUEUE_SIZE_MAX, fixed_queue_length(queue));
+    TEST_ASSERT_EQUAL_PTR(&items[3], fixed_queue_try_peek_first(queue));
+    TEST_ASSERT_EQUAL_PTR(&items[2], fixed_queue_try_peek_last(queue));
+
+    /* Remove every other element while iterating */
+    i = 3;
+    for (data = fixed_queue_iter_begin(queue, &iter); data != NULL; data = fixed_queue_iter_next(queue, &iter)) {
+        TEST_ASSERT_EQUAL_PTR(&items[i % QUEUE_SIZE_MAX], data);
+        if (i % 2) {
+            TEST_ASSERT_EQUAL_PTR(data, fixed_queue_try_remove_from_queue(queue, data));
+        }
+        i++;
+    }
+    TEST_ASSERT_EQUAL(QUEUE_SIZE_MAX + 3, i);
+    TEST_ASSERT_EQUAL(QUEUE_SIZE_MAX / 2, fixed_queue_length(queue));
+    TEST_ASSERT_NULL(fixed_queue_try_remove_from_queue(queue, &items[3]));
+
+    for (i = 4; i < QUEUE_SIZE_MAX + 3; i += 2) {
+        TEST_ASSERT_EQUAL_PTR(&items[i % QUEUE_SIZE_MAX], fixed_queue_dequeue(queue, 0));
+    }
+    TEST_ASSERT_TRUE(fixed_queue_is_empty(queue));
+    TEST_ASSERT_NULL(fixed_queue_dequeue(queue, 0));
+
+    int64_t start = esp_timer_get_time();
+    for (i = 0; i < TEST_ITERATIONS; i++) {
+        fixed_queue_enqueue(queue, &items[0], 0);
+        fixed_queue_enqueue(queue, &items[1], 0);
+        fixed_queue_dequeue(queue, 0);
+        fixed_queue_dequeue(queue, 0);
+    }
+    ESP_LOGI(TAG, "fixed_queue enqueue and dequeue: %lld us per %d",
+             esp_timer_get_time() - start, 2 * TEST_ITERATIONS);
+
+    fixed_queue_free(queue, NULL);
+}
+
+/* Sections "00:00" up to |end| excluded, without |removed|, with the link key |key_3| in "03:00" */
+static void test_config_check(const config_t *config, int removed, int end, const char *key_3)
+{
+    char name[16];
+    int i = 0;
+
+    for (const config_section_node_t *node = config_section_begin(config); node != config_section_end(config);
+            node = config_section_next(node)) {
+        if (i == removed) {
+            i++;
+        }
+        snprintf(name, sizeof(name), "%02x:00", i);
+        TEST_ASSERT_EQUAL_STRING(name, config_section_name(node));
+        TEST_ASSERT_EQUAL(i, config_get_int(config, name, "DevType", -1));
+        TEST_ASSERT_EQUAL_STRING(i == 3 ? key_3 : TEST_LINK_KEY, config_get_string(config, name, "LinkKey", NULL));
+        i++;
+    }
+    TEST_ASSERT_EQUAL(end, i);
+}
+
+#if CONFIG_BT_CONFIG_NVS_PER_SECTION
+typedef struct {
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    size_t length;
+    uint8_t *data;
+} test_blob_t;
+
+/* Reads all the blobs of the config namespace, returns their number */
+static int test_read_blobs(test_blob_t *blobs)
+{
+    nvs_iterator_t it = NULL;
+    nvs_handle_t handle;
+    int n = 0;
+
+    TEST_ESP_OK(nvs_open(TEST_CONFIG_NS, NVS_READONLY, &handle));
+    for (esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, TEST_CONFIG_NS, NVS_TYPE_BLOB, &it);
+            err == ESP_OK; err = nvs_entry_next(&it)) {
+        nvs_entry_info_t info;
+        TEST_ASSERT_LESS_THAN(TEST_MAX_BLOBS, n);
+        TEST_ESP_OK(nvs_entry_info(it, &info));
+        strlcpy(blobs[n].key, info.key, sizeof(blobs[n].key));
+        TEST_ESP_OK(nvs_get_blob(handle, info.key, NULL, &blobs[n].length));
+        blobs[n].data = malloc(blobs[n].length);
+        TEST_ASSERT_NOT_NULL(blobs[n].data);
+        TEST_ESP_OK(nvs_get_blob(handle, info.key, blobs[n].data, &blobs[n].length));
+        n++;
+    }
+    nvs_release_iterator(it);
+    nvs_close(handle);
+    return n;
+}
+
+static void test_free_blobs(test_blob_t *blobs, int num)
+{
+    for (int i = 0; i < num; i++) {
+        free(blobs[i].data);
+    }
+}
+
+/* Checks that only the entry of section |index| was written since |before| was read.
+ * NVS doesn't write a blob with unchanged data, so only the written entry differs,
+ * and the free entries show whether other entries were erased and written again.
+ */
+static void test_check_one_section_saved(const test_blob_t *before, int num_before,
+                                         const nvs_stats_t *stats_before, int index)
+{
+    test_blob_t after[TEST_MAX_BLOBS];
+    char section_key[NVS_KEY_NAME_MAX_SIZE] = "";
+    int num_after = test_read_blobs(after);
+    size_t section_length = 0;
+    nvs_stats_t stats;
+
+    /* The index lists the slots in section order */
+    for (int i = 0; i < num_before; i++) {
+        if (strcmp(before[i].key, "bt_cfg_idx") == 0) {
+            TEST_ASSERT_LESS_THAN(before[i].length / sizeof(uint16_t), index);
+            snprintf(section_key, sizeof(section_key), "bt_cfg_s%u", ((const uint16_t *)before[i].data)[index]);
+        }
+    }
+    TEST_ASSERT_NOT_EQUAL(0, strlen(section_key));
+
+    TEST_ASSERT_EQUAL(num_before, num_after);
+    for (int i = 0; i < num_before; i++) {
+        const test_blob_t *blob = NULL;
+        for (int j = 0; j < num_after; j++) {
+            if (strcmp(before[i].key, after[j].key) == 0) {
+                blob = &after[j];
+            }
+        }
+        TEST_ASSERT_NOT_NULL_MESSAGE(blob, before[i].key);
+        bool same = (blob->length == before[i].length) &&
+                    memcmp(blob->data, before[i].data, blob->length) == 0;
+        TEST_ASSERT_EQUAL_MESSAGE(strcmp(before[i].key, section_key) != 0, same, before[i].key);
+        if (!same) {
+            section_length = blob->length;
+        }
+    }
+    test_free_blobs(after, num_after);
+
+    /* A blob takes a data entry per 32 bytes plus a header and an index entry.
+     * Allow twice that, as a blob may be split across two pages.
+     */
+    TEST_ESP_OK(nvs_get_stats(NULL, &stats));
+    TEST_ASSERT_LESS_OR_EQUAL(2 * (2 + (section_length + 31) / 32), stats_before->free_entries - stats.free_entries);
+}
+#endif /* CONFIG_BT_CONFIG_NVS_PER_SECTION */
+
+#if !CONFIG_BT_CONFIG_NVS_PER_SECTION
+/* Sections "00:00" up to |num| excluded, saved one per entry as with CONFIG_BT_CONFIG_NVS_PER_SECTION */
+static void test_write_sections(nvs_handle_t handle, int num)
+{
+    uint16_t slots[TEST_NUM_SECTIONS];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    char text[128];
+
+    for (int i = 0; i < num; i++) {
+        slots[i] = i;
+        snprintf(key, sizeof(key), "bt_cfg_s%d", i);
+        int len = snprintf(text, sizeof(text), "[%02x:00]\nLinkKey = %s\nDevType = %d\n", i, TEST_LINK_KEY, i);
+        TEST_ESP_OK(nvs_set_blob(handle, key, text, len));
+    }
+    TEST_ESP_OK(nvs_set_blob(handle, "bt_cfg_idx", slots, num * sizeof(uint16_t)));
+}
+
+TEST_CASE("osi config converts the sections saved one per entry", "[bt_common]")
+{
+    const char *blob = "[ff:00]\nDevType = 255\n";
+    nvs_handle_t handle;
+    size_t length;
+
+    TEST_ESP_OK(nvs_flash_init());
+    TEST_ESP_OK(nvs_open(TEST_CONFIG_NS, NVS_READWRITE, &handle));
+    /* As left by an interrupted conversion: the blob is ignored while the index is there */
+    TEST_ESP_OK(nvs_set_blob(handle, "bt_cfg_key0", blob, strlen(blob)));
+    test_write_sections(handle, TEST_NUM_SECTIONS);
+    TEST_ESP_OK(nvs_commit(handle));
+
+    config_t *config = config_new(TEST_CONFIG_NS);
+    TEST_ASSERT_NOT_NULL(config);
+    test_config_check(config, -1, TEST_NUM_SECTIONS, TEST_LINK_KEY);
+    TEST_ASSERT_TRUE(config_save(config, TEST_CONFIG_NS));
+    config_free(config);
+
+    /* Only the blob is left */
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, nvs_get_blob(handle, "bt_cfg_idx", NULL, &length));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, nvs_get_blob(handle, "bt_cfg_s0", NULL, &length));
+    TEST_ESP_OK(nvs_get_blob(handle, "bt_cfg_key0", NULL, &length));
+
+    config = config_new(TEST_CONFIG_NS);
+    TEST_ASSERT_NOT_NULL(config);
+    test_config_check(config, -1, TEST_NUM_SECTIONS, TEST_LINK_KEY);
+    config_free(config);
+
+    TEST_ESP_OK(nvs_erase_all(handle));
+    TEST_ESP_OK(nvs_commit(handle));
+    nvs_close(handle);
+}
+#endif /* !CONFIG_BT_CONFIG_NVS_PER_SECTION */
+
+TEST_CASE("osi config save and load", "[bt_common]")
+{
+    char name[16];
+    nvs_handle_t handle;
+
+    TEST_ESP_OK(nvs_flash_init());
+    config_t *config = config_new_empty();
+    TEST_ASSERT_NOT_NULL(config);
+    for (int i = 0; i < TEST_NUM_SECTIONS; i++) {
+        snprintf(name, sizeof(name), "%02x:00", i);
+        config_set_string(config, name, "LinkKey", TEST_LINK_KEY, true);
+        config_set_int(config, name, "DevType", i);
+    }
+    TEST_ASSERT_TRUE(config_save(config, TEST_CONFIG_NS));
+    config_free(config);
+
+    config = config_new(TEST_CONFIG_NS);
+    TEST_ASSERT_NOT_NULL(config);
+    test_config_check(config, -1, TEST_NUM_SECTIONS, TEST_LINK_KEY);
+
+    /* A single bond update, then a removal */
+#if CONFIG_BT_CONFIG_NVS_PER_SECTION
+    test_blob_t before[TEST_MAX_BLOBS];
+    int num_before = test_read_blobs(before);
+    nvs_stats_t stats_before;
+    TEST_ESP_OK(nvs_get_stats(NULL, &stats_before));
+#endif
+    int64_t start = esp_timer_get_time();
+    config_set_string(config, "03:00", "LinkKey", "updated", true);
+    TEST_ASSERT_TRUE(config_save(config, TEST_CONFIG_NS));
+    ESP_LOGI(TAG, "config save of one updated section: %lld us", esp_timer_get_time() - start);
+#if CONFIG_BT_CONFIG_NVS_PER_SECTION
+    /* Only the entry of the updated section is written */
+    test_check_one_section_saved(before, num_before, &stats_before, 3);
+    test_free_blobs(before, num_before);
+#endif
+    TEST_ASSERT_TRUE(config_remove_section(config, "05:00"));
+    snprintf(name, sizeof(name), "%02x:00", TEST_NUM_SECTIONS);
+    config_set_string(config, name, "LinkKey", TEST_LINK_KEY, true);
+    config_set_int(config, name, "DevType", TEST_NUM_SECTIONS);
+    TEST_ASSERT_TRUE(config_save(config, TEST_CONFIG_NS));
+    config_free(config);
+
+    config = config_new(TEST_CONFIG_NS);
+    TEST_ASSERT_NOT_NULL(config);
+    test_config_check(config, 5, TEST_NUM_SECTIONS + 1, "updated");
+    config_free(config);
+
+    TEST_ESP_OK(nvs_open(TEST_CONFIG_NS, NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_erase_all(handle));
+    TEST_ESP_OK(nvs_commit(handle));
+    nvs_close(handle);
+}
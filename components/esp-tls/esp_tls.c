@@ -47,6 +47,10 @@ static const char *TAG = "esp-tls";
 #define _esp_tls_server_session_delete      esp_mbedtls_server_session_delete
 #define _esp_tls_server_session_ticket_ctx_init    esp_mbedtls_server_session_ticket_ctx_init
 #define _esp_tls_server_session_ticket_ctx_free    esp_mbedtls_server_session_ticket_ctx_free
+#define _esp_tls_server_session_cache_ctx_init     esp_mbedtls_server_session_cache_ctx_init
+#define _esp_tls_server_session_cache_ctx_free     esp_mbedtls_server_session_cache_ctx_free
+#define _esp_tls_server_get_handshake_stats        esp_mbedtls_server_get_handshake_stats
+#define _esp_tls_server_reset_handshake_stats      esp_mbedtls_server_reset_handshake_stats
 #endif  /* CONFIG_ESP_TLS_SERVER */
 #define _esp_tls_get_bytes_avail            esp_mbedtls_get_bytes_avail
 #define _esp_tls_init_global_ca_store       esp_mbedtls_init_global_ca_store
@@ -587,6 +591,7 @@ esp_err_t esp_tls_cfg_server_session_tickets_init(esp_tls_cfg_server_t *cfg)
     esp_err_t ret =  _esp_tls_server_session_ticket_ctx_init(cfg->ticket_ctx);
     if (ret != ESP_OK) {
         free(cfg->ticket_ctx);
+        cfg->ticket_ctx = NULL;
     }
     return ret;
 #else
@@ -603,6 +608,61 @@ void esp_tls_cfg_server_session_tickets_free(esp_tls_cfg_server_t *cfg)
 #endif
 }
 
+esp_err_t esp_tls_cfg_server_session_cache_init(esp_tls_cfg_server_t *cfg)
+{
+#if defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE)
+    if (!cfg || cfg->session_cache) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    cfg->session_cache = calloc(1, sizeof(esp_tls_server_session_cache_ctx_t));
+    if (!cfg->session_cache) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = _esp_tls_server_session_cache_ctx_init(cfg->session_cache);
+    if (ret != ESP_OK) {
+        free(cfg->session_cache);
+        cfg->session_cache = NULL;
+    }
+    return ret;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void esp_tls_cfg_server_session_cache_free(esp_tls_cfg_server_t *cfg)
+{
+#if defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE)
+    if (cfg && cfg->session_cache) {
+        _esp_tls_server_session_cache_ctx_free(cfg->session_cache);
+        free(cfg->session_cache);
+        cfg->session_cache = NULL;
+    }
+#endif
+}
+
+esp_err_t esp_tls_server_get_handshake_stats(esp_tls_server_handshake_stats_t *stats)
+{
+#ifdef CONFIG_ESP_TLS_USING_MBEDTLS
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_tls_server_get_handshake_stats(stats);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t esp_tls_server_reset_handshake_stats(void)
+{
+#ifdef CONFIG_ESP_TLS_USING_MBEDTLS
+    _esp_tls_server_reset_handshake_stats();
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 /**
  * @brief      Create a server side TLS/SSL connection
  */
@@ -15,6 +15,10 @@
 #ifdef CONFIG_ESP_TLS_SERVER_SESSION_TICKETS
 #include "mbedtls/ssl_ticket.h"
 #endif
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+#include <sys/lock.h>
+#include "mbedtls/ssl_cache.h"
+#endif
 #elif CONFIG_ESP_TLS_USING_WOLFSSL
 #include "wolfssl/wolfcrypt/settings.h"
 #include "wolfssl/ssl.h"
@@ -197,6 +201,39 @@ typedef struct esp_tls_server_session_ticket_ctx {
 } esp_tls_server_session_ticket_ctx_t;
 #endif
 
+#if defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE)
+/**
+ * @brief Server side cache of TLS sessions, looked up by the session ID offered by the client
+ */
+typedef struct esp_tls_server_session_cache_ctx {
+    mbedtls_ssl_cache_context cache;                                            /*!< Session cache, bounded by
+                                                                                     CONFIG_ESP_TLS_SERVER_SESSION_CACHE_SIZE */
+    _lock_t lock;                                                               /*!< Serializes the cache access of
+                                                                                     concurrent handshakes */
+} esp_tls_server_session_cache_ctx_t;
+#endif
+
+/**
+ * @brief Number of buckets of the server handshake time histogram
+ */
+#define ESP_TLS_SERVER_HANDSHAKE_TIME_BUCKETS   8
+
+/**
+ * @brief Server side handshake statistics, see esp_tls_server_get_handshake_stats()
+ *
+ * Bucket 0 of time_hist counts the handshakes which took less than 25 ms, each following
+ * bucket doubles the bound, and the last one counts the handshakes which took 1.6 s or more.
+ */
+typedef struct esp_tls_server_handshake_stats {
+    uint32_t full_handshakes;                   /*!< Completed handshakes which negotiated a new session */
+    uint32_t resumed_handshakes;                /*!< Completed handshakes which resumed a session
+                                                     from the session cache or a session ticket */
+    uint32_t failed_handshakes;                 /*!< Failed handshakes */
+    uint64_t full_time_us;                      /*!< Total time of the full handshakes */
+    uint64_t resumed_time_us;                   /*!< Total time of the resumed handshakes */
+    uint32_t time_hist[ESP_TLS_SERVER_HANDSHAKE_TIME_BUCKETS];  /*!< Completed handshakes by duration */
+} esp_tls_server_handshake_stats_t;
+
 typedef struct esp_tls_cfg_server {
     const char **alpn_protos;                   /*!< Application protocols required for HTTP2.
                                                      If HTTP2/ALPN support is required, a list
@@ -259,6 +296,14 @@ typedef struct esp_tls_cfg_server {
                                                     Call esp_tls_cfg_server_session_tickets_free
                                                     to free the data associated with this context. */
 #endif
+
+#if defined(CONFIG_ESP_TLS_SERVER_SESSION_CACHE)
+    esp_tls_server_session_cache_ctx_t * session_cache; /*!< Session cache.
+                                                    You have to call esp_tls_cfg_server_session_cache_init
+                                                    to use it.
+                                                    Call esp_tls_cfg_server_session_cache_free
+                                                    to free the data associated with this context. */
+#endif
 } esp_tls_cfg_server_t;
 
 /**
@@ -285,6 +330,56 @@ esp_err_t esp_tls_cfg_server_session_tickets_init(esp_tls_cfg_server_t *cfg);
  * @param cfg server configuration as esp_tls_cfg_server_t
  */
 void esp_tls_cfg_server_session_tickets_free(esp_tls_cfg_server_t *cfg);
+
+/**
+ * @brief Initialize the server side TLS session cache
+ *
+ * Sessions negotiated by connections using this configuration are kept in a cache
+ * of CONFIG_ESP_TLS_SERVER_SESSION_CACHE_SIZE entries, so that clients reconnecting
+ * with the session ID of a previous connection resume it instead of running a full handshake.
+ * The cache can be used together with session tickets.
+ * Use esp_tls_cfg_server_session_cache_free to free the data.
+ *
+ * @param[in]  cfg server configuration as esp_tls_cfg_server_t
+ * @return
+ *             ESP_OK if setup succeeded
+ *             ESP_ERR_INVALID_ARG if the cache is already initialized
+ *             ESP_ERR_NO_MEM if memory allocation failed
+ *             ESP_ERR_NOT_SUPPORTED if the session cache is not available due to build configuration
+ */
+esp_err_t esp_tls_cfg_server_session_cache_init(esp_tls_cfg_server_t *cfg);
+
+/**
+ * @brief Free the server side TLS session cache
+ *
+ * No connection created with this configuration may be open.
+ *
+ * @param cfg server configuration as esp_tls_cfg_server_t
+ */
+void esp_tls_cfg_server_session_cache_free(esp_tls_cfg_server_t *cfg);
+
+/**
+ * @brief Get the handshake statistics of all the server side TLS sessions
+ *
+ * The ratio of resumed to full handshakes shows how much the session cache and
+ * session tickets save; a full handshake costs a key exchange and a signature.
+ *
+ * @param[out] stats copy of the statistics
+ * @return
+ *             ESP_OK on success
+ *             ESP_ERR_INVALID_ARG if stats is NULL
+ *             ESP_ERR_NOT_SUPPORTED if the statistics are not available with the selected TLS library
+ */
+esp_err_t esp_tls_server_get_handshake_stats(esp_tls_server_handshake_stats_t *stats);
+
+/**
+ * @brief Reset the server handshake statistics to zero
+ *
+ * @return
+ *             ESP_OK on success
+ *             ESP_ERR_NOT_SUPPORTED if the statistics are not available with the selected TLS library
+ */
+esp_err_t esp_tls_server_reset_handshake_stats(void);
 #endif /* ! CONFIG_ESP_TLS_SERVER */
 
 typedef struct esp_tls esp_tls_t;
@@ -19,6 +19,8 @@
 #include <errno.h>
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
 
 #ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
 #include "esp_crt_bundle.h"
@@ -42,6 +44,14 @@ static esp_err_t esp_mbedtls_init_pk_ctx_for_ds(const void *pki);
 static const char *TAG = "esp-tls-mbedtls";
 static mbedtls_x509_crt *global_cacert = NULL;
 
+#ifdef CONFIG_ESP_TLS_SERVER
+/* Upper bound of the first bucket of the handshake time histogram, doubling for each following one */
+#define SERVER_HANDSHAKE_TIME_BUCKET0_US    (25 * 1000)
+
+static esp_tls_server_handshake_stats_t s_server_stats;
+static portMUX_TYPE s_server_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
 /* This function shall return the error message when appropriate log level has been set, otherwise this function shall do nothing */
 static void mbedtls_print_error_msg(int error)
 {
@@ -429,9 +439,11 @@ static esp_err_t set_global_ca_store(esp_tls_t *tls)
 
 #ifdef CONFIG_ESP_TLS_SERVER
 #ifdef CONFIG_ESP_TLS_SERVER_SESSION_TICKETS
+/* p_ticket is the esp_tls_t of the connection, to tell whether its handshake resumed a session */
 int esp_mbedtls_server_session_ticket_write(void *p_ticket, const mbedtls_ssl_session *session, unsigned char *start, const unsigned char *end, size_t *tlen, uint32_t *lifetime)
 {
-    int ret = mbedtls_ssl_ticket_write(p_ticket, session, start, end, tlen, lifetime);
+    esp_tls_t *tls = p_ticket;
+    int ret = mbedtls_ssl_ticket_write(&tls->server_cfg->ticket_ctx->ticket_ctx, session, start, end, tlen, lifetime);
 #ifndef NDEBUG
     if (ret != 0) {
         ESP_LOGE(TAG, "Writing session ticket resulted in error code -0x%04X", -ret);
@@ -443,13 +455,17 @@ int esp_mbedtls_server_session_ticket_write(void *p_ticket, const mbedtls_ssl_se
 
 int esp_mbedtls_server_session_ticket_parse(void *p_ticket, mbedtls_ssl_session *session, unsigned char *buf, size_t len)
 {
-    int ret = mbedtls_ssl_ticket_parse(p_ticket, session, buf, len);
+    esp_tls_t *tls = p_ticket;
+    int ret = mbedtls_ssl_ticket_parse(&tls->server_cfg->ticket_ctx->ticket_ctx, session, buf, len);
 #ifndef NDEBUG
     if (ret != 0) {
         ESP_LOGD(TAG, "Parsing session ticket resulted in error code -0x%04X", -ret);
         mbedtls_print_error_msg(ret);
     }
 #endif
+    if (ret == 0) {
+        tls->session_resumed = true;
+    }
     return ret;
 }
 
@@ -496,12 +512,103 @@ void esp_mbedtls_server_session_ticket_ctx_free(esp_tls_server_session_ticket_ct
 }
 #endif
 
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+/* p_cache is the esp_tls_t of the connection, as for the session ticket callbacks */
+static int esp_mbedtls_server_session_cache_get(void *p_cache, unsigned char const *session_id, size_t session_id_len, mbedtls_ssl_session *session)
+{
+    esp_tls_t *tls = p_cache;
+    esp_tls_server_session_cache_ctx_t *ctx = tls->server_cfg->session_cache;
+    _lock_acquire(&ctx->lock);
+    int ret = mbedtls_ssl_cache_get(&ctx->cache, session_id, session_id_len, session);
+    _lock_release(&ctx->lock);
+    if (ret == 0) {
+        tls->session_resumed = true;
+    }
+    return ret;
+}
+
+static int esp_mbedtls_server_session_cache_set(void *p_cache, unsigned char const *session_id, size_t session_id_len, const mbedtls_ssl_session *session)
+{
+    esp_tls_t *tls = p_cache;
+    esp_tls_server_session_cache_ctx_t *ctx = tls->server_cfg->session_cache;
+    _lock_acquire(&ctx->lock);
+    int ret = mbedtls_ssl_cache_set(&ctx->cache, session_id, session_id_len, session);
+    _lock_release(&ctx->lock);
+#ifndef NDEBUG
+    if (ret != 0) {
+        ESP_LOGD(TAG, "Caching the session resulted in error code -0x%04X", -ret);
+        mbedtls_print_error_msg(ret);
+    }
+#endif
+    return ret;
+}
+
+esp_err_t esp_mbedtls_server_session_cache_ctx_init(esp_tls_server_session_cache_ctx_t *ctx)
+{
+    if (!ctx) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mbedtls_ssl_cache_init(&ctx->cache);
+    mbedtls_ssl_cache_set_max_entries(&ctx->cache, CONFIG_ESP_TLS_SERVER_SESSION_CACHE_SIZE);
+    mbedtls_ssl_cache_set_timeout(&ctx->cache, CONFIG_ESP_TLS_SERVER_SESSION_CACHE_TIMEOUT);
+    _lock_init(&ctx->lock);
+    return ESP_OK;
+}
+
+void esp_mbedtls_server_session_cache_ctx_free(esp_tls_server_session_cache_ctx_t *ctx)
+{
+    if (ctx) {
+        mbedtls_ssl_cache_free(&ctx->cache);
+        _lock_close(&ctx->lock);
+    }
+}
+#endif
+
+static void esp_mbedtls_server_handshake_done(esp_tls_t *tls, int64_t start_us, bool success)
+{
+    uint64_t elapsed_us = esp_timer_get_time() - start_us;
+    int bucket = 0;
+    for (uint64_t bound = SERVER_HANDSHAKE_TIME_BUCKET0_US;
+            elapsed_us >= bound && bucket < ESP_TLS_SERVER_HANDSHAKE_TIME_BUCKETS - 1; bound *= 2) {
+        bucket++;
+    }
+    portENTER_CRITICAL(&s_server_stats_lock);
+    if (!success) {
+        s_server_stats.failed_handshakes++;
+    } else {
+        if (tls->session_resumed) {
+            s_server_stats.resumed_handshakes++;
+            s_server_stats.resumed_time_us += elapsed_us;
+        } else {
+            s_server_stats.full_handshakes++;
+            s_server_stats.full_time_us += elapsed_us;
+        }
+        s_server_stats.time_hist[bucket]++;
+    }
+    portEXIT_CRITICAL(&s_server_stats_lock);
+}
+
+void esp_mbedtls_server_get_handshake_stats(esp_tls_server_handshake_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_server_stats_lock);
+    *stats = s_server_stats;
+    portEXIT_CRITICAL(&s_server_stats_lock);
+}
+
+void esp_mbedtls_server_reset_handshake_stats(void)
+{
+    portENTER_CRITICAL(&s_server_stats_lock);
+    memset(&s_server_stats, 0, sizeof(s_server_stats));
+    portEXIT_CRITICAL(&s_server_stats_lock);
+}
+
 esp_err_t set_server_config(esp_tls_cfg_server_t *cfg, esp_tls_t *tls)
 {
     assert(cfg != NULL);
     assert(tls != NULL);
     int ret;
     esp_err_t esp_ret;
+    tls->server_cfg = cfg;
     if ((ret = mbedtls_ssl_config_defaults(&tls->conf,
                     MBEDTLS_SSL_IS_SERVER,
                     MBEDTLS_SSL_TRANSPORT_STREAM,
@@ -580,7 +687,17 @@ esp_err_t set_server_config(esp_tls_cfg_server_t *cfg, esp_tls_t *tls)
         mbedtls_ssl_conf_session_tickets_cb( &tls->conf,
                 esp_mbedtls_server_session_ticket_write,
                 esp_mbedtls_server_session_ticket_parse,
-                &cfg->ticket_ctx->ticket_ctx );
+                tls );
+    }
+#endif
+
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+    if (cfg->session_cache) {
+        ESP_LOGD(TAG, "Enabling server-side tls session cache");
+
+        mbedtls_ssl_conf_session_cache(&tls->conf, tls,
+                esp_mbedtls_server_session_cache_get,
+                esp_mbedtls_server_session_cache_set);
     }
 #endif
 
@@ -793,14 +910,17 @@ int esp_mbedtls_server_session_create(esp_tls_cfg_server_t *cfg, int sockfd, esp
     tls->read = esp_mbedtls_read;
     tls->write = esp_mbedtls_write;
     int ret;
+    int64_t start_us = esp_timer_get_time();
     while ((ret = mbedtls_ssl_handshake(&tls->ssl)) != 0) {
         if (ret != ESP_TLS_ERR_SSL_WANT_READ && ret != ESP_TLS_ERR_SSL_WANT_WRITE) {
             ESP_LOGE(TAG, "mbedtls_ssl_handshake returned -0x%04X", -ret);
             mbedtls_print_error_msg(ret);
             tls->conn_state = ESP_TLS_FAIL;
+            esp_mbedtls_server_handshake_done(tls, start_us, false);
             return ret;
         }
     }
+    esp_mbedtls_server_handshake_done(tls, start_us, true);
     return 0;
 }
 /**
@@ -98,6 +98,32 @@ esp_err_t esp_mbedtls_server_session_ticket_ctx_init(esp_tls_server_session_tick
  */
 void esp_mbedtls_server_session_ticket_ctx_free(esp_tls_server_session_ticket_ctx_t *cfg);
 #endif
+
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+/**
+ * Internal function to setup server side session cache
+ *
+ * /note :- The function can only be used with mbedtls ssl library
+ */
+esp_err_t esp_mbedtls_server_session_cache_ctx_init(esp_tls_server_session_cache_ctx_t *ctx);
+
+/**
+ * Internal function to free server side session cache
+ *
+ * /note :- The function can only be used with mbedtls ssl library
+ */
+void esp_mbedtls_server_session_cache_ctx_free(esp_tls_server_session_cache_ctx_t *ctx);
+#endif
+
+/**
+ * Internal Callback for esp_tls_server_get_handshake_stats
+ */
+void esp_mbedtls_server_get_handshake_stats(esp_tls_server_handshake_stats_t *stats);
+
+/**
+ * Internal Callback for esp_tls_server_reset_handshake_stats
+ */
+void esp_mbedtls_server_reset_handshake_stats(void);
 #endif
 
 /**
@@ -60,6 +60,11 @@ struct esp_tls {
 
     mbedtls_pk_context serverkey;                                               /*!< Container for the private key of the server
                                                                                    certificate */
+
+    esp_tls_cfg_server_t *server_cfg;                                           /*!< Server configuration, used by the session
+                                                                                     cache and session ticket callbacks */
+
+    bool session_resumed;                                                       /*!< The server handshake resumed a session */
 #endif
 #elif CONFIG_ESP_TLS_USING_WOLFSSL
     void *priv_ctx;
@@ -11,6 +11,11 @@
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "sys/socket.h"
+#include "netinet/in.h"
+#include "arpa/inet.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #if SOC_SHA_SUPPORT_PARALLEL_ENG
 #include "sha/sha_parallel_engine.h"
 #elif SOC_SHA_SUPPORT_DMA
@@ -127,4 +132,130 @@ TEST_CASE("esp_tls_server session create delete", "[esp-tls][leaks=0]")
     // free the allocated memory.
     esp_tls_server_session_delete(tls);
 }
+
+TEST_CASE("esp_tls_server failed handshake is counted", "[esp-tls]")
+{
+    esp_tls_server_handshake_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_server_reset_handshake_stats());
+    struct esp_tls *tls = esp_tls_init();
+    TEST_ASSERT_NOT_NULL(tls);
+    esp_tls_cfg_server_t cfg = {
+        .servercert_buf = (const unsigned char *)test_cert_pem,
+        .servercert_bytes = strlen(test_cert_pem) + 1,
+        .serverkey_buf = (const unsigned char *)test_key_pem,
+        .serverkey_bytes = strlen(test_key_pem) + 1,
+    };
+    TEST_ASSERT_LESS_THAN_INT(0, esp_tls_server_session_create(&cfg, -1, tls));
+    esp_tls_server_session_delete(tls);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_server_get_handshake_stats(&stats));
+    TEST_ASSERT_EQUAL(1, stats.failed_handshakes);
+    TEST_ASSERT_EQUAL(0, stats.full_handshakes);
+    TEST_ASSERT_EQUAL(0, stats.resumed_handshakes);
+}
+
+#ifdef CONFIG_ESP_TLS_SERVER_SESSION_CACHE
+TEST_CASE("esp_tls_server session cache init free", "[esp-tls][leaks=0]")
+{
+    test_leak_setup(__FILE__, __LINE__);
+    esp_tls_cfg_server_t cfg = { 0 };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_cfg_server_session_cache_init(&cfg));
+    TEST_ASSERT_NOT_NULL(cfg.session_cache);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_tls_cfg_server_session_cache_init(&cfg));
+    esp_tls_cfg_server_session_cache_free(&cfg);
+    TEST_ASSERT_NULL(cfg.session_cache);
+}
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+#define TEST_TLS_PORT           8443
+#define TEST_TLS_CONNECTIONS    2
+
+typedef struct {
+    esp_tls_cfg_server_t *cfg;
+    int listen_fd;
+    SemaphoreHandle_t done;
+} test_tls_server_t;
+
+/* Accepts the connections and runs the server side of their handshakes */
+static void test_tls_server_task(void *arg)
+{
+    test_tls_server_t *server = arg;
+    for (int i = 0; i < TEST_TLS_CONNECTIONS; i++) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd >= 0) {
+            esp_tls_t *tls = esp_tls_init();
+            if (tls) {
+                esp_tls_server_session_create(server->cfg, fd, tls);
+                esp_tls_server_session_delete(tls);
+            }
+            close(fd);
+        }
+        xSemaphoreGive(server->done);
+    }
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("esp_tls_server session cache resumes the session of a reconnecting client", "[esp-tls]")
+{
+    test_case_uses_tcpip();
+
+    esp_tls_cfg_server_t server_cfg = {
+        .servercert_buf = (const unsigned char *)test_cert_pem,
+        .servercert_bytes = strlen(test_cert_pem) + 1,
+        .serverkey_buf = (const unsigned char *)test_key_pem,
+        .serverkey_bytes = strlen(test_key_pem) + 1,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_cfg_server_session_cache_init(&server_cfg));
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, listen_fd);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(TEST_TLS_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    TEST_ASSERT_EQUAL(0, bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, listen(listen_fd, 1));
+
+    test_tls_server_t server = {
+        .cfg = &server_cfg,
+        .listen_fd = listen_fd,
+        .done = xSemaphoreCreateCounting(TEST_TLS_CONNECTIONS, 0),
+    };
+    TEST_ASSERT_NOT_NULL(server.done);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_server_reset_handshake_stats());
+    xTaskCreate(test_tls_server_task, "tls_server", 8192, &server, uxTaskPriorityGet(NULL), NULL);
+
+    /* The second connection offers the session of the first one */
+    esp_tls_client_session_t *session = NULL;
+    esp_tls_server_handshake_stats_t stats;
+    for (int i = 0; i < TEST_TLS_CONNECTIONS; i++) {
+        esp_tls_cfg_t cfg = {
+            .cacert_buf = (const unsigned char *)test_cert_pem,
+            .cacert_bytes = strlen(test_cert_pem) + 1,
+            .common_name = "ESP-TLS Tests",
+            .client_session = session,
+        };
+        esp_tls_t *tls = esp_tls_init();
+        TEST_ASSERT_NOT_NULL(tls);
+        TEST_ASSERT_EQUAL(1, esp_tls_conn_new_sync("127.0.0.1", strlen("127.0.0.1"), TEST_TLS_PORT, &cfg, tls));
+        if (session == NULL) {
+            session = esp_tls_get_client_session(tls);
+            TEST_ASSERT_NOT_NULL(session);
+        }
+        esp_tls_conn_destroy(tls);
+        TEST_ASSERT_TRUE(xSemaphoreTake(server.done, pdMS_TO_TICKS(10000)));
+
+        TEST_ASSERT_EQUAL(ESP_OK, esp_tls_server_get_handshake_stats(&stats));
+        TEST_ASSERT_EQUAL(1, stats.full_handshakes);
+        TEST_ASSERT_EQUAL(i, stats.resumed_handshakes);
+        TEST_ASSERT_EQUAL(0, stats.failed_handshakes);
+    }
+
+    esp_tls_free_client_session(session);
+    vSemaphoreDelete(server.done);
+    close(listen_fd);
+    esp_tls_cfg_server_session_cache_free(&server_cfg);
+}
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS */
+#endif /* CONFIG_ESP_TLS_SERVER_SESSION_CACHE */
 #endif
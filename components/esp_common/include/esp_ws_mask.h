@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Word type for masking, may alias the byte buffers it is used on */
+typedef uint32_t __attribute__((__may_alias__)) esp_ws_mask_word_t;
+
+/**
+ * @brief Masks or unmasks WebSocket payload data (RFC 6455, section 5.3)
+ *
+ * Shared by the WebSocket client of tcp_transport and the WebSocket server of
+ * esp_http_server. Works a word at a time once the destination is aligned.
+ *
+ * @param[out] dst       Output buffer, may be the same as src
+ * @param[in]  src       Input data
+ * @param[in]  len       Number of bytes
+ * @param[in]  mask_key  4 byte masking key of the frame
+ * @param[in]  offset    Position of src[0] within the payload of the frame
+ */
+static inline void esp_ws_mask(uint8_t *dst, const uint8_t *src, size_t len, const uint8_t mask_key[4], size_t offset)
+{
+    size_t i = 0;
+
+    /* Process single bytes until the destination is word aligned */
+    for (; i < len && ((uintptr_t)(dst + i) % sizeof(esp_ws_mask_word_t)); i++) {
+        dst[i] = src[i] ^ mask_key[(offset + i) % 4];
+    }
+
+    size_t words = (len - i) / sizeof(esp_ws_mask_word_t);
+    if (words) {
+        /* Masking key rotated to start at the first aligned byte */
+        uint8_t key[sizeof(esp_ws_mask_word_t)];
+        for (size_t j = 0; j < sizeof(key); j++) {
+            key[j] = mask_key[(offset + i + j) % 4];
+        }
+        esp_ws_mask_word_t mask;
+        memcpy(&mask, key, sizeof(mask));
+
+        esp_ws_mask_word_t *dst_word = (esp_ws_mask_word_t *)(dst + i);
+        if ((uintptr_t)(src + i) % sizeof(esp_ws_mask_word_t) == 0) {
+            const esp_ws_mask_word_t *src_word = (const esp_ws_mask_word_t *)(src + i);
+            for (size_t w = 0; w < words; w++) {
+                dst_word[w] = src_word[w] ^ mask;
+            }
+        } else {
+            /* Source alignment differs from the destination */
+            for (size_t w = 0; w < words; w++) {
+                esp_ws_mask_word_t word;
+                memcpy(&word, src + i + w * sizeof(word), sizeof(word));
+                dst_word[w] = word ^ mask;
+            }
+        }
+        i += words * sizeof(esp_ws_mask_word_t);
+    }
+
+    for (; i < len; i++) {
+        dst[i] = src[i] ^ mask_key[(offset + i) % 4];
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
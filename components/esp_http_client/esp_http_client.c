@@ -16,6 +16,7 @@
 #include "esp_transport_tcp.h"
 #include "http_utils.h"
 #include "http_auth.h"
+#include "http_conn_pool.h"
 #include "sdkconfig.h"
 #include "esp_http_client.h"
 #include "errno.h"
@@ -118,6 +119,11 @@ struct esp_http_client {
     bool                        is_async;
     esp_transport_keep_alive_t  keep_alive_cfg;
     struct ifreq                *if_name;
+    esp_http_client_pool_handle_t pool;
+    char                        *pool_key;
+    http_body_data_cb           body_cb;
+    void                        *body_cb_data;
+    esp_err_t                   body_cb_err;
     unsigned                    cache_data_in_fetch_hdr: 1;
 };
 
@@ -270,6 +276,14 @@ static int http_on_body(http_parser *parser, const char *at, size_t length)
     esp_http_client_t *client = parser->data;
     ESP_LOGD(TAG, "http_on_body %d", length);
 
+    if (client->body_cb) {
+        /* Streaming the body, hand out the data in the receive buffer */
+        client->response->data_process += length;
+        client->body_cb_err = client->body_cb(at, length, client->body_cb_data);
+        http_dispatch_event(client, HTTP_EVENT_ON_DATA, (void *)at, length);
+        return client->body_cb_err == ESP_OK ? 0 : -1;
+    }
+
     if (client->response->buffer->output_ptr) {
         memcpy(client->response->buffer->output_ptr, (char *)at, length);
         client->response->buffer->output_ptr += length;
@@ -466,6 +480,8 @@ static esp_err_t _set_config(esp_http_client_handle_t client, const esp_http_cli
     }
     if (config->is_async) {
         client->is_async = true;
+    } else {
+        client->pool = config->connection_pool;
     }
 
     return ret;
@@ -807,6 +823,7 @@ esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
     free(client->current_header_key);
     free(client->location);
     free(client->auth_header);
+    free(client->pool_key);
     free(client);
     return ESP_OK;
 }
@@ -1270,7 +1287,23 @@ static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
 #endif
             return ESP_ERR_HTTP_INVALID_TRANSPORT;
         }
-        if (!client->is_async) {
+        if (client->pool) {
+            free(client->pool_key);
+            if (asprintf(&client->pool_key, "%s://%s:%d", client->connection_info.scheme, client->connection_info.host, client->connection_info.port) < 0) {
+                client->pool_key = NULL;
+                return ESP_ERR_NO_MEM;
+            }
+            if (http_conn_pool_acquire(client->pool, client->pool_key, client->transport) == ESP_OK) {
+                ESP_LOGD(TAG, "Reusing idle connection to %s", client->pool_key);
+                client->state = HTTP_STATE_CONNECTED;
+                http_dispatch_event(client, HTTP_EVENT_ON_CONNECTED, NULL, 0);
+                return ESP_OK;
+            }
+            if (http_conn_pool_connect(client->pool, client->pool_key, client->transport, client->connection_info.host, client->connection_info.port, client->timeout_ms) < 0) {
+                ESP_LOGE(TAG, "Connection failed, sock < 0");
+                return ESP_ERR_HTTP_CONNECT;
+            }
+        } else if (!client->is_async) {
             if (esp_transport_connect(client->transport, client->connection_info.host, client->connection_info.port, client->timeout_ms) < 0) {
                 ESP_LOGE(TAG, "Connection failed, sock < 0");
                 return ESP_ERR_HTTP_CONNECT;
@@ -1457,11 +1490,29 @@ int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, i
     return widx;
 }
 
+/* The connection can serve another request if nothing of the next request has
+ * been sent yet and the last response was read completely */
+static bool http_client_is_connection_reusable(esp_http_client_handle_t client)
+{
+    if (client->state == HTTP_STATE_CONNECTED) {
+        return !client->first_line_prepared && esp_http_client_is_complete_data_received(client);
+    }
+    if (client->state >= HTTP_STATE_RES_ON_DATA_START) {
+        return esp_http_client_is_complete_data_received(client) && http_should_keep_alive(client->parser);
+    }
+    return false;
+}
+
 esp_err_t esp_http_client_close(esp_http_client_handle_t client)
 {
     if (client->state >= HTTP_STATE_INIT) {
         http_dispatch_event(client, HTTP_EVENT_DISCONNECTED, esp_transport_get_error_handle(client->transport), 0);
+        bool reusable = client->pool && client->pool_key && http_client_is_connection_reusable(client);
         client->state = HTTP_STATE_INIT;
+        if (reusable && http_conn_pool_release(client->pool, client->pool_key, client->transport) == ESP_OK) {
+            ESP_LOGD(TAG, "Keeping connection to %s in the pool", client->pool_key);
+            return ESP_OK;
+        }
         return esp_transport_close(client->transport);
     }
     return ESP_OK;
@@ -1616,6 +1667,64 @@ esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *l
     return ESP_OK;
 }
 
+esp_err_t esp_http_client_read_stream(esp_http_client_handle_t client, http_body_data_cb body_cb, void *user_data)
+{
+    if (client == NULL || body_cb == NULL) {
+        ESP_LOGE(TAG, "client and body_cb must not be NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->state < HTTP_STATE_RES_ON_DATA_START) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (client->connection_info.method == HTTP_METHOD_HEAD) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = ESP_OK;
+    esp_http_buffer_t *res_buffer = client->response->buffer;
+    /* Body received together with the headers has been cached by esp_http_client_fetch_headers() */
+    if (res_buffer->raw_len) {
+        err = body_cb(res_buffer->raw_data, res_buffer->raw_len, user_data);
+        free(res_buffer->orig_raw_data);
+        res_buffer->orig_raw_data = NULL;
+        res_buffer->raw_data = NULL;
+        res_buffer->raw_len = 0;
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    client->body_cb = body_cb;
+    client->body_cb_data = user_data;
+    client->body_cb_err = ESP_OK;
+    while (!esp_http_client_is_complete_data_received(client)) {
+        int rlen = esp_transport_read(client->transport, res_buffer->data, client->buffer_size_rx, client->timeout_ms);
+        if (rlen == ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT) {
+            err = ESP_ERR_HTTP_EAGAIN;
+            break;
+        }
+        if (rlen == ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN && client->response->is_chunked) {
+            /* Body without length ends when the server closes the connection */
+            http_parser_execute(client->parser, client->parser_settings, res_buffer->data, 0);
+            err = client->is_chunk_complete ? ESP_OK : ESP_FAIL;
+            break;
+        }
+        if (rlen <= 0) {
+            ESP_LOGE(TAG, "esp_transport_read returned:%d and errno:%d ", rlen, errno);
+            http_dispatch_event(client, HTTP_EVENT_ERROR, esp_transport_get_error_handle(client->transport), 0);
+            err = ESP_FAIL;
+            break;
+        }
+        if (http_parser_execute(client->parser, client->parser_settings, res_buffer->data, rlen) != rlen) {
+            err = client->body_cb_err != ESP_OK ? client->body_cb_err : ESP_FAIL;
+            break;
+        }
+    }
+    client->body_cb = NULL;
+    client->body_cb_data = NULL;
+    return err;
+}
+
 esp_err_t esp_http_client_get_url(esp_http_client_handle_t client, char *url, const int len)
 {
     if (client == NULL || url == NULL) {
@@ -21,6 +21,7 @@ extern "C" {
 
 typedef struct esp_http_client *esp_http_client_handle_t;
 typedef struct esp_http_client_event *esp_http_client_event_handle_t;
+typedef struct esp_http_client_pool *esp_http_client_pool_handle_t;
 
 /**
  * @brief   HTTP Client events id
@@ -63,6 +64,14 @@ typedef enum {
 
 typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
 
+/**
+ * @brief Callback receiving a part of the response body, see `esp_http_client_read_stream`
+ *
+ * `data` points into the receive buffer of the client and is only valid during the call.
+ * Returning anything else than ESP_OK stops reading the body.
+ */
+typedef esp_err_t (*http_body_data_cb)(const char *data, int len, void *user_data);
+
 /**
  * @brief HTTP method
  */
@@ -137,8 +146,18 @@ typedef struct {
     int                         keep_alive_interval; /*!< Keep-alive interval time. Default is 5 (second) */
     int                         keep_alive_count;    /*!< Keep-alive packet retry send count. Default is 3 counts */
     struct ifreq                *if_name;            /*!< The name of interface for data to go through. Use the default interface without setting */
+    esp_http_client_pool_handle_t connection_pool;   /*!< Pool to share idle connections with other clients, see `esp_http_client_pool_create`.
+                                                          Not used in asynchronous mode */
 } esp_http_client_config_t;
 
+/**
+ * @brief HTTP connection pool configuration
+ */
+typedef struct {
+    int max_idle_per_host;      /*!< Max number of idle connections kept for the same scheme, host and port, using default value (2) if zero */
+    int idle_timeout_ms;        /*!< Idle connections are closed after this time in milliseconds, using default value (4000) if zero */
+} esp_http_client_pool_config_t;
+
 /**
  * Enum for the HTTP status codes.
  */
@@ -504,6 +523,41 @@ esp_err_t esp_http_client_close(esp_http_client_handle_t client);
  */
 esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
 
+/**
+ * @brief      Create a connection pool which can be shared by several esp_http_client handles
+ *
+ *             Clients which have the pool in their `connection_pool` config don't close their connection in
+ *             `esp_http_client_close` or `esp_http_client_cleanup` if the last response was complete and the server
+ *             allows keep-alive. The connection is kept idle in the pool instead, and the next client connecting to
+ *             the same scheme, host and port takes it over instead of opening a new one.
+ *             With TLS session tickets enabled (ESP_TLS_CLIENT_SESSION_TICKETS), new HTTPS connections also resume
+ *             the session of the last connection to the host, which saves most of the handshake.
+ *
+ *             Connections are matched by scheme, host and port only: all clients sharing a pool should use the same
+ *             TLS configuration for a given host. Enabling `keep_alive_enable` lets the network stack notice dead peers
+ *             while connections are idle, such connections are dropped instead of being reused.
+ *
+ * @param[in]  config   The pool configuration, NULL for defaults
+ *
+ * @return
+ *     - `esp_http_client_pool_handle_t`
+ *     - NULL if any errors
+ */
+esp_http_client_pool_handle_t esp_http_client_pool_create(const esp_http_client_pool_config_t *config);
+
+/**
+ * @brief      Close all idle connections and free the pool
+ *
+ * @note       All clients which use the pool must be cleaned up before
+ *
+ * @param[in]  pool     The pool handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t esp_http_client_pool_destroy(esp_http_client_pool_handle_t pool);
+
 /**
  * @brief      Get transport type
  *
@@ -580,6 +634,27 @@ int esp_http_client_read_response(esp_http_client_handle_t client, char *buffer,
  */
 esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len);
 
+/**
+ * @brief       Read the remaining response body without copying it
+ *              The body is passed to `body_cb` in parts which point directly into the receive buffer of the client,
+ *              with the chunked transfer encoding already removed, so the data is not copied to a user buffer as by
+ *              `esp_http_client_read`. Suitable for large downloads which are processed as they arrive, like OTA updates.
+ *              Must be called after `esp_http_client_fetch_headers`, `HTTP_EVENT_ON_DATA` events are still dispatched.
+ *
+ * @param[in]  client     The esp_http_client handle
+ * @param[in]  body_cb    Callback receiving the body data
+ * @param[in]  user_data  Argument passed to `body_cb`
+ *
+ * @return
+ *     - ESP_OK                 If the whole body was received
+ *     - ESP_ERR_HTTP_EAGAIN    If the call timed out, it can be called again to read the rest of the body
+ *     - ESP_ERR_INVALID_ARG    If the client or body_cb is NULL
+ *     - ESP_ERR_INVALID_STATE  If the response headers were not fetched
+ *     - ESP_FAIL               If failed to read response
+ *     - Error returned by `body_cb`
+ */
+esp_err_t esp_http_client_read_stream(esp_http_client_handle_t client, http_body_data_cb body_cb, void *user_data);
+
 /**
  * @brief          Get URL from client
  *
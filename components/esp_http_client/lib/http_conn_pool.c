@@ -0,0 +1,303 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sys/queue.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_transport.h"
+#include "esp_transport_tcp.h"
+#include "http_conn_pool.h"
+
+#ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
+#include "esp_transport_ssl.h"
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+#define HTTP_CONN_POOL_SESSIONS 1
+#endif
+#endif
+
+static const char *TAG = "HTTP_CONN_POOL";
+
+/* Servers commonly close idle connections after 5 seconds, stay below that */
+#define DEFAULT_POOL_IDLE_TIMEOUT_MS    (4000)
+#define DEFAULT_POOL_MAX_IDLE_PER_HOST  (2)
+
+/**
+ * Idle connection, owned by a transport which isn't part of any client
+ */
+typedef struct http_conn_pool_item {
+    char *key;                                  /*!< "scheme://host:port" */
+    esp_transport_handle_t transport;           /*!< Transport holding the connection */
+    TickType_t idle_since;                      /*!< Time the connection was released */
+    STAILQ_ENTRY(http_conn_pool_item) next;     /*!< Point to next entry */
+} http_conn_pool_item_t;
+
+STAILQ_HEAD(http_conn_pool_list, http_conn_pool_item);
+
+#ifdef HTTP_CONN_POOL_SESSIONS
+/**
+ * TLS session of the last connection to a host
+ */
+typedef struct http_conn_pool_session {
+    char *key;                                  /*!< "scheme://host:port" */
+    esp_tls_client_session_t *session;          /*!< Session to resume */
+    STAILQ_ENTRY(http_conn_pool_session) next;  /*!< Point to next entry */
+} http_conn_pool_session_t;
+#endif
+
+struct esp_http_client_pool {
+    SemaphoreHandle_t lock;
+    int max_idle_per_host;
+    TickType_t idle_timeout;
+    struct http_conn_pool_list idle;            /*!< Idle connections, most recently released first */
+#ifdef HTTP_CONN_POOL_SESSIONS
+    STAILQ_HEAD(, http_conn_pool_session) sessions;
+#endif
+};
+
+static void http_conn_pool_item_destroy(http_conn_pool_item_t *item)
+{
+    esp_transport_destroy(item->transport);
+    free(item->key);
+    free(item);
+}
+
+/* Unlinks the expired connections into `expired`, to be closed without holding the lock */
+static void http_conn_pool_remove_expired(esp_http_client_pool_handle_t pool, struct http_conn_pool_list *expired)
+{
+    TickType_t now = xTaskGetTickCount();
+    http_conn_pool_item_t *item, *tmp;
+    STAILQ_FOREACH_SAFE(item, &pool->idle, next, tmp) {
+        if (now - item->idle_since >= pool->idle_timeout) {
+            STAILQ_REMOVE(&pool->idle, item, http_conn_pool_item, next);
+            STAILQ_INSERT_TAIL(expired, item, next);
+        }
+    }
+}
+
+static void http_conn_pool_list_destroy(struct http_conn_pool_list *list)
+{
+    http_conn_pool_item_t *item, *tmp;
+    STAILQ_FOREACH_SAFE(item, list, next, tmp) {
+        http_conn_pool_item_destroy(item);
+    }
+    STAILQ_INIT(list);
+}
+
+esp_http_client_pool_handle_t esp_http_client_pool_create(const esp_http_client_pool_config_t *config)
+{
+    esp_http_client_pool_handle_t pool = calloc(1, sizeof(struct esp_http_client_pool));
+    ESP_RETURN_ON_FALSE(pool, NULL, TAG, "Memory exhausted");
+    pool->lock = xSemaphoreCreateMutex();
+    if (pool->lock == NULL) {
+        ESP_LOGE(TAG, "Memory exhausted");
+        free(pool);
+        return NULL;
+    }
+    int idle_timeout_ms = DEFAULT_POOL_IDLE_TIMEOUT_MS;
+    pool->max_idle_per_host = DEFAULT_POOL_MAX_IDLE_PER_HOST;
+    if (config) {
+        if (config->idle_timeout_ms > 0) {
+            idle_timeout_ms = config->idle_timeout_ms;
+        }
+        if (config->max_idle_per_host > 0) {
+            pool->max_idle_per_host = config->max_idle_per_host;
+        }
+    }
+    pool->idle_timeout = pdMS_TO_TICKS(idle_timeout_ms);
+    STAILQ_INIT(&pool->idle);
+#ifdef HTTP_CONN_POOL_SESSIONS
+    STAILQ_INIT(&pool->sessions);
+#endif
+    return pool;
+}
+
+esp_err_t esp_http_client_pool_destroy(esp_http_client_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    http_conn_pool_list_destroy(&pool->idle);
+#ifdef HTTP_CONN_POOL_SESSIONS
+    http_conn_pool_session_t *item, *tmp;
+    STAILQ_FOREACH_SAFE(item, &pool->sessions, next, tmp) {
+        esp_tls_free_client_session(item->session);
+        free(item->key);
+        free(item);
+    }
+#endif
+    vSemaphoreDelete(pool->lock);
+    free(pool);
+    return ESP_OK;
+}
+
+esp_err_t http_conn_pool_acquire(esp_http_client_pool_handle_t pool, const char *key, esp_transport_handle_t t)
+{
+    struct http_conn_pool_list drop = STAILQ_HEAD_INITIALIZER(drop);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    while (ret != ESP_OK) {
+        http_conn_pool_item_t *item;
+        xSemaphoreTake(pool->lock, portMAX_DELAY);
+        http_conn_pool_remove_expired(pool, &drop);
+        STAILQ_FOREACH(item, &pool->idle, next) {
+            if (strcasecmp(item->key, key) == 0) {
+                STAILQ_REMOVE(&pool->idle, item, http_conn_pool_item, next);
+                break;
+            }
+        }
+        xSemaphoreGive(pool->lock);
+        if (item == NULL) {
+            break;
+        }
+        /* An idle connection has nothing to read, unless the server has closed it,
+         * or TCP keep-alive found the peer gone */
+        if (esp_transport_poll_read(item->transport, 0) != 0) {
+            ESP_LOGD(TAG, "Dropping connection to %s closed by the server", key);
+            STAILQ_INSERT_TAIL(&drop, item, next);
+            continue;
+        }
+        ret = esp_transport_tcp_move_connection(t, item->transport);
+        if (ret == ESP_OK) {
+            http_conn_pool_item_destroy(item);
+        } else {
+            STAILQ_INSERT_TAIL(&drop, item, next);
+        }
+    }
+    http_conn_pool_list_destroy(&drop);
+    return ret;
+}
+
+esp_err_t http_conn_pool_release(esp_http_client_pool_handle_t pool, const char *key, esp_transport_handle_t t)
+{
+    struct http_conn_pool_list drop = STAILQ_HEAD_INITIALIZER(drop);
+    http_conn_pool_item_t *item = calloc(1, sizeof(http_conn_pool_item_t));
+    ESP_RETURN_ON_FALSE(item, ESP_ERR_NO_MEM, TAG, "Memory exhausted");
+    item->key = strdup(key);
+#ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
+    if (strncasecmp(key, "https:", 6) == 0) {
+        item->transport = esp_transport_ssl_init();
+    } else
+#endif
+    {
+        item->transport = esp_transport_tcp_init();
+    }
+    if (item->key == NULL || item->transport == NULL) {
+        ESP_LOGE(TAG, "Memory exhausted");
+        goto error;
+    }
+    if (esp_transport_tcp_move_connection(item->transport, t) != ESP_OK) {
+        goto error;
+    }
+    item->idle_since = xTaskGetTickCount();
+
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    http_conn_pool_remove_expired(pool, &drop);
+    http_conn_pool_item_t *it, *oldest = NULL;
+    int count = 0;
+    STAILQ_FOREACH(it, &pool->idle, next) {
+        if (strcasecmp(it->key, key) == 0) {
+            oldest = it;
+            count++;
+        }
+    }
+    if (count >= pool->max_idle_per_host) {
+        STAILQ_REMOVE(&pool->idle, oldest, http_conn_pool_item, next);
+        STAILQ_INSERT_TAIL(&drop, oldest, next);
+    }
+    STAILQ_INSERT_HEAD(&pool->idle, item, next);
+    xSemaphoreGive(pool->lock);
+
+    http_conn_pool_list_destroy(&drop);
+    return ESP_OK;
+
+error:
+    if (item->transport) {
+        esp_transport_destroy(item->transport);
+    }
+    free(item->key);
+    free(item);
+    return ESP_ERR_NO_MEM;
+}
+
+#ifdef HTTP_CONN_POOL_SESSIONS
+static esp_tls_client_session_t *http_conn_pool_take_session(esp_http_client_pool_handle_t pool, const char *key)
+{
+    esp_tls_client_session_t *session = NULL;
+    http_conn_pool_session_t *item;
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    STAILQ_FOREACH(item, &pool->sessions, next) {
+        if (strcasecmp(item->key, key) == 0) {
+            session = item->session;
+            item->session = NULL;
+            break;
+        }
+    }
+    xSemaphoreGive(pool->lock);
+    return session;
+}
+
+static void http_conn_pool_put_session(esp_http_client_pool_handle_t pool, const char *key, esp_tls_client_session_t *session)
+{
+    esp_tls_client_session_t *old = NULL;
+    http_conn_pool_session_t *item;
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    STAILQ_FOREACH(item, &pool->sessions, next) {
+        if (strcasecmp(item->key, key) == 0) {
+            break;
+        }
+    }
+    if (item == NULL && (item = calloc(1, sizeof(http_conn_pool_session_t))) != NULL) {
+        if ((item->key = strdup(key)) != NULL) {
+            STAILQ_INSERT_TAIL(&pool->sessions, item, next);
+        } else {
+            free(item);
+            item = NULL;
+        }
+    }
+    if (item) {
+        old = item->session;
+        item->session = session;
+        session = NULL;
+    }
+    xSemaphoreGive(pool->lock);
+    esp_tls_free_client_session(old);
+    esp_tls_free_client_session(session);
+}
+#endif
+
+int http_conn_pool_connect(esp_http_client_pool_handle_t pool, const char *key, esp_transport_handle_t t,
+                           const char *host, int port, int timeout_ms)
+{
+#ifdef HTTP_CONN_POOL_SESSIONS
+    if (strncasecmp(key, "https:", 6) == 0) {
+        int ret;
+        esp_tls_client_session_t *session = http_conn_pool_take_session(pool, key);
+        if (session) {
+            esp_transport_ssl_set_client_session(t, session);
+            ret = esp_transport_connect(t, host, port, timeout_ms);
+            esp_transport_ssl_set_client_session(t, NULL);
+            esp_tls_free_client_session(session);
+            if (ret < 0) {
+                /* esp-tls doesn't configure server verification when resuming,
+                 * so a full handshake needs a fresh connection */
+                ESP_LOGD(TAG, "Failed to resume session with %s, retrying", key);
+                ret = esp_transport_connect(t, host, port, timeout_ms);
+            }
+        } else {
+            ret = esp_transport_connect(t, host, port, timeout_ms);
+        }
+        if (ret >= 0) {
+            http_conn_pool_put_session(pool, key, esp_transport_ssl_get_client_session(t));
+        }
+        return ret;
+    }
+#endif
+    return esp_transport_connect(t, host, port, timeout_ms);
+}
@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _HTTP_CONN_POOL_H_
+#define _HTTP_CONN_POOL_H_
+
+#include "esp_err.h"
+#include "esp_transport.h"
+#include "esp_http_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief      Take an idle connection out of the pool
+ *
+ *             Expired connections and connections closed by the server are dropped on the way.
+ *
+ * @param[in]  pool  The pool
+ * @param[in]  key   The connection key, "scheme://host:port"
+ * @param[in]  t     The transport which takes over the connection
+ *
+ * @return
+ *     - ESP_OK if `t` is connected
+ *     - ESP_ERR_NOT_FOUND if there is no idle connection for `key`
+ */
+esp_err_t http_conn_pool_acquire(esp_http_client_pool_handle_t pool, const char *key, esp_transport_handle_t t);
+
+/**
+ * @brief      Put the connection of a transport into the pool
+ *
+ *             On success the transport is closed and the connection stays open in the pool.
+ *             The oldest idle connection for `key` is closed if there are already max_idle_per_host of them.
+ *
+ * @param[in]  pool  The pool
+ * @param[in]  key   The connection key, "scheme://host:port"
+ * @param[in]  t     The connected transport
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NO_MEM, the transport is still connected
+ */
+esp_err_t http_conn_pool_release(esp_http_client_pool_handle_t pool, const char *key, esp_transport_handle_t t);
+
+/**
+ * @brief      Connect the transport, resuming the TLS session of a previous connection to the same key if there is one
+ *
+ *             The session of the new connection is saved in the pool. Same as esp_transport_connect() for
+ *             plain TCP or if session tickets are disabled.
+ *
+ * @return     Same as esp_transport_connect()
+ */
+int http_conn_pool_connect(esp_http_client_pool_handle_t pool, const char *key, esp_transport_handle_t t,
+                           const char *host, int port, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,13 +1,16 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <sys/param.h>
 #include <esp_system.h>
 #include <esp_http_client.h>
+#include <esp_http_server.h>
+#include <esp_timer.h>
 
 #include "unity.h"
 #include "test_utils.h"
@@ -145,3 +148,169 @@ TEST_CASE("esp_http_client_init() should return NULL if configured with wrong ur
     TEST_ASSERT_NULL(client);
     esp_http_client_cleanup(client);
 }
+
+#define POOL_TEST_PORT      8089
+#define POOL_TEST_REQUESTS  5
+
+static int s_pool_test_sessions;
+
+static esp_err_t pool_test_open_fn(httpd_handle_t hd, int sockfd)
+{
+    s_pool_test_sessions++;
+    return ESP_OK;
+}
+
+static esp_err_t pool_test_handler(httpd_req_t *req)
+{
+    return httpd_resp_sendstr(req, "pooled");
+}
+
+/**
+ * Test case to verify that clients sharing a connection pool reuse the connection of the previous client.
+ **/
+TEST_CASE("Clients sharing a connection pool reuse the connection", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t server = NULL;
+    httpd_config_t server_config = HTTPD_DEFAULT_CONFIG();
+    server_config.server_port = POOL_TEST_PORT;
+    server_config.ctrl_port = POOL_TEST_PORT + 1;
+    server_config.open_fn = pool_test_open_fn;
+    TEST_ESP_OK(httpd_start(&server, &server_config));
+    httpd_uri_t uri = {
+        .uri = "/pool",
+        .method = HTTP_GET,
+        .handler = pool_test_handler,
+    };
+    TEST_ESP_OK(httpd_register_uri_handler(server, &uri));
+
+    esp_http_client_pool_handle_t pool = esp_http_client_pool_create(NULL);
+    TEST_ASSERT_NOT_NULL(pool);
+    esp_http_client_config_t config = {
+        .url = "http://127.0.0.1:8089/pool",
+        .connection_pool = pool,
+    };
+    s_pool_test_sessions = 0;
+    for (int i = 0; i < POOL_TEST_REQUESTS; i++) {
+        esp_http_client_handle_t client = esp_http_client_init(&config);
+        TEST_ASSERT_NOT_NULL(client);
+        TEST_ESP_OK(esp_http_client_perform(client));
+        TEST_ASSERT_EQUAL(200, esp_http_client_get_status_code(client));
+        TEST_ESP_OK(esp_http_client_cleanup(client));
+    }
+    TEST_ASSERT_EQUAL(1, s_pool_test_sessions);
+
+    /* Without the pool every client opens its own connection */
+    config.connection_pool = NULL;
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ESP_OK(esp_http_client_perform(client));
+    TEST_ESP_OK(esp_http_client_cleanup(client));
+    TEST_ASSERT_EQUAL(2, s_pool_test_sessions);
+
+    TEST_ESP_OK(esp_http_client_pool_destroy(pool));
+    TEST_ESP_OK(httpd_stop(server));
+}
+
+#define STREAM_TEST_PORT        8091
+#define STREAM_TEST_BODY_SIZE   (64 * 1024)
+#define STREAM_TEST_CHUNK_SIZE  1436
+#define STREAM_TEST_REPEAT      8
+
+static char *s_stream_test_body;
+
+static esp_err_t stream_test_handler(httpd_req_t *req)
+{
+    return httpd_resp_send(req, s_stream_test_body, STREAM_TEST_BODY_SIZE);
+}
+
+static esp_err_t stream_test_chunked_handler(httpd_req_t *req)
+{
+    for (int offset = 0; offset < STREAM_TEST_BODY_SIZE; offset += STREAM_TEST_CHUNK_SIZE) {
+        int len = MIN(STREAM_TEST_CHUNK_SIZE, STREAM_TEST_BODY_SIZE - offset);
+        if (httpd_resp_send_chunk(req, s_stream_test_body + offset, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t stream_test_body_cb(const char *data, int len, void *user_data)
+{
+    int *offset = (int *)user_data;
+    TEST_ASSERT_LESS_OR_EQUAL(STREAM_TEST_BODY_SIZE, *offset + len);
+    TEST_ASSERT_EQUAL_MEMORY(s_stream_test_body + *offset, data, len);
+    *offset += len;
+    return ESP_OK;
+}
+
+static void stream_test_download(esp_http_client_handle_t client, const char *url, bool stream)
+{
+    static char buffer[DEFAULT_HTTP_BUF_SIZE];
+    int offset = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < STREAM_TEST_REPEAT; i++) {
+        offset = 0;
+        TEST_ESP_OK(esp_http_client_set_url(client, url));
+        TEST_ESP_OK(esp_http_client_open(client, 0));
+        TEST_ASSERT_GREATER_OR_EQUAL(0, esp_http_client_fetch_headers(client));
+        if (stream) {
+            TEST_ESP_OK(esp_http_client_read_stream(client, stream_test_body_cb, &offset));
+        } else {
+            int len;
+            while ((len = esp_http_client_read(client, buffer, sizeof(buffer))) > 0) {
+                TEST_ASSERT_EQUAL_MEMORY(s_stream_test_body + offset, buffer, len);
+                offset += len;
+            }
+        }
+        TEST_ASSERT_EQUAL(STREAM_TEST_BODY_SIZE, offset);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    printf("%s %s: %d KB/s\n", stream ? "esp_http_client_read_stream" : "esp_http_client_read", url,
+           (int)(STREAM_TEST_REPEAT * (int64_t)STREAM_TEST_BODY_SIZE * 1000000 / 1024 / elapsed));
+}
+
+/**
+ * Test case to verify esp_http_client_read_stream() against esp_http_client_read(), and to compare their throughput
+ * on a loopback server, with and without chunked transfer encoding.
+ **/
+TEST_CASE("Response body can be streamed from the receive buffer", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    s_stream_test_body = malloc(STREAM_TEST_BODY_SIZE);
+    TEST_ASSERT_NOT_NULL(s_stream_test_body);
+    for (int i = 0; i < STREAM_TEST_BODY_SIZE; i++) {
+        s_stream_test_body[i] = (char)(i * 7 + i / 251);
+    }
+
+    httpd_handle_t server = NULL;
+    httpd_config_t server_config = HTTPD_DEFAULT_CONFIG();
+    server_config.server_port = STREAM_TEST_PORT;
+    server_config.ctrl_port = STREAM_TEST_PORT + 1;
+    TEST_ESP_OK(httpd_start(&server, &server_config));
+    httpd_uri_t uri = {
+        .uri = "/body",
+        .method = HTTP_GET,
+        .handler = stream_test_handler,
+    };
+    TEST_ESP_OK(httpd_register_uri_handler(server, &uri));
+    uri.uri = "/chunked";
+    uri.handler = stream_test_chunked_handler;
+    TEST_ESP_OK(httpd_register_uri_handler(server, &uri));
+
+    esp_http_client_config_t config = {
+        .url = "http://127.0.0.1:8091/body",
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    stream_test_download(client, "http://127.0.0.1:8091/body", false);
+    stream_test_download(client, "http://127.0.0.1:8091/body", true);
+    stream_test_download(client, "http://127.0.0.1:8091/chunked", false);
+    stream_test_download(client, "http://127.0.0.1:8091/chunked", true);
+    TEST_ESP_OK(esp_http_client_cleanup(client));
+
+    TEST_ESP_OK(httpd_stop(server));
+    free(s_stream_test_body);
+}
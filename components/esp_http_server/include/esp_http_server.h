@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -19,6 +19,9 @@
 extern "C" {
 #endif
 
+/* Defined in esp_partition.h, only used through a pointer */
+struct esp_partition_t;
+
 /*
 note: esp_https_server.h includes a customized copy of this
 initializer that should be kept in sync
@@ -36,6 +39,7 @@ initializer that should be kept in sync
         .lru_purge_enable   = false,                    \
         .recv_wait_timeout  = 5,                        \
         .send_wait_timeout  = 5,                        \
+        .worker_count       = 0,                        \
         .global_user_ctx = NULL,                        \
         .global_user_ctx_free_fn = NULL,                \
         .global_transport_ctx = NULL,                   \
@@ -155,6 +159,18 @@ typedef struct httpd_config {
     uint16_t    recv_wait_timeout;  /*!< Timeout for recv function (in seconds)*/
     uint16_t    send_wait_timeout;  /*!< Timeout for send function (in seconds)*/
 
+    /**
+     * Number of worker tasks which execute requests.
+     *
+     * If 0, requests are parsed and URI handlers are executed by the server task,
+     * one at a time. Otherwise the server task only accepts connections and waits
+     * for data, and each session with a request ready is handed to one of the workers,
+     * so a slow handler doesn't hold up other sessions. A session is processed by
+     * a single worker at a time. Workers use the same stack size, priority and core
+     * as the server task, and each one allocates its own request data.
+     */
+    uint16_t    worker_count;
+
     /**
      * Global user context.
      *
@@ -232,6 +248,11 @@ typedef struct httpd_config {
      *
      * Users can implement their own matching functions (See description
      * of the `httpd_uri_match_func_t` function prototype)
+     *
+     * With the two built-in options, registered URIs are kept in a
+     * prefix tree, so finding the handler doesn't depend on the number
+     * of registered URI handlers. A custom function is called for each
+     * registered URI handler until a match is found.
      */
     httpd_uri_match_func_t uri_match_fn;
 } httpd_config_t;
@@ -1106,6 +1127,100 @@ static inline esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *r, const char *str
     return httpd_resp_send_chunk(r, str, (str == NULL) ? 0 : HTTPD_RESP_USE_STRLEN);
 }
 
+/**
+ * @brief   API to send the contents of an open file as HTTP response
+ *
+ * Sends len bytes read from the file descriptor with a Content-Length
+ * header. The status line and headers are sent together with the first
+ * part of the file, and the rest is read and sent in parts of
+ * CONFIG_HTTPD_SEND_FILE_BUF_SIZE bytes, without chunked encoding.
+ *
+ * The content type and additional headers are set in the same way
+ * as for httpd_resp_send().
+ *
+ * @note
+ *  - This API is supposed to be called only from the context of
+ *    a URI handler where httpd_req_t* request pointer is valid.
+ *  - Once this API is called, all request headers are purged.
+ *  - If reading the file fails after the headers have been sent, the
+ *    handler should return ESP_FAIL so that the connection is closed.
+ *
+ * @param[in] r     The request being responded to
+ * @param[in] fd    File descriptor to read the content from, e.g. a file on SPIFFS or FAT
+ * @param[in] len   Number of bytes to send
+ *
+ * @return
+ *  - ESP_OK : On successfully sending the response packet
+ *  - ESP_ERR_INVALID_ARG : Null request pointer or invalid file descriptor
+ *  - ESP_ERR_NO_MEM : Failed to allocate the send buffer
+ *  - ESP_ERR_HTTPD_RESP_HDR    : Essential headers are too large for internal buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND   : Error in raw send
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request
+ *  - ESP_FAIL : Error reading from the file descriptor
+ */
+esp_err_t httpd_resp_send_fd(httpd_req_t *r, int fd, size_t len);
+
+/**
+ * @brief   API to send a file as HTTP response
+ *
+ * Opens the file at path and sends it using httpd_resp_send_fd().
+ * If the request has an Accept-Encoding header which allows gzip and
+ * a precompressed file with the same name and ".gz" appended exists,
+ * that file is sent instead, with the header "Content-Encoding: gzip".
+ * "Vary: Accept-Encoding" is set whenever the precompressed file exists,
+ * also if the original file is sent.
+ *
+ * The content type should be set for the original file name using
+ * httpd_resp_set_type() before calling this API.
+ *
+ * @note
+ *  - This API is supposed to be called only from the context of
+ *    a URI handler where httpd_req_t* request pointer is valid.
+ *  - Nothing is sent if the file can't be opened, so that the handler
+ *    can send an error response instead.
+ *
+ * @param[in] r     The request being responded to
+ * @param[in] path  Path of the file in the VFS
+ *
+ * @return
+ *  - ESP_OK : On successfully sending the response packet
+ *  - ESP_ERR_NOT_FOUND : File doesn't exist or is not a regular file
+ *  - Other errors as returned by httpd_resp_send_fd()
+ */
+esp_err_t httpd_resp_send_file(httpd_req_t *r, const char *path);
+
+/**
+ * @brief   API to send data stored in a flash partition as HTTP response
+ *
+ * The data is memory mapped using esp_partition_mmap() and sent with a
+ * Content-Length header, so it is not copied into an intermediate buffer.
+ * Small responses are sent in a single send together with the headers.
+ *
+ * The content type and additional headers are set in the same way
+ * as for httpd_resp_send().
+ *
+ * @note
+ *  - This API is supposed to be called only from the context of
+ *    a URI handler where httpd_req_t* request pointer is valid.
+ *  - Once this API is called, all request headers are purged.
+ *
+ * @param[in] r          The request being responded to
+ * @param[in] partition  Partition which contains the data
+ * @param[in] offset     Offset of the data from the beginning of the partition
+ * @param[in] len        Number of bytes to send
+ *
+ * @return
+ *  - ESP_OK : On successfully sending the response packet
+ *  - ESP_ERR_INVALID_ARG : Null arguments
+ *  - ESP_ERR_NO_MEM : Failed to allocate the send buffer
+ *  - ESP_ERR_HTTPD_RESP_HDR    : Essential headers are too large for internal buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND   : Error in raw send
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request
+ *  - Other errors as returned by esp_partition_mmap()
+ */
+esp_err_t httpd_resp_send_partition(httpd_req_t *r, const struct esp_partition_t *partition,
+                                    size_t offset, size_t len);
+
 /* Some commonly used status codes */
 #define HTTPD_200      "200 OK"                     /*!< HTTP Response 200 */
 #define HTTPD_204      "204 No Content"             /*!< HTTP Response 204 */
@@ -1545,6 +1660,12 @@ typedef void (*httpd_work_fn_t)(void *arg);
  *          and send it to the persistently opened connection. This facility is for use
  *          by such protocols.
  *
+ * @note    With worker tasks (see httpd_config_t::worker_count), the work runs while
+ *          workers process requests. WebSocket frames sent with httpd_ws_send_frame_async()
+ *          don't interleave with the frames sent by the worker processing the same session,
+ *          but other data sent on a session a worker is processing, e.g. with
+ *          httpd_socket_send(), may.
+ *
  * @param[in] handle    Handle to server returned by httpd_start
  * @param[in] work      Pointer to the function to be executed in the HTTPD's context
  * @param[in] arg       Pointer to the arguments that should be passed to this function
@@ -1700,6 +1821,37 @@ esp_err_t httpd_ws_send_data(httpd_handle_t handle, int socket, httpd_ws_frame_t
 esp_err_t httpd_ws_send_data_async(httpd_handle_t handle, int socket, httpd_ws_frame_t *frame,
                                    transfer_complete_cb callback, void *arg);
 
+/**
+ * @brief Sends the same data to several websockets asynchronously
+ *
+ * The frame is encoded once and copied, so the payload buffer may be reused as soon as
+ * this returns. It is then sent to every client, with a single send per client, by one
+ * work item queued with httpd_queue_work().
+ *
+ * @note    Clients which are not (or no longer) WebSocket clients of this server are
+ *          skipped, with ESP_ERR_INVALID_ARG passed to the callback.
+ *
+ * @note    Like with httpd_ws_send_frame_async(), the frame doesn't interleave with the
+ *          frames sent by a worker task processing the same client.
+ *
+ * @param[in] handle    Server instance data
+ * @param[in] fds       Socket descriptors of the clients, or NULL to send to all clients
+ *                      which did the WebSocket handshake on `uri`
+ * @param[in] fd_count  Number of socket descriptors in `fds`
+ * @param[in] uri       URI of the clients, exactly as registered with httpd_register_uri_handler(),
+ *                      if `fds` is NULL. If NULL as well, data is sent to all WebSocket clients
+ * @param[in] frame     Websocket frame
+ * @param[in] callback  Callback invoked for every client after sending data, may be NULL
+ * @param[in] arg       User data passed to provided callback
+ * @return
+ *  - ESP_OK                    : On successfully queueing the work
+ *  - ESP_FAIL                  : Failure in ctrl socket
+ *  - ESP_ERR_NO_MEM            : Unable to allocate memory
+ *  - ESP_ERR_INVALID_ARG       : Null arguments
+ */
+esp_err_t httpd_ws_broadcast_async(httpd_handle_t handle, const int *fds, size_t fd_count, const char *uri,
+                                   httpd_ws_frame_t *frame, transfer_complete_cb callback, void *arg);
+
 #endif /* CONFIG_HTTPD_WS_SUPPORT */
 /** End of WebSocket related stuff
  * @}
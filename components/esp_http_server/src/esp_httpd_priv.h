@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -16,6 +16,8 @@
 #include <esp_err.h>
 
 #include <esp_http_server.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include "osal.h"
 
 #ifdef __cplusplus
@@ -23,9 +25,14 @@ extern "C" {
 #endif
 
 /* Size of request data block/chunk (not to be confused with chunked encoded data)
- * that is received and parsed in one turn of the parsing process. This should not
- * exceed the scratch buffer size and should at least be 8 bytes */
-#define PARSER_BLOCK_SIZE  128
+ * that is received and parsed in one turn of the parsing process. This is also the
+ * size of the per-session buffer for data received past the end of a request, and
+ * should at least be 8 bytes */
+#define PARSER_BLOCK_SIZE  CONFIG_HTTPD_RECV_BUF_SIZE
+
+/* Maximum number of requests, already received on a session, that are processed
+ * before other sessions are polled again */
+#define HTTPD_MAX_BATCH_REQS  8
 
 /* Calculate the maximum size needed for the scratch buffer */
 #define HTTPD_SCRATCH_BUF  MAX(HTTPD_MAX_REQ_HDR_LEN, HTTPD_MAX_URI_LEN)
@@ -64,12 +71,16 @@ struct sock_db {
     bool lru_socket;                        /*!< Flag indicating LRU socket */
     char pending_data[PARSER_BLOCK_SIZE];   /*!< Buffer for pending data to be received */
     size_t pending_len;                     /*!< Length of pending data to be received */
+    struct httpd_req *req;                  /*!< Request being processed on this socket, NULL if none */
+    bool busy;                              /*!< Handed to a worker task, not polled by the server task until done */
+    bool close_pending;                     /*!< Close the session once the worker task is done with it */
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     bool ws_handshake_done;                 /*!< True if it has done WebSocket handshake (if this socket is a valid WS) */
     bool ws_close;                          /*!< Set to true to close the socket later (when WS Close frame received) */
     esp_err_t (*ws_handler)(httpd_req_t *r);   /*!< WebSocket handler, leave to null if it's not WebSocket */
     bool ws_control_frames;                         /*!< WebSocket flag indicating that control frames should be passed to user handlers */
     void *ws_user_ctx;                         /*!< Pointer to user context data which will be available to handler for websocket*/
+    char *ws_uri;                           /*!< URI of the handler which did the WebSocket handshake, as registered */
 #endif
 };
 
@@ -91,6 +102,7 @@ struct httpd_req_aux {
         const char *value;
     } *resp_hdrs;                                   /*!< Additional headers in response packet */
     struct http_parser_url url_parse_res;           /*!< URL parsing result, used for retrieving URL elements */
+    char            resp_buf[CONFIG_HTTPD_RESP_BUF_SIZE]; /*!< Buffer for sending response headers together with small content */
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     bool ws_handshake_detect;                       /*!< WebSocket handshake detection flag */
     httpd_ws_type_t ws_type;                        /*!< WebSocket frame type */
@@ -99,6 +111,16 @@ struct httpd_req_aux {
 #endif
 };
 
+/**
+ * @brief   Worker task data, used if config.worker_count is not 0
+ */
+struct httpd_worker {
+    struct httpd_data *hd;                  /*!< Server instance the worker belongs to */
+    struct thread_data td;                  /*!< Information for the worker thread */
+    struct httpd_req req;                   /*!< The request being processed by this worker */
+    struct httpd_req_aux req_aux;           /*!< Additional data about the request */
+};
+
 /**
  * @brief   Server data for each instance. This is exposed publicly as
  *          httpd_handle_t but internal structure/members are kept private.
@@ -115,9 +137,15 @@ struct httpd_data {
     struct sock_db *hd_sd;                  /*!< The socket database */
     int hd_sd_active_count;                 /*!< The number of the active sockets */
     httpd_uri_t **hd_calls;                 /*!< Registered URI handlers */
+    struct httpd_uri_router *uri_router;    /*!< Lookup structure for hd_calls, NULL if not available */
+    bool uri_router_dirty;                  /*!< hd_calls changed since the router was built */
+    SemaphoreHandle_t uri_lock;             /*!< Guards hd_calls and the router, handlers are registered from other tasks */
     struct httpd_req hd_req;                /*!< The current HTTPD request */
     struct httpd_req_aux hd_req_aux;        /*!< Additional data about the HTTPD request kept unexposed */
     uint64_t lru_counter;                   /*!< LRU counter */
+    struct httpd_worker *workers;           /*!< Worker tasks, NULL if requests are processed by the server task */
+    QueueHandle_t work_queue;               /*!< Sessions with data ready, waiting for a worker */
+    SemaphoreHandle_t *sess_locks;          /*!< Write lock of each session slot, NULL if there are no workers */
 
     /* Array of registered error handler functions */
     httpd_err_handler_func_t *err_handler_fns;
@@ -194,12 +222,39 @@ esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd);
  *
  * @param[in] hd      Server instance data
  * @param[in] session Session
+ * @param[in] r       Request data to use for processing
+ * @param[in] ra      Additional request data to use for processing
+ *
+ * Requests which were already received along with the previous one, i.e.
+ * pipelined by the client, are processed as well, up to HTTPD_MAX_BATCH_REQS
+ * requests in total.
  *
  * @return
  *  - ESP_OK    : on successfully receiving, parsing and responding to a request
  *  - ESP_FAIL  : in case of failure in any of the stages of processing
  */
-esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session);
+esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session,
+                             struct httpd_req *r, struct httpd_req_aux *ra);
+
+/**
+ * @brief   Serialize writes to a session between its worker and the server task
+ *
+ * A worker may be sending on a session while queued work, e.g. an asynchronous
+ * WebSocket frame, sends on it from the server task. Does nothing if the server
+ * has no workers.
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ */
+void httpd_sess_lock(struct httpd_data *hd, struct sock_db *session);
+
+/**
+ * @brief   Release the lock taken with httpd_sess_lock()
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] session Session
+ */
+void httpd_sess_unlock(struct httpd_data *hd, struct sock_db *session);
 
 /**
  * @brief   Remove client descriptor from the session / socket database
@@ -260,6 +315,20 @@ bool httpd_is_sess_available(struct httpd_data *hd);
  */
 bool httpd_sess_pending(struct httpd_data *hd, struct sock_db *session);
 
+/**
+ * @brief   Checks if any session, which is not being processed by a
+ *          worker task, has pending data for processing
+ *
+ * A session processes at most HTTPD_MAX_BATCH_REQS requests in one go,
+ * so there may still be pending data left after that. The server task
+ * must not block in select() in that case.
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return True if there is any session with pending data
+ */
+bool httpd_sess_any_pending(struct httpd_data *hd);
+
 /**
  * @brief   Removes the least recently used client from the session
  *
@@ -298,12 +367,13 @@ void httpd_sess_close_all(struct httpd_data *hd);
  *          and invokes the appropriate one if found
  *
  * @param[in] hd  Server instance data for which handler needs to be invoked
+ * @param[in] r   Parsed request
  *
  * @return
  *  - ESP_OK    : if handler found and executed successfully
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_uri(struct httpd_data *hd);
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *r);
 
 /**
  * @brief   Unregister all URI handlers
@@ -352,25 +422,28 @@ bool httpd_validate_req_ptr(httpd_req_t *r);
  * http_recv() after this reads the body of the request.
  *
  * @param[in] hd  Server instance data
+ * @param[in] r   Request data to be filled in
+ * @param[in] ra  Additional request data to be filled in
  * @param[in] sd  Pointer to socket which is needed for receiving TCP packets.
  *
  * @return
  *  - ESP_OK    : if request packet is valid
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd);
+esp_err_t httpd_req_new(struct httpd_data *hd, httpd_req_t *r, struct httpd_req_aux *ra, struct sock_db *sd);
 
 /**
  * @brief   For an HTTP request, resets the resources allocated for it and
  *          purges any data left to be received
  *
  * @param[in] hd  Server instance data
+ * @param[in] r   Request to delete
  *
  * @return
  *  - ESP_OK    : if request packet deleted and resources cleaned.
  *  - ESP_FAIL  : otherwise.
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd);
+esp_err_t httpd_req_delete(struct httpd_data *hd, httpd_req_t *r);
 
 /**
  * @brief   For handling HTTP errors by invoking registered
@@ -435,7 +508,8 @@ int httpd_recv_with_opt(httpd_req_t *r, char *buf, size_t buf_len, bool halt_aft
  *
  * This function copies data into internal buffer pending_data so that
  * when httpd_recv is called, it first fetches this pending data and
- * then only starts receiving from the socket
+ * then only starts receiving from the socket. The data is placed in
+ * front of any data that is already pending.
  *
  * @note    If data is too large for the internal buffer then only
  *          part of the data is unreceived, reflected in the returned
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -181,6 +181,99 @@ static void httpd_process_ctrl_msg(struct httpd_data *hd)
 #endif
 }
 
+/* Runs in the server thread once a worker is done with a session */
+static void httpd_worker_sess_done(void *arg)
+{
+    struct sock_db *session = (struct sock_db *) arg;
+    struct httpd_data *hd = (struct httpd_data *) session->handle;
+
+    session->busy = false;
+    if (session->close_pending) {
+        session->close_pending = false;
+        httpd_sess_delete(hd, session);
+        return;
+    }
+    session->lru_counter = ++hd->lru_counter;
+}
+
+/* Worker thread, processes sessions handed over by the server thread */
+static void httpd_worker_thread(void *arg)
+{
+    struct httpd_worker *worker = (struct httpd_worker *) arg;
+    struct httpd_data *hd = worker->hd;
+    struct sock_db *session;
+
+    worker->td.status = THREAD_RUNNING;
+    while (xQueueReceive(hd->work_queue, &session, portMAX_DELAY) == pdTRUE) {
+        if (session == NULL) {
+            /* Server is stopping */
+            break;
+        }
+        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), session->fd);
+        if (httpd_sess_process(hd, session, &worker->req, &worker->req_aux) != ESP_OK) {
+            session->close_pending = true;
+        }
+        /* Session table is only modified by the server thread, let it finish the session */
+        while (httpd_queue_work(hd, httpd_worker_sess_done, session) != ESP_OK) {
+            if (hd->hd_td.status != THREAD_RUNNING) {
+                /* Server is stopping, httpd_workers_stop() finishes the session */
+                break;
+            }
+            httpd_os_thread_sleep(10);
+        }
+    }
+    worker->td.status = THREAD_STOPPED;
+    httpd_os_thread_delete();
+}
+
+static esp_err_t httpd_workers_start(struct httpd_data *hd)
+{
+    for (int i = 0; i < hd->config.worker_count; i++) {
+        struct httpd_worker *worker = &hd->workers[i];
+        if (httpd_os_thread_create(&worker->td.handle, "httpd_worker",
+                                   hd->config.stack_size,
+                                   hd->config.task_priority,
+                                   httpd_worker_thread, worker,
+                                   hd->config.core_id) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        worker->td.status = THREAD_RUNNING;
+    }
+    return ESP_OK;
+}
+
+static void httpd_workers_stop(struct httpd_data *hd)
+{
+    if (!hd->workers) {
+        return;
+    }
+    /* Workers finish the request they are processing, then exit. Any worker
+     * may take a stop message, so count the running ones before sending */
+    int running = 0;
+    for (int i = 0; i < hd->config.worker_count; i++) {
+        if (hd->workers[i].td.status == THREAD_RUNNING) {
+            running++;
+        }
+    }
+    for (int i = 0; i < running; i++) {
+        struct sock_db *stop = NULL;
+        xQueueSend(hd->work_queue, &stop, portMAX_DELAY);
+    }
+    for (int i = 0; i < hd->config.worker_count; i++) {
+        while (hd->workers[i].td.status == THREAD_RUNNING) {
+            httpd_os_thread_sleep(10);
+        }
+    }
+    /* The done work of a session may not have been queued or run, because the
+     * server thread stopped. Finish these sessions here, so they are closed */
+    for (int i = 0; i < hd->config.max_open_sockets; i++) {
+        struct sock_db *session = &hd->hd_sd[i];
+        if (session->fd != -1 && session->busy) {
+            httpd_worker_sess_done(session);
+        }
+    }
+}
+
 // Called for each session from httpd_server
 static int httpd_process_session(struct sock_db *session, void *context)
 {
@@ -188,7 +281,7 @@ static int httpd_process_session(struct sock_db *session, void *context)
         return 0;
     }
 
-    if (session->fd < 0) {
+    if (session->fd < 0 || session->busy) {
         return 1;
     }
 
@@ -196,9 +289,18 @@ static int httpd_process_session(struct sock_db *session, void *context)
     int fd = session->fd;
 
     if (FD_ISSET(fd, ctx->fdset) || httpd_sess_pending(ctx->hd, session)) {
+        if (ctx->hd->work_queue) {
+            ESP_LOGD(TAG, LOG_FMT("dispatching socket %d"), fd);
+            /* Queue has room for every session and a session is queued at most once */
+            session->busy = true;
+            xQueueSend(ctx->hd->work_queue, &session, portMAX_DELAY);
+            return 1;
+        }
         ESP_LOGD(TAG, LOG_FMT("processing socket %d"), fd);
-        if (httpd_sess_process(ctx->hd, session) != ESP_OK) {
+        if (httpd_sess_process(ctx->hd, session, &ctx->hd->hd_req, &ctx->hd->hd_req_aux) != ESP_OK) {
             httpd_sess_delete(ctx->hd, session); // Delete session
+        } else {
+            session->lru_counter = ++ctx->hd->lru_counter;
         }
     }
     return 1;
@@ -223,8 +325,13 @@ static esp_err_t httpd_server(struct httpd_data *hd)
     tmp_max_fd = maxfd;
     maxfd = MAX(hd->ctrl_fd, tmp_max_fd);
 
+    /* Don't wait for socket activity if a session still has received
+     * requests to process */
+    struct timeval no_wait = { 0 };
+    struct timeval *timeout = httpd_sess_any_pending(hd) ? &no_wait : NULL;
+
     ESP_LOGD(TAG, LOG_FMT("doing select maxfd+1 = %d"), maxfd + 1);
-    int active_cnt = select(maxfd + 1, &read_set, NULL, NULL, NULL);
+    int active_cnt = select(maxfd + 1, &read_set, NULL, NULL, timeout);
     if (active_cnt < 0) {
         ESP_LOGE(TAG, LOG_FMT("error in select (%d)"), errno);
         httpd_sess_delete_invalid(hd);
@@ -276,6 +383,7 @@ static void httpd_thread(void *arg)
     }
 
     ESP_LOGD(TAG, LOG_FMT("web server exiting"));
+    httpd_workers_stop(hd);
     close(hd->msg_fd);
     cs_free_ctrl_sock(hd->ctrl_fd);
     httpd_sess_close_all(hd);
@@ -355,6 +463,62 @@ static esp_err_t httpd_server_init(struct httpd_data *hd)
     return ESP_OK;
 }
 
+static esp_err_t httpd_workers_create(struct httpd_data *hd)
+{
+    hd->workers = calloc(hd->config.worker_count, sizeof(struct httpd_worker));
+    if (!hd->workers) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < hd->config.worker_count; i++) {
+        hd->workers[i].hd = hd;
+        hd->workers[i].req_aux.resp_hdrs = calloc(hd->config.max_resp_headers, sizeof(struct resp_hdr));
+        if (!hd->workers[i].req_aux.resp_hdrs) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    /* Each session is queued at most once */
+    hd->work_queue = xQueueCreate(hd->config.max_open_sockets + hd->config.worker_count, sizeof(struct sock_db *));
+    if (!hd->work_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+    /* Kept apart from the session data, which is cleared for each new session */
+    hd->sess_locks = calloc(hd->config.max_open_sockets, sizeof(SemaphoreHandle_t));
+    if (!hd->sess_locks) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < hd->config.max_open_sockets; i++) {
+        hd->sess_locks[i] = xSemaphoreCreateMutex();
+        if (!hd->sess_locks[i]) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+static void httpd_workers_free(struct httpd_data *hd)
+{
+    if (hd->workers) {
+        for (int i = 0; i < hd->config.worker_count; i++) {
+            free(hd->workers[i].req_aux.resp_hdrs);
+        }
+        free(hd->workers);
+        hd->workers = NULL;
+    }
+    if (hd->work_queue) {
+        vQueueDelete(hd->work_queue);
+        hd->work_queue = NULL;
+    }
+    if (hd->sess_locks) {
+        for (int i = 0; i < hd->config.max_open_sockets; i++) {
+            if (hd->sess_locks[i]) {
+                vSemaphoreDelete(hd->sess_locks[i]);
+            }
+        }
+        free(hd->sess_locks);
+        hd->sess_locks = NULL;
+    }
+}
+
 static struct httpd_data *httpd_create(const httpd_config_t *config)
 {
     /* Allocate memory for httpd instance data */
@@ -396,6 +560,18 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
     }
     /* Save the configuration for this instance */
     hd->config = *config;
+    if (config->worker_count) {
+        if (httpd_workers_create(hd) != ESP_OK) {
+            ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP worker data"));
+            httpd_workers_free(hd);
+            free(hd->err_handler_fns);
+            free(ra->resp_hdrs);
+            free(hd->hd_sd);
+            free(hd->hd_calls);
+            free(hd);
+            return NULL;
+        }
+    }
     return hd;
 }
 
@@ -403,6 +579,7 @@ static void httpd_delete(struct httpd_data *hd)
 {
     struct httpd_req_aux *ra = &hd->hd_req_aux;
     /* Free memory of httpd instance data */
+    httpd_workers_free(hd);
     free(hd->err_handler_fns);
     free(ra->resp_hdrs);
     free(hd->hd_sd);
@@ -410,6 +587,9 @@ static void httpd_delete(struct httpd_data *hd)
     /* Free registered URI handlers */
     httpd_unregister_all_uri_handlers(hd);
     free(hd->hd_calls);
+    if (hd->uri_lock) {
+        vSemaphoreDelete(hd->uri_lock);
+    }
     free(hd);
 }
 
@@ -441,6 +621,12 @@ esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
         /* Failed to allocate memory */
         return ESP_ERR_HTTPD_ALLOC_MEM;
     }
+    hd->uri_lock = xSemaphoreCreateMutex();
+    if (hd->uri_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create URI handler lock");
+        httpd_delete(hd);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
 #if CONFIG_HTTPD_QUEUE_WORK_BLOCKING
     /* Using a Counting Semaphore with count equals CONFIG_LWIP_UDP_RECVMBOX_SIZE
      * as the number of UDP messages which can be stored is equal to UDP mailbox size.
@@ -460,12 +646,23 @@ esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
     }
 
     httpd_sess_init(hd);
+    if (httpd_workers_start(hd) != ESP_OK) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to launch worker tasks"));
+        /* Workers which are already running exit on the stop message */
+        httpd_workers_stop(hd);
+        close(hd->listen_fd);
+        cs_free_ctrl_sock(hd->ctrl_fd);
+        close(hd->msg_fd);
+        httpd_delete(hd);
+        return ESP_ERR_HTTPD_TASK;
+    }
     if (httpd_os_thread_create(&hd->hd_td.handle, "httpd",
                                hd->config.stack_size,
                                hd->config.task_priority,
                                httpd_thread, hd,
                                hd->config.core_id) != ESP_OK) {
         /* Failed to launch task */
+        httpd_workers_stop(hd);
         httpd_delete(hd);
         return ESP_ERR_HTTPD_TASK;
     }
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -310,46 +310,6 @@ static esp_err_t cb_headers_complete(http_parser *parser)
             return ESP_FAIL;
         }
     } else if (parser_data->status == PARSING_HDR_VALUE) {
-        /* Locate end of last header */
-        char *at = (char *)parser_data->last.at + parser_data->last.length;
-
-        /* Check if there is data left to parse. This value should
-         * at least be equal to the number of line terminators, i.e. 2 */
-        ssize_t remaining_length = parser_data->raw_datalen - (at - ra->scratch);
-        if (remaining_length < 2) {
-            ESP_LOGE(TAG, LOG_FMT("invalid length of data remaining to be parsed"));
-            parser_data->error = HTTPD_500_INTERNAL_SERVER_ERROR;
-            parser_data->status = PARSING_FAILED;
-            return ESP_FAIL;
-        }
-
-        /* Locate end of headers section by skipping the remaining
-         * two line terminators. No assumption is made here about the
-         * termination sequence used apart from the necessity that it
-         * must end with an LF, because:
-         *      1) some clients may send non standard LFs instead of
-         *         CRLFs for indicating termination.
-         *      2) it is the responsibility of http_parser to check
-         *         that the termination is either CRLF or LF and
-         *         not any other sequence */
-        unsigned short remaining_terminators = 2;
-        while (remaining_length-- && remaining_terminators) {
-            if (*at == '\n') {
-                remaining_terminators--;
-            }
-            /* Overwrite termination characters with null */
-            *(at++) = '\0';
-        }
-        if (remaining_terminators) {
-            ESP_LOGE(TAG, LOG_FMT("incomplete termination of headers"));
-            parser_data->error = HTTPD_400_BAD_REQUEST;
-            parser_data->status = PARSING_FAILED;
-            return ESP_FAIL;
-        }
-
-        /* Place the parser ptr right after the end of headers section */
-        parser_data->last.at = at;
-
         /* Increment header count */
         ra->req_hdrs_count++;
     } else {
@@ -359,6 +319,48 @@ static esp_err_t cb_headers_complete(http_parser *parser)
         return ESP_FAIL;
     }
 
+    /* Locate end of last header, or of the request line if there
+     * are no headers. The URL is already copied by verify_url() */
+    char *at = (char *)parser_data->last.at + parser_data->last.length;
+
+    /* Check if there is data left to parse. This value should
+     * at least be equal to the number of line terminators, i.e. 2 */
+    ssize_t remaining_length = parser_data->raw_datalen - (at - ra->scratch);
+    if (remaining_length < 2) {
+        ESP_LOGE(TAG, LOG_FMT("invalid length of data remaining to be parsed"));
+        parser_data->error = HTTPD_500_INTERNAL_SERVER_ERROR;
+        parser_data->status = PARSING_FAILED;
+        return ESP_FAIL;
+    }
+
+    /* Locate end of headers section by skipping the remaining
+     * two line terminators. No assumption is made here about the
+     * termination sequence used apart from the necessity that it
+     * must end with an LF, because:
+     *      1) some clients may send non standard LFs instead of
+     *         CRLFs for indicating termination.
+     *      2) it is the responsibility of http_parser to check
+     *         that the termination is either CRLF or LF and
+     *         not any other sequence */
+    unsigned short remaining_terminators = 2;
+    while (remaining_length-- && remaining_terminators) {
+        if (*at == '\n') {
+            remaining_terminators--;
+        }
+        /* Overwrite termination characters with null */
+        *(at++) = '\0';
+    }
+    if (remaining_terminators) {
+        ESP_LOGE(TAG, LOG_FMT("incomplete termination of headers"));
+        parser_data->error = HTTPD_400_BAD_REQUEST;
+        parser_data->status = PARSING_FAILED;
+        return ESP_FAIL;
+    }
+
+    /* Place the parser ptr right after the end of headers section,
+     * which is where parsing is paused once the request is complete */
+    parser_data->last.at = at;
+
     /* In absence of body/chunked encoding, http_parser sets content_len to -1 */
     r->content_len = ((int)parser->content_length != -1 ?
                       parser->content_length : 0);
@@ -614,9 +616,8 @@ static void parse_init(httpd_req_t *r, http_parser *parser, parser_data_t *data)
 
 /* Function that receives TCP data and runs parser on it
  */
-static esp_err_t httpd_parse_req(struct httpd_data *hd)
+static esp_err_t httpd_parse_req(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     int blk_len,  offset;
     http_parser   parser;
     parser_data_t parser_data;
@@ -656,7 +657,7 @@ static esp_err_t httpd_parse_req(struct httpd_data *hd)
     } while (parser_data.status != PARSING_COMPLETE);
 
     ESP_LOGD(TAG, LOG_FMT("parsing complete"));
-    return httpd_uri(hd);
+    return httpd_uri(hd, r);
 }
 
 static void init_req(httpd_req_t *r, httpd_config_t *config)
@@ -711,6 +712,7 @@ static void httpd_req_cleanup(httpd_req_t *r)
     ra->sd->ignore_sess_ctx_changes = r->ignore_sess_ctx_changes;
 
     /* Clear out the request and request_aux structures */
+    ra->sd->req = NULL;
     ra->sd = NULL;
     r->handle = NULL;
     r->aux = NULL;
@@ -720,17 +722,16 @@ static void httpd_req_cleanup(httpd_req_t *r)
 /* Function that processes incoming TCP data and
  * updates the http request data httpd_req_t
  */
-esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
+esp_err_t httpd_req_new(struct httpd_data *hd, httpd_req_t *r, struct httpd_req_aux *ra, struct sock_db *sd)
 {
-    httpd_req_t *r = &hd->hd_req;
     init_req(r, &hd->config);
-    init_req_aux(&hd->hd_req_aux, &hd->config);
+    init_req_aux(ra, &hd->config);
     r->handle = hd;
-    r->aux = &hd->hd_req_aux;
+    r->aux = ra;
 
     /* Associate the request to the socket */
-    struct httpd_req_aux *ra = r->aux;
     ra->sd = sd;
+    sd->req = r;
 
     /* Set defaults */
     ra->status = (char *)HTTPD_200;
@@ -763,8 +764,11 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
         ESP_LOGD(TAG, LOG_FMT("New WS request from existing socket, ws_type=%d"), ra->ws_type);
 
         if (ra->ws_type == HTTPD_WS_TYPE_CLOSE) {
-            /*  Only mark ws_close to true if it's a CLOSE frame */
+            /*  Only mark ws_close to true if it's a CLOSE frame. Broadcasts
+             *  from the server task check it with the session lock held */
+            httpd_sess_lock(hd, sd);
             sd->ws_close = true;
+            httpd_sess_unlock(hd, sd);
         } else if (ra->ws_type == HTTPD_WS_TYPE_PONG) {
             /* Pass the PONG frames to the handler as well, as user app might send PINGs */
             ESP_LOGD(TAG, LOG_FMT("Received PONG frame"));
@@ -784,7 +788,7 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 #endif
 
     /* Parse request */
-    ret = httpd_parse_req(hd);
+    ret = httpd_parse_req(hd, r);
     if (ret != ESP_OK) {
         httpd_req_cleanup(r);
     }
@@ -793,9 +797,8 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 
 /* Function that resets the http request data
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd)
+esp_err_t httpd_req_delete(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     struct httpd_req_aux *ra = r->aux;
 
     /* Finish off reading any pending/leftover data */
@@ -835,10 +838,15 @@ bool httpd_validate_req_ptr(httpd_req_t *r)
         struct httpd_data *hd = (struct httpd_data *) r->handle;
         if (hd) {
             /* Check if this function is running in the context of
-             * the correct httpd server thread */
+             * the correct httpd server thread or one of its workers */
             if (httpd_os_thread_handle() == hd->hd_td.handle) {
                 return true;
             }
+            for (int i = 0; hd->workers && i < hd->config.worker_count; i++) {
+                if (httpd_os_thread_handle() == hd->workers[i].td.handle) {
+                    return true;
+                }
+            }
         }
     }
     return false;
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -24,6 +24,7 @@ typedef enum {
     HTTPD_TASK_SET_DESCRIPTOR,  // Set descriptor
     HTTPD_TASK_DELETE_INVALID,  // Delete invalid session
     HTTPD_TASK_FIND_LOWEST_LRU, // Find session with lowest lru
+    HTTPD_TASK_FIND_PENDING,    // Find session with pending data
     HTTPD_TASK_CLOSE            // Close session
 } task_t;
 
@@ -87,7 +88,8 @@ static int enum_function(struct sock_db *session, void *context)
         break;
     // Set descriptor
     case HTTPD_TASK_SET_DESCRIPTOR:
-        if (session->fd != -1) {
+        /* Sessions handed to a worker are polled again once the worker is done */
+        if (session->fd != -1 && !session->busy) {
             FD_SET(session->fd, ctx->fdset);
             if (session->fd > ctx->max_fd) {
                 ctx->max_fd = session->fd;
@@ -96,7 +98,7 @@ static int enum_function(struct sock_db *session, void *context)
         break;
     // Delete invalid session
     case HTTPD_TASK_DELETE_INVALID:
-        if (!fd_is_valid(session->fd)) {
+        if (!session->busy && !fd_is_valid(session->fd)) {
             ESP_LOGW(TAG, LOG_FMT("Closing invalid socket %d"), session->fd);
             httpd_sess_delete(ctx->hd, session);
         }
@@ -107,12 +109,16 @@ static int enum_function(struct sock_db *session, void *context)
         if (session->fd == -1) {
             return 0;
         }
-        // Check/update lowest lru
-        if (session->lru_counter < ctx->lru_counter) {
+        // Check/update lowest lru, sessions being processed by a worker can't be closed now
+        if (!session->busy && session->lru_counter < ctx->lru_counter) {
             ctx->lru_counter = session->lru_counter;
             ctx->session = session;
         }
         break;
+    // Find session with pending data
+    case HTTPD_TASK_FIND_PENDING:
+        found = (session->fd != -1 && !session->busy && httpd_sess_pending(ctx->hd, session));
+        break;
     case HTTPD_TASK_CLOSE:
         if (session->fd != -1) {
             ESP_LOGD(TAG, LOG_FMT("cleaning up socket %d"), session->fd);
@@ -141,6 +147,11 @@ static void httpd_sess_close(void *arg)
         return;
     }
     sock_db->lru_socket = false;
+    if (sock_db->busy) {
+        // A worker is processing the session, it is closed when the worker is done
+        sock_db->close_pending = true;
+        return;
+    }
     struct httpd_data *hd = (struct httpd_data *) sock_db->handle;
     httpd_sess_delete(hd, sock_db);
 }
@@ -263,9 +274,8 @@ void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd)
     // Check if the function has been called from inside a
     // request handler, in which case fetch the context from
     // the httpd_req_t structure
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == session) {
-        return hd->hd_req.sess_ctx;
+    if (session->req) {
+        return session->req->sess_ctx;
     }
     return session->ctx;
 }
@@ -280,17 +290,17 @@ void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void *ctx, httpd_free
     // Check if the function has been called from inside a
     // request handler, in which case set the context inside
     // the httpd_req_t structure
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == session) {
-        if (hd->hd_req.sess_ctx != ctx) {
+    struct httpd_req *req = session->req;
+    if (req) {
+        if (req->sess_ctx != ctx) {
             // Don't free previous context if it is in sockdb
             // as it will be freed inside httpd_req_cleanup()
-            if (session->ctx != hd->hd_req.sess_ctx) {
-                httpd_sess_free_ctx(&hd->hd_req.sess_ctx, hd->hd_req.free_ctx); // Free previous context
+            if (session->ctx != req->sess_ctx) {
+                httpd_sess_free_ctx(&req->sess_ctx, req->free_ctx); // Free previous context
             }
-            hd->hd_req.sess_ctx = ctx;
+            req->sess_ctx = ctx;
         }
-        hd->hd_req.free_ctx = free_fn;
+        req->free_ctx = free_fn;
         return;
     }
 
@@ -364,6 +374,11 @@ void httpd_sess_delete(struct httpd_data *hd, struct sock_db *session)
     // clear all contexts
     httpd_sess_clear_ctx(session);
 
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    free(session->ws_uri);
+    session->ws_uri = NULL;
+#endif
+
     // mark session slot as available
     session->fd = -1;
 
@@ -375,6 +390,20 @@ void httpd_sess_delete(struct httpd_data *hd, struct sock_db *session)
     }
 }
 
+void httpd_sess_lock(struct httpd_data *hd, struct sock_db *session)
+{
+    if (hd->sess_locks) {
+        xSemaphoreTake(hd->sess_locks[session - hd->hd_sd], portMAX_DELAY);
+    }
+}
+
+void httpd_sess_unlock(struct httpd_data *hd, struct sock_db *session)
+{
+    if (hd->sess_locks) {
+        xSemaphoreGive(hd->sess_locks[session - hd->hd_sd]);
+    }
+}
+
 void httpd_sess_init(struct httpd_data *hd)
 {
     enum_context_t context = {
@@ -398,26 +427,48 @@ bool httpd_sess_pending(struct httpd_data *hd, struct sock_db *session)
     return (session->pending_len != 0);
 }
 
+bool httpd_sess_any_pending(struct httpd_data *hd)
+{
+    enum_context_t context = {
+        .task = HTTPD_TASK_FIND_PENDING,
+        .hd = hd
+    };
+    httpd_sess_enum(hd, enum_function, &context);
+    return (context.session != NULL);
+}
+
 /* This MUST return ESP_OK on successful execution. If any other
  * value is returned, everything related to this socket will be
  * cleaned up and the socket will be closed.
  */
-esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session)
+esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *session,
+                             struct httpd_req *r, struct httpd_req_aux *ra)
 {
     if ((!hd) || (!session)) {
         return ESP_FAIL;
     }
 
-    ESP_LOGD(TAG, LOG_FMT("httpd_req_new"));
-    if (httpd_req_new(hd, session) != ESP_OK) {
-        return ESP_FAIL;
-    }
-    ESP_LOGD(TAG, LOG_FMT("httpd_req_delete"));
-    if (httpd_req_delete(hd) != ESP_OK) {
-        return ESP_FAIL;
-    }
-    ESP_LOGD(TAG, LOG_FMT("success"));
-    session->lru_counter = ++hd->lru_counter;
+    /* Requests pipelined by the client may have been received along with
+     * the previous one, in which case they are in the pending buffer and
+     * select() won't report the socket again. Process them right away */
+    int count = 0;
+    do {
+        ESP_LOGD(TAG, LOG_FMT("httpd_req_new"));
+        if (httpd_req_new(hd, r, ra, session) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        ESP_LOGD(TAG, LOG_FMT("httpd_req_delete"));
+        if (httpd_req_delete(hd, r) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        ESP_LOGD(TAG, LOG_FMT("success"));
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        if (session->ws_close) {
+            break;
+        }
+#endif
+    } while (++count < HTTPD_MAX_BATCH_REQS && !session->close_pending &&
+             httpd_sess_pending(hd, session));
     return ESP_OK;
 }
 
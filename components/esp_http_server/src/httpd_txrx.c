@@ -1,17 +1,28 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
 
+#include <stdlib.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_partition.h>
 
 #include <esp_http_server.h>
 #include "esp_httpd_priv.h"
 
+/* Flag for sends which are followed by more data of the same response */
+#ifdef MSG_MORE
+#define HTTPD_SEND_MORE     MSG_MORE
+#else
+#define HTTPD_SEND_MORE     0
+#endif
+
 static const char *TAG = "httpd_txrx";
 
 esp_err_t httpd_sess_set_send_override(httpd_handle_t hd, int sockfd, httpd_send_func_t send_func)
@@ -63,13 +74,13 @@ int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
     return ret;
 }
 
-static esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len)
+static esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len, int flags)
 {
     struct httpd_req_aux *ra = r->aux;
     int ret;
 
     while (buf_len > 0) {
-        ret = ra->sd->send_fn(ra->sd->handle, ra->sd->fd, buf, buf_len, 0);
+        ret = ra->sd->send_fn(ra->sd->handle, ra->sd->fd, buf, buf_len, flags);
         if (ret < 0) {
             ESP_LOGD(TAG, LOG_FMT("error in send_fn"));
             return ESP_FAIL;
@@ -144,15 +155,19 @@ int httpd_recv(httpd_req_t *r, char *buf, size_t buf_len)
 size_t httpd_unrecv(struct httpd_req *r, const char *buf, size_t buf_len)
 {
     struct httpd_req_aux *ra = r->aux;
-    /* Truncate if external buf_len is greater than pending_data buffer size */
-    ra->sd->pending_len = MIN(sizeof(ra->sd->pending_data), buf_len);
-
-    /* Copy data into internal pending_data buffer with the exact offset
-     * such that it is right aligned inside the buffer */
+    /* Truncate if external buf_len is greater than the free space
+     * left in pending_data buffer */
+    buf_len = MIN(sizeof(ra->sd->pending_data) - ra->sd->pending_len, buf_len);
+
+    /* Pending data is right aligned inside the buffer, so copy data
+     * right in front of it. Data that was already pending, e.g. the
+     * part of a received block that didn't fit in the scratch buffer,
+     * must be received after the data being un-received now */
+    ra->sd->pending_len += buf_len;
     size_t offset = sizeof(ra->sd->pending_data) - ra->sd->pending_len;
-    memcpy(ra->sd->pending_data + offset, buf, ra->sd->pending_len);
-    ESP_LOGD(TAG, LOG_FMT("length = %d"), ra->sd->pending_len);
-    return ra->sd->pending_len;
+    memcpy(ra->sd->pending_data + offset, buf, buf_len);
+    ESP_LOGD(TAG, LOG_FMT("length = %d"), buf_len);
+    return buf_len;
 }
 
 /**
@@ -224,71 +239,120 @@ esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
     return ESP_OK;
 }
 
-esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+/* Response data is collected in a buffer, so that the headers
+ * and the body go out in as few sends as possible */
+struct httpd_resp_buf {
+    httpd_req_t *req;
+    char *buf;
+    size_t size;
+    size_t len;
+};
+
+static esp_err_t httpd_resp_buf_flush(struct httpd_resp_buf *rb, int flags)
 {
-    if (r == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    if (rb->len > 0 && httpd_send_all(rb->req, rb->buf, rb->len, flags) != ESP_OK) {
+        return ESP_ERR_HTTPD_RESP_SEND;
     }
+    rb->len = 0;
+    return ESP_OK;
+}
 
-    if (!httpd_valid_req(r)) {
-        return ESP_ERR_HTTPD_INVALID_REQ;
+static esp_err_t httpd_resp_buf_append(struct httpd_resp_buf *rb, const char *data, size_t len)
+{
+    while (len > 0) {
+        if (rb->len == rb->size && httpd_resp_buf_flush(rb, HTTPD_SEND_MORE) != ESP_OK) {
+            return ESP_ERR_HTTPD_RESP_SEND;
+        }
+        size_t copy_len = MIN(len, rb->size - rb->len);
+        memcpy(rb->buf + rb->len, data, copy_len);
+        rb->len += copy_len;
+        data    += copy_len;
+        len     -= copy_len;
     }
+    return ESP_OK;
+}
 
-    struct httpd_req_aux *ra = r->aux;
-    const char *httpd_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n";
-    const char *colon_separator = ": ";
-    const char *cr_lf_seperator = "\r\n";
-
-    if (buf_len == HTTPD_RESP_USE_STRLEN) {
-        buf_len = strlen(buf);
+/* Appends data if it fits in the buffer, otherwise sends the
+ * buffered data and then sends data without copying it */
+static esp_err_t httpd_resp_buf_data(struct httpd_resp_buf *rb, const char *data, size_t len, int flags)
+{
+    if (len <= rb->size - rb->len) {
+        return httpd_resp_buf_append(rb, data, len);
+    }
+    if (httpd_resp_buf_flush(rb, HTTPD_SEND_MORE) != ESP_OK ||
+        httpd_send_all(rb->req, data, len, flags) != ESP_OK) {
+        return ESP_ERR_HTTPD_RESP_SEND;
     }
+    return ESP_OK;
+}
+
+/* Appends status line and headers of a response, either with
+ * known content length or with chunked transfer encoding */
+static esp_err_t httpd_resp_buf_hdrs(struct httpd_resp_buf *rb, bool chunked, size_t content_len)
+{
+    struct httpd_req_aux *ra = rb->req->aux;
+    const char *httpd_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n";
+    const char *httpd_chunked_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n";
 
     /* Request headers are no longer available */
     ra->req_hdrs_count = 0;
 
     /* Size of essential headers is limited by scratch buffer size */
-    if (snprintf(ra->scratch, sizeof(ra->scratch), httpd_hdr_str,
-                 ra->status, ra->content_type, buf_len) >= sizeof(ra->scratch)) {
+    int len = chunked ?
+              snprintf(ra->scratch, sizeof(ra->scratch), httpd_chunked_hdr_str,
+                       ra->status, ra->content_type) :
+              snprintf(ra->scratch, sizeof(ra->scratch), httpd_hdr_str,
+                       ra->status, ra->content_type, content_len);
+    if (len >= sizeof(ra->scratch)) {
         return ESP_ERR_HTTPD_RESP_HDR;
     }
 
-    /* Sending essential headers */
-    if (httpd_send_all(r, ra->scratch, strlen(ra->scratch)) != ESP_OK) {
-        return ESP_ERR_HTTPD_RESP_SEND;
+    esp_err_t ret = httpd_resp_buf_append(rb, ra->scratch, len);
+    for (unsigned i = 0; i < ra->resp_hdrs_count && ret == ESP_OK; i++) {
+        if ((ret = httpd_resp_buf_append(rb, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field))) != ESP_OK ||
+            (ret = httpd_resp_buf_append(rb, ": ", 2)) != ESP_OK ||
+            (ret = httpd_resp_buf_append(rb, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value))) != ESP_OK) {
+            break;
+        }
+        ret = httpd_resp_buf_append(rb, "\r\n", 2);
     }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_buf_append(rb, "\r\n", 2);
+    }
+    return ret;
+}
 
-    /* Sending additional headers based on set_header */
-    for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
-        /* Send header field */
-        if (httpd_send_all(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send ': ' */
-        if (httpd_send_all(r, colon_separator, strlen(colon_separator)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send header value */
-        if (httpd_send_all(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send CR + LF */
-        if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    if (r == NULL) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    /* End header section */
-    if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-        return ESP_ERR_HTTPD_RESP_SEND;
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
     }
 
-    /* Sending content */
-    if (buf && buf_len) {
-        if (httpd_send_all(r, buf, buf_len) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
+    struct httpd_req_aux *ra = r->aux;
+    struct httpd_resp_buf rb = {
+        .req  = r,
+        .buf  = ra->resp_buf,
+        .size = sizeof(ra->resp_buf),
+    };
+
+    if (buf_len == HTTPD_RESP_USE_STRLEN) {
+        buf_len = strlen(buf);
     }
-    return ESP_OK;
+
+    /* A small response goes out in a single send, otherwise
+     * headers and content are sent separately */
+    esp_err_t ret = httpd_resp_buf_hdrs(&rb, false, buf_len);
+    if (ret == ESP_OK && buf && buf_len) {
+        ret = httpd_resp_buf_data(&rb, buf, buf_len, 0);
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_buf_flush(&rb, 0);
+    }
+    return ret;
 }
 
 esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
@@ -306,70 +370,199 @@ esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len
     }
 
     struct httpd_req_aux *ra = r->aux;
-    const char *httpd_chunked_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n";
-    const char *colon_separator = ": ";
-    const char *cr_lf_seperator = "\r\n";
-
-    /* Request headers are no longer available */
-    ra->req_hdrs_count = 0;
+    struct httpd_resp_buf rb = {
+        .req  = r,
+        .buf  = ra->resp_buf,
+        .size = sizeof(ra->resp_buf),
+    };
+    esp_err_t ret;
 
     if (!ra->first_chunk_sent) {
-        /* Size of essential headers is limited by scratch buffer size */
-        if (snprintf(ra->scratch, sizeof(ra->scratch), httpd_chunked_hdr_str,
-                     ra->status, ra->content_type) >= sizeof(ra->scratch)) {
-            return ESP_ERR_HTTPD_RESP_HDR;
+        if ((ret = httpd_resp_buf_hdrs(&rb, true, 0)) != ESP_OK) {
+            return ret;
         }
+        ra->first_chunk_sent = true;
+    }
 
-        /* Sending essential headers */
-        if (httpd_send_all(r, ra->scratch, strlen(ra->scratch)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
+    /* Chunk size, chunk data and end of chunk are sent together if they fit in the buffer */
+    char len_str[10];
+    snprintf(len_str, sizeof(len_str), "%x\r\n", buf_len);
+    ret = httpd_resp_buf_append(&rb, len_str, strlen(len_str));
+    if (ret == ESP_OK && buf) {
+        ret = httpd_resp_buf_data(&rb, buf, (size_t) buf_len, HTTPD_SEND_MORE);
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_buf_append(&rb, "\r\n", strlen("\r\n"));
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_buf_flush(&rb, 0);
+    }
+    return ret;
+}
+
+esp_err_t httpd_resp_send_fd(httpd_req_t *r, int fd, size_t len)
+{
+    if (r == NULL || fd < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    struct httpd_resp_buf rb = {
+        .req  = r,
+        .size = CONFIG_HTTPD_SEND_FILE_BUF_SIZE,
+    };
+    rb.buf = malloc(rb.size);
+    if (rb.buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* The first part of the file is read into the buffer right after
+     * the headers, so that both are sent together */
+    esp_err_t ret = httpd_resp_buf_hdrs(&rb, false, len);
+    while (ret == ESP_OK && len > 0) {
+        if (rb.len == rb.size) {
+            ret = httpd_resp_buf_flush(&rb, HTTPD_SEND_MORE);
+            continue;
         }
+        ssize_t read_len = read(fd, rb.buf + rb.len, MIN(len, rb.size - rb.len));
+        if (read_len <= 0) {
+            ESP_LOGE(TAG, LOG_FMT("error reading fd %d : %d"), fd, read_len < 0 ? errno : 0);
+            ret = ESP_FAIL;
+            break;
+        }
+        rb.len += read_len;
+        len    -= read_len;
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_buf_flush(&rb, 0);
+    }
+    free(rb.buf);
+    return ret;
+}
 
-        /* Sending additional headers based on set_header */
-        for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
-            /* Send header field */
-            if (httpd_send_all(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send ': ' */
-            if (httpd_send_all(r, colon_separator, strlen(colon_separator)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send header value */
-            if (httpd_send_all(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send CR + LF */
-            if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
+/* Checks if gzip is listed in the Accept-Encoding header of the request */
+static bool httpd_req_accepts_gzip(httpd_req_t *r)
+{
+    size_t len = httpd_req_get_hdr_value_len(r, "Accept-Encoding");
+    if (len == 0) {
+        return false;
+    }
+    char *value = malloc(len + 1);
+    if (value == NULL) {
+        return false;
+    }
+
+    bool accepts = false;
+    if (httpd_req_get_hdr_value_str(r, "Accept-Encoding", value, len + 1) == ESP_OK) {
+        char *saveptr = NULL;
+        for (char *coding = strtok_r(value, ",", &saveptr); coding; coding = strtok_r(NULL, ",", &saveptr)) {
+            coding += strspn(coding, " \t");
+            if (strncasecmp(coding, "gzip", 4) != 0 ||
+                (coding[4] != '\0' && coding[4] != ';' && coding[4] != ' ')) {
+                continue;
             }
+            /* gzip;q=0 means the encoding is not acceptable */
+            const char *qvalue = strstr(coding + 4, "q=");
+            accepts = (qvalue == NULL) || (strtod(qvalue + 2, NULL) > 0);
+            break;
         }
+    }
+    free(value);
+    return accepts;
+}
 
-        /* End header section */
-        if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
+/* Opens a regular file for reading and gets its size, returns -1 on failure */
+static int httpd_open_file(const char *path, size_t *size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    *size = st.st_size;
+    return fd;
+}
+
+esp_err_t httpd_resp_send_file(httpd_req_t *r, const char *path)
+{
+    if (r == NULL || path == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    int fd = -1;
+    size_t size = 0;
+
+    /* Prefer the precompressed file if the client accepts it. The response depends on
+     * Accept-Encoding whenever there is one, so caches have to know in both cases */
+    size_t path_len = strlen(path);
+    char *gz_path = malloc(path_len + sizeof(".gz"));
+    if (gz_path) {
+        memcpy(gz_path, path, path_len);
+        strcpy(gz_path + path_len, ".gz");
+        fd = httpd_open_file(gz_path, &size);
+        free(gz_path);
+    }
+    if (fd >= 0) {
+        if (httpd_resp_set_hdr(r, "Vary", "Accept-Encoding") != ESP_OK ||
+            !httpd_req_accepts_gzip(r) ||
+            httpd_resp_set_hdr(r, "Content-Encoding", "gzip") != ESP_OK) {
+            close(fd);
+            fd = -1;
         }
-        ra->first_chunk_sent = true;
     }
 
-    /* Sending chunked content */
-    char len_str[10];
-    snprintf(len_str, sizeof(len_str), "%x\r\n", buf_len);
-    if (httpd_send_all(r, len_str, strlen(len_str)) != ESP_OK) {
-        return ESP_ERR_HTTPD_RESP_SEND;
+    if (fd < 0) {
+        fd = httpd_open_file(path, &size);
+        if (fd < 0) {
+            ESP_LOGD(TAG, LOG_FMT("can't open %s"), path);
+            return ESP_ERR_NOT_FOUND;
+        }
     }
 
-    if (buf) {
-        if (httpd_send_all(r, buf, (size_t) buf_len) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
+    ESP_LOGD(TAG, LOG_FMT("sending %s, %d bytes"), path, size);
+    esp_err_t ret = httpd_resp_send_fd(r, fd, size);
+    close(fd);
+    return ret;
+}
+
+esp_err_t httpd_resp_send_partition(httpd_req_t *r, const esp_partition_t *partition,
+                                    size_t offset, size_t len)
+{
+    if (r == NULL || partition == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    const char *data = NULL;
+    spi_flash_mmap_handle_t mmap_handle;
+    if (len > 0) {
+        esp_err_t err = esp_partition_mmap(partition, offset, len, SPI_FLASH_MMAP_DATA,
+                                           (const void **) &data, &mmap_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, LOG_FMT("failed to map partition %s : 0x%x"), partition->label, err);
+            return err;
         }
     }
 
-    /* Indicate end of chunk */
-    if (httpd_send_all(r, "\r\n", strlen("\r\n")) != ESP_OK) {
-        return ESP_ERR_HTTPD_RESP_SEND;
+    esp_err_t ret = httpd_resp_send(r, data, len);
+    if (len > 0) {
+        spi_flash_munmap(mmap_handle);
     }
-    return ESP_OK;
+    return ret;
 }
 
 esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *usr_msg)
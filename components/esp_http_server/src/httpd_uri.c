@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -21,16 +21,20 @@ static bool httpd_uri_match_simple(const char *uri1, const char *uri2, size_t le
         (strncmp(uri1, uri2, len2) == 0);   // Then match actual URIs
 }
 
-bool httpd_uri_match_wildcard(const char *template, const char *uri, size_t len)
+/* Splits a wildcard template into the number of characters which have to match
+ * exactly and the trailing question mark and asterisk flags. If quest is set,
+ * the optional character is template[*exact_len]. Returns false if the template
+ * is not valid */
+static bool httpd_uri_parse_template(const char *template, size_t *exact_len,
+                                     bool *quest, bool *asterisk)
 {
     const size_t tpl_len = strlen(template);
-    size_t exact_match_chars = tpl_len;
 
     /* Check for trailing question mark and asterisk */
     const char last = (const char) (tpl_len > 0 ? template[tpl_len - 1] : 0);
     const char prevlast = (const char) (tpl_len > 1 ? template[tpl_len - 2] : 0);
-    const bool asterisk = last == '*' || (prevlast == '*' && last == '?');
-    const bool quest = last == '?' || (prevlast == '?' && last == '*');
+    *asterisk = last == '*' || (prevlast == '*' && last == '?');
+    *quest = last == '?' || (prevlast == '?' && last == '*');
 
     /* Minimum template string length must be:
      *      0 : if neither of '*' and '?' are present
@@ -43,12 +47,23 @@ bool httpd_uri_match_wildcard(const char *template, const char *uri, size_t len)
      */
 
     /* abort in cases such as "?" with no preceding character (invalid template) */
-    if (exact_match_chars < asterisk + quest*2) {
+    if (tpl_len < *asterisk + *quest*2) {
         return false;
     }
 
     /* account for special characters and the optional character if "?" is used */
-    exact_match_chars -= asterisk + quest*2;
+    *exact_len = tpl_len - (*asterisk + *quest*2);
+    return true;
+}
+
+bool httpd_uri_match_wildcard(const char *template, const char *uri, size_t len)
+{
+    size_t exact_match_chars;
+    bool quest, asterisk;
+
+    if (!httpd_uri_parse_template(template, &exact_match_chars, &quest, &asterisk)) {
+        return false;
+    }
 
     if (len < exact_match_chars) {
         return false;
@@ -80,6 +95,240 @@ bool httpd_uri_match_wildcard(const char *template, const char *uri, size_t len)
     }
 }
 
+/* The router is a radix trie built from the registered URI templates, so that
+ * finding a handler doesn't need to compare the URI against every template.
+ * The part of a template which has to match exactly is stored as a path in the
+ * trie, and the handler is attached as a route to the node at the end of that
+ * path, together with the trailing '?' and '*' of wildcard templates. A lookup
+ * walks the trie along the URI and checks the routes of every node it passes.
+ * The router is dropped whenever handlers are registered or unregistered, and
+ * rebuilt by the next request, so that registering many handlers doesn't
+ * rebuild it each time. It is only used with the built-in URI matching functions.
+ * Both hd_calls and the router are accessed with uri_lock held. */
+
+#define HTTPD_URI_ROUTER_NONE   UINT16_MAX
+
+struct httpd_uri_node {
+    const char *label;          /*!< Characters on the edge from the parent, points into a handler URI */
+    uint16_t label_len;         /*!< Number of characters in label */
+    uint16_t child;             /*!< First child node */
+    uint16_t sibling;           /*!< Next child node of the parent */
+    uint16_t route;             /*!< First route ending at this node */
+};
+
+struct httpd_uri_route {
+    uint16_t handler;           /*!< Index of the handler in hd_calls */
+    uint16_t next;              /*!< Next route ending at the same node */
+    char opt;                   /*!< Optional character, if quest is set */
+    bool quest;                 /*!< Template ends with '?' */
+    bool asterisk;              /*!< Template ends with '*' */
+};
+
+struct httpd_uri_router {
+    struct httpd_uri_node *nodes;   /*!< Trie nodes, nodes[0] is the root */
+    struct httpd_uri_route *routes; /*!< One route per registered handler */
+    uint16_t node_count;            /*!< Number of used nodes */
+};
+
+static uint16_t httpd_uri_router_new_node(struct httpd_uri_router *router,
+                                          const char *label, size_t label_len)
+{
+    uint16_t index = router->node_count++;
+    struct httpd_uri_node *node = &router->nodes[index];
+    node->label = label;
+    node->label_len = label_len;
+    node->child = HTTPD_URI_ROUTER_NONE;
+    node->sibling = HTTPD_URI_ROUTER_NONE;
+    node->route = HTTPD_URI_ROUTER_NONE;
+    return index;
+}
+
+/* Returns the node at the end of the path for prefix, adding at most two nodes */
+static uint16_t httpd_uri_router_insert(struct httpd_uri_router *router,
+                                        const char *prefix, size_t len)
+{
+    uint16_t node = 0;
+    size_t pos = 0;
+
+    while (pos < len) {
+        /* Children of a node start with different characters */
+        uint16_t *link = &router->nodes[node].child;
+        while (*link != HTTPD_URI_ROUTER_NONE && router->nodes[*link].label[0] != prefix[pos]) {
+            link = &router->nodes[*link].sibling;
+        }
+        if (*link == HTTPD_URI_ROUTER_NONE) {
+            *link = httpd_uri_router_new_node(router, prefix + pos, len - pos);
+            return *link;
+        }
+
+        uint16_t child = *link;
+        struct httpd_uri_node *cn = &router->nodes[child];
+        size_t common = 1;
+        while (common < cn->label_len && pos + common < len &&
+               cn->label[common] == prefix[pos + common]) {
+            common++;
+        }
+        if (common < cn->label_len) {
+            /* Split the edge, the new node takes the common part of the label */
+            uint16_t mid = httpd_uri_router_new_node(router, cn->label, common);
+            cn = &router->nodes[child];
+            router->nodes[mid].child = child;
+            router->nodes[mid].sibling = cn->sibling;
+            cn->label += common;
+            cn->label_len -= common;
+            cn->sibling = HTTPD_URI_ROUTER_NONE;
+            *link = mid;
+            child = mid;
+        }
+        node = child;
+        pos += common;
+    }
+    return node;
+}
+
+static inline bool httpd_uri_route_match(const struct httpd_uri_route *route,
+                                         const char *uri, size_t len, size_t pos)
+{
+    /* The first pos characters of the URI match the exact part of the template */
+    if (len == pos) {
+        return true;
+    }
+    if (route->quest && uri[pos] != route->opt) {
+        return false;
+    }
+    return route->asterisk || (route->quest && len == pos + 1);
+}
+
+/* Same as the linear search over hd_calls: returns the first registered handler
+ * for which both URI and method match */
+static httpd_uri_t* httpd_uri_router_find(struct httpd_data *hd,
+                                          const char *uri, size_t uri_len,
+                                          httpd_method_t method,
+                                          httpd_err_code_t *err)
+{
+    const struct httpd_uri_router *router = hd->uri_router;
+    uint16_t found = HTTPD_URI_ROUTER_NONE;
+    bool uri_found = false;
+    uint16_t node = 0;
+    size_t pos = 0;
+
+    while (true) {
+        const struct httpd_uri_node *n = &router->nodes[node];
+        for (uint16_t r = n->route; r != HTTPD_URI_ROUTER_NONE; r = router->routes[r].next) {
+            const struct httpd_uri_route *route = &router->routes[r];
+            if (route->handler >= found ||
+                !httpd_uri_route_match(route, uri, uri_len, pos)) {
+                continue;
+            }
+            if (hd->hd_calls[route->handler]->method == method) {
+                found = route->handler;
+            } else {
+                uri_found = true;
+            }
+        }
+        if (pos == uri_len) {
+            break;
+        }
+        node = n->child;
+        while (node != HTTPD_URI_ROUTER_NONE && router->nodes[node].label[0] != uri[pos]) {
+            node = router->nodes[node].sibling;
+        }
+        if (node == HTTPD_URI_ROUTER_NONE ||
+            router->nodes[node].label_len > uri_len - pos ||
+            memcmp(router->nodes[node].label, uri + pos, router->nodes[node].label_len) != 0) {
+            break;
+        }
+        pos += router->nodes[node].label_len;
+    }
+
+    if (err) {
+        *err = (found != HTTPD_URI_ROUTER_NONE) ? 0 :
+               (uri_found ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND);
+    }
+    return (found != HTTPD_URI_ROUTER_NONE) ? hd->hd_calls[found] : NULL;
+}
+
+static inline void httpd_uri_lock(struct httpd_data *hd)
+{
+    xSemaphoreTake(hd->uri_lock, portMAX_DELAY);
+}
+
+static inline void httpd_uri_unlock(struct httpd_data *hd)
+{
+    xSemaphoreGive(hd->uri_lock);
+}
+
+/* Called when hd_calls changes. Until the router is rebuilt,
+ * URIs are compared against every registered template */
+static void httpd_uri_router_invalidate(struct httpd_data *hd)
+{
+    free(hd->uri_router);
+    hd->uri_router = NULL;
+    hd->uri_router_dirty = true;
+}
+
+/* Rebuilds the router from hd_calls. If the router can't be used, URIs are
+ * matched by comparing them against every registered template */
+static void httpd_uri_router_update(struct httpd_data *hd)
+{
+    free(hd->uri_router);
+    hd->uri_router = NULL;
+    hd->uri_router_dirty = false;
+
+    bool wildcard = (hd->config.uri_match_fn == httpd_uri_match_wildcard);
+    if (hd->config.uri_match_fn && !wildcard) {
+        /* Custom matching function */
+        return;
+    }
+
+    size_t count = 0;
+    while (count < hd->config.max_uri_handlers && hd->hd_calls[count]) {
+        if (strlen(hd->hd_calls[count]->uri) >= UINT16_MAX) {
+            return;
+        }
+        count++;
+    }
+    if (count == 0 || count >= (UINT16_MAX - 1) / 2) {
+        return;
+    }
+
+    /* Every template adds at most two nodes */
+    const size_t max_nodes = 2 * count + 1;
+    struct httpd_uri_router *router = malloc(sizeof(struct httpd_uri_router) +
+                                             max_nodes * sizeof(struct httpd_uri_node) +
+                                             count * sizeof(struct httpd_uri_route));
+    if (router == NULL) {
+        ESP_LOGW(TAG, LOG_FMT("failed to allocate URI router"));
+        return;
+    }
+    router->nodes = (struct httpd_uri_node *) (router + 1);
+    router->routes = (struct httpd_uri_route *) (router->nodes + max_nodes);
+    router->node_count = 0;
+    httpd_uri_router_new_node(router, "", 0);
+
+    for (size_t i = 0; i < count; i++) {
+        const char *template = hd->hd_calls[i]->uri;
+        struct httpd_uri_route *route = &router->routes[i];
+        size_t exact_len = strlen(template);
+        route->handler = i;
+        route->quest = false;
+        route->asterisk = false;
+        route->opt = 0;
+        if (wildcard && !httpd_uri_parse_template(template, &exact_len, &route->quest, &route->asterisk)) {
+            /* Invalid template, never matches */
+            continue;
+        }
+        if (route->quest) {
+            route->opt = template[exact_len];
+        }
+        uint16_t node = httpd_uri_router_insert(router, template, exact_len);
+        route->next = router->nodes[node].route;
+        router->nodes[node].route = i;
+    }
+    hd->uri_router = router;
+    ESP_LOGD(TAG, LOG_FMT("router built with %d handlers, %d nodes"), count, router->node_count);
+}
+
 /* Find handler with matching URI and method, and set
  * appropriate error code if URI or method not found */
 static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
@@ -91,6 +340,10 @@ static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
         *err = HTTPD_404_NOT_FOUND;
     }
 
+    if (hd->uri_router) {
+        return httpd_uri_router_find(hd, uri, uri_len, method, err);
+    }
+
     for (int i = 0; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
             break;
@@ -123,20 +376,14 @@ static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
     return NULL;
 }
 
-esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
-                                     const httpd_uri_t *uri_handler)
+static esp_err_t httpd_register_uri_handler_locked(struct httpd_data *hd,
+                                                   const httpd_uri_t *uri_handler)
 {
-    if (handle == NULL || uri_handler == NULL) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    struct httpd_data *hd = (struct httpd_data *) handle;
-
     /* Make sure another handler with matching URI and method
      * is not already registered. This will also catch cases
      * when a registered URI wildcard pattern already accounts
      * for the new URI being registered */
-    if (httpd_find_uri_handler(handle, uri_handler->uri,
+    if (httpd_find_uri_handler(hd, uri_handler->uri,
                                strlen(uri_handler->uri),
                                uri_handler->method, NULL) != NULL) {
         ESP_LOGW(TAG, LOG_FMT("handler %s with method %d already registered"),
@@ -157,6 +404,7 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
             if (hd->hd_calls[i]->uri == NULL) {
                 /* Failed to allocate memory */
                 free(hd->hd_calls[i]);
+                hd->hd_calls[i] = NULL;
                 return ESP_ERR_HTTPD_ALLOC_MEM;
             }
 
@@ -174,6 +422,7 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
             }
 #endif
             ESP_LOGD(TAG, LOG_FMT("[%d] installed %s"), i, uri_handler->uri);
+            httpd_uri_router_invalidate(hd);
             return ESP_OK;
         }
         ESP_LOGD(TAG, LOG_FMT("[%d] exists %s"), i, hd->hd_calls[i]->uri);
@@ -182,14 +431,23 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
     return ESP_ERR_HTTPD_HANDLERS_FULL;
 }
 
-esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
-                                       const char *uri, httpd_method_t method)
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
+                                     const httpd_uri_t *uri_handler)
 {
-    if (handle == NULL || uri == NULL) {
+    if (handle == NULL || uri_handler == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
     struct httpd_data *hd = (struct httpd_data *) handle;
+    httpd_uri_lock(hd);
+    esp_err_t ret = httpd_register_uri_handler_locked(hd, uri_handler);
+    httpd_uri_unlock(hd);
+    return ret;
+}
+
+static esp_err_t httpd_unregister_uri_handler_locked(struct httpd_data *hd,
+                                                     const char *uri, httpd_method_t method)
+{
     for (int i = 0; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
             break;
@@ -212,6 +470,7 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
             }
             /* Nullify the following non null entry */
             hd->hd_calls[i-1] = NULL;
+            httpd_uri_router_invalidate(hd);
             return ESP_OK;
         }
     }
@@ -219,13 +478,22 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
     return ESP_ERR_NOT_FOUND;
 }
 
-esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
+esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
+                                       const char *uri, httpd_method_t method)
 {
     if (handle == NULL || uri == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
     struct httpd_data *hd = (struct httpd_data *) handle;
+    httpd_uri_lock(hd);
+    esp_err_t ret = httpd_unregister_uri_handler_locked(hd, uri, method);
+    httpd_uri_unlock(hd);
+    return ret;
+}
+
+static esp_err_t httpd_unregister_uri_locked(struct httpd_data *hd, const char *uri)
+{
     bool found = false;
 
     int i = 0, j = 0; // For keeping count of removed entries
@@ -255,10 +523,25 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
 
     if (!found) {
         ESP_LOGW(TAG, LOG_FMT("no handler found for URI %s"), uri);
+    } else {
+        httpd_uri_router_invalidate(hd);
     }
     return (found ? ESP_OK : ESP_ERR_NOT_FOUND);
 }
 
+esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
+{
+    if (handle == NULL || uri == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    httpd_uri_lock(hd);
+    esp_err_t ret = httpd_unregister_uri_locked(hd, uri);
+    httpd_uri_unlock(hd);
+    return ret;
+}
+
 void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
 {
     for (unsigned i = 0; i < hd->config.max_uri_handlers; i++) {
@@ -271,24 +554,59 @@ void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
         free(hd->hd_calls[i]);
         hd->hd_calls[i] = NULL;
     }
+    free(hd->uri_router);
+    hd->uri_router = NULL;
 }
 
-esp_err_t httpd_uri(struct httpd_data *hd)
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req)
 {
     httpd_uri_t            *uri = NULL;
-    httpd_req_t            *req = &hd->hd_req;
-    struct http_parser_url *res = &hd->hd_req_aux.url_parse_res;
+    httpd_uri_t             found;
+    struct http_parser_url *res = &((struct httpd_req_aux *)req->aux)->url_parse_res;
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    struct httpd_req_aux   *aux = req->aux;
+    bool                    ws_handshake = false;
+    char                   *ws_uri = NULL;
+    char                   *ws_subprotocol = NULL;
+#endif
 
     /* For conveying URI not found/method not allowed */
     httpd_err_code_t err = 0;
 
     ESP_LOGD(TAG, LOG_FMT("request for %s with type %d"), req->uri, req->method);
 
+    /* Handlers may be registered and unregistered by other tasks while the
+     * request is processed, keep a copy of what is needed from the handler */
+    httpd_uri_lock(hd);
+    if (hd->uri_router_dirty) {
+        httpd_uri_router_update(hd);
+    }
+
     /* URL parser result contains offset and length of path string */
     if (res->field_set & (1 << UF_PATH)) {
         uri = httpd_find_uri_handler(hd, req->uri + res->field_data[UF_PATH].off,
                                      res->field_data[UF_PATH].len, req->method, &err);
     }
+    if (uri) {
+        found = *uri;
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        ws_handshake = uri->is_websocket && aux->ws_handshake_detect && uri->method == HTTP_GET;
+        if (ws_handshake) {
+            ws_uri = strdup(uri->uri);
+            ws_subprotocol = uri->supported_subprotocol ? strdup(uri->supported_subprotocol) : NULL;
+        }
+#endif
+    }
+    httpd_uri_unlock(hd);
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    if (ws_handshake && (ws_uri == NULL || (found.supported_subprotocol && ws_subprotocol == NULL))) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for WS URI"));
+        free(ws_uri);
+        free(ws_subprotocol);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
 
     /* If URI with method not found, respond with error code */
     if (uri == NULL) {
@@ -306,27 +624,37 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     }
 
     /* Attach user context data (passed during URI registration) into request */
-    req->user_ctx = uri->user_ctx;
+    req->user_ctx = found.user_ctx;
 
     /* Final step for a WebSocket handshake verification */
 #ifdef CONFIG_HTTPD_WS_SUPPORT
-    struct httpd_req_aux   *aux = req->aux;
-    if (uri->is_websocket && aux->ws_handshake_detect && uri->method == HTTP_GET) {
+    if (ws_handshake) {
         ESP_LOGD(TAG, LOG_FMT("Responding WS handshake to sock %d"), aux->sd->fd);
-        esp_err_t ret = httpd_ws_respond_server_handshake(&hd->hd_req, uri->supported_subprotocol);
+        /* Frames sent from the server task go out after the handshake response,
+         * and see the WebSocket state of the session complete */
+        httpd_sess_lock(hd, aux->sd);
+        esp_err_t ret = httpd_ws_respond_server_handshake(req, ws_subprotocol);
+        free(ws_subprotocol);
+        if (ret == ESP_OK) {
+            /* Kept for sending to all clients of a URI with httpd_ws_broadcast_async() */
+            free(aux->sd->ws_uri);
+            aux->sd->ws_uri = ws_uri;
+            aux->sd->ws_handshake_done = true;
+            aux->sd->ws_handler = found.handler;
+            aux->sd->ws_control_frames = found.handle_ws_control_frames;
+            aux->sd->ws_user_ctx = found.user_ctx;
+        } else {
+            free(ws_uri);
+        }
+        httpd_sess_unlock(hd, aux->sd);
         if (ret != ESP_OK) {
             return ret;
         }
-
-        aux->sd->ws_handshake_done = true;
-        aux->sd->ws_handler = uri->handler;
-        aux->sd->ws_control_frames = uri->handle_ws_control_frames;
-        aux->sd->ws_user_ctx = uri->user_ctx;
     }
 #endif
 
     /* Invoke handler */
-    if (uri->handler(req) != ESP_OK) {
+    if (found.handler(req) != ESP_OK) {
         /* Handler returns error, this socket should be closed */
         ESP_LOGW(TAG, LOG_FMT("uri handler execution failed"));
         return ESP_FAIL;
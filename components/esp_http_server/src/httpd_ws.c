@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2020-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2020-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -11,6 +11,7 @@
 #include <sys/random.h>
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_ws_mask.h>
 #include <mbedtls/sha1.h>
 #include <mbedtls/base64.h>
 
@@ -33,6 +34,19 @@ typedef struct {
     EventGroupHandle_t transfer_done;
 } async_transfer_t;
 
+/* Frame sent to several clients. Allocated in one block along with the
+ * descriptors, the encoded frame and the URI, freed once all sends are done */
+typedef struct {
+    httpd_handle_t handle;
+    transfer_complete_cb callback;
+    void *arg;
+    const int *fds;                 /*!< Clients to send to, NULL for all clients of uri */
+    size_t fd_count;
+    const char *uri;                /*!< URI of the clients if fds is NULL, NULL for all WebSocket clients */
+    const uint8_t *data;            /*!< Frame header followed by the payload */
+    size_t len;
+} ws_broadcast_t;
+
 static const char *TAG="httpd_ws";
 
 /*
@@ -45,6 +59,9 @@ static const char *TAG="httpd_ws";
 #define HTTPD_WS_MASK_BIT       0x80U
 #define HTTPD_WS_LENGTH_BITS    0x7fU
 
+/* Maximum length of a frame header sent by the server, which doesn't mask the payload */
+#define HTTPD_WS_MAX_HEADER_LEN 10
+
 /*
  * The magic GUID string used for handshake
  * Please refer to RFC6455 Section 1.3 for more details.
@@ -228,17 +245,30 @@ static esp_err_t httpd_ws_check_req(httpd_req_t *req)
     return ESP_OK;
 }
 
-static esp_err_t httpd_ws_unmask_payload(uint8_t *payload, size_t len, const uint8_t *mask_key)
+/* Unmasks a part of the payload in place, offset is the position of the part
+ * within the payload */
+static esp_err_t httpd_ws_unmask_payload(uint8_t *payload, size_t len, const uint8_t *mask_key, size_t offset)
 {
     if (len < 1 || !payload) {
         ESP_LOGW(TAG, LOG_FMT("Invalid payload provided"));
         return ESP_ERR_INVALID_ARG;
     }
 
-    for (size_t idx = 0; idx < len; idx++) {
-        payload[idx] = (payload[idx] ^ mask_key[idx % 4]);
-    }
+    esp_ws_mask(payload, payload, len, mask_key, offset);
+    return ESP_OK;
+}
 
+/* Receives exactly len bytes, the frame header may arrive in several parts */
+static esp_err_t httpd_ws_recv_all(httpd_req_t *req, uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        int ret = httpd_recv_with_opt(req, (char *)buf, len, false);
+        if (ret <= 0) {
+            return ESP_FAIL;
+        }
+        buf += ret;
+        len -= ret;
+    }
     return ESP_OK;
 }
 
@@ -284,7 +314,7 @@ esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t
         } else if (init_len == 126) {
             /* Case 2: If length byte is 126, then this frame's length bit is 16 bits */
             uint8_t length_bytes[2] = { 0 };
-            if (httpd_recv_with_opt(req, (char *)length_bytes, sizeof(length_bytes), false) <= 0) {
+            if (httpd_ws_recv_all(req, length_bytes, sizeof(length_bytes)) != ESP_OK) {
                 ESP_LOGW(TAG, LOG_FMT("Failed to receive 2 bytes length"));
                 return ESP_FAIL;
             }
@@ -293,7 +323,7 @@ esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t
         } else if (init_len == 127) {
             /* Case 3: If length is byte 127, then this frame's length bit is 64 bits */
             uint8_t length_bytes[8] = { 0 };
-            if (httpd_recv_with_opt(req, (char *)length_bytes, sizeof(length_bytes), false) <= 0) {
+            if (httpd_ws_recv_all(req, length_bytes, sizeof(length_bytes)) != ESP_OK) {
                 ESP_LOGW(TAG, LOG_FMT("Failed to receive 2 bytes length"));
                 return ESP_FAIL;
             }
@@ -309,7 +339,7 @@ esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t
         }
         /* If this frame is masked, dump the mask as well */
         if (masked) {
-            if (httpd_recv_with_opt(req, (char *)aux->mask_key, sizeof(aux->mask_key), false) <= 0) {
+            if (httpd_ws_recv_all(req, aux->mask_key, sizeof(aux->mask_key)) != ESP_OK) {
                 ESP_LOGW(TAG, LOG_FMT("Failed to receive mask key"));
                 return ESP_FAIL;
             }
@@ -351,15 +381,14 @@ esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t
             ESP_LOGW(TAG, LOG_FMT("Failed to receive payload"));
             return ESP_FAIL;
         }
+        /* Unmask the received part while it is still in cache */
+        httpd_ws_unmask_payload(frame->payload + offset, read_len, aux->mask_key, offset);
         offset += read_len;
         left_len -= read_len;
 
         ESP_LOGD(TAG, "Frame length: %d, Bytes Read: %d", frame->len, offset);
     }
 
-    /* Unmask payload */
-    httpd_ws_unmask_payload(frame->payload, frame->len, aux->mask_key);
-
     return ESP_OK;
 }
 
@@ -372,16 +401,12 @@ esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame)
     return httpd_ws_send_frame_async(req->handle, httpd_req_to_sockfd(req), frame);
 }
 
-esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+/* Encodes the header of a frame sent by the server, returns the length of the header */
+static uint8_t httpd_ws_encode_header(const httpd_ws_frame_t *frame, uint8_t *header_buf)
 {
-    if (!frame) {
-        ESP_LOGW(TAG, LOG_FMT("Argument is invalid"));
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    /* Prepare Tx buffer - maximum length is 14, which includes 2 bytes header, 8 bytes length, 4 bytes mask key */
+    /* Maximum length is 10, which includes 2 bytes header, 8 bytes length, as there is no mask key */
     uint8_t tx_len = 0;
-    uint8_t header_buf[10] = {0 };
+    memset(header_buf, 0, HTTPD_WS_MAX_HEADER_LEN);
     /* Set the `FIN` bit by default if message is not fragmented. Else, set it as per the `final` field */
     header_buf[0] |= (!frame->fragmented) ? HTTPD_WS_FIN_BIT : (frame->final? HTTPD_WS_FIN_BIT: HTTPD_WS_CONTINUE);
     header_buf[0] |= frame->type; /* Type (opcode): 4 bits */
@@ -409,27 +434,44 @@ esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t
 
     /* WebSocket server does not required to mask response payload, so leave the MASK bit as 0. */
     header_buf[1] &= (~HTTPD_WS_MASK_BIT);
+    return tx_len;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+{
+    if (!frame) {
+        ESP_LOGW(TAG, LOG_FMT("Argument is invalid"));
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t header_buf[HTTPD_WS_MAX_HEADER_LEN];
+    uint8_t tx_len = httpd_ws_encode_header(frame, header_buf);
 
     struct sock_db *sess = httpd_sess_get(hd, fd);
     if (!sess) {
         return ESP_ERR_INVALID_ARG;
     }
 
+    /* Called from a worker or from work queued to the server task, the frame must go out whole */
+    esp_err_t ret = ESP_OK;
+    httpd_sess_lock(hd, sess);
+
     /* Send off header */
     if (sess->send_fn(hd, fd, (const char *)header_buf, tx_len, 0) < 0) {
         ESP_LOGW(TAG, LOG_FMT("Failed to send WS header"));
-        return ESP_FAIL;
+        ret = ESP_FAIL;
     }
 
     /* Send off payload */
-    if(frame->len > 0 && frame->payload != NULL) {
+    if (ret == ESP_OK && frame->len > 0 && frame->payload != NULL) {
         if (sess->send_fn(hd, fd, (const char *)frame->payload, frame->len, 0) < 0) {
             ESP_LOGW(TAG, LOG_FMT("Failed to send WS payload"));
-            return ESP_FAIL;
+            ret = ESP_FAIL;
         }
     }
 
-    return ESP_OK;
+    httpd_sess_unlock(hd, sess);
+    return ret;
 }
 
 esp_err_t httpd_ws_get_frame_type(httpd_req_t *req)
@@ -600,4 +642,127 @@ esp_err_t httpd_ws_send_data_async(httpd_handle_t handle, int socket, httpd_ws_f
     return ESP_OK;
 }
 
+/* Whether the session is a WebSocket client the broadcast is for. The worker
+ * processing the session changes its WebSocket state, so the session lock
+ * must be held */
+static bool httpd_ws_broadcast_match(ws_broadcast_t *bc, struct sock_db *sess)
+{
+    return sess->ws_handshake_done && !sess->ws_close &&
+           (!bc->uri || (sess->ws_uri && strcmp(sess->ws_uri, bc->uri) == 0));
+}
+
+static esp_err_t httpd_ws_broadcast_send(ws_broadcast_t *bc, struct sock_db *sess)
+{
+    /* Header and payload go out together in one send */
+    const char *buf = (const char *)bc->data;
+    size_t buf_len = bc->len;
+    while (buf_len > 0) {
+        int ret = sess->send_fn(bc->handle, sess->fd, buf, buf_len, 0);
+        if (ret < 0) {
+            ESP_LOGD(TAG, LOG_FMT("Failed to send WS frame to fd %d"), sess->fd);
+            return ESP_FAIL;
+        }
+        buf     += ret;
+        buf_len -= ret;
+    }
+    return ESP_OK;
+}
+
+/* Runs in the server task, which is the only one deleting sessions. A worker
+ * may be processing a session though, the session lock keeps the broadcast
+ * frame from interleaving with the frames it sends */
+static void httpd_ws_broadcast_cb(void *arg)
+{
+    ws_broadcast_t *bc = arg;
+    struct httpd_data *hd = (struct httpd_data *) bc->handle;
+
+    if (bc->fds) {
+        for (size_t i = 0; i < bc->fd_count; i++) {
+            struct sock_db *sess = httpd_sess_get(hd, bc->fds[i]);
+            esp_err_t err = ESP_ERR_INVALID_ARG;
+            if (sess) {
+                httpd_sess_lock(hd, sess);
+                if (httpd_ws_broadcast_match(bc, sess)) {
+                    err = httpd_ws_broadcast_send(bc, sess);
+                }
+                httpd_sess_unlock(hd, sess);
+            }
+            if (bc->callback) {
+                bc->callback(err, bc->fds[i], bc->arg);
+            }
+        }
+    } else {
+        for (int i = 0; i < hd->config.max_open_sockets; i++) {
+            struct sock_db *sess = &hd->hd_sd[i];
+            if (sess->fd < 0) {
+                continue;
+            }
+            int fd = sess->fd;
+            esp_err_t err = ESP_OK;
+            httpd_sess_lock(hd, sess);
+            bool match = httpd_ws_broadcast_match(bc, sess);
+            if (match) {
+                err = httpd_ws_broadcast_send(bc, sess);
+            }
+            httpd_sess_unlock(hd, sess);
+            if (match && bc->callback) {
+                bc->callback(err, fd, bc->arg);
+            }
+        }
+    }
+
+    free(bc);
+}
+
+esp_err_t httpd_ws_broadcast_async(httpd_handle_t handle, const int *fds, size_t fd_count, const char *uri,
+                                   httpd_ws_frame_t *frame, transfer_complete_cb callback, void *arg)
+{
+    if (handle == NULL || frame == NULL || (frame->len > 0 && frame->payload == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t header_buf[HTTPD_WS_MAX_HEADER_LEN];
+    uint8_t header_len = httpd_ws_encode_header(frame, header_buf);
+    if (!fds) {
+        fd_count = 0;
+    }
+    size_t uri_size = (!fds && uri) ? strlen(uri) + 1 : 0;
+
+    /* Descriptors right after the struct keep their alignment, the frame and the URI follow */
+    ws_broadcast_t *bc = malloc(sizeof(ws_broadcast_t) + fd_count * sizeof(int) +
+                                header_len + frame->len + uri_size);
+    if (bc == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    int *bc_fds = (int *)(bc + 1);
+    uint8_t *bc_data = (uint8_t *)(bc_fds + fd_count);
+    char *bc_uri = (char *)(bc_data + header_len + frame->len);
+
+    bc->handle = handle;
+    bc->callback = callback;
+    bc->arg = arg;
+    bc->fds = NULL;
+    bc->fd_count = fd_count;
+    bc->uri = NULL;
+    bc->data = bc_data;
+    bc->len = header_len + frame->len;
+    if (fds) {
+        memcpy(bc_fds, fds, fd_count * sizeof(int));
+        bc->fds = bc_fds;
+    } else if (uri) {
+        memcpy(bc_uri, uri, uri_size);
+        bc->uri = bc_uri;
+    }
+    memcpy(bc_data, header_buf, header_len);
+    if (frame->len > 0) {
+        memcpy(bc_data + header_len, frame->payload, frame->len);
+    }
+
+    esp_err_t err = httpd_queue_work(handle, httpd_ws_broadcast_cb, bc);
+    if (err != ESP_OK) {
+        free(bc);
+    }
+    return err;
+}
+
 #endif /* CONFIG_HTTPD_WS_SUPPORT */
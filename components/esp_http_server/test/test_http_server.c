@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -225,6 +225,45 @@ TEST_CASE("URI Wildcard Matcher Tests", "[HTTP SERVER]")
     }
 }
 
+TEST_CASE("URI Router Registration Tests", "[HTTP SERVER]")
+{
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.uri_match_fn = httpd_uri_match_wildcard;
+
+    test_case_uses_tcpip();
+
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+
+    httpd_uri_t uri = handler_limit_uri("/path/*");
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+
+    /* Already handled by the wildcard template */
+    uri.uri = "/path/abc";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    uri.method = HTTP_POST;
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+
+    uri.uri = "/pat?";
+    uri.method = HTTP_GET;
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+    uri.uri = "/pat";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    uri.uri = "/pa";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    uri.uri = "/patt";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+
+    /* Unregistered templates don't match anymore */
+    TEST_ASSERT(httpd_unregister_uri(hd, "/path/*") == ESP_OK);
+    uri.uri = "/path/abc";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+    uri.uri = "/path/";
+    TEST_ASSERT(httpd_register_uri_handler(hd, &uri) == ESP_OK);
+
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+
 TEST_CASE("Max Allowed Sockets Test", "[HTTP SERVER]")
 {
     test_case_uses_tcpip();
@@ -0,0 +1,1133 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <esp_vfs.h>
+#include <esp_partition.h>
+#include <esp_http_server.h>
+
+#include "unity.h"
+#include "test_utils.h"
+
+/* Loopback benchmark: clients run on the device and connect to the server over 127.0.0.1.
+ * Fast clients measure request latency while a slow client keeps a handler busy. */
+
+#define BENCH_PORT              8080
+#define BENCH_FAST_CLIENTS      2
+#define BENCH_REQUESTS          50
+#define BENCH_SLOW_DELAY_MS     100
+#define BENCH_LARGE_SIZE        4096
+#define BENCH_CHUNKS            4
+#define BENCH_WS_CLIENTS        4
+#define BENCH_CHURN_REQUESTS    1000
+
+typedef struct {
+    const char *uri;
+    int requests;
+    int64_t *latency_us;        /* one entry per request, NULL to not record */
+    bool pipelined;             /* send all requests before receiving the responses */
+    int completed;
+    SemaphoreHandle_t done;
+} bench_client_t;
+
+static volatile bool s_bench_stop;
+static volatile int s_send_calls;
+
+static esp_err_t bench_fast_handler(httpd_req_t *req)
+{
+    return httpd_resp_sendstr(req, "ok");
+}
+
+static esp_err_t bench_slow_handler(httpd_req_t *req)
+{
+    vTaskDelay(pdMS_TO_TICKS(BENCH_SLOW_DELAY_MS));
+    return httpd_resp_sendstr(req, "slow");
+}
+
+/* Counts the sends needed for a response */
+static int bench_counting_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    s_send_calls++;
+    int ret = send(sockfd, buf, buf_len, flags);
+    return (ret < 0) ? HTTPD_SOCK_ERR_FAIL : ret;
+}
+
+static esp_err_t bench_small_handler(httpd_req_t *req)
+{
+    httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), bench_counting_send);
+    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_sendstr(req, "{\"status\":\"ok\",\"uptime\":123456}");
+}
+
+static esp_err_t bench_large_handler(httpd_req_t *req)
+{
+    static char body[BENCH_LARGE_SIZE];
+    memset(body, 'x', sizeof(body));
+    httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), bench_counting_send);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_send(req, body, sizeof(body));
+}
+
+static esp_err_t bench_chunked_handler(httpd_req_t *req)
+{
+    httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), bench_counting_send);
+    for (int i = 0; i < BENCH_CHUNKS; i++) {
+        esp_err_t ret = httpd_resp_sendstr_chunk(req, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+/* Receives one response, returns false on error or if the status is not 200 */
+static bool bench_recv_response(int sock, char *buf, size_t buf_size)
+{
+    size_t len = 0;
+    char *body = NULL;
+    while (body == NULL) {
+        int ret = recv(sock, buf + len, buf_size - len - 1, 0);
+        if (ret <= 0) {
+            return false;
+        }
+        len += ret;
+        buf[len] = '\0';
+        body = strstr(buf, "\r\n\r\n");
+    }
+    if (strncmp(buf, "HTTP/1.1 200", strlen("HTTP/1.1 200")) != 0) {
+        return false;
+    }
+    body += 4;
+    if (strstr(buf, "Transfer-Encoding: chunked")) {
+        /* Chunk data doesn't contain line breaks, so the end is the last chunk */
+        size_t body_off = body - buf;
+        while (strstr(buf + body_off, "\r\n0\r\n\r\n") == NULL && strncmp(buf + body_off, "0\r\n\r\n", 5) != 0) {
+            int ret = recv(sock, buf + len, buf_size - len - 1, 0);
+            if (ret <= 0) {
+                return false;
+            }
+            len += ret;
+            buf[len] = '\0';
+        }
+        return true;
+    }
+    const char *cl = strstr(buf, "Content-Length: ");
+    if (cl == NULL) {
+        return false;
+    }
+    size_t content_len = atoi(cl + strlen("Content-Length: "));
+    size_t have = len - (body - buf);
+    while (have < content_len) {
+        int ret = recv(sock, buf, buf_size - 1, 0);
+        if (ret <= 0) {
+            return false;
+        }
+        have += ret;
+    }
+    return true;
+}
+
+/* Sends all requests at once and then receives the responses, returns the number of responses */
+static int bench_run_pipelined(int sock, const char *request, int req_len, int requests, char *buf, size_t buf_size)
+{
+    char *all = malloc(requests * req_len);
+    if (all == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < requests; i++) {
+        memcpy(all + i * req_len, request, req_len);
+    }
+    int ret = send(sock, all, requests * req_len, 0);
+    free(all);
+    if (ret != requests * req_len) {
+        return 0;
+    }
+
+    struct timeval timeout = { .tv_sec = 5 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    const char *status_line = "HTTP/1.1 200";
+    const size_t keep = strlen(status_line) - 1;
+    size_t len = 0;
+    int responses = 0;
+    while (responses < requests) {
+        ret = recv(sock, buf + len, buf_size - len - 1, 0);
+        if (ret <= 0) {
+            break;
+        }
+        len += ret;
+        buf[len] = '\0';
+        for (char *p = strstr(buf, status_line); p; p = strstr(p + 1, status_line)) {
+            responses++;
+        }
+        /* Keep the tail, a status line may be split across receives */
+        if (len > keep) {
+            memmove(buf, buf + len - keep, keep);
+            len = keep;
+        }
+    }
+    return responses;
+}
+
+static void bench_client_task(void *arg)
+{
+    bench_client_t *client = (bench_client_t *) arg;
+    char buf[1024];
+    char request[64];
+    int req_len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", client->uri);
+
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(BENCH_PORT),
+        .sin_addr.s_addr = inet_addr("127.0.0.1"),
+    };
+    if (sock >= 0 && connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        if (client->pipelined) {
+            client->completed = bench_run_pipelined(sock, request, req_len, client->requests, buf, sizeof(buf));
+        }
+        for (int i = 0; i < client->requests && !client->pipelined && !s_bench_stop; i++) {
+            int64_t start = esp_timer_get_time();
+            if (send(sock, request, req_len, 0) != req_len || !bench_recv_response(sock, buf, sizeof(buf))) {
+                break;
+            }
+            if (client->latency_us) {
+                client->latency_us[i] = esp_timer_get_time() - start;
+            }
+            client->completed++;
+        }
+    }
+    if (sock >= 0) {
+        close(sock);
+    }
+    xSemaphoreGive(client->done);
+    vTaskDelete(NULL);
+}
+
+static int cmp_latency(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Returns p99 latency of the fast clients in microseconds */
+static int64_t run_worker_bench(uint16_t worker_count)
+{
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    config.max_open_sockets = BENCH_FAST_CLIENTS + 1;
+    config.worker_count = worker_count;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+
+    httpd_uri_t fast = { .uri = "/fast", .method = HTTP_GET, .handler = bench_fast_handler };
+    httpd_uri_t slow = { .uri = "/slow", .method = HTTP_GET, .handler = bench_slow_handler };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &fast));
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &slow));
+
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(BENCH_FAST_CLIENTS + 1, 0);
+    TEST_ASSERT_NOT_NULL(done);
+    int64_t *latency = calloc(BENCH_FAST_CLIENTS * BENCH_REQUESTS, sizeof(int64_t));
+    TEST_ASSERT_NOT_NULL(latency);
+    bench_client_t clients[BENCH_FAST_CLIENTS + 1];
+
+    s_bench_stop = false;
+    clients[0] = (bench_client_t) { .uri = "/slow", .requests = INT32_MAX, .done = done };
+    xTaskCreate(bench_client_task, "bench_slow", 4096, &clients[0], uxTaskPriorityGet(NULL), NULL);
+    vTaskDelay(pdMS_TO_TICKS(10));
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FAST_CLIENTS; i++) {
+        clients[i + 1] = (bench_client_t) {
+            .uri = "/fast",
+            .requests = BENCH_REQUESTS,
+            .latency_us = latency + i * BENCH_REQUESTS,
+            .done = done,
+        };
+        xTaskCreate(bench_client_task, "bench_fast", 4096, &clients[i + 1], uxTaskPriorityGet(NULL), NULL);
+    }
+    for (int i = 0; i < BENCH_FAST_CLIENTS; i++) {
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    s_bench_stop = true;
+    xSemaphoreTake(done, portMAX_DELAY);
+
+    int completed = 0;
+    for (int i = 0; i < BENCH_FAST_CLIENTS; i++) {
+        TEST_ASSERT_EQUAL(BENCH_REQUESTS, clients[i + 1].completed);
+        completed += clients[i + 1].completed;
+    }
+    qsort(latency, completed, sizeof(int64_t), cmp_latency);
+    int64_t p50 = latency[completed / 2];
+    int64_t p99 = latency[completed * 99 / 100];
+    printf("workers=%d: %d requests, %.1f req/s, latency p50=%lld us p99=%lld us (slow requests: %d)\n",
+           worker_count, completed, completed * 1000000.0 / elapsed, p50, p99, clients[0].completed);
+
+    free(latency);
+    vSemaphoreDelete(done);
+    TEST_ESP_OK(httpd_stop(hd));
+    return p99;
+}
+
+/* Returns the number of sends for BENCH_REQUESTS responses */
+static int run_send_bench(httpd_handle_t hd, const char *uri)
+{
+    SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(done);
+    bench_client_t client = { .uri = uri, .requests = BENCH_REQUESTS, .done = done };
+
+    s_bench_stop = false;
+    s_send_calls = 0;
+    int64_t start = esp_timer_get_time();
+    xTaskCreate(bench_client_task, "bench_client", 4096, &client, uxTaskPriorityGet(NULL), NULL);
+    xSemaphoreTake(done, portMAX_DELAY);
+    int64_t elapsed = esp_timer_get_time() - start;
+    vSemaphoreDelete(done);
+
+    TEST_ASSERT_EQUAL(BENCH_REQUESTS, client.completed);
+    printf("%s: %d responses, %.1f req/s, %.2f sends per response\n",
+           uri, client.completed, client.completed * 1000000.0 / elapsed,
+           (float) s_send_calls / client.completed);
+    return s_send_calls;
+}
+
+TEST_CASE("Response headers are sent together with the content", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+
+    httpd_uri_t small = { .uri = "/small", .method = HTTP_GET, .handler = bench_small_handler };
+    httpd_uri_t large = { .uri = "/large", .method = HTTP_GET, .handler = bench_large_handler };
+    httpd_uri_t chunked = { .uri = "/chunked", .method = HTTP_GET, .handler = bench_chunked_handler };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &small));
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &large));
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &chunked));
+
+    /* Headers and content in one send, or headers and content in two sends if content is large */
+    TEST_ASSERT_EQUAL(BENCH_REQUESTS, run_send_bench(hd, "/small"));
+    TEST_ASSERT_EQUAL(2 * BENCH_REQUESTS, run_send_bench(hd, "/large"));
+    /* One send per chunk, the first one includes the headers */
+    TEST_ASSERT_EQUAL((BENCH_CHUNKS + 1) * BENCH_REQUESTS, run_send_bench(hd, "/chunked"));
+
+    TEST_ESP_OK(httpd_stop(hd));
+}
+
+TEST_CASE("Pipelined requests are served without waiting for more data", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+
+    httpd_uri_t fast = { .uri = "/fast", .method = HTTP_GET, .handler = bench_fast_handler };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &fast));
+
+    int64_t elapsed[2];
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+        TEST_ASSERT_NOT_NULL(done);
+        bench_client_t client = { .uri = "/fast", .requests = BENCH_REQUESTS, .pipelined = pipelined, .done = done };
+
+        s_bench_stop = false;
+        int64_t start = esp_timer_get_time();
+        xTaskCreate(bench_client_task, "bench_client", 4096, &client, uxTaskPriorityGet(NULL), NULL);
+        xSemaphoreTake(done, portMAX_DELAY);
+        elapsed[pipelined] = esp_timer_get_time() - start;
+        vSemaphoreDelete(done);
+
+        /* All requests arrive in a few segments, the server must not wait for
+         * more data on the socket before processing the ones already received */
+        TEST_ASSERT_EQUAL(BENCH_REQUESTS, client.completed);
+        printf("%s: %.1f req/s\n", pipelined ? "pipelined" : "sequential",
+               client.completed * 1000000.0 / elapsed[pipelined]);
+    }
+    TEST_ASSERT_LESS_THAN(elapsed[0], elapsed[1]);
+
+    TEST_ESP_OK(httpd_stop(hd));
+}
+
+/* Files of a read-only in-memory filesystem, registered at BENCH_VFS_BASE */
+#define BENCH_VFS_BASE          "/httpdtest"
+#define BENCH_FILE_SIZE         (3 * CONFIG_HTTPD_SEND_FILE_BUF_SIZE + 123)
+#define BENCH_PARTITION_OFFSET  100
+#define BENCH_PARTITION_LEN     5000
+
+typedef struct {
+    const char *path;
+    const char *data;
+    size_t len;
+} bench_file_t;
+
+static char s_big_file[BENCH_FILE_SIZE];
+static const char s_page[] = "<html>plain</html>";
+static const char s_page_gz[] = "\x1f\x8b compressed";
+
+static const bench_file_t s_bench_files[] = {
+    { "/big.bin", s_big_file, sizeof(s_big_file) },
+    { "/page.html", s_page, sizeof(s_page) - 1 },
+    { "/page.html.gz", s_page_gz, sizeof(s_page_gz) - 1 },
+};
+
+/* File and read position of each descriptor, NULL if not open */
+static struct {
+    const bench_file_t *file;
+    size_t pos;
+} s_bench_fds[4];
+
+static int bench_vfs_open(const char *path, int flags, int mode)
+{
+    for (int i = 0; i < sizeof(s_bench_files) / sizeof(s_bench_files[0]); i++) {
+        if (strcmp(path, s_bench_files[i].path) != 0) {
+            continue;
+        }
+        for (int fd = 0; fd < sizeof(s_bench_fds) / sizeof(s_bench_fds[0]); fd++) {
+            if (s_bench_fds[fd].file == NULL) {
+                s_bench_fds[fd].file = &s_bench_files[i];
+                s_bench_fds[fd].pos = 0;
+                return fd;
+            }
+        }
+        errno = ENFILE;
+        return -1;
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+static ssize_t bench_vfs_read(int fd, void *dst, size_t size)
+{
+    const bench_file_t *file = s_bench_fds[fd].file;
+    size_t len = MIN(size, file->len - s_bench_fds[fd].pos);
+    memcpy(dst, file->data + s_bench_fds[fd].pos, len);
+    s_bench_fds[fd].pos += len;
+    return len;
+}
+
+static int bench_vfs_fstat(int fd, struct stat *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->st_mode = S_IFREG;
+    st->st_size = s_bench_fds[fd].file->len;
+    return 0;
+}
+
+static int bench_vfs_close(int fd)
+{
+    s_bench_fds[fd].file = NULL;
+    return 0;
+}
+
+static void bench_vfs_register(void)
+{
+    for (int i = 0; i < sizeof(s_big_file); i++) {
+        s_big_file[i] = 'a' + i % 26;
+    }
+    const esp_vfs_t vfs = {
+        .flags = ESP_VFS_FLAG_DEFAULT,
+        .open = bench_vfs_open,
+        .read = bench_vfs_read,
+        .fstat = bench_vfs_fstat,
+        .close = bench_vfs_close,
+    };
+    TEST_ESP_OK(esp_vfs_register(BENCH_VFS_BASE, &vfs, NULL));
+}
+
+/* Sends the file at the path in user_ctx */
+static esp_err_t bench_file_handler(httpd_req_t *req)
+{
+    esp_err_t ret = httpd_resp_send_file(req, req->user_ctx);
+    if (ret == ESP_ERR_NOT_FOUND) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    return ret;
+}
+
+/* Sends the first 1000 bytes of the big file */
+static esp_err_t bench_fd_handler(httpd_req_t *req)
+{
+    int fd = open(BENCH_VFS_BASE "/big.bin", O_RDONLY);
+    if (fd < 0) {
+        return ESP_FAIL;
+    }
+    esp_err_t ret = httpd_resp_send_fd(req, fd, 1000);
+    close(fd);
+    return ret;
+}
+
+static esp_err_t bench_partition_handler(httpd_req_t *req)
+{
+    return httpd_resp_send_partition(req, req->user_ctx, BENCH_PARTITION_OFFSET, BENCH_PARTITION_LEN);
+}
+
+/* Sends a request with the extra headers and receives the whole response, which must
+ * have a Content-Length. Returns the status code, the headers and body are in buf */
+static int bench_request(const char *method, const char *uri, const char *headers, char *buf, size_t buf_size,
+                         const char **body, size_t *body_len)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, sock);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(BENCH_PORT),
+        .sin_addr.s_addr = inet_addr("127.0.0.1"),
+    };
+    TEST_ASSERT_EQUAL(0, connect(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    struct timeval timeout = { .tv_sec = 1 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    int len = snprintf(buf, buf_size, "%s %s HTTP/1.1\r\nHost: localhost\r\n%s\r\n", method, uri, headers);
+    TEST_ASSERT_EQUAL(len, send(sock, buf, len, 0));
+
+    len = 0;
+    char *end = NULL;
+    const char *cl = NULL;
+    while (end == NULL || len < (end + 4 - buf) + atoi(cl + strlen("Content-Length: "))) {
+        int ret = recv(sock, buf + len, buf_size - len - 1, 0);
+        TEST_ASSERT_GREATER_THAN(0, ret);
+        len += ret;
+        buf[len] = '\0';
+        if (end == NULL && (end = strstr(buf, "\r\n\r\n")) != NULL) {
+            cl = strstr(buf, "Content-Length: ");
+            TEST_ASSERT_NOT_NULL(cl);
+        }
+    }
+    close(sock);
+    *body = end + 4;
+    *body_len = len - (end + 4 - buf);
+    return atoi(buf + strlen("HTTP/1.1 "));
+}
+
+static int bench_get(const char *uri, const char *headers, char *buf, size_t buf_size,
+                     const char **body, size_t *body_len)
+{
+    return bench_request("GET", uri, headers, buf, buf_size, body, body_len);
+}
+
+TEST_CASE("Files are sent with a Content-Length, precompressed if the client accepts gzip", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    bench_vfs_register();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+
+    httpd_uri_t big = { .uri = "/big", .method = HTTP_GET, .handler = bench_file_handler,
+                        .user_ctx = BENCH_VFS_BASE "/big.bin" };
+    httpd_uri_t page = { .uri = "/page", .method = HTTP_GET, .handler = bench_file_handler,
+                         .user_ctx = BENCH_VFS_BASE "/page.html" };
+    httpd_uri_t missing = { .uri = "/missing", .method = HTTP_GET, .handler = bench_file_handler,
+                            .user_ctx = BENCH_VFS_BASE "/missing.html" };
+    httpd_uri_t part = { .uri = "/part", .method = HTTP_GET, .handler = bench_fd_handler };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &big));
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &page));
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &missing));
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &part));
+
+    size_t buf_size = BENCH_FILE_SIZE + 512;
+    char *buf = malloc(buf_size);
+    TEST_ASSERT_NOT_NULL(buf);
+    const char *body;
+    size_t body_len;
+
+    /* Read and sent in several parts of the buffer size */
+    TEST_ASSERT_EQUAL(200, bench_get("/big", "", buf, buf_size, &body, &body_len));
+    TEST_ASSERT_EQUAL(BENCH_FILE_SIZE, body_len);
+    TEST_ASSERT_EQUAL_MEMORY(s_big_file, body, body_len);
+    TEST_ASSERT_NULL(strstr(buf, "Content-Encoding"));
+    TEST_ASSERT_NULL(strstr(buf, "Vary"));
+
+    /* Only a part of the file */
+    TEST_ASSERT_EQUAL(200, bench_get("/part", "", buf, buf_size, &body, &body_len));
+    TEST_ASSERT_EQUAL(1000, body_len);
+    TEST_ASSERT_EQUAL_MEMORY(s_big_file, body, body_len);
+
+    TEST_ASSERT_EQUAL(200, bench_get("/page", "", buf, buf_size, &body, &body_len));
+    TEST_ASSERT_EQUAL(strlen(s_page), body_len);
+    TEST_ASSERT_EQUAL_MEMORY(s_page, body, body_len);
+    TEST_ASSERT_NULL(strstr(buf, "Content-Encoding"));
+    /* A precompressed file exists, so the response depends on Accept-Encoding */
+    TEST_ASSERT_NOT_NULL(strstr(buf, "Vary: Accept-Encoding\r\n"));
+
+    TEST_ASSERT_EQUAL(200, bench_get("/page", "Accept-Encoding: deflate, gzip\r\n", buf, buf_size, &body, &body_len));
+    TEST_ASSERT_EQUAL(strlen(s_page_gz), body_len);
+    TEST_ASSERT_EQUAL_MEMORY(s_page_gz, body, body_len);
+    TEST_ASSERT_NOT_NULL(strstr(buf, "Content-Encoding: gzip\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "Vary: Accept-Encoding\r\n"));
+
+    /* Not acceptable */
+    TEST_ASSERT_EQUAL(200, bench_get("/page", "Accept-Encoding: gzip;q=0, deflate\r\n", buf, buf_size, &body, &body_len));
+    TEST_ASSERT_EQUAL_MEMORY(s_page, body, body_len);
+    TEST_ASSERT_NULL(strstr(buf, "Content-Encoding"));
+    TEST_ASSERT_NOT_NULL(strstr(buf, "Vary: Accept-Encoding\r\n"));
+    TEST_ASSERT_EQUAL(200, bench_get("/page", "Accept-Encoding: gzipx\r\n", buf, buf_size, &body, &body_len));
+    TEST_ASSERT_EQUAL_MEMORY(s_page, body, body_len);
+
+    /* There is no precompressed file */
+    TEST_ASSERT_EQUAL(200, bench_get("/big", "Accept-Encoding: gzip\r\n", buf, buf_size, &body, &body_len));
+    TEST_ASSERT_EQUAL(BENCH_FILE_SIZE, body_len);
+    TEST_ASSERT_NULL(strstr(buf, "Content-Encoding"));
+    TEST_ASSERT_NULL(strstr(buf, "Vary"));
+
+    TEST_ASSERT_EQUAL(404, bench_get("/missing", "", buf, buf_size, &body, &body_len));
+
+    free(buf);
+    TEST_ESP_OK(httpd_stop(hd));
+    TEST_ESP_OK(esp_vfs_unregister(BENCH_VFS_BASE));
+}
+
+TEST_CASE("Partition data is sent with a Content-Length", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                                ESP_PARTITION_SUBTYPE_ANY, "flash_test");
+    TEST_ASSERT_NOT_NULL(partition);
+    size_t erase_len = (BENCH_PARTITION_OFFSET + BENCH_PARTITION_LEN + SPI_FLASH_SEC_SIZE - 1) &
+                       ~(SPI_FLASH_SEC_SIZE - 1);
+    TEST_ESP_OK(esp_partition_erase_range(partition, 0, erase_len));
+    char *data = malloc(BENCH_PARTITION_LEN);
+    TEST_ASSERT_NOT_NULL(data);
+    for (int i = 0; i < BENCH_PARTITION_LEN; i++) {
+        data[i] = 'A' + i % 26;
+    }
+    TEST_ESP_OK(esp_partition_write(partition, BENCH_PARTITION_OFFSET, data, BENCH_PARTITION_LEN));
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+    httpd_uri_t part = { .uri = "/partition", .method = HTTP_GET, .handler = bench_partition_handler,
+                         .user_ctx = (void *) partition };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &part));
+
+    size_t buf_size = BENCH_PARTITION_LEN + 512;
+    char *buf = malloc(buf_size);
+    TEST_ASSERT_NOT_NULL(buf);
+    const char *body;
+    size_t body_len;
+    TEST_ASSERT_EQUAL(200, bench_get("/partition", "", buf, buf_size, &body, &body_len));
+    TEST_ASSERT_EQUAL(BENCH_PARTITION_LEN, body_len);
+    TEST_ASSERT_EQUAL_MEMORY(data, body, body_len);
+
+    free(buf);
+    free(data);
+    TEST_ESP_OK(httpd_stop(hd));
+}
+
+static esp_err_t bench_route_handler(httpd_req_t *req)
+{
+    return httpd_resp_sendstr(req, req->user_ctx);
+}
+
+/* Sends a request and checks the status, and for 200 the name of the handler which answered */
+static void bench_check_route(const char *method, const char *uri, int status, const char *handler)
+{
+    char buf[512];
+    const char *body;
+    size_t body_len;
+    TEST_ASSERT_EQUAL(status, bench_request(method, uri, "Content-Length: 0\r\n", buf, sizeof(buf), &body, &body_len));
+    if (status == 200) {
+        TEST_ASSERT_EQUAL(strlen(handler), body_len);
+        TEST_ASSERT_EQUAL_MEMORY(handler, body, body_len);
+    }
+}
+
+/* Same as httpd_uri_match_wildcard(), but as a custom function it makes the
+ * server compare the URI against every template instead of using the router */
+static bool bench_wildcard_match(const char *uri_template, const char *uri_to_match, size_t match_upto)
+{
+    return httpd_uri_match_wildcard(uri_template, uri_to_match, match_upto);
+}
+
+/* The router is rebuilt by the first request after handlers are registered or unregistered */
+static void bench_check_routes(httpd_uri_match_func_t uri_match_fn)
+{
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    config.uri_match_fn = uri_match_fn;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+    /* A wildcard template can't be registered after a template which it matches */
+    httpd_uri_t uris[] = {
+        { .uri = "/api/status", .method = HTTP_GET,  .user_ctx = "status" },
+        { .uri = "/api/status", .method = HTTP_POST, .user_ctx = "post status" },
+        { .uri = "/api/*",      .method = HTTP_GET,  .user_ctx = "api" },
+        { .uri = "/file?",      .method = HTTP_GET,  .user_ctx = "file" },
+        { .uri = "/",           .method = HTTP_GET,  .user_ctx = "root" },
+    };
+    for (int i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        uris[i].handler = bench_route_handler;
+        TEST_ESP_OK(httpd_register_uri_handler(hd, &uris[i]));
+    }
+
+    bench_check_route("GET", "/", 200, "root");
+    /* Both templates match, the first registered one wins */
+    bench_check_route("GET", "/api/status", 200, "status");
+    bench_check_route("GET", "/api/status?verbose=1", 200, "status");
+    bench_check_route("GET", "/api/", 200, "api");
+    bench_check_route("GET", "/api/other", 200, "api");
+    bench_check_route("POST", "/api/status", 200, "post status");
+    bench_check_route("GET", "/fil", 200, "file");
+    bench_check_route("GET", "/file", 200, "file");
+    /* URI is known but not for this method */
+    bench_check_route("POST", "/api/other", 405, NULL);
+    bench_check_route("POST", "/", 405, NULL);
+    bench_check_route("GET", "/api", 404, NULL);
+    bench_check_route("GET", "/files", 404, NULL);
+    bench_check_route("GET", "/ap", 404, NULL);
+    bench_check_route("GET", "/other", 404, NULL);
+
+    /* Lookup after unregistering uses the remaining handlers */
+    TEST_ESP_OK(httpd_unregister_uri_handler(hd, "/api/status", HTTP_GET));
+    bench_check_route("GET", "/api/status", 200, "api");
+    bench_check_route("POST", "/api/status", 200, "post status");
+    TEST_ESP_OK(httpd_unregister_uri_handler(hd, "/api/*", HTTP_GET));
+    bench_check_route("GET", "/api/other", 404, NULL);
+    bench_check_route("GET", "/api/status", 405, NULL);
+    TEST_ESP_OK(httpd_unregister_uri_handler(hd, "/api/status", HTTP_POST));
+    bench_check_route("GET", "/api/status", 404, NULL);
+    bench_check_route("GET", "/file", 200, "file");
+
+    /* Registering again after a lookup */
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &uris[0]));
+    bench_check_route("GET", "/api/status", 200, "status");
+    TEST_ESP_OK(httpd_stop(hd));
+}
+
+TEST_CASE("Requests are routed to the first registered handler which matches", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    /* With the router */
+    bench_check_routes(httpd_uri_match_wildcard);
+    /* Same results with the linear search */
+    bench_check_routes(bench_wildcard_match);
+}
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+static volatile int s_ws_sent;
+
+static esp_err_t bench_ws_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        /* Handshake is done, count the sends from now on */
+        httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), bench_counting_send);
+    }
+    return ESP_OK;
+}
+
+static void bench_ws_sent_cb(esp_err_t err, int socket, void *arg)
+{
+    if (err == ESP_OK) {
+        s_ws_sent++;
+    }
+}
+
+/* Connects a WebSocket client, returns the socket after the handshake */
+static int bench_ws_connect(const char *uri)
+{
+    char buf[512];
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, sock);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(BENCH_PORT),
+        .sin_addr.s_addr = inet_addr("127.0.0.1"),
+    };
+    TEST_ASSERT_EQUAL(0, connect(sock, (struct sockaddr *)&addr, sizeof(addr)));
+    struct timeval timeout = { .tv_sec = 1 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    int len = snprintf(buf, sizeof(buf), "GET %s HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\n"
+                       "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "Sec-WebSocket-Version: 13\r\n\r\n", uri);
+    TEST_ASSERT_EQUAL(len, send(sock, buf, len, 0));
+    len = recv(sock, buf, sizeof(buf) - 1, 0);
+    TEST_ASSERT_GREATER_THAN(0, len);
+    buf[len] = '\0';
+    TEST_ASSERT_NOT_NULL(strstr(buf, "101 Switching Protocols"));
+    return sock;
+}
+
+TEST_CASE("WebSocket broadcast sends one frame to all clients of a URI", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+
+    httpd_uri_t ws = { .uri = "/ws", .method = HTTP_GET, .handler = bench_ws_handler, .is_websocket = true };
+    httpd_uri_t other = { .uri = "/other", .method = HTTP_GET, .handler = bench_ws_handler, .is_websocket = true };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &ws));
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &other));
+
+    int socks[BENCH_WS_CLIENTS];
+    for (int i = 0; i < BENCH_WS_CLIENTS; i++) {
+        socks[i] = bench_ws_connect("/ws");
+    }
+    int other_sock = bench_ws_connect("/other");
+
+    char payload[200];
+    memset(payload, 't', sizeof(payload));
+    httpd_ws_frame_t frame = {
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)payload,
+        .len = sizeof(payload),
+    };
+    s_send_calls = 0;
+    s_ws_sent = 0;
+    TEST_ESP_OK(httpd_ws_broadcast_async(hd, NULL, 0, "/ws", &frame, bench_ws_sent_cb, NULL));
+    /* The frame was copied */
+    memset(payload, 0, sizeof(payload));
+
+    for (int i = 0; i < BENCH_WS_CLIENTS; i++) {
+        uint8_t buf[4 + sizeof(payload)];
+        size_t len = 0;
+        while (len < sizeof(buf)) {
+            int ret = recv(socks[i], buf + len, sizeof(buf) - len, 0);
+            TEST_ASSERT_GREATER_THAN(0, ret);
+            len += ret;
+        }
+        TEST_ASSERT_EQUAL_HEX8(0x81, buf[0]);
+        TEST_ASSERT_EQUAL_HEX8(126, buf[1]);
+        TEST_ASSERT_EQUAL(sizeof(payload), (buf[2] << 8) | buf[3]);
+        TEST_ASSERT_EACH_EQUAL_HEX8('t', buf + 4, sizeof(payload));
+    }
+    /* Clients of other URIs get nothing */
+    char c;
+    TEST_ASSERT_LESS_THAN(0, recv(other_sock, &c, 1, 0));
+
+    /* Header and payload in a single send per client */
+    TEST_ASSERT_EQUAL(BENCH_WS_CLIENTS, s_send_calls);
+    TEST_ASSERT_EQUAL(BENCH_WS_CLIENTS, s_ws_sent);
+
+    for (int i = 0; i < BENCH_WS_CLIENTS; i++) {
+        close(socks[i]);
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    close(other_sock);
+    TEST_ESP_OK(httpd_stop(hd));
+}
+
+#define BENCH_WS_FRAME_LEN      300
+#define BENCH_WS_WORKER_FRAMES  50
+#define BENCH_WS_ROUNDS         10
+
+static volatile int s_ws_fd;
+static volatile bool s_bench_broadcast;
+static SemaphoreHandle_t s_bench_done;
+
+/* Delays each send, so that frames sent concurrently would interleave */
+static int bench_slow_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    vTaskDelay(1);
+    int ret = send(sockfd, buf, buf_len, flags);
+    return (ret < 0) ? HTTPD_SOCK_ERR_FAIL : ret;
+}
+
+/* Answers each frame received with BENCH_WS_WORKER_FRAMES frames of 'W' */
+static esp_err_t bench_ws_burst_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), bench_slow_send);
+        s_ws_fd = httpd_req_to_sockfd(req);
+        return ESP_OK;
+    }
+    uint8_t buf[8];
+    httpd_ws_frame_t frame = { .payload = buf };
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, sizeof(buf));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    static uint8_t payload[BENCH_WS_FRAME_LEN];
+    memset(payload, 'W', sizeof(payload));
+    frame = (httpd_ws_frame_t) { .type = HTTPD_WS_TYPE_BINARY, .payload = payload, .len = sizeof(payload) };
+    for (int i = 0; i < BENCH_WS_WORKER_FRAMES && ret == ESP_OK; i++) {
+        ret = httpd_ws_send_frame(req, &frame);
+    }
+    return ret;
+}
+
+static void bench_ws_broadcast_done_cb(esp_err_t err, int socket, void *arg)
+{
+    xSemaphoreGive((SemaphoreHandle_t) arg);
+}
+
+/* Sends frames of 'S' from the server task until stopped, to the session
+ * or as a broadcast to all clients of "/ws" */
+static void bench_ws_async_task(void *arg)
+{
+    httpd_handle_t hd = arg;
+    static uint8_t payload[BENCH_WS_FRAME_LEN];
+    memset(payload, 'S', sizeof(payload));
+    httpd_ws_frame_t frame = { .type = HTTPD_WS_TYPE_BINARY, .payload = payload, .len = sizeof(payload) };
+    SemaphoreHandle_t sent = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(sent);
+    while (!s_bench_stop) {
+        if (!s_bench_broadcast) {
+            httpd_ws_send_data(hd, s_ws_fd, &frame);
+        } else if (httpd_ws_broadcast_async(hd, NULL, 0, "/ws", &frame, bench_ws_broadcast_done_cb, sent) == ESP_OK) {
+            xSemaphoreTake(sent, pdMS_TO_TICKS(100));
+        }
+    }
+    vSemaphoreDelete(sent);
+    xSemaphoreGive(s_bench_done);
+    vTaskDelete(NULL);
+}
+
+static void bench_ws_interleave(bool broadcast)
+{
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    config.worker_count = 2;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+
+    httpd_uri_t ws = { .uri = "/ws", .method = HTTP_GET, .handler = bench_ws_burst_handler, .is_websocket = true };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &ws));
+
+    s_ws_fd = -1;
+    int sock = bench_ws_connect("/ws");
+    while (s_ws_fd < 0) {
+        vTaskDelay(1);
+    }
+    s_bench_stop = false;
+    s_bench_broadcast = broadcast;
+    s_bench_done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(s_bench_done);
+    xTaskCreate(bench_ws_async_task, "bench_ws_async", 4096, hd, uxTaskPriorityGet(NULL), NULL);
+
+    /* Masked binary frame of one byte */
+    const uint8_t trigger[] = { 0x82, 0x81, 1, 2, 3, 4, 'x' ^ 1 };
+    int worker_frames = 0, async_frames = 0;
+    for (int round = 0; round < BENCH_WS_ROUNDS; round++) {
+        TEST_ASSERT_EQUAL(sizeof(trigger), send(sock, trigger, sizeof(trigger), 0));
+        int expected = worker_frames + BENCH_WS_WORKER_FRAMES;
+        while (worker_frames < expected) {
+            uint8_t buf[4 + BENCH_WS_FRAME_LEN];
+            size_t len = 0;
+            while (len < sizeof(buf)) {
+                int ret = recv(sock, buf + len, sizeof(buf) - len, 0);
+                TEST_ASSERT_GREATER_THAN(0, ret);
+                len += ret;
+            }
+            /* A whole frame, from either sender */
+            TEST_ASSERT_EQUAL_HEX8(0x82, buf[0]);
+            TEST_ASSERT_EQUAL_HEX8(126, buf[1]);
+            TEST_ASSERT_EQUAL(BENCH_WS_FRAME_LEN, (buf[2] << 8) | buf[3]);
+            TEST_ASSERT_EACH_EQUAL_HEX8(buf[4], buf + 4, BENCH_WS_FRAME_LEN);
+            if (buf[4] == 'W') {
+                worker_frames++;
+            } else {
+                async_frames++;
+            }
+        }
+    }
+    printf("worker frames: %d, asynchronous frames: %d\n", worker_frames, async_frames);
+
+    s_bench_stop = true;
+    close(sock);
+    xSemaphoreTake(s_bench_done, portMAX_DELAY);
+    vSemaphoreDelete(s_bench_done);
+    TEST_ESP_OK(httpd_stop(hd));
+}
+
+TEST_CASE("Asynchronous WebSocket frames don't interleave with frames sent by a worker", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    bench_ws_interleave(false);
+}
+
+TEST_CASE("WebSocket broadcasts don't interleave with frames sent by a worker", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    bench_ws_interleave(true);
+}
+#define BENCH_WS_ECHO_MAX       200
+
+static uint8_t s_ws_rx_buf[BENCH_WS_ECHO_MAX + 4] __attribute__((aligned(4)));
+static volatile int s_ws_rx_align;
+
+/* Receives the payload at s_ws_rx_align bytes from a word boundary and sends it back */
+static esp_err_t bench_ws_echo_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        return ESP_OK;
+    }
+    httpd_ws_frame_t frame = { 0 };
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    frame.payload = s_ws_rx_buf + s_ws_rx_align;
+    ret = httpd_ws_recv_frame(req, &frame, BENCH_WS_ECHO_MAX);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return httpd_ws_send_frame(req, &frame);
+}
+
+static void bench_recv_all(int sock, uint8_t *buf, size_t len)
+{
+    for (size_t done = 0; done < len; ) {
+        int ret = recv(sock, buf + done, len - done, 0);
+        TEST_ASSERT_GREATER_THAN(0, ret);
+        done += ret;
+    }
+}
+
+TEST_CASE("WebSocket payload is unmasked for any alignment and split of the received data", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+    httpd_uri_t ws = { .uri = "/ws", .method = HTTP_GET, .handler = bench_ws_echo_handler, .is_websocket = true };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &ws));
+
+    int sock = bench_ws_connect("/ws");
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    const uint8_t mask_key[4] = { 0x12, 0x34, 0x56, 0x78 };
+    const size_t lengths[] = { 1, 3, 4, 5, 13, 64, 130 };
+    uint8_t payload[BENCH_WS_ECHO_MAX];
+    uint8_t frame[8 + BENCH_WS_ECHO_MAX];
+    for (int align = 0; align < 4; align++) {
+        s_ws_rx_align = align;
+        for (int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+            size_t len = lengths[l];
+            size_t hdr_len = (len < 126) ? 2 : 4;
+            frame[0] = 0x82;
+            if (len < 126) {
+                frame[1] = 0x80 | len;
+            } else {
+                frame[1] = 0x80 | 126;
+                frame[2] = len >> 8;
+                frame[3] = len & 0xFF;
+            }
+            memcpy(frame + hdr_len, mask_key, sizeof(mask_key));
+            for (size_t i = 0; i < len; i++) {
+                payload[i] = i * 31 + len;
+                frame[hdr_len + 4 + i] = payload[i] ^ mask_key[i % 4];
+            }
+
+            /* Parts of 1 to 7 bytes, so that the server receives the payload
+             * in pieces of different lengths and at different offsets */
+            size_t frame_len = hdr_len + 4 + len;
+            size_t part = 1;
+            for (size_t sent = 0; sent < frame_len; sent += part, part = part % 7 + 1) {
+                part = MIN(part, frame_len - sent);
+                TEST_ASSERT_EQUAL(part, send(sock, frame + sent, part, 0));
+                vTaskDelay(1);
+            }
+
+            uint8_t echo[4 + BENCH_WS_ECHO_MAX];
+            bench_recv_all(sock, echo, hdr_len + len);
+            TEST_ASSERT_EQUAL_HEX8(0x82, echo[0]);
+            TEST_ASSERT_EQUAL(len, (len < 126) ? echo[1] : (echo[2] << 8 | echo[3]));
+            TEST_ASSERT_EQUAL_MEMORY(payload, echo + hdr_len, len);
+        }
+    }
+
+    close(sock);
+    TEST_ESP_OK(httpd_stop(hd));
+}
+#endif /* CONFIG_HTTPD_WS_SUPPORT */
+
+TEST_CASE("URI handlers can be registered and unregistered while requests are served", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = BENCH_PORT;
+    config.max_open_sockets = BENCH_FAST_CLIENTS;
+    config.max_uri_handlers = 16;
+    config.worker_count = BENCH_FAST_CLIENTS;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+
+    httpd_uri_t fast = { .uri = "/fast*", .method = HTTP_GET, .handler = bench_fast_handler };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &fast));
+
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(BENCH_FAST_CLIENTS, 0);
+    TEST_ASSERT_NOT_NULL(done);
+    bench_client_t clients[BENCH_FAST_CLIENTS];
+    s_bench_stop = false;
+    for (int i = 0; i < BENCH_FAST_CLIENTS; i++) {
+        clients[i] = (bench_client_t) { .uri = "/fast", .requests = BENCH_CHURN_REQUESTS, .done = done };
+        xTaskCreate(bench_client_task, "bench_fast", 4096, &clients[i], uxTaskPriorityGet(NULL), NULL);
+    }
+
+    /* Handlers come and go while the clients' requests are matched */
+    char uris[8][16];
+    int finished = 0;
+    int rounds = 0;
+    while (finished < BENCH_FAST_CLIENTS) {
+        for (int n = 0; n < 10; n++, rounds++) {
+            for (int i = 0; i < 8; i++) {
+                snprintf(uris[i], sizeof(uris[i]), "/fas%c/%d", 'a' + i, rounds);
+                httpd_uri_t uri = { .uri = uris[i], .method = HTTP_GET, .handler = bench_slow_handler };
+                TEST_ESP_OK(httpd_register_uri_handler(hd, &uri));
+            }
+            for (int i = 0; i < 8; i++) {
+                TEST_ESP_OK(httpd_unregister_uri_handler(hd, uris[i], HTTP_GET));
+            }
+        }
+        while (finished < BENCH_FAST_CLIENTS && xSemaphoreTake(done, 0) == pdTRUE) {
+            finished++;
+        }
+        vTaskDelay(1);
+    }
+    printf("%d rounds of registering and unregistering handlers\n", rounds);
+
+    for (int i = 0; i < BENCH_FAST_CLIENTS; i++) {
+        TEST_ASSERT_EQUAL(BENCH_CHURN_REQUESTS, clients[i].completed);
+    }
+    vSemaphoreDelete(done);
+    TEST_ESP_OK(httpd_stop(hd));
+}
+
+TEST_CASE("Worker tasks keep serving while a handler is slow", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    int64_t p99_inline = run_worker_bench(0);
+    int64_t p99_workers = run_worker_bench(2);
+
+    /* With inline execution, fast requests queue up behind the slow handler */
+    TEST_ASSERT_GREATER_THAN(BENCH_SLOW_DELAY_MS * 1000 / 2, p99_inline);
+    TEST_ASSERT_LESS_THAN(BENCH_SLOW_DELAY_MS * 1000 / 2, p99_workers);
+}
@@ -0,0 +1,49 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Runs the esp_http_server unit tests on the host. An optional argument selects
+ * the tests whose name contains it */
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+
+#define MAX_TEST_CASES  64
+
+static host_test_case_t s_test_cases[MAX_TEST_CASES];
+static int s_test_case_count;
+
+void host_test_register(const char *name, void (*fn)(void))
+{
+    if (s_test_case_count == MAX_TEST_CASES) {
+        fprintf(stderr, "Too many test cases, increase MAX_TEST_CASES\n");
+        abort();
+    }
+    s_test_cases[s_test_case_count].name = name;
+    s_test_cases[s_test_case_count].fn = fn;
+    s_test_case_count++;
+}
+
+int main(int argc, char **argv)
+{
+    /* Tests close connections which the server is still writing to */
+    signal(SIGPIPE, SIG_IGN);
+
+    int run = 0;
+    for (int i = 0; i < s_test_case_count; i++) {
+        if (argc > 1 && strstr(s_test_cases[i].name, argv[1]) == NULL) {
+            continue;
+        }
+        printf("%s ... ", s_test_cases[i].name);
+        fflush(stdout);
+        s_test_cases[i].fn();
+        printf("PASS\n");
+        run++;
+    }
+    printf("%d tests passed\n", run);
+    return 0;
+}
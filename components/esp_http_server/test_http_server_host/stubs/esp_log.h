@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#define ESP_LOGE(tag, ...)                  ((void) (tag))
+#define ESP_LOGW(tag, ...)                  ((void) (tag))
+#define ESP_LOGI(tag, ...)                  ((void) (tag))
+#define ESP_LOGD(tag, ...)                  ((void) (tag))
+#define ESP_LOGV(tag, ...)                  ((void) (tag))
+#define ESP_LOG_BUFFER_HEX_LEVEL(...)       ((void) 0)
+#define ESP_LOG_BUFFER_HEXDUMP(...)         ((void) 0)
@@ -0,0 +1,262 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "esp_vfs.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+
+#define FLASH_TEST_SIZE     (64 * 1024)
+#define VFS_FD_OFFSET       1000
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return UINT32_MAX;
+}
+
+/* Not in glibc before 2.38 */
+__attribute__((weak)) size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t copy = (len < size) ? len : size - 1;
+        memcpy(dst, src, copy);
+        dst[copy] = '\0';
+    }
+    return len;
+}
+
+/* Flash partition */
+
+static uint8_t s_flash[FLASH_TEST_SIZE];
+static const esp_partition_t s_flash_test = {
+    .size = FLASH_TEST_SIZE,
+    .label = "flash_test",
+};
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, int subtype, const char *label)
+{
+    return (label && strcmp(label, s_flash_test.label) == 0) ? &s_flash_test : NULL;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(s_flash + offset, 0xFF, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size)
+{
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(s_flash + offset, src, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             spi_flash_mmap_memory_t memory, const void **out_ptr, spi_flash_mmap_handle_t *out_handle)
+{
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_ptr = s_flash + offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle)
+{
+}
+
+/* VFS, the file descriptors of the registered file system start at VFS_FD_OFFSET */
+
+static char s_vfs_base[32];
+static esp_vfs_t s_vfs;
+
+esp_err_t esp_vfs_register(const char *base_path, const esp_vfs_t *vfs, void *ctx)
+{
+    if (s_vfs_base[0] != '\0' || strlen(base_path) >= sizeof(s_vfs_base)) {
+        return ESP_ERR_NO_MEM;
+    }
+    strcpy(s_vfs_base, base_path);
+    s_vfs = *vfs;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_unregister(const char *base_path)
+{
+    if (strcmp(base_path, s_vfs_base) != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_vfs_base[0] = '\0';
+    return ESP_OK;
+}
+
+#define LIBC_FUNC(name) ({ \
+        static __typeof__(name) *libc_##name; \
+        if (libc_##name == NULL) { \
+            libc_##name = dlsym(RTLD_NEXT, #name); \
+        } \
+        libc_##name; \
+    })
+
+int open(const char *path, int flags, ...)
+{
+    va_list ap;
+    va_start(ap, flags);
+    int mode = va_arg(ap, int);
+    va_end(ap);
+    size_t base_len = strlen(s_vfs_base);
+    if (base_len && strncmp(path, s_vfs_base, base_len) == 0) {
+        int fd = s_vfs.open(path + base_len, flags, mode);
+        return (fd < 0) ? fd : fd + VFS_FD_OFFSET;
+    }
+    return LIBC_FUNC(open)(path, flags, mode);
+}
+
+ssize_t read(int fd, void *dst, size_t size)
+{
+    if (fd >= VFS_FD_OFFSET) {
+        return s_vfs.read(fd - VFS_FD_OFFSET, dst, size);
+    }
+    return LIBC_FUNC(read)(fd, dst, size);
+}
+
+int fstat(int fd, struct stat *st)
+{
+    if (fd >= VFS_FD_OFFSET) {
+        return s_vfs.fstat(fd - VFS_FD_OFFSET, st);
+    }
+    return LIBC_FUNC(fstat)(fd, st);
+}
+
+int close(int fd)
+{
+    if (fd >= VFS_FD_OFFSET) {
+        return s_vfs.close(fd - VFS_FD_OFFSET);
+    }
+    return LIBC_FUNC(close)(fd);
+}
+
+/* SHA-1 and Base64 for the WebSocket handshake */
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(uint32_t state[5], const uint8_t block[64])
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t) block[i * 4] << 24 | (uint32_t) block[i * 4 + 1] << 16 |
+               (uint32_t) block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = ROL32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL32(b, 30);
+        b = a;
+        a = t;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint8_t block[64];
+    size_t done = 0;
+    for (; ilen - done >= 64; done += 64) {
+        sha1_block(state, input + done);
+    }
+    size_t rest = ilen - done;
+    memcpy(block, input + done, rest);
+    block[rest++] = 0x80;
+    if (rest > 56) {
+        memset(block + rest, 0, 64 - rest);
+        sha1_block(state, block);
+        rest = 0;
+    }
+    memset(block + rest, 0, 56 - rest);
+    uint64_t bits = (uint64_t) ilen * 8;
+    for (int i = 0; i < 8; i++) {
+        block[63 - i] = (uint8_t) (bits >> (i * 8));
+    }
+    sha1_block(state, block);
+    for (int i = 0; i < 20; i++) {
+        output[i] = (uint8_t) (state[i / 4] >> (24 - (i % 4) * 8));
+    }
+    return 0;
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t need = 4 * ((slen + 2) / 3) + 1;
+    if (dst == NULL || dlen < need) {
+        *olen = need;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < slen; i += 3) {
+        uint32_t v = (uint32_t) src[i] << 16;
+        if (i + 1 < slen) {
+            v |= (uint32_t) src[i + 1] << 8;
+        }
+        if (i + 2 < slen) {
+            v |= src[i + 2];
+        }
+        dst[n++] = alphabet[(v >> 18) & 0x3F];
+        dst[n++] = alphabet[(v >> 12) & 0x3F];
+        dst[n++] = (i + 1 < slen) ? alphabet[(v >> 6) & 0x3F] : '=';
+        dst[n++] = (i + 2 < slen) ? alphabet[v & 0x3F] : '=';
+    }
+    dst[n] = '\0';
+    *olen = n;
+    return 0;
+}
@@ -0,0 +1,27 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* One file system can be registered. open(), read(), fstat() and close() are
+ * redirected to it for paths under its base path */
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "esp_err.h"
+
+#define ESP_VFS_FLAG_DEFAULT    0
+
+typedef struct {
+    int flags;
+    int (*open)(const char *path, int flags, int mode);
+    ssize_t (*read)(int fd, void *dst, size_t size);
+    int (*fstat)(int fd, struct stat *st);
+    int (*close)(int fd);
+} esp_vfs_t;
+
+esp_err_t esp_vfs_register(const char *base_path, const esp_vfs_t *vfs, void *ctx);
+esp_err_t esp_vfs_unregister(const char *base_path);
@@ -0,0 +1,299 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* FreeRTOS tasks, queues, semaphores and event groups on top of pthreads. Priorities
+ * and core affinity are ignored, every task runs in its own thread */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+typedef struct {
+    pthread_t thread;
+    void (*fn)(void *);
+    void *arg;
+} host_task_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t item_size;           /* 0 for semaphores */
+    size_t length;
+    size_t count;
+    size_t head;
+    char *items;
+} host_queue_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+} host_event_group_t;
+
+static __thread host_task_t *s_current_task;
+static pthread_mutex_t s_task_count_lock = PTHREAD_MUTEX_INITIALIZER;
+static UBaseType_t s_task_count = 1;
+
+static void *task_entry(void *arg)
+{
+    s_current_task = (host_task_t *) arg;
+    s_current_task->fn(s_current_task->arg);
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack_size, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id)
+{
+    host_task_t *task = calloc(1, sizeof(host_task_t));
+    if (task == NULL) {
+        return pdFALSE;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (handle) {
+        *handle = task;
+    }
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_mutex_lock(&s_task_count_lock);
+    s_task_count++;
+    pthread_mutex_unlock(&s_task_count_lock);
+    if (pthread_create(&task->thread, &attr, task_entry, task) != 0) {
+        pthread_mutex_lock(&s_task_count_lock);
+        s_task_count--;
+        pthread_mutex_unlock(&s_task_count_lock);
+        free(task);
+        return pdFALSE;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack_size, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_size, arg, priority, handle, tskNO_AFFINITY);
+}
+
+/* Only self delete is supported */
+void vTaskDelete(TaskHandle_t handle)
+{
+    host_task_t *task = s_current_task;
+    if (handle != NULL && handle != task) {
+        abort();
+    }
+    pthread_mutex_lock(&s_task_count_lock);
+    s_task_count--;
+    pthread_mutex_unlock(&s_task_count_lock);
+    s_current_task = NULL;
+    free(task);
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t) ticks * 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (s_current_task == NULL) {
+        /* Main thread of the test program */
+        s_current_task = calloc(1, sizeof(host_task_t));
+        s_current_task->thread = pthread_self();
+    }
+    return s_current_task;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t handle)
+{
+    return tskIDLE_PRIORITY + 5;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    pthread_mutex_lock(&s_task_count_lock);
+    UBaseType_t count = s_task_count;
+    pthread_mutex_unlock(&s_task_count_lock);
+    return count;
+}
+
+/* Waits with the lock held until `ready` is true, returns false on timeout */
+static bool queue_wait(host_queue_t *queue, bool (*ready)(host_queue_t *), TickType_t ticks)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long nsec = deadline.tv_nsec + (long long) (ticks % 1000) * 1000000;
+    deadline.tv_sec += ticks / 1000 + nsec / 1000000000;
+    deadline.tv_nsec = nsec % 1000000000;
+    while (!ready(queue)) {
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        } else if (pthread_cond_timedwait(&queue->changed, &queue->lock, &deadline) != 0) {
+            return ready(queue);
+        }
+    }
+    return true;
+}
+
+static bool queue_not_full(host_queue_t *queue)
+{
+    return queue->count < queue->length;
+}
+
+static bool queue_not_empty(host_queue_t *queue)
+{
+    return queue->count > 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    host_queue_t *queue = calloc(1, sizeof(host_queue_t));
+    if (queue == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->item_size = item_size;
+    queue->length = length;
+    if (item_size) {
+        queue->items = calloc(length, item_size);
+    }
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t ticks)
+{
+    host_queue_t *queue = (host_queue_t *) handle;
+    pthread_mutex_lock(&queue->lock);
+    bool ok = queue_wait(queue, queue_not_full, ticks);
+    if (ok) {
+        if (queue->item_size) {
+            size_t tail = (queue->head + queue->count) % queue->length;
+            memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+        }
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t ticks)
+{
+    host_queue_t *queue = (host_queue_t *) handle;
+    pthread_mutex_lock(&queue->lock);
+    bool ok = queue_wait(queue, queue_not_empty, ticks);
+    if (ok) {
+        if (queue->item_size) {
+            memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+        }
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+void vQueueDelete(QueueHandle_t handle)
+{
+    host_queue_t *queue = (host_queue_t *) handle;
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    free(queue);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    host_queue_t *queue = xQueueCreate(max_count, 0);
+    if (queue) {
+        queue->count = initial_count;
+    }
+    return queue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSend(sem, NULL, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    vQueueDelete(sem);
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    host_event_group_t *group = calloc(1, sizeof(host_event_group_t));
+    if (group == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->changed, NULL);
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t handle)
+{
+    host_event_group_t *group = (host_event_group_t *) handle;
+    pthread_cond_destroy(&group->changed);
+    pthread_mutex_destroy(&group->lock);
+    free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t handle, EventBits_t bits)
+{
+    host_event_group_t *group = (host_event_group_t *) handle;
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t ret = group->bits;
+    pthread_cond_broadcast(&group->changed);
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
+
+/* Only waiting forever is supported */
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t handle, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks)
+{
+    host_event_group_t *group = (host_event_group_t *) handle;
+    pthread_mutex_lock(&group->lock);
+    while (wait_for_all ? (group->bits & bits) != bits : (group->bits & bits) == 0) {
+        pthread_cond_wait(&group->changed, &group->lock);
+    }
+    EventBits_t ret = group->bits;
+    if (clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->lock);
+    return ret;
+}
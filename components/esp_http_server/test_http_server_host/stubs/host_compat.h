@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Included before every source file. Declarations which the target gets from
+ * lwIP and newlib headers */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/tcp.h>
+#include "sdkconfig.h"
+
+size_t strlcpy(char *dst, const char *src, size_t size);
@@ -0,0 +1,20 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#define CONFIG_HTTPD_MAX_REQ_HDR_LEN        512
+#define CONFIG_HTTPD_MAX_URI_LEN            512
+#define CONFIG_HTTPD_ERR_RESP_NO_DELAY      1
+#define CONFIG_HTTPD_PURGE_BUF_LEN          32
+#define CONFIG_HTTPD_WS_SUPPORT             1
+#define CONFIG_HTTPD_QUEUE_WORK_BLOCKING    1
+#define CONFIG_HTTPD_VALIDATE_REQ           1
+#define CONFIG_HTTPD_SEND_FILE_BUF_SIZE     4096
+#define CONFIG_HTTPD_RESP_BUF_SIZE          1024
+#define CONFIG_HTTPD_RECV_BUF_SIZE          512
+#define CONFIG_LWIP_MAX_SOCKETS             10
+#define CONFIG_LWIP_UDP_RECVMBOX_SIZE       6
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Assertions of Unity used by the tests in ../test. A failed assertion aborts the
+ * test program. TEST_CASE() registers the test with the runner in main.c */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *name;
+    void (*fn)(void);
+} host_test_case_t;
+
+void host_test_register(const char *name, void (*fn)(void));
+
+#define HOST_TEST_CONCAT2(a, b)     a##b
+#define HOST_TEST_CONCAT(a, b)      HOST_TEST_CONCAT2(a, b)
+#define HOST_TEST_FN                HOST_TEST_CONCAT(test_func_, __LINE__)
+
+#define TEST_CASE(name, tags) \
+    static void HOST_TEST_FN(void); \
+    __attribute__((constructor)) static void HOST_TEST_CONCAT(test_register_, __LINE__)(void) \
+    { \
+        host_test_register(name, HOST_TEST_FN); \
+    } \
+    static void HOST_TEST_FN(void)
+
+#define TEST_FAIL_MESSAGE(msg) do { \
+        fprintf(stderr, "%s:%d: FAIL: %s\n", __FILE__, __LINE__, msg); \
+        abort(); \
+    } while (0)
+
+/* Like in Unity, this is an if statement, it also works without a semicolon */
+#define TEST_ASSERT(cond) if (cond) {} else { TEST_FAIL_MESSAGE(#cond); }
+#define TEST_ASSERT_TRUE(cond)                  TEST_ASSERT(cond)
+#define TEST_ASSERT_FALSE(cond)                 TEST_ASSERT(!(cond))
+#define TEST_ASSERT_NULL(ptr)                   TEST_ASSERT((ptr) == NULL)
+#define TEST_ASSERT_NOT_NULL(ptr)               TEST_ASSERT((ptr) != NULL)
+
+#define TEST_ASSERT_EQUAL(expected, actual) do { \
+        long long _e = (long long) (expected), _a = (long long) (actual); \
+        if (_e != _a) { \
+            fprintf(stderr, "Expected %lld Was %lld\n", _e, _a); \
+            TEST_FAIL_MESSAGE(#expected " == " #actual); \
+        } \
+    } while (0)
+#define TEST_ASSERT_EQUAL_INT(expected, actual)     TEST_ASSERT_EQUAL(expected, actual)
+#define TEST_ASSERT_EQUAL_HEX8(expected, actual)    TEST_ASSERT_EQUAL((uint8_t) (expected), (uint8_t) (actual))
+#define TEST_ASSERT_EQUAL_HEX32(expected, actual)   TEST_ASSERT_EQUAL((uint32_t) (expected), (uint32_t) (actual))
+#define TEST_ESP_OK(rc)                             TEST_ASSERT_EQUAL(0, rc)
+
+#define TEST_ASSERT_GREATER_THAN(threshold, actual)     TEST_ASSERT((actual) > (threshold))
+#define TEST_ASSERT_GREATER_OR_EQUAL(threshold, actual) TEST_ASSERT((actual) >= (threshold))
+#define TEST_ASSERT_LESS_THAN(threshold, actual)        TEST_ASSERT((actual) < (threshold))
+#define TEST_ASSERT_LESS_OR_EQUAL(threshold, actual)    TEST_ASSERT((actual) <= (threshold))
+
+#define TEST_ASSERT_EQUAL_STRING(expected, actual)      TEST_ASSERT(strcmp((expected), (actual)) == 0)
+#define TEST_ASSERT_EQUAL_MEMORY(expected, actual, len) TEST_ASSERT(memcmp((expected), (actual), (len)) == 0)
+#define TEST_ASSERT_EACH_EQUAL_HEX8(expected, actual, num) do { \
+        for (size_t _i = 0; _i < (size_t) (num); _i++) { \
+            TEST_ASSERT_EQUAL_HEX8(expected, ((const uint8_t *) (actual))[_i]); \
+        } \
+    } while (0)
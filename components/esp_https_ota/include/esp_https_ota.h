@@ -17,6 +17,18 @@ extern "C" {
 typedef void *esp_https_ota_handle_t;
 typedef esp_err_t(*http_client_init_cb_t)(esp_http_client_handle_t);
 
+/**
+ * @brief Time spent in each stage of the OTA process
+ *
+ * Compare `http_read_time_us` with `flash_write_time_us` to see if the update is bound by the network or by flash.
+ */
+typedef struct {
+    int64_t http_read_time_us;      /*!< Time spent receiving image data from the server */
+    int64_t flash_write_time_us;    /*!< Time spent erasing and writing flash */
+    int64_t read_wait_time_us;      /*!< Pipelined write only: time HTTP receive waited for a free buffer (flash bound) */
+    int64_t write_idle_time_us;     /*!< Pipelined write only: time the writer task waited for data (network bound) */
+} esp_https_ota_stats_t;
+
 #if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
 typedef struct {
     const char *data_in;    /*!< Pointer to data to be decrypted */
@@ -37,6 +49,8 @@ typedef struct {
     bool bulk_flash_erase;                         /*!< Erase entire flash partition during initialization. By default flash partition is erased during write operation and in chunk of 4K sector size */
     bool partial_http_download;                    /*!< Enable Firmware image to be downloaded over multiple HTTP requests */
     int max_http_request_size;                     /*!< Maximum request size for partial HTTP download */
+    bool pipelined_write;                          /*!< Write to flash from a separate task, so HTTP receive continues while flash is erased and written */
+    int pipeline_buf_count;                        /*!< Number of data buffers used by pipelined write (minimum 2). Default value (0) is 2 */
 #if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
     decrypt_cb_t decrypt_cb;                       /*!< Callback for external decryption layer */
     void *decrypt_user_ctx;                        /*!< User context for external decryption layer */
@@ -226,6 +240,21 @@ int esp_https_ota_get_image_len_read(esp_https_ota_handle_t https_ota_handle);
 *    - total bytes of image
 */
 int esp_https_ota_get_image_size(esp_https_ota_handle_t https_ota_handle);
+
+/**
+* @brief  This function returns the time spent in each stage of the OTA process so far.
+*
+* @note   With pipelined write, flash write statistics are complete only after esp_https_ota_perform()
+*         has finished, i.e. they may lag behind by the data still queued for the writer task.
+*
+* @param[in]   https_ota_handle   pointer to esp_https_ota_handle_t structure
+* @param[out]  stats              statistics of the OTA process
+*
+* @return
+*    - ESP_ERR_INVALID_ARG: Invalid argument
+*    - ESP_OK: Statistics copied to `stats`
+*/
+esp_err_t esp_https_ota_get_stats(esp_https_ota_handle_t https_ota_handle, esp_https_ota_stats_t *stats);
 #ifdef __cplusplus
 }
 #endif
@@ -10,8 +10,13 @@
 #include <esp_https_ota.h>
 #include <esp_log.h>
 #include <esp_ota_ops.h>
+#include <esp_timer.h>
 #include <errno.h>
 #include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #define IMAGE_HEADER_SIZE (1024)
 
@@ -22,8 +27,17 @@
 _Static_assert(DEFAULT_OTA_BUF_SIZE > (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t) + 1), "OTA data buffer too small");
 
 #define DEFAULT_REQUEST_SIZE (64 * 1024)
+
+#define DEFAULT_PIPELINE_BUF_COUNT (2)
 static const char *TAG = "esp_https_ota";
 
+/* Data queued for the writer task. `data` is either `buf` or the output of the decryption callback */
+typedef struct {
+    char *buf;
+    const void *data;
+    size_t len;
+} ota_write_item_t;
+
 typedef enum {
     ESP_HTTPS_OTA_INIT,
     ESP_HTTPS_OTA_BEGIN,
@@ -47,6 +61,16 @@ struct esp_https_ota_handle {
     decrypt_cb_t decrypt_cb;
     void *decrypt_user_ctx;
 #endif
+    esp_https_ota_stats_t stats;
+    portMUX_TYPE stats_lock;            /* `stats` is updated by the writer task and read by the application */
+    /* Pipelined write, `ota_upgrade_buf` is one of `pipeline_bufs` and is owned by the HTTP reader */
+    char **pipeline_bufs;
+    int pipeline_buf_count;
+    QueueHandle_t free_queue;           /* Buffers available for HTTP receive */
+    QueueHandle_t write_queue;          /* ota_write_item_t waiting to be written to flash */
+    SemaphoreHandle_t writer_done;
+    TaskHandle_t writer_task;
+    volatile esp_err_t write_err;       /* First error of the writer task */
 };
 
 typedef struct esp_https_ota_handle esp_https_ota_t;
@@ -189,22 +213,163 @@ static void esp_https_ota_decrypt_cb_free_buf(void *buffer)
 }
 #endif // CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
 
+static void _ota_stats_add(esp_https_ota_t *https_ota_handle, int64_t *counter, int64_t start)
+{
+    int64_t elapsed = esp_timer_get_time() - start;
+    portENTER_CRITICAL(&https_ota_handle->stats_lock);
+    *counter += elapsed;
+    portEXIT_CRITICAL(&https_ota_handle->stats_lock);
+}
+
+static int _http_read(esp_https_ota_t *https_ota_handle, char *buffer, int len)
+{
+    int64_t start = esp_timer_get_time();
+    int data_read = esp_http_client_read(https_ota_handle->http_client, buffer, len);
+    _ota_stats_add(https_ota_handle, &https_ota_handle->stats.http_read_time_us, start);
+    return data_read;
+}
+
+static esp_err_t _ota_flash_write(esp_https_ota_t *https_ota_handle, const void *buffer, size_t buf_len)
+{
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_ota_write(https_ota_handle->update_handle, buffer, buf_len);
+    _ota_stats_add(https_ota_handle, &https_ota_handle->stats.flash_write_time_us, start);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%x", err);
+    }
+#if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
+    esp_https_ota_decrypt_cb_free_buf((void *) buffer);
+#endif
+    return err;
+}
+
+static void _ota_writer_task(void *arg)
+{
+    esp_https_ota_t *https_ota_handle = (esp_https_ota_t *)arg;
+    ota_write_item_t item;
+
+    while (1) {
+        int64_t start = esp_timer_get_time();
+        xQueueReceive(https_ota_handle->write_queue, &item, portMAX_DELAY);
+        if (item.buf == NULL) {
+            break;
+        }
+        _ota_stats_add(https_ota_handle, &https_ota_handle->stats.write_idle_time_us, start);
+        if (https_ota_handle->write_err == ESP_OK) {
+            esp_err_t err = _ota_flash_write(https_ota_handle, item.data, item.len);
+            if (err != ESP_OK) {
+                https_ota_handle->write_err = err;
+            }
+        } else {
+            /* Keep draining the queue, the error is reported to the reader */
+#if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
+            esp_https_ota_decrypt_cb_free_buf((void *) item.data);
+#endif
+        }
+        xQueueSend(https_ota_handle->free_queue, &item.buf, portMAX_DELAY);
+    }
+    xSemaphoreGive(https_ota_handle->writer_done);
+    vTaskDelete(NULL);
+}
+
+/* Hand the current buffer over to the writer task and continue receiving into a free one */
+static esp_err_t _ota_queue_write(esp_https_ota_t *https_ota_handle, const void *buffer, size_t buf_len)
+{
+    if (https_ota_handle->write_err != ESP_OK) {
+#if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
+        esp_https_ota_decrypt_cb_free_buf((void *) buffer);
+#endif
+        return https_ota_handle->write_err;
+    }
+    ota_write_item_t item = {
+        .buf = https_ota_handle->ota_upgrade_buf,
+        .data = buffer,
+        .len = buf_len,
+    };
+    xQueueSend(https_ota_handle->write_queue, &item, portMAX_DELAY);
+    int64_t start = esp_timer_get_time();
+    xQueueReceive(https_ota_handle->free_queue, &https_ota_handle->ota_upgrade_buf, portMAX_DELAY);
+    _ota_stats_add(https_ota_handle, &https_ota_handle->stats.read_wait_time_us, start);
+    return ESP_OK;
+}
+
+/* Wait until all queued data is written, returns the first write error */
+static esp_err_t _ota_writer_stop(esp_https_ota_t *https_ota_handle)
+{
+    if (https_ota_handle->writer_task != NULL) {
+        ota_write_item_t item = { 0 };
+        xQueueSend(https_ota_handle->write_queue, &item, portMAX_DELAY);
+        xSemaphoreTake(https_ota_handle->writer_done, portMAX_DELAY);
+        https_ota_handle->writer_task = NULL;
+    }
+    return https_ota_handle->write_err;
+}
+
+static esp_err_t _ota_pipeline_init(esp_https_ota_t *https_ota_handle, int buf_count, int buf_size)
+{
+    https_ota_handle->pipeline_bufs = calloc(buf_count, sizeof(char *));
+    if (https_ota_handle->pipeline_bufs == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    https_ota_handle->pipeline_buf_count = buf_count;
+    for (int i = 0; i < buf_count; i++) {
+        https_ota_handle->pipeline_bufs[i] = (char *)malloc(buf_size);
+        if (https_ota_handle->pipeline_bufs[i] == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    https_ota_handle->free_queue = xQueueCreate(buf_count, sizeof(char *));
+    https_ota_handle->write_queue = xQueueCreate(buf_count, sizeof(ota_write_item_t));
+    https_ota_handle->writer_done = xSemaphoreCreateBinary();
+    if (https_ota_handle->free_queue == NULL || https_ota_handle->write_queue == NULL || https_ota_handle->writer_done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    https_ota_handle->ota_upgrade_buf = https_ota_handle->pipeline_bufs[0];
+    for (int i = 1; i < buf_count; i++) {
+        xQueueSend(https_ota_handle->free_queue, &https_ota_handle->pipeline_bufs[i], 0);
+    }
+    return ESP_OK;
+}
+
+static void _ota_free_buffers(esp_https_ota_t *https_ota_handle)
+{
+    if (https_ota_handle->pipeline_bufs) {
+        for (int i = 0; i < https_ota_handle->pipeline_buf_count; i++) {
+            free(https_ota_handle->pipeline_bufs[i]);
+        }
+        free(https_ota_handle->pipeline_bufs);
+        https_ota_handle->pipeline_bufs = NULL;
+    } else if (https_ota_handle->ota_upgrade_buf) {
+        free(https_ota_handle->ota_upgrade_buf);
+    }
+    https_ota_handle->ota_upgrade_buf = NULL;
+    if (https_ota_handle->free_queue) {
+        vQueueDelete(https_ota_handle->free_queue);
+    }
+    if (https_ota_handle->write_queue) {
+        vQueueDelete(https_ota_handle->write_queue);
+    }
+    if (https_ota_handle->writer_done) {
+        vSemaphoreDelete(https_ota_handle->writer_done);
+    }
+}
+
 static esp_err_t _ota_write(esp_https_ota_t *https_ota_handle, const void *buffer, size_t buf_len)
 {
     if (buffer == NULL || https_ota_handle == NULL) {
         return ESP_FAIL;
     }
-    esp_err_t err = esp_ota_write(https_ota_handle->update_handle, buffer, buf_len);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%x", err);
+    esp_err_t err;
+    if (https_ota_handle->writer_task != NULL) {
+        err = _ota_queue_write(https_ota_handle, buffer, buf_len);
     } else {
+        err = _ota_flash_write(https_ota_handle, buffer, buf_len);
+    }
+    if (err == ESP_OK) {
         https_ota_handle->binary_file_len += buf_len;
         ESP_LOGD(TAG, "Written image length %d", https_ota_handle->binary_file_len);
         err = ESP_ERR_HTTPS_OTA_IN_PROGRESS;
     }
-#if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
-    esp_https_ota_decrypt_cb_free_buf((void *) buffer);
-#endif
     return err;
 }
 
@@ -242,6 +407,7 @@ esp_err_t esp_https_ota_begin(const esp_https_ota_config_t *ota_config, esp_http
         *handle = NULL;
         return ESP_ERR_NO_MEM;
     }
+    portMUX_INITIALIZE(&https_ota_handle->stats_lock);
 
     https_ota_handle->partial_http_download = ota_config->partial_http_download;
     https_ota_handle->max_http_request_size = (ota_config->max_http_request_size == 0) ? DEFAULT_REQUEST_SIZE : ota_config->max_http_request_size;
@@ -316,11 +482,25 @@ esp_err_t esp_https_ota_begin(const esp_https_ota_config_t *ota_config, esp_http
         https_ota_handle->update_partition->subtype, https_ota_handle->update_partition->address);
 
     const int alloc_size = MAX(ota_config->http_config->buffer_size, DEFAULT_OTA_BUF_SIZE);
-    https_ota_handle->ota_upgrade_buf = (char *)malloc(alloc_size);
-    if (!https_ota_handle->ota_upgrade_buf) {
-        ESP_LOGE(TAG, "Couldn't allocate memory to upgrade data buffer");
-        err = ESP_ERR_NO_MEM;
-        goto http_cleanup;
+    if (ota_config->pipelined_write) {
+        const int buf_count = (ota_config->pipeline_buf_count == 0) ? DEFAULT_PIPELINE_BUF_COUNT : ota_config->pipeline_buf_count;
+        if (buf_count < 2) {
+            ESP_LOGE(TAG, "Pipelined write needs at least 2 buffers");
+            err = ESP_ERR_INVALID_ARG;
+            goto http_cleanup;
+        }
+        err = _ota_pipeline_init(https_ota_handle, buf_count, alloc_size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Couldn't allocate memory to upgrade data buffer");
+            goto http_cleanup;
+        }
+    } else {
+        https_ota_handle->ota_upgrade_buf = (char *)malloc(alloc_size);
+        if (!https_ota_handle->ota_upgrade_buf) {
+            ESP_LOGE(TAG, "Couldn't allocate memory to upgrade data buffer");
+            err = ESP_ERR_NO_MEM;
+            goto http_cleanup;
+        }
     }
 #if CONFIG_ESP_HTTPS_OTA_DECRYPT_CB
     if (ota_config->decrypt_cb == NULL) {
@@ -338,6 +518,7 @@ esp_err_t esp_https_ota_begin(const esp_https_ota_config_t *ota_config, esp_http
     return ESP_OK;
 
 http_cleanup:
+    _ota_free_buffers(https_ota_handle);
     _http_cleanup(https_ota_handle->http_client);
 failure:
     free(https_ota_handle);
@@ -358,9 +539,7 @@ static esp_err_t read_header(esp_https_ota_t *handle)
      * are not sent in a single packet.
      */
     while (data_read_size > 0 && !esp_http_client_is_complete_data_received(handle->http_client)) {
-        data_read = esp_http_client_read(handle->http_client,
-                                          (handle->ota_upgrade_buf + bytes_read),
-                                          data_read_size);
+        data_read = _http_read(handle, (handle->ota_upgrade_buf + bytes_read), data_read_size);
         if (data_read < 0) {
             if (data_read == -ESP_ERR_HTTP_EAGAIN) {
                 ESP_LOGD(TAG, "ESP_ERR_HTTP_EAGAIN invoked: Call timed out before data was ready");
@@ -444,6 +623,13 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
                 ESP_LOGE(TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
                 return err;
             }
+            if (handle->pipeline_bufs != NULL) {
+                if (xTaskCreate(_ota_writer_task, "ota_writer", CONFIG_ESP_HTTPS_OTA_WRITER_TASK_STACK_SIZE,
+                                handle, uxTaskPriorityGet(NULL), &handle->writer_task) != pdPASS) {
+                    ESP_LOGW(TAG, "Couldn't create writer task, writing to flash synchronously");
+                    handle->writer_task = NULL;
+                }
+            }
             handle->state = ESP_HTTPS_OTA_IN_PROGRESS;
             /* In case `esp_https_ota_read_img_desc` was invoked first,
                then the image data read there should be written to OTA partition
@@ -483,9 +669,7 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
             }
             return _ota_write(handle, data_buf, binary_file_len);
         case ESP_HTTPS_OTA_IN_PROGRESS:
-            data_read = esp_http_client_read(handle->http_client,
-                                             handle->ota_upgrade_buf,
-                                             handle->ota_upgrade_buf_size);
+            data_read = _http_read(handle, handle->ota_upgrade_buf, handle->ota_upgrade_buf_size);
             if (data_read == 0) {
                 /*
                  *  esp_http_client_is_complete_data_received is added to check whether
@@ -582,12 +766,15 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle)
     switch (handle->state) {
         case ESP_HTTPS_OTA_SUCCESS:
         case ESP_HTTPS_OTA_IN_PROGRESS:
-            err = esp_ota_end(handle->update_handle);
+            err = _ota_writer_stop(handle);
+            if (err == ESP_OK) {
+                err = esp_ota_end(handle->update_handle);
+            } else {
+                esp_ota_abort(handle->update_handle);
+            }
             /* falls through */
         case ESP_HTTPS_OTA_BEGIN:
-            if (handle->ota_upgrade_buf) {
-                free(handle->ota_upgrade_buf);
-            }
+            _ota_free_buffers(handle);
             if (handle->http_client) {
                 _http_cleanup(handle->http_client);
             }
@@ -622,12 +809,11 @@ esp_err_t esp_https_ota_abort(esp_https_ota_handle_t https_ota_handle)
     switch (handle->state) {
         case ESP_HTTPS_OTA_SUCCESS:
         case ESP_HTTPS_OTA_IN_PROGRESS:
+            _ota_writer_stop(handle);
             err = esp_ota_abort(handle->update_handle);
             /* falls through */
         case ESP_HTTPS_OTA_BEGIN:
-            if (handle->ota_upgrade_buf) {
-                free(handle->ota_upgrade_buf);
-            }
+            _ota_free_buffers(handle);
             if (handle->http_client) {
                 _http_cleanup(handle->http_client);
             }
@@ -665,6 +851,18 @@ int esp_https_ota_get_image_size(esp_https_ota_handle_t https_ota_handle)
     return handle->image_length;
 }
 
+esp_err_t esp_https_ota_get_stats(esp_https_ota_handle_t https_ota_handle, esp_https_ota_stats_t *stats)
+{
+    esp_https_ota_t *handle = (esp_https_ota_t *)https_ota_handle;
+    if (handle == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&handle->stats_lock);
+    memcpy(stats, &handle->stats, sizeof(esp_https_ota_stats_t));
+    portEXIT_CRITICAL(&handle->stats_lock);
+    return ESP_OK;
+}
+
 esp_err_t esp_https_ota(const esp_https_ota_config_t *ota_config)
 {
     if (ota_config == NULL || ota_config->http_config == NULL) {
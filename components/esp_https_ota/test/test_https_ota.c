@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_partition.h>
+#include <esp_ota_ops.h>
+#include <esp_image_format.h>
+#include <esp_http_server.h>
+#include <esp_https_ota.h>
+
+#include "unity.h"
+#include "test_utils.h"
+
+/* The image is served over 127.0.0.1 by esp_http_server, so these tests need the
+ * "esp_https_ota" unit-test-app config (two OTA partitions, HTTP allowed) */
+
+#define OTA_TEST_PORT           8080
+#define OTA_TEST_CHUNK_SIZE     4096
+#define OTA_TEST_OVERSIZE       (64 * 1024)
+
+static const esp_partition_t *s_running;
+static uint32_t s_image_len;
+
+static esp_err_t ota_image_handler(httpd_req_t *req)
+{
+    return httpd_resp_send_partition(req, s_running, 0, s_image_len);
+}
+
+/* Starts with the header of the running image, so that it is accepted by esp_https_ota,
+ * but is larger than the update partition. The error comes from the flash write */
+static esp_err_t ota_oversize_handler(httpd_req_t *req)
+{
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    char *chunk = malloc(OTA_TEST_CHUNK_SIZE);
+    if (chunk == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = esp_partition_read(s_running, 0, chunk, OTA_TEST_CHUNK_SIZE);
+    for (size_t sent = 0; ret == ESP_OK && sent < update->size + OTA_TEST_OVERSIZE; sent += OTA_TEST_CHUNK_SIZE) {
+        ret = httpd_resp_send_chunk(req, chunk, OTA_TEST_CHUNK_SIZE);
+        memset(chunk, 0xA5, OTA_TEST_CHUNK_SIZE);
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    free(chunk);
+    return ret;
+}
+
+static httpd_handle_t ota_test_start_server(void)
+{
+    s_running = esp_ota_get_running_partition();
+    TEST_ASSERT_NOT_NULL(s_running);
+    esp_partition_pos_t pos = { .offset = s_running->address, .size = s_running->size };
+    esp_image_metadata_t metadata;
+    TEST_ESP_OK(esp_image_get_metadata(&pos, &metadata));
+    s_image_len = metadata.image_len;
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = OTA_TEST_PORT;
+    TEST_ESP_OK(httpd_start(&hd, &config));
+    httpd_uri_t image = { .uri = "/image.bin", .method = HTTP_GET, .handler = ota_image_handler };
+    httpd_uri_t oversize = { .uri = "/oversize.bin", .method = HTTP_GET, .handler = ota_oversize_handler };
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &image));
+    TEST_ESP_OK(httpd_register_uri_handler(hd, &oversize));
+    return hd;
+}
+
+/* Downloads the image and aborts the update, so the boot partition is not changed.
+ * Statistics are read while the writer task updates them. */
+static esp_err_t ota_test_run(const char *uri, bool pipelined, esp_https_ota_stats_t *stats)
+{
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", OTA_TEST_PORT, uri);
+    esp_http_client_config_t http_config = {
+        .url = url,
+        .timeout_ms = 5000,
+    };
+    esp_https_ota_config_t ota_config = {
+        .http_config = &http_config,
+        .pipelined_write = pipelined,
+    };
+    esp_https_ota_handle_t handle = NULL;
+    TEST_ESP_OK(esp_https_ota_begin(&ota_config, &handle));
+
+    esp_err_t err;
+    do {
+        err = esp_https_ota_perform(handle);
+        TEST_ESP_OK(esp_https_ota_get_stats(handle, stats));
+    } while (err == ESP_ERR_HTTPS_OTA_IN_PROGRESS);
+
+    /* Waits for the writer task, so all queued data is in flash afterwards */
+    TEST_ESP_OK(esp_https_ota_abort(handle));
+    return err;
+}
+
+static void ota_test_check_image(const esp_partition_t *update)
+{
+    uint8_t *expected = malloc(OTA_TEST_CHUNK_SIZE);
+    uint8_t *actual = malloc(OTA_TEST_CHUNK_SIZE);
+    TEST_ASSERT_NOT_NULL(expected);
+    TEST_ASSERT_NOT_NULL(actual);
+    for (uint32_t offset = 0; offset < s_image_len; offset += OTA_TEST_CHUNK_SIZE) {
+        size_t len = MIN(OTA_TEST_CHUNK_SIZE, s_image_len - offset);
+        TEST_ESP_OK(esp_partition_read(s_running, offset, expected, len));
+        TEST_ESP_OK(esp_partition_read(update, offset, actual, len));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual, len);
+    }
+    free(expected);
+    free(actual);
+}
+
+TEST_CASE("Pipelined write stores the whole image and records the time of each stage", "[esp_https_ota]")
+{
+    test_case_uses_tcpip();
+    httpd_handle_t hd = ota_test_start_server();
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    TEST_ASSERT_NOT_NULL(update);
+
+    esp_https_ota_stats_t stats;
+    TEST_ESP_OK(ota_test_run("/image.bin", true, &stats));
+    TEST_ASSERT_GREATER_THAN(0, stats.http_read_time_us);
+    ota_test_check_image(update);
+
+    /* Same image written synchronously, the pipeline counters stay at zero */
+    TEST_ESP_OK(esp_partition_erase_range(update, 0, update->size));
+    TEST_ESP_OK(ota_test_run("/image.bin", false, &stats));
+    TEST_ASSERT_GREATER_THAN(0, stats.http_read_time_us);
+    TEST_ASSERT_GREATER_THAN(0, stats.flash_write_time_us);
+    TEST_ASSERT_EQUAL(0, stats.read_wait_time_us);
+    TEST_ASSERT_EQUAL(0, stats.write_idle_time_us);
+    ota_test_check_image(update);
+
+    TEST_ESP_OK(httpd_stop(hd));
+}
+
+TEST_CASE("Pipelined write returns the flash write error from esp_https_ota_perform", "[esp_https_ota]")
+{
+    test_case_uses_tcpip();
+    httpd_handle_t hd = ota_test_start_server();
+
+    esp_https_ota_stats_t stats;
+    /* The writer task fails once the partition is full, the reader has to stop with its error
+     * instead of downloading the rest of the image */
+    TEST_ASSERT_EQUAL_HEX32(ESP_ERR_INVALID_SIZE, ota_test_run("/oversize.bin", true, &stats));
+    TEST_ASSERT_GREATER_THAN(0, stats.flash_write_time_us);
+
+    /* Same error without the writer task */
+    TEST_ASSERT_EQUAL_HEX32(ESP_ERR_INVALID_SIZE, ota_test_run("/oversize.bin", false, &stats));
+
+    TEST_ESP_OK(httpd_stop(hd));
+}
@@ -91,6 +91,9 @@ struct httpd_ssl_config {
     /** Enable tls session tickets */
     bool session_tickets;
 
+    /** Enable the tls session cache (needs CONFIG_ESP_TLS_SERVER_SESSION_CACHE) */
+    bool session_cache;
+
     /** Enable secure element for server session */
     bool use_secure_element;
 
@@ -143,6 +146,7 @@ typedef struct httpd_ssl_config httpd_ssl_config_t;
     .port_secure = 443,                           \
     .port_insecure = 80,                          \
     .session_tickets = false,                     \
+    .session_cache = false,                       \
     .user_cb = NULL,                              \
 }
 
@@ -188,6 +188,7 @@ static void free_secure_context(void *ctx)
         free((void *)cfg->serverkey_buf);
     }
     esp_tls_cfg_server_session_tickets_free(cfg);
+    esp_tls_cfg_server_session_cache_free(cfg);
     free(cfg);
     free(ssl_ctx);
 }
@@ -207,9 +208,14 @@ static httpd_ssl_ctx_t *create_secure_context(const struct httpd_ssl_config *con
     if (config->session_tickets) {
         if ( esp_tls_cfg_server_session_tickets_init(cfg) != ESP_OK ) {
             ESP_LOGE(TAG, "Failed to init session ticket support");
-            free(ssl_ctx);
-            free(cfg);
-            return NULL;
+            goto fail;
+        }
+    }
+
+    if (config->session_cache) {
+        if (esp_tls_cfg_server_session_cache_init(cfg) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to init session cache support");
+            goto fail;
         }
     }
 
@@ -221,9 +227,7 @@ static httpd_ssl_ctx_t *create_secure_context(const struct httpd_ssl_config *con
         cfg->cacert_buf = (unsigned char *)malloc(config->cacert_len);
         if (!cfg->cacert_buf) {
             ESP_LOGE(TAG, "Could not allocate memory");
-            free(cfg);
-            free(ssl_ctx);
-            return NULL;
+            goto fail;
         }
         memcpy((char *)cfg->cacert_buf, config->cacert_pem, config->cacert_len);
         cfg->cacert_bytes = config->cacert_len;
@@ -233,10 +237,7 @@ static httpd_ssl_ctx_t *create_secure_context(const struct httpd_ssl_config *con
     cfg->servercert_buf = (unsigned char *)malloc(config->servercert_len);
     if (!cfg->servercert_buf) {
         ESP_LOGE(TAG, "Could not allocate memory");
-        free((void *)cfg->cacert_buf);
-        free(cfg);
-        free(ssl_ctx);
-        return NULL;
+        goto fail;
     }
     memcpy((char *)cfg->servercert_buf, config->servercert, config->servercert_len);
     cfg->servercert_bytes = config->servercert_len;
@@ -247,11 +248,7 @@ static httpd_ssl_ctx_t *create_secure_context(const struct httpd_ssl_config *con
         cfg->serverkey_buf = (unsigned char *)malloc(config->prvtkey_len);
         if (!cfg->serverkey_buf) {
             ESP_LOGE(TAG, "Could not allocate memory");
-            free((void *)cfg->servercert_buf);
-            free((void *)cfg->cacert_buf);
-            free(cfg);
-            free(ssl_ctx);
-            return NULL;
+            goto fail;
         }
     }
 
@@ -259,6 +256,15 @@ static httpd_ssl_ctx_t *create_secure_context(const struct httpd_ssl_config *con
     cfg->serverkey_bytes = config->prvtkey_len;
 
     return ssl_ctx;
+
+fail:
+    free((void *)cfg->servercert_buf);
+    free((void *)cfg->cacert_buf);
+    esp_tls_cfg_server_session_cache_free(cfg);
+    esp_tls_cfg_server_session_tickets_free(cfg);
+    free(cfg);
+    free(ssl_ctx);
+    return NULL;
 }
 
 /** Start the server */
@@ -14,6 +14,7 @@
 #include "esp_netif.h"
 #include "esp_netif_private.h"
 #include "esp_random.h"
+#include "freertos/FreeRTOS.h"
 
 #if defined(CONFIG_ESP_NETIF_TCPIP_LWIP)
 
@@ -110,9 +111,102 @@ static void esp_netif_internal_dhcpc_cb(struct netif *netif);
 #if LWIP_IPV6
 static void esp_netif_internal_nd6_cb(struct netif *p_netif, uint8_t ip_index);
 #endif /* LWIP_IPV6 */
+static esp_netif_t* esp_netif_is_active(esp_netif_t *arg);
+
+/*
+ * Snapshots of the interface state, so that the frequently used getters (esp_netif_get_ip_info(),
+ * esp_netif_is_netif_up()) don't have to wait for the lwip task. The DNS servers are not part of it,
+ * as lwip changes them (e.g. on DHCP renew or from RDNSS) without notifying esp-netif. Writers serialize on the spinlock and make the sequence counter odd while
+ * copying, readers retry until they see the same even counter before and after the copy.
+ */
+static portMUX_TYPE s_snapshot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline void snapshot_write_begin(atomic_uint *seq)
+{
+    portENTER_CRITICAL_SAFE(&s_snapshot_lock);
+    atomic_fetch_add_explicit(seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void snapshot_write_end(atomic_uint *seq)
+{
+    atomic_fetch_add_explicit(seq, 1, memory_order_release);
+    portEXIT_CRITICAL_SAFE(&s_snapshot_lock);
+}
+
+static inline unsigned snapshot_read_begin(atomic_uint *seq)
+{
+    unsigned s;
+    // the writer can't be preempted while the counter is odd, so it's a short wait for the other core
+    while ((s = atomic_load_explicit(seq, memory_order_acquire)) & 1) {
+    }
+    return s;
+}
+
+static inline bool snapshot_read_retry(atomic_uint *seq, unsigned s)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(seq, memory_order_relaxed) != s;
+}
+
+/**
+ * @brief Reads the current state of the lwip netif, to be used from lwip task context
+ */
+static bool esp_netif_is_netif_up_internal(esp_netif_t *esp_netif)
+{
+    if (esp_netif != NULL && esp_netif->lwip_netif != NULL) {
+        if (_IS_NETIF_ANY_POINT2POINT_TYPE(esp_netif)) {
+            // ppp implementation uses netif_set_link_up/down to update link state
+            return netif_is_link_up(esp_netif->lwip_netif);
+        }
+        // esp-netif handlers and drivers take care to set_netif_up/down on link state update
+        return netif_is_up(esp_netif->lwip_netif);
+    } else {
+        return false;
+    }
+}
+
+/**
+ * @brief Reads the current addresses of the lwip netif, to be used from lwip task context
+ */
+static void esp_netif_get_ip_info_internal(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info)
+{
+    struct netif *p_netif = esp_netif->lwip_netif;
+
+    if (p_netif != NULL && netif_is_up(p_netif)) {
+        ip4_addr_set(&ip_info->ip, ip_2_ip4(&p_netif->ip_addr));
+        ip4_addr_set(&ip_info->netmask, ip_2_ip4(&p_netif->netmask));
+        ip4_addr_set(&ip_info->gw, ip_2_ip4(&p_netif->gw));
+        return;
+    }
+    memcpy(ip_info, esp_netif->ip_info, sizeof(esp_netif_ip_info_t));
+}
+
+/**
+ * @brief Refreshes the snapshot of the interface, if not NULL
+ */
+static void esp_netif_update_snapshot(esp_netif_t *esp_netif)
+{
+    if (esp_netif == NULL) {
+        return;
+    }
+    esp_netif_ip_info_t ip_info;
+    esp_netif_get_ip_info_internal(esp_netif, &ip_info);
+    bool is_up = esp_netif_is_netif_up_internal(esp_netif);
+
+    snapshot_write_begin(&esp_netif->snapshot.seq);
+    esp_netif->snapshot.ip_info = ip_info;
+    esp_netif->snapshot.is_up = is_up;
+    snapshot_write_end(&esp_netif->snapshot.seq);
+}
 
 static void netif_callback_fn(struct netif* netif, netif_nsc_reason_t reason, const netif_ext_callback_args_t* args)
 {
+    // refresh before the handlers below post their events, so that the event handlers see the new state;
+    // netifs not owned by esp-netif (or already being destroyed) are not listed
+    if (!(reason & LWIP_NSC_NETIF_REMOVED)) {
+        esp_netif_update_snapshot(esp_netif_is_active(esp_netif_get_handle_from_netif_impl(netif)));
+    }
     if (reason & DHCP_CB_CHANGE) {
         esp_netif_internal_dhcpc_cb(netif);
     }
@@ -192,6 +286,8 @@ static void esp_netif_api_cb(void *api_msg)
     }
 
     msg->ret = msg->api_fn(msg);
+    // the handle might be already destroyed (e.g. updating default netif from esp_netif_destroy())
+    esp_netif_update_snapshot(esp_netif_is_active(msg->esp_netif));
     ESP_LOGD(TAG, "call api in lwip: ret=0x%x, give sem", msg->ret);
     sys_sem_signal(&api_sync_sem);
 
@@ -219,7 +315,9 @@ static inline esp_err_t esp_netif_lwip_ipc_call(esp_netif_api_fn fn, esp_netif_t
     }
 #endif /* !LWIP_TCPIP_CORE_LOCKING */
     ESP_LOGD(TAG, "check: local, if=%p fn=%p\n", netif, fn);
-    return fn(&msg);
+    esp_err_t ret = fn(&msg);
+    esp_netif_update_snapshot(esp_netif_is_active(netif));
+    return ret;
 }
 
 /**
@@ -288,10 +386,10 @@ static esp_err_t esp_netif_update_default_netif_lwip(esp_netif_api_msg_t *msg)
         {
             // check if previously default interface hasn't been destroyed in the meantime
             s_last_default_esp_netif = esp_netif_is_active(s_last_default_esp_netif);
-            if (s_last_default_esp_netif && esp_netif_is_netif_up(s_last_default_esp_netif)
+            if (s_last_default_esp_netif && esp_netif_is_netif_up_internal(s_last_default_esp_netif)
                 && (s_last_default_esp_netif->route_prio > esp_netif->route_prio)) {
                 esp_netif_set_default_netif_internal(s_last_default_esp_netif);
-            } else if (esp_netif_is_netif_up(esp_netif)) {
+            } else if (esp_netif_is_netif_up_internal(esp_netif)) {
                 s_last_default_esp_netif = esp_netif;
                 esp_netif_set_default_netif_internal(s_last_default_esp_netif);
             }
@@ -305,8 +403,8 @@ static esp_err_t esp_netif_update_default_netif_lwip(esp_netif_api_msg_t *msg)
             esp_netif_list_lock();
             esp_netif_t *netif = esp_netif_next_unsafe(NULL);
             while (netif) {
-                if (esp_netif_is_netif_up(netif)) {
-                    if (s_last_default_esp_netif && esp_netif_is_netif_up(s_last_default_esp_netif)) {
+                if (esp_netif_is_netif_up_internal(netif)) {
+                    if (s_last_default_esp_netif && esp_netif_is_netif_up_internal(s_last_default_esp_netif)) {
                         if (netif->route_prio > s_last_default_esp_netif->route_prio) {
                             s_last_default_esp_netif = netif;
                         } // else not needed, as the s_last_default_esp_netif is correct
@@ -318,7 +416,7 @@ static esp_err_t esp_netif_update_default_netif_lwip(esp_netif_api_msg_t *msg)
                 netif = esp_netif_next_unsafe(netif);
             }
             esp_netif_list_unlock();
-            if (s_last_default_esp_netif && esp_netif_is_netif_up(s_last_default_esp_netif)) {
+            if (s_last_default_esp_netif && esp_netif_is_netif_up_internal(s_last_default_esp_netif)) {
                 esp_netif_set_default_netif_internal(s_last_default_esp_netif);
             }
         }
@@ -688,6 +786,7 @@ esp_netif_t *esp_netif_new(const esp_netif_config_t *esp_netif_config)
         esp_netif_destroy(esp_netif);
         return NULL;
     }
+    esp_netif_update_snapshot(esp_netif);
 
     set_lwip_netif_callback();
 
@@ -854,7 +953,7 @@ esp_err_t esp_netif_get_mac(esp_netif_t *esp_netif, uint8_t mac[])
     if (_IS_NETIF_ANY_POINT2POINT_TYPE(esp_netif)) {
         return ESP_ERR_NOT_SUPPORTED;
     }
-    if (esp_netif_is_netif_up(esp_netif)) {
+    if (esp_netif_is_netif_up_internal(esp_netif)) {
         memcpy(mac, esp_netif->lwip_netif->hwaddr, NETIF_MAX_HWADDR_LEN);
         return ESP_OK;
     }
@@ -1533,16 +1632,16 @@ bool esp_netif_is_netif_up(esp_netif_t *esp_netif)
 {
     ESP_LOGV(TAG, "%s esp_netif:%p", __func__, esp_netif);
 
-    if (esp_netif != NULL && esp_netif->lwip_netif != NULL) {
-        if (_IS_NETIF_ANY_POINT2POINT_TYPE(esp_netif)) {
-            // ppp implementation uses netif_set_link_up/down to update link state
-            return netif_is_link_up(esp_netif->lwip_netif);
-        }
-        // esp-netif handlers and drivers take care to set_netif_up/down on link state update
-        return netif_is_up(esp_netif->lwip_netif);
-    } else {
+    if (esp_netif == NULL) {
         return false;
     }
+    bool is_up;
+    unsigned seq;
+    do {
+        seq = snapshot_read_begin(&esp_netif->snapshot.seq);
+        is_up = esp_netif->snapshot.is_up;
+    } while (snapshot_read_retry(&esp_netif->snapshot.seq, seq));
+    return is_up;
 }
 
 esp_err_t esp_netif_get_old_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info)
@@ -1564,17 +1663,11 @@ esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_
         return ESP_ERR_INVALID_ARG;
     }
 
-    struct netif *p_netif = esp_netif->lwip_netif;
-
-    if (p_netif != NULL && netif_is_up(p_netif)) {
-        ip4_addr_set(&ip_info->ip, ip_2_ip4(&p_netif->ip_addr));
-        ip4_addr_set(&ip_info->netmask, ip_2_ip4(&p_netif->netmask));
-        ip4_addr_set(&ip_info->gw, ip_2_ip4(&p_netif->gw));
-
-        return ESP_OK;
-    }
-
-    memcpy(ip_info, esp_netif->ip_info, sizeof(esp_netif_ip_info_t));
+    unsigned seq;
+    do {
+        seq = snapshot_read_begin(&esp_netif->snapshot.seq);
+        memcpy(ip_info, &esp_netif->snapshot.ip_info, sizeof(esp_netif_ip_info_t));
+    } while (snapshot_read_retry(&esp_netif->snapshot.seq, seq));
 
     return ESP_OK;
 }
@@ -2019,7 +2112,7 @@ esp_err_t esp_netif_dhcps_option(esp_netif_t *esp_netif, esp_netif_dhcp_option_m
 
                 if (poll->enable) {
                     memset(&info, 0x00, sizeof(esp_netif_ip_info_t));
-                    esp_netif_get_ip_info(esp_netif, &info);
+                    esp_netif_get_ip_info_internal(esp_netif, &info);
 
                     softap_ip = htonl(info.ip.addr);
                     start_ip = htonl(poll->start_ip.addr);
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <stdatomic.h>
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
 #include "esp_netif_slip.h"
@@ -87,6 +88,18 @@ typedef struct netif_related_data {
     enum netif_types netif_type;
 } netif_related_data_t;
 
+/**
+ * @brief Copy of the interface state for the getters which don't enter the lwip task
+ *
+ * Written from lwip task context whenever the state might have changed, guarded by a sequence
+ * counter which is odd while an update is in progress
+ */
+typedef struct esp_netif_snapshot {
+    atomic_uint seq;
+    esp_netif_ip_info_t ip_info;
+    bool is_up;
+} esp_netif_snapshot_t;
+
 /**
  * @brief Main esp-netif container with interface related information
  */
@@ -95,6 +108,7 @@ struct esp_netif_obj {
     uint8_t mac[NETIF_MAX_HWADDR_LEN];
     esp_netif_ip_info_t* ip_info;
     esp_netif_ip_info_t* ip_info_old;
+    esp_netif_snapshot_t snapshot;
 
     // lwip netif related
     struct netif *lwip_netif;
@@ -6,6 +6,9 @@
 #include "nvs_flash.h"
 #include "esp_wifi_netif.h"
 #include "lwip/netif.h"
+#include "lwip/dns.h"
+#include "lwip/tcpip.h"
+#include "freertos/semphr.h"
 #include "esp_netif_net_stack.h"
 
 
@@ -424,3 +427,59 @@ TEST_CASE("esp_netif: test routing priority", "[esp_netif]")
         TEST_ASSERT_FALSE(esp_netif_is_netif_listed(netifs[i]));
     }
 }
+
+static void test_dns_setserver(void *ctx)
+{
+    // as lwip does on DHCP renew, without any esp-netif event
+    ip_addr_t dns = IPADDR4_INIT_BYTES(1, 0, 0, 1);
+    dns_setserver(ESP_NETIF_DNS_MAIN, &dns);
+    xSemaphoreGive((SemaphoreHandle_t)ctx);
+}
+
+TEST_CASE("esp_netif: getters follow the interface state", "[esp_netif]")
+{
+    test_case_uses_tcpip();
+    esp_netif_driver_ifconfig_t driver_config = { .handle =  (void*)1, .transmit = dummy_transmit };
+    esp_netif_inherent_config_t base_netif_config = { .if_key = "getters_if" };
+    esp_netif_config_t cfg = {  .base = &base_netif_config,
+                                .stack = ESP_NETIF_NETSTACK_DEFAULT_WIFI_STA,
+                                .driver = &driver_config };
+    esp_netif_t *esp_netif = esp_netif_new(&cfg);
+    TEST_ASSERT_NOT_NULL(esp_netif);
+    TEST_ASSERT_FALSE(esp_netif_is_netif_up(esp_netif));
+
+    esp_netif_ip_info_t ip = { .ip.addr = ESP_IP4TOADDR(192, 168, 4, 2),
+                               .netmask.addr = ESP_IP4TOADDR(255, 255, 255, 0),
+                               .gw.addr = ESP_IP4TOADDR(192, 168, 4, 1) };
+    esp_netif_ip_info_t ip_read;
+    TEST_ESP_OK(esp_netif_set_ip_info(esp_netif, &ip));
+    TEST_ESP_OK(esp_netif_get_ip_info(esp_netif, &ip_read));
+    TEST_ASSERT_EQUAL_MEMORY(&ip, &ip_read, sizeof(ip));
+
+    // link up/down updates the interface state read without entering the lwip task
+    esp_netif_action_start(esp_netif, 0, 0, 0);
+    esp_netif_action_connected(esp_netif, 0, 0, 0);
+    TEST_ASSERT_TRUE(esp_netif_is_netif_up(esp_netif));
+    TEST_ASSERT_TRUE(netif_is_up(esp_netif_get_netif_impl(esp_netif)));
+    TEST_ESP_OK(esp_netif_get_ip_info(esp_netif, &ip_read));
+    TEST_ASSERT_EQUAL_MEMORY(&ip, &ip_read, sizeof(ip));
+
+    esp_netif_dns_info_t dns = { .ip.type = ESP_IPADDR_TYPE_V4, .ip.u_addr.ip4.addr = ESP_IP4TOADDR(8, 8, 4, 4) };
+    esp_netif_dns_info_t dns_read;
+    TEST_ESP_OK(esp_netif_set_dns_info(esp_netif, ESP_NETIF_DNS_MAIN, &dns));
+    TEST_ESP_OK(esp_netif_get_dns_info(esp_netif, ESP_NETIF_DNS_MAIN, &dns_read));
+    TEST_ASSERT_EQUAL(dns.ip.u_addr.ip4.addr, dns_read.ip.u_addr.ip4.addr);
+
+    SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(done);
+    TEST_ASSERT(tcpip_callback(test_dns_setserver, done) == ERR_OK);
+    TEST_ASSERT(xSemaphoreTake(done, pdMS_TO_TICKS(1000)) == pdTRUE);
+    vSemaphoreDelete(done);
+    TEST_ESP_OK(esp_netif_get_dns_info(esp_netif, ESP_NETIF_DNS_MAIN, &dns_read));
+    TEST_ASSERT_EQUAL(ESP_IP4TOADDR(1, 0, 0, 1), dns_read.ip.u_addr.ip4.addr);
+
+    esp_netif_action_disconnected(esp_netif, 0, 0, 0);
+    TEST_ASSERT_FALSE(esp_netif_is_netif_up(esp_netif));
+    esp_netif_action_stop(esp_netif, 0, 0, 0);
+    esp_netif_destroy(esp_netif);
+}
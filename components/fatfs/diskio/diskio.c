@@ -11,13 +11,337 @@
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <sys/time.h>
+#include "sdkconfig.h"
 #include "diskio_impl.h"
 #include "ffconf.h"
 #include "ff.h"
+#include "esp_log.h"
+
+static const char* TAG = "diskio";
 
 static ff_diskio_impl_t * s_impls[FF_VOLUMES] = { NULL };
 
+#if CONFIG_FATFS_PARALLEL_FILE_ACCESS
+#include <sys/lock.h>
+/* FatFs transfers file data without the volume lock, so accesses to the drive are serialized here */
+static _lock_t s_locks[FF_VOLUMES];
+#define DISKIO_LOCK(pdrv)   _lock_acquire(&s_locks[pdrv])
+#define DISKIO_UNLOCK(pdrv) _lock_release(&s_locks[pdrv])
+#else
+#define DISKIO_LOCK(pdrv)
+#define DISKIO_UNLOCK(pdrv)
+#endif
+
+#if CONFIG_FATFS_DISKIO_CACHE
+
+#define CACHE_SECTORS       CONFIG_FATFS_DISKIO_CACHE_SECTORS
+#define CACHE_RA_SECTORS    CONFIG_FATFS_DISKIO_CACHE_READ_AHEAD_SECTORS
+
+#define CACHE_SLOT_VALID    0x01
+#define CACHE_SLOT_DIRTY    0x02
+
+typedef struct {
+    LBA_t sector;
+    uint32_t last_use;
+    uint8_t flags;
+} ff_diskio_cache_slot_t;
+
+/**
+ * Sector cache placed between FatFs and the diskio driver.
+ *
+ * Slots hold single sectors (FAT, directory entries, small reads and writes)
+ * and are replaced in LRU order. Dirty slots are written back on CTRL_SYNC or
+ * when they are evicted; consecutive dirty sectors are written with one command.
+ * Sequential reads are served from a separate read-ahead window, which is
+ * filled with one multi-sector command. The window is also used as the bounce
+ * buffer to coalesce writes, so it is invalidated by a write back.
+ */
+typedef struct {
+    UINT sector_size;
+    LBA_t sector_count;         /* 0 if unknown, read-ahead is not used then */
+    ff_diskio_cache_slot_t slots[CACHE_SECTORS];
+    BYTE* slot_data;            /* CACHE_SECTORS * sector_size bytes */
+    BYTE* ra_data;              /* CACHE_RA_SECTORS * sector_size bytes */
+    LBA_t ra_start;
+    UINT ra_count;
+    LBA_t next_sector;          /* sector following the last read, to detect sequential access */
+    uint32_t use_counter;
+    ff_diskio_cache_stats_t stats;
+} ff_diskio_cache_t;
+
+static ff_diskio_cache_t * s_caches[FF_VOLUMES] = { NULL };
+
+static void cache_delete(BYTE pdrv)
+{
+    ff_diskio_cache_t* c = s_caches[pdrv];
+    if (c) {
+        s_caches[pdrv] = NULL;
+        ff_memfree(c->slot_data);
+        ff_memfree(c->ra_data);
+        ff_memfree(c);
+    }
+}
+
+static void cache_create(BYTE pdrv)
+{
+    WORD sector_size = 0;
+    LBA_t sector_count = 0;
+    if (s_caches[pdrv] || s_impls[pdrv]->ioctl(pdrv, GET_SECTOR_SIZE, &sector_size) != RES_OK || sector_size == 0) {
+        return;
+    }
+    if (s_impls[pdrv]->ioctl(pdrv, GET_SECTOR_COUNT, &sector_count) != RES_OK) {
+        sector_count = 0;
+    }
+    ff_diskio_cache_t* c = ff_memalloc(sizeof(ff_diskio_cache_t));
+    if (!c) {
+        return;
+    }
+    memset(c, 0, sizeof(ff_diskio_cache_t));
+    c->sector_size = sector_size;
+    c->sector_count = sector_count;
+    c->slot_data = ff_memalloc(CACHE_SECTORS * sector_size);
+    c->ra_data = ff_memalloc(CACHE_RA_SECTORS * sector_size);
+    s_caches[pdrv] = c;
+    if (!c->slot_data || !c->ra_data) {
+        /* run without cache */
+        cache_delete(pdrv);
+    }
+}
+
+static int cache_find(ff_diskio_cache_t* c, LBA_t sector)
+{
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        if ((c->slots[i].flags & CACHE_SLOT_VALID) && c->slots[i].sector == sector) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool cache_ra_contains(ff_diskio_cache_t* c, LBA_t sector)
+{
+    return c->ra_count && sector >= c->ra_start && sector < c->ra_start + c->ra_count;
+}
+
+static DRESULT cache_flush(BYTE pdrv, ff_diskio_cache_t* c)
+{
+    int dirty[CACHE_SECTORS];
+    int n = 0;
+    /* collect dirty slots, sorted by sector number */
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        if (c->slots[i].flags & CACHE_SLOT_DIRTY) {
+            int j = n++;
+            while (j > 0 && c->slots[dirty[j - 1]].sector > c->slots[i].sector) {
+                dirty[j] = dirty[j - 1];
+                j--;
+            }
+            dirty[j] = i;
+        }
+    }
+    if (n > 1) {
+        /* read-ahead window becomes the bounce buffer */
+        c->ra_count = 0;
+    }
+    for (int i = 0; i < n; ) {
+        int run = 1;
+        while (i + run < n && run < CACHE_RA_SECTORS
+                && c->slots[dirty[i + run]].sector == c->slots[dirty[i]].sector + run) {
+            run++;
+        }
+        const BYTE* src = c->slot_data + dirty[i] * c->sector_size;
+        if (run > 1) {
+            for (int k = 0; k < run; k++) {
+                memcpy(c->ra_data + k * c->sector_size, c->slot_data + dirty[i + k] * c->sector_size, c->sector_size);
+            }
+            src = c->ra_data;
+        }
+        DRESULT res = s_impls[pdrv]->write(pdrv, src, c->slots[dirty[i]].sector, run);
+        c->stats.disk_writes++;
+        if (res != RES_OK) {
+            return res;
+        }
+        for (int k = 0; k < run; k++) {
+            c->slots[dirty[i + k]].flags &= ~CACHE_SLOT_DIRTY;
+        }
+        i += run;
+    }
+    return RES_OK;
+}
+
+static int cache_evict(BYTE pdrv, ff_diskio_cache_t* c)
+{
+    int victim = 0;
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        if (!(c->slots[i].flags & CACHE_SLOT_VALID)) {
+            return i;
+        }
+        if (c->slots[i].last_use < c->slots[victim].last_use) {
+            victim = i;
+        }
+    }
+    if ((c->slots[victim].flags & CACHE_SLOT_DIRTY) && cache_flush(pdrv, c) != RES_OK) {
+        return -1;
+    }
+    c->slots[victim].flags = 0;
+    return victim;
+}
+
+static void cache_put(ff_diskio_cache_t* c, int slot, LBA_t sector, const BYTE* data, uint8_t flags)
+{
+    memcpy(c->slot_data + slot * c->sector_size, data, c->sector_size);
+    c->slots[slot].sector = sector;
+    c->slots[slot].flags = CACHE_SLOT_VALID | flags;
+    c->slots[slot].last_use = ++c->use_counter;
+}
+
+static DRESULT cache_read(BYTE pdrv, ff_diskio_cache_t* c, BYTE* buff, LBA_t sector, UINT count)
+{
+    DRESULT res;
+    const UINT ss = c->sector_size;
+
+    if (count >= CACHE_SECTORS) {
+        /* large transfer goes to the driver directly, dirty data must be on the disk first */
+        for (int i = 0; i < CACHE_SECTORS; i++) {
+            if ((c->slots[i].flags & CACHE_SLOT_DIRTY) && c->slots[i].sector >= sector && c->slots[i].sector < sector + count) {
+                res = cache_flush(pdrv, c);
+                if (res != RES_OK) {
+                    return res;
+                }
+                break;
+            }
+        }
+        c->stats.disk_reads++;
+        c->next_sector = sector + count;
+        return s_impls[pdrv]->read(pdrv, buff, sector, count);
+    }
+
+    /* Sequential access is detected on sectors which are not in the LRU slots,
+     * so that FAT and directory lookups between data reads do not break it. */
+    for (UINT i = 0; i < count; ) {
+        LBA_t s = sector + i;
+        int slot = cache_find(c, s);
+        if (slot >= 0) {
+            memcpy(buff + i * ss, c->slot_data + slot * ss, ss);
+            c->slots[slot].last_use = ++c->use_counter;
+            c->stats.read_hits++;
+            i++;
+            continue;
+        }
+        if (cache_ra_contains(c, s)) {
+            memcpy(buff + i * ss, c->ra_data + (s - c->ra_start) * ss, ss);
+            c->stats.read_hits++;
+            c->next_sector = s + 1;
+            i++;
+            continue;
+        }
+        c->stats.read_misses++;
+        if (s == c->next_sector && c->sector_count > s) {
+            /* fill the read-ahead window, remaining sectors are served from it */
+            UINT n = CACHE_RA_SECTORS;
+            if (c->sector_count - s < n) {
+                n = c->sector_count - s;
+            }
+            c->ra_count = 0;
+            c->stats.disk_reads++;
+            res = s_impls[pdrv]->read(pdrv, c->ra_data, s, n);
+            if (res != RES_OK) {
+                return res;
+            }
+            c->ra_start = s;
+            c->ra_count = n;
+            continue;
+        }
+        /* random access: read the run of missing sectors to the caller buffer and keep a copy */
+        UINT run = 1;
+        while (i + run < count && cache_find(c, s + run) < 0 && !cache_ra_contains(c, s + run)) {
+            run++;
+        }
+        c->stats.disk_reads++;
+        res = s_impls[pdrv]->read(pdrv, buff + i * ss, s, run);
+        if (res != RES_OK) {
+            return res;
+        }
+        c->next_sector = s + run;
+        for (UINT k = 0; k < run; k++) {
+            slot = cache_evict(pdrv, c);
+            if (slot < 0) {
+                return RES_ERROR;
+            }
+            cache_put(c, slot, s + k, buff + (i + k) * ss, 0);
+        }
+        i += run;
+    }
+    return RES_OK;
+}
+
+/* Drop cached copies of trimmed sectors, including dirty ones, so they are neither read back nor written back */
+static void cache_trim(ff_diskio_cache_t* c, LBA_t start, LBA_t end)
+{
+    if (c->ra_count && start < c->ra_start + c->ra_count && end >= c->ra_start) {
+        c->ra_count = 0;
+    }
+    for (int i = 0; i < CACHE_SECTORS; i++) {
+        if ((c->slots[i].flags & CACHE_SLOT_VALID) && c->slots[i].sector >= start && c->slots[i].sector <= end) {
+            c->slots[i].flags = 0;
+        }
+    }
+}
+
+static DRESULT cache_write(BYTE pdrv, ff_diskio_cache_t* c, const BYTE* buff, LBA_t sector, UINT count)
+{
+    const UINT ss = c->sector_size;
+    /* keep the read-ahead window coherent */
+    if (c->ra_count && sector < c->ra_start + c->ra_count && sector + count > c->ra_start) {
+        c->ra_count = 0;
+    }
+
+    if (count >= CACHE_SECTORS) {
+        /* large transfer goes to the driver directly, cached copies are superseded */
+        for (int i = 0; i < CACHE_SECTORS; i++) {
+            if ((c->slots[i].flags & CACHE_SLOT_VALID) && c->slots[i].sector >= sector && c->slots[i].sector < sector + count) {
+                c->slots[i].flags = 0;
+            }
+        }
+        c->stats.disk_writes++;
+        return s_impls[pdrv]->write(pdrv, buff, sector, count);
+    }
+
+    for (UINT i = 0; i < count; i++) {
+        int slot = cache_find(c, sector + i);
+        if (slot < 0) {
+            slot = cache_evict(pdrv, c);
+            if (slot < 0) {
+                return RES_ERROR;
+            }
+        }
+        cache_put(c, slot, sector + i, buff + i * ss, CACHE_SLOT_DIRTY);
+    }
+    return RES_OK;
+}
+
+esp_err_t ff_diskio_get_cache_stats(BYTE pdrv, ff_diskio_cache_stats_t* out_stats)
+{
+    if (pdrv >= FF_VOLUMES || !out_stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_caches[pdrv]) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *out_stats = s_caches[pdrv]->stats;
+    return ESP_OK;
+}
+
+#else // CONFIG_FATFS_DISKIO_CACHE
+
+esp_err_t ff_diskio_get_cache_stats(BYTE pdrv, ff_diskio_cache_stats_t* out_stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_FATFS_DISKIO_CACHE
+
 #if FF_MULTI_PARTITION		/* Multiple partition configuration */
 const PARTITION VolToPart[FF_VOLUMES] = {
     {0, 0},    /* Logical drive 0 ==> Physical drive 0, auto detection */
@@ -66,6 +390,17 @@ void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl)
     assert(pdrv < FF_VOLUMES);
 
     if (s_impls[pdrv]) {
+#if CONFIG_FATFS_DISKIO_CACHE
+        DISKIO_LOCK(pdrv);
+        if (s_caches[pdrv]) {
+            DRESULT res = cache_flush(pdrv, s_caches[pdrv]);
+            if (res != RES_OK) {
+                ESP_LOGE(TAG, "drive %d: failed to write back the cache (%d), cached data is lost", pdrv, res);
+            }
+            cache_delete(pdrv);
+        }
+        DISKIO_UNLOCK(pdrv);
+#endif
         ff_diskio_impl_t* im = s_impls[pdrv];
         s_impls[pdrv] = NULL;
         free(im);
@@ -83,23 +418,70 @@ void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl)
 
 DSTATUS ff_disk_initialize (BYTE pdrv)
 {
-    return s_impls[pdrv]->init(pdrv);
+    DISKIO_LOCK(pdrv);
+    DSTATUS status = s_impls[pdrv]->init(pdrv);
+#if CONFIG_FATFS_DISKIO_CACHE
+    if (!(status & STA_NOINIT)) {
+        cache_create(pdrv);
+    }
+#endif
+    DISKIO_UNLOCK(pdrv);
+    return status;
 }
 DSTATUS ff_disk_status (BYTE pdrv)
 {
-    return s_impls[pdrv]->status(pdrv);
+    DISKIO_LOCK(pdrv);
+    DSTATUS status = s_impls[pdrv]->status(pdrv);
+    DISKIO_UNLOCK(pdrv);
+    return status;
 }
 DRESULT ff_disk_read (BYTE pdrv, BYTE* buff, LBA_t sector, UINT count)
 {
-    return s_impls[pdrv]->read(pdrv, buff, sector, count);
+    DRESULT res;
+    DISKIO_LOCK(pdrv);
+#if CONFIG_FATFS_DISKIO_CACHE
+    if (s_caches[pdrv]) {
+        res = cache_read(pdrv, s_caches[pdrv], buff, sector, count);
+    } else
+#endif
+    {
+        res = s_impls[pdrv]->read(pdrv, buff, sector, count);
+    }
+    DISKIO_UNLOCK(pdrv);
+    return res;
 }
 DRESULT ff_disk_write (BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count)
 {
-    return s_impls[pdrv]->write(pdrv, buff, sector, count);
+    DRESULT res;
+    DISKIO_LOCK(pdrv);
+#if CONFIG_FATFS_DISKIO_CACHE
+    if (s_caches[pdrv]) {
+        res = cache_write(pdrv, s_caches[pdrv], buff, sector, count);
+    } else
+#endif
+    {
+        res = s_impls[pdrv]->write(pdrv, buff, sector, count);
+    }
+    DISKIO_UNLOCK(pdrv);
+    return res;
 }
 DRESULT ff_disk_ioctl (BYTE pdrv, BYTE cmd, void* buff)
 {
-    return s_impls[pdrv]->ioctl(pdrv, cmd, buff);
+    DRESULT res = RES_OK;
+    DISKIO_LOCK(pdrv);
+#if CONFIG_FATFS_DISKIO_CACHE
+    if (cmd == CTRL_SYNC && s_caches[pdrv]) {
+        res = cache_flush(pdrv, s_caches[pdrv]);
+    } else if (cmd == CTRL_TRIM && s_caches[pdrv]) {
+        LBA_t* range = (LBA_t*)buff;
+        cache_trim(s_caches[pdrv], range[0], range[1]);
+    }
+#endif
+    if (res == RES_OK) {
+        res = s_impls[pdrv]->ioctl(pdrv, cmd, buff);
+    }
+    DISKIO_UNLOCK(pdrv);
+    return res;
 }
 
 DWORD get_fattime(void)
@@ -41,6 +41,16 @@ typedef struct {
     DRESULT (*ioctl) (unsigned char pdrv, unsigned char cmd, void* buff); /*!< function to get info about disk and do some misc operations */
 } ff_diskio_impl_t;
 
+/**
+ * Statistics of the disk I/O cache (CONFIG_FATFS_DISKIO_CACHE)
+ */
+typedef struct {
+    uint32_t read_hits;     /*!< sectors read from the cache */
+    uint32_t read_misses;   /*!< sectors which had to be read from the disk */
+    uint32_t disk_reads;    /*!< read commands issued to the diskio driver */
+    uint32_t disk_writes;   /*!< write commands issued to the diskio driver */
+} ff_diskio_cache_stats_t;
+
 /**
  * Register or unregister diskio driver for given drive number.
  *
@@ -66,6 +76,22 @@ void ff_diskio_register(BYTE pdrv, const ff_diskio_impl_t* discio_impl);
  */
 esp_err_t ff_diskio_get_drive(BYTE* out_pdrv);
 
+/**
+ * Get statistics of the disk I/O cache of given drive
+ *
+ * The cache is created when the drive is initialized by FatFs and is
+ * flushed and released when the drive is unregistered.
+ *
+ * @param   pdrv                drive number
+ * @param   out_stats           pointer to the structure to fill
+ *
+ * @return  ESP_OK              on success
+ *          ESP_ERR_INVALID_ARG if pdrv or out_stats is invalid
+ *          ESP_ERR_NOT_FOUND   if the drive has no cache
+ *          ESP_ERR_NOT_SUPPORTED if CONFIG_FATFS_DISKIO_CACHE is disabled
+ */
+esp_err_t ff_diskio_get_cache_stats(BYTE pdrv, ff_diskio_cache_stats_t* out_stats);
+
 
 #ifdef __cplusplus
 }
@@ -105,4 +105,66 @@ void ff_rel_grant (
     xSemaphoreGive(sobj);
 }
 
+
+#if FF_FS_PARALLEL_DATA
+
+/*------------------------------------------------------------------------*/
+/* Create a Transfer End Event                                            */
+/*------------------------------------------------------------------------*/
+/* This function is called in f_mount() function to create the event which
+/  is signaled when the last file data transfer done without the volume lock
+/  ends. When a 0 is returned, the f_mount() function fails with FR_INT_ERR.
+*/
+
+int ff_cre_xferobj (    /* 1:Function succeeded, 0:Could not create the event */
+    BYTE vol,           /* Corresponding volume (logical drive number) */
+    FF_SYNC_t *xobj     /* Pointer to return the created event */
+)
+{
+    *xobj = xSemaphoreCreateBinary();
+    return (*xobj != NULL) ? 1 : 0;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Delete a Transfer End Event                                            */
+/*------------------------------------------------------------------------*/
+
+void ff_del_xferobj (
+    FF_SYNC_t xobj      /* Event to be deleted */
+)
+{
+    vSemaphoreDelete(xobj);
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Wait for a Transfer End Event                                          */
+/*------------------------------------------------------------------------*/
+/* This function is called in f_mount() function, without the volume lock,
+/  while file data transfers are in progress. The event may have been
+/  signaled before, so f_mount() checks the transfers again on return.
+*/
+
+int ff_wait_xfer (      /* 1:Event was signaled, 0:Timeout */
+    FF_SYNC_t xobj      /* Event to wait */
+)
+{
+    return (xSemaphoreTake(xobj, FF_FS_TIMEOUT) == pdTRUE) ? 1 : 0;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Signal a Transfer End Event                                            */
+/*------------------------------------------------------------------------*/
+
+void ff_sig_xfer (
+    FF_SYNC_t xobj      /* Event to be signaled */
+)
+{
+    xSemaphoreGive(xobj);
+}
+
+#endif // FF_FS_PARALLEL_DATA
+
 #endif // FF_FS_REENTRANT
@@ -43,3 +43,26 @@ int ff_req_grant (FF_SYNC_t sobj)
 void ff_rel_grant (FF_SYNC_t sobj)
 {
 }
+
+#if FF_FS_PARALLEL_DATA
+/* 1:Function succeeded, 0:Could not create the event */
+int ff_cre_xferobj(BYTE vol, FF_SYNC_t* xobj)
+{
+    *xobj = NULL;
+    return 1;
+}
+
+void ff_del_xferobj(FF_SYNC_t xobj)
+{
+}
+
+/* 1:Event was signaled, 0:Timeout */
+int ff_wait_xfer(FF_SYNC_t xobj)
+{
+    return 1;
+}
+
+void ff_sig_xfer(FF_SYNC_t xobj)
+{
+}
+#endif
@@ -905,6 +905,53 @@ static void unlock_fs (
 	}
 }
 
+
+#if FF_FS_PARALLEL_DATA
+/*-----------------------------------------------------------------------*/
+/* Transfer contiguous file data sectors without the volume lock         */
+/*-----------------------------------------------------------------------*/
+/* Data sectors of a file are not shared with other objects, so the volume
+/  is released during the transfer and other tasks can access the FAT and
+/  directories (and data of other files) meanwhile. */
+static FRESULT xfer_data_unlocked (	/* FR_OK, FR_DISK_ERR, FR_INVALID_OBJECT or FR_TIMEOUT (volume is not locked) */
+	FIL* fp,			/* File object */
+	BYTE* rbuff,		/* Buffer to read into, or NULL to write */
+	const BYTE* wbuff,	/* Buffer to write from */
+	LBA_t sect,			/* Start sector */
+	UINT cc				/* Number of sectors */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	DRESULT dr;
+
+
+	int locked;
+
+
+	__atomic_add_fetch(&fs->n_xfer, 1, __ATOMIC_SEQ_CST);	/* Keeps f_mount() from deleting the sync object meanwhile */
+	ff_rel_grant(fs->sobj);
+#if !FF_FS_READONLY
+	if (!rbuff) {
+		dr = disk_write(fs->pdrv, wbuff, sect, cc);
+	} else
+#endif
+	{
+		dr = disk_read(fs->pdrv, rbuff, sect, cc);
+	}
+	locked = lock_fs(fs);
+	if (!locked) {						/* Time-out, the volume is not used anymore */
+		ff_sig_xfer(fs->xobj);			/* Signal while the count keeps f_mount() from deleting the object */
+		__atomic_sub_fetch(&fs->n_xfer, 1, __ATOMIC_SEQ_CST);
+		return FR_TIMEOUT;
+	}
+	if (__atomic_sub_fetch(&fs->n_xfer, 1, __ATOMIC_SEQ_CST) == 0) {
+		ff_sig_xfer(fs->xobj);			/* Wake up f_mount() waiting for the transfers */
+	}
+	if (fs->fs_type == 0 || fs->id != fp->obj.id) return FR_INVALID_OBJECT;	/* The volume has been remounted meanwhile */
+	return (dr == RES_OK) ? FR_OK : FR_DISK_ERR;
+}
+#endif
+
 #endif
 
 
@@ -3620,19 +3667,39 @@ FRESULT f_mount (
 	cfs = FatFs[vol];					/* Pointer to fs object */
 
 	if (cfs) {
+#if FF_FS_REENTRANT && FF_FS_PARALLEL_DATA	/* Wait for the file data transfers in progress */
+		for (;;) {
+			if (!ff_req_grant(cfs->sobj)) return FR_TIMEOUT;
+			if (__atomic_load_n(&cfs->n_xfer, __ATOMIC_SEQ_CST) == 0) break;
+			ff_rel_grant(cfs->sobj);
+			ff_wait_xfer(cfs->xobj);	/* Signaled when the last transfer ends, checked again on time-out */
+		}
+#endif
 #if FF_FS_LOCK != 0
 		clear_lock(cfs);
 #endif
 #if FF_FS_REENTRANT						/* Discard sync object of the current volume */
 		if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
+#if FF_FS_PARALLEL_DATA
+		ff_del_xferobj(cfs->xobj);
+#endif
 #endif
 		cfs->fs_type = 0;				/* Clear old fs object */
 	}
 
 	if (fs) {
 		fs->fs_type = 0;				/* Clear new fs object */
+#if FF_FS_REENTRANT && FF_FS_PARALLEL_DATA
+		fs->n_xfer = 0;
+#endif
 #if FF_FS_REENTRANT						/* Create sync object for the new volume */
 		if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
+#if FF_FS_PARALLEL_DATA
+		if (!ff_cre_xferobj((BYTE)vol, &fs->xobj)) {
+			ff_del_syncobj(fs->sobj);
+			return FR_INT_ERR;
+		}
+#endif
 #endif
 	}
 	FatFs[vol] = fs;					/* Register new fs object */
@@ -3898,7 +3965,14 @@ FRESULT f_read (
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+#if FF_FS_REENTRANT && FF_FS_PARALLEL_DATA
+				res = xfer_data_unlocked(fp, rbuff, 0, sect, cc);
+				if (res == FR_TIMEOUT) return res;	/* Volume is not locked */
+				if (res == FR_DISK_ERR) ABORT(fs, FR_DISK_ERR);
+				if (res != FR_OK) LEAVE_FF(fs, res);
+#else
 				if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#endif
 #if !FF_FS_READONLY && FF_FS_MINIMIZE <= 2		/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if FF_FS_TINY
 				if (fs->wflag && fs->winsect - sect < cc) {
@@ -4013,7 +4087,14 @@ FRESULT f_write (
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+#if FF_FS_REENTRANT && FF_FS_PARALLEL_DATA
+				res = xfer_data_unlocked(fp, 0, wbuff, sect, cc);
+				if (res == FR_TIMEOUT) return res;	/* Volume is not locked */
+				if (res == FR_DISK_ERR) ABORT(fs, FR_DISK_ERR);
+				if (res != FR_OK) LEAVE_FF(fs, res);
+#else
 				if (disk_write(fs->pdrv, wbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#endif
 #if FF_FS_MINIMIZE <= 2
 #if FF_FS_TINY
 				if (fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
@@ -149,6 +149,10 @@ typedef struct {
 #endif
 #if FF_FS_REENTRANT
 	FF_SYNC_t	sobj;		/* Identifier of sync object */
+#if FF_FS_PARALLEL_DATA
+	UINT	n_xfer;			/* Number of file data transfers in progress without the volume lock */
+	FF_SYNC_t	xobj;		/* Signaled when the last of these transfers ends */
+#endif
 #endif
 #if !FF_FS_READONLY
 	DWORD	last_clst;		/* Last allocated cluster */
@@ -373,6 +377,12 @@ int ff_cre_syncobj (BYTE vol, FF_SYNC_t* sobj);	/* Create a sync object */
 int ff_req_grant (FF_SYNC_t sobj);		/* Lock sync object */
 void ff_rel_grant (FF_SYNC_t sobj);		/* Unlock sync object */
 int ff_del_syncobj (FF_SYNC_t sobj);	/* Delete a sync object */
+#if FF_FS_PARALLEL_DATA
+int ff_cre_xferobj (BYTE vol, FF_SYNC_t* xobj);	/* Create a transfer end event */
+int ff_wait_xfer (FF_SYNC_t xobj);		/* Wait for a transfer end event */
+void ff_sig_xfer (FF_SYNC_t xobj);		/* Signal a transfer end event */
+void ff_del_xferobj (FF_SYNC_t xobj);	/* Delete a transfer end event */
+#endif
 #endif
 
 
@@ -316,6 +316,24 @@
 /  SemaphoreHandle_t and etc. A header file for O/S definitions needs to be
 /  included somewhere in the scope of ff.h. */
 
+#if defined(CONFIG_FATFS_PARALLEL_FILE_ACCESS) && !FF_FS_TINY
+#define FF_FS_PARALLEL_DATA	1
+#else
+#define FF_FS_PARALLEL_DATA	0
+#endif
+/* The option FF_FS_PARALLEL_DATA (ESP-IDF extension) makes f_read() and f_write()
+/  release the volume lock while contiguous data sectors of the file are transferred
+/  directly between the disk and the caller's buffer. The volume lock then guards only
+/  the shared FAT, directory and sector window structures, and file data of different
+/  files can be transferred in parallel. It has no effect when FF_FS_REENTRANT is 0,
+/  or with FF_FS_TINY, where file data is buffered in the shared sector window.
+/  A file object must not be used by several tasks at the same time in this mode,
+/  and the disk I/O layer must be thread safe. f_mount() waits for the transfers
+/  in progress before unmounting the volume, blocking on an event created with
+/  ff_cre_xferobj(), which must be added to the project with ff_wait_xfer(),
+/  ff_sig_xfer() and ff_del_xferobj(). */
+
+
 #include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
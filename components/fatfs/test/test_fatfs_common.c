@@ -12,6 +12,7 @@
 #include <sys/time.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
+#include <sys/param.h>
 #include <errno.h>
 #include <utime.h>
 #include "unity.h"
@@ -922,6 +923,215 @@ void test_fatfs_rw_speed(const char* filename, void* buf, size_t buf_size, size_
                     file_size / (1024.0f * 1024.0f * t_s));
 }
 
+typedef struct {
+    const char* filename;
+    uint32_t* buf;
+    size_t buf_size;
+    size_t file_size;
+    bool write;
+    SemaphoreHandle_t done;
+    int result;
+} rw_files_test_arg_t;
+
+/* Contents of the block at |offset| of the file |filename|, different for each block and each file */
+static void fill_block(const char* filename, uint32_t* buf, size_t buf_size, size_t offset)
+{
+    uint32_t x = offset ^ (filename[strlen(filename) - 1] << 24);
+    for (size_t i = 0; i < buf_size / sizeof(uint32_t); ++i) {
+        x = x * 1664525 + 1013904223;
+        buf[i] = x;
+    }
+}
+
+static bool check_block(const char* filename, const uint32_t* buf, size_t buf_size, size_t offset)
+{
+    uint32_t x = offset ^ (filename[strlen(filename) - 1] << 24);
+    for (size_t i = 0; i < buf_size / sizeof(uint32_t); ++i) {
+        x = x * 1664525 + 1013904223;
+        if (buf[i] != x) {
+            esp_rom_printf("E(r): %s offset=%d word=%d got=0x%08x expected=0x%08x\n",
+                           filename, offset, i, buf[i], x);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void rw_file_task(void* param)
+{
+    rw_files_test_arg_t* args = (rw_files_test_arg_t*) param;
+    args->result = ESP_FAIL;
+    int fd = args->write ? open(args->filename, O_WRONLY | O_CREAT | O_TRUNC) : open(args->filename, O_RDONLY);
+    if (fd >= 0) {
+        size_t total = 0;
+        while (total < args->file_size) {
+            if (args->write) {
+                fill_block(args->filename, args->buf, args->buf_size, total);
+                if (write(fd, args->buf, args->buf_size) != args->buf_size) {
+                    break;
+                }
+            } else {
+                if (read(fd, args->buf, args->buf_size) != args->buf_size ||
+                        !check_block(args->filename, args->buf, args->buf_size, total)) {
+                    break;
+                }
+            }
+            total += args->buf_size;
+        }
+        if (close(fd) == 0 && total == args->file_size) {
+            args->result = ESP_OK;
+        }
+    }
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
+
+static float rw_files_in_tasks(rw_files_test_arg_t* args, size_t count, size_t task_count, bool write)
+{
+    struct timeval tv_start;
+    gettimeofday(&tv_start, NULL);
+    for (size_t i = 0; i < count; i += task_count) {
+        for (size_t j = i; j < i + task_count && j < count; ++j) {
+            args[j].write = write;
+            xTaskCreatePinnedToCore(&rw_file_task, "rw", 4096, &args[j], 5, NULL, j % portNUM_PROCESSORS);
+        }
+        for (size_t j = i; j < i + task_count && j < count; ++j) {
+            xSemaphoreTake(args[j].done, portMAX_DELAY);
+            TEST_ASSERT_EQUAL(ESP_OK, args[j].result);
+        }
+    }
+    struct timeval tv_end;
+    gettimeofday(&tv_end, NULL);
+    return tv_end.tv_sec - tv_start.tv_sec + 1e-6f * (tv_end.tv_usec - tv_start.tv_usec);
+}
+
+void test_fatfs_concurrent_rw_speed(const char* filename_prefix, size_t buf_size, size_t file_size)
+{
+    const size_t file_count = 2;
+    char names[2][64];
+    rw_files_test_arg_t args[2];
+    for (size_t i = 0; i < file_count; ++i) {
+        snprintf(names[i], sizeof(names[i]), "%s%d", filename_prefix, i + 1);
+        args[i] = (rw_files_test_arg_t) {
+            .filename = names[i],
+            .buf = malloc(buf_size),
+            .buf_size = buf_size,
+            .file_size = file_size,
+            .done = xSemaphoreCreateBinary(),
+        };
+        TEST_ASSERT_NOT_NULL(args[i].buf);
+    }
+
+    /* Both files are written at the same time, then each is read back by one task, then by parallel tasks */
+    float t_write = rw_files_in_tasks(args, file_count, file_count, true);
+    float t_one = rw_files_in_tasks(args, file_count, 1, false);
+    float t_all = rw_files_in_tasks(args, file_count, file_count, false);
+    const size_t total_size = file_count * file_size;
+    printf("Wrote %d files of %d bytes (block size %d) in %d tasks: %.3fms (%.3f MB/s)\n",
+            file_count, file_size, buf_size, file_count, t_write * 1e3, total_size / (1024.0f * 1024.0f * t_write));
+    printf("Read them: 1 task %.3fms (%.3f MB/s), %d tasks %.3fms (%.3f MB/s)\n",
+            t_one * 1e3, total_size / (1024.0f * 1024.0f * t_one),
+            file_count, t_all * 1e3, total_size / (1024.0f * 1024.0f * t_all));
+
+    for (size_t i = 0; i < file_count; ++i) {
+        TEST_ASSERT_EQUAL(0, unlink(names[i]));
+        free(args[i].buf);
+        vSemaphoreDelete(args[i].done);
+    }
+}
+
+static float elapsed_s(const struct timeval* tv_start)
+{
+    struct timeval tv_end;
+    gettimeofday(&tv_end, NULL);
+    return tv_end.tv_sec - tv_start->tv_sec + 1e-6f * (tv_end.tv_usec - tv_start->tv_usec);
+}
+
+typedef struct {
+    rw_files_test_arg_t rw;
+    float max_read_s;           /* longest read() call of the file */
+} large_read_test_arg_t;
+
+static void large_read_task(void* param)
+{
+    large_read_test_arg_t* args = (large_read_test_arg_t*) param;
+    args->rw.result = ESP_FAIL;
+    args->max_read_s = 0;
+    int fd = open(args->rw.filename, O_RDONLY);
+    if (fd >= 0) {
+        size_t total = 0;
+        while (total < args->rw.file_size) {
+            struct timeval tv_start;
+            gettimeofday(&tv_start, NULL);
+            if (read(fd, args->rw.buf, args->rw.buf_size) != args->rw.buf_size) {
+                break;
+            }
+            args->max_read_s = MAX(args->max_read_s, elapsed_s(&tv_start));
+            total += args->rw.buf_size;
+        }
+        if (close(fd) == 0 && total == args->rw.file_size) {
+            args->rw.result = ESP_OK;
+        }
+    }
+    xSemaphoreGive(args->rw.done);
+    vTaskDelete(NULL);
+}
+
+void test_fatfs_small_read_latency(const char* filename_prefix, size_t buf_size, size_t file_size)
+{
+    char large_name[64];
+    char small_name[64];
+    snprintf(large_name, sizeof(large_name), "%s1", filename_prefix);
+    snprintf(small_name, sizeof(small_name), "%s2", filename_prefix);
+    large_read_test_arg_t args = {
+        .rw = {
+            .filename = large_name,
+            .buf = malloc(buf_size),
+            .buf_size = buf_size,
+            .file_size = file_size,
+            .done = xSemaphoreCreateBinary(),
+        },
+    };
+    TEST_ASSERT_NOT_NULL(args.rw.buf);
+    rw_files_in_tasks(&args.rw, 1, 1, true);
+    test_fatfs_create_file_with_text(small_name, fatfs_test_hello_str);
+
+    /* The small file is read once per tick by a higher priority task, while the large file is read in big chunks */
+    const size_t small_size = strlen(fatfs_test_hello_str);
+    char small_buf[32] = { 0 };
+    int fd = open(small_name, O_RDONLY);
+    TEST_ASSERT_TRUE(fd >= 0);
+    xTaskCreatePinnedToCore(&large_read_task, "large_read", 4096, &args, uxTaskPriorityGet(NULL) - 1, NULL, xPortGetCoreID());
+    float max_small_read_s = 0;
+    int small_reads = 0;
+    do {
+        vTaskDelay(1);
+        struct timeval tv_start;
+        gettimeofday(&tv_start, NULL);
+        TEST_ASSERT_EQUAL(0, lseek(fd, 0, SEEK_SET));
+        TEST_ASSERT_EQUAL(small_size, read(fd, small_buf, small_size));
+        max_small_read_s = MAX(max_small_read_s, elapsed_s(&tv_start));
+        ++small_reads;
+    } while (xSemaphoreTake(args.rw.done, 0) != pdTRUE);
+    TEST_ASSERT_EQUAL(0, close(fd));
+    TEST_ASSERT_EQUAL(ESP_OK, args.rw.result);
+    TEST_ASSERT_EQUAL(0, strcmp(fatfs_test_hello_str, small_buf));
+
+    printf("%d small reads during large reads of %d bytes: max latency %.3fms, longest large read %.3fms\n",
+            small_reads, buf_size, max_small_read_s * 1e3, args.max_read_s * 1e3);
+    TEST_ASSERT_GREATER_THAN(1, small_reads);
+#if CONFIG_FATFS_PARALLEL_FILE_ACCESS
+    /* The volume lock is released while the sectors are transferred, so a small read
+     * waits for one disk command at most, instead of the whole large read */
+    TEST_ASSERT_TRUE(max_small_read_s < args.max_read_s / 2);
+#endif
+
+    TEST_ASSERT_EQUAL(0, unlink(large_name));
+    TEST_ASSERT_EQUAL(0, unlink(small_name));
+    free(args.rw.buf);
+    vSemaphoreDelete(args.rw.done);
+}
+
 void test_fatfs_info(const char* base_path, const char* filepath)
 {
     // Empty FS
@@ -67,4 +67,8 @@ void test_fatfs_opendir_readdir_rewinddir_utf_8(const char* dir_prefix);
 
 void test_fatfs_rw_speed(const char* filename, void* buf, size_t buf_size, size_t file_size, bool write);
 
+void test_fatfs_concurrent_rw_speed(const char* filename_prefix, size_t buf_size, size_t file_size);
+
+void test_fatfs_small_read_latency(const char* filename_prefix, size_t buf_size, size_t file_size);
+
 void test_fatfs_info(const char* base_path, const char* filepath);
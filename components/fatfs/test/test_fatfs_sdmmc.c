@@ -206,6 +206,20 @@ TEST_CASE("(SD) multiple tasks can use same volume", "[fatfs][test_env=UT_T1_SDM
     test_teardown_sdmmc();
 }
 
+TEST_CASE("(SD) multiple tasks can write and read different files in parallel", "[fatfs][test_env=UT_T1_SDMODE][timeout=60]")
+{
+    test_setup_sdmmc();
+    test_fatfs_concurrent_rw_speed("/sdcard/p", 16 * 1024, 1024 * 1024);
+    test_teardown_sdmmc();
+}
+
+TEST_CASE("(SD) small reads are not blocked by large reads of another file", "[fatfs][test_env=UT_T1_SDMODE][timeout=60]")
+{
+    test_setup_sdmmc();
+    test_fatfs_small_read_latency("/sdcard/l", 64 * 1024, 1024 * 1024);
+    test_teardown_sdmmc();
+}
+
 static void sdmmc_speed_test(void *buf, size_t buf_size, size_t file_size, bool write);
 
 TEST_CASE("(SD) write/read speed test", "[fatfs][sd][test_env=UT_T1_SDMODE][timeout=60]")
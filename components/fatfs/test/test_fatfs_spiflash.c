@@ -175,6 +175,20 @@ TEST_CASE("(WL) multiple tasks can use same volume", "[fatfs][wear_levelling]")
     test_teardown();
 }
 
+TEST_CASE("(WL) multiple tasks can write and read different files in parallel", "[fatfs][wear_levelling][timeout=60]")
+{
+    test_setup();
+    test_fatfs_concurrent_rw_speed("/spiflash/p", 4 * 1024, 128 * 1024);
+    test_teardown();
+}
+
+TEST_CASE("(WL) small reads are not blocked by large reads of another file", "[fatfs][wear_levelling][timeout=60]")
+{
+    test_setup();
+    test_fatfs_small_read_latency("/spiflash/l", 32 * 1024, 128 * 1024);
+    test_teardown();
+}
+
 TEST_CASE("(WL) write/read speed test", "[fatfs][wear_levelling][timeout=60]")
 {
     /* Erase partition before running the test to get consistent results */
@@ -12,3 +12,7 @@
 
 #define CONFIG_FATFS_VOLUME_COUNT 2
 #define CONFIG_MMU_PAGE_SIZE 0X10000 // 64KB
+
+#define CONFIG_FATFS_DISKIO_CACHE 1
+#define CONFIG_FATFS_DISKIO_CACHE_SECTORS 8
+#define CONFIG_FATFS_DISKIO_CACHE_READ_AHEAD_SECTORS 8
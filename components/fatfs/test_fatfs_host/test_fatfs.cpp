@@ -6,6 +6,7 @@
 #include "wear_levelling.h"
 #include "diskio_impl.h"
 #include "diskio_wl.h"
+#include "diskio.h"
 
 #include "catch.hpp"
 
@@ -92,3 +93,184 @@ TEST_CASE("create volume, open file, write and read back data", "[fatfs]")
     free(read);
     free(data);
 }
+
+TEST_CASE("disk I/O cache merges small sequential reads and writes", "[fatfs]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    FATFS fs;
+    FIL file;
+    UINT bw;
+    BYTE pdrv;
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, "storage");
+
+    wl_handle_t wl_handle;
+    REQUIRE(wl_mount(partition, &wl_handle) == ESP_OK);
+    REQUIRE(ff_diskio_get_drive(&pdrv) == ESP_OK);
+    REQUIRE(ff_diskio_register_wl_partition(pdrv, wl_handle) == ESP_OK);
+    char drv[3] = {(char)('0' + pdrv), ':', 0};
+    char path[16];
+    snprintf(path, sizeof(path), "%s/cache.bin", drv);
+
+    LBA_t part_list[] = {100, 0, 0, 0};
+    BYTE work_area[FF_MAX_SS];
+    REQUIRE(f_fdisk(pdrv, part_list, work_area) == FR_OK);
+    const MKFS_PARM opt = {(BYTE)FM_ANY, 0, 0, 0, 0};
+    REQUIRE(f_mkfs(drv, &opt, work_area, sizeof(work_area)) == FR_OK);
+    REQUIRE(f_mount(&fs, drv, 1) == FR_OK);
+
+    // Small chunks, so that FatFs accesses the disk one sector at a time
+    const uint32_t data_size = 400000;
+    const uint32_t chunk_size = 1000;
+    char *data = (char*) malloc(data_size);
+    char *read = (char*) malloc(data_size);
+    for (uint32_t i = 0; i < data_size; i += sizeof(i)) {
+        *((uint32_t*)(data + i)) = i;
+    }
+
+    ff_diskio_cache_stats_t before, after;
+    REQUIRE(ff_diskio_get_cache_stats(pdrv, &before) == ESP_OK);
+    clock_t start = clock();
+    REQUIRE(f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    for (uint32_t offset = 0; offset < data_size; offset += chunk_size) {
+        REQUIRE(f_write(&file, data + offset, chunk_size, &bw) == FR_OK);
+        REQUIRE(bw == chunk_size);
+    }
+    REQUIRE(f_close(&file) == FR_OK);
+    double write_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+    REQUIRE(ff_diskio_get_cache_stats(pdrv, &after) == ESP_OK);
+    uint32_t write_cmds = after.disk_writes - before.disk_writes;
+
+    before = after;
+    start = clock();
+    REQUIRE(f_open(&file, path, FA_READ) == FR_OK);
+    for (uint32_t offset = 0; offset < data_size; offset += chunk_size) {
+        REQUIRE(f_read(&file, read + offset, chunk_size, &bw) == FR_OK);
+        REQUIRE(bw == chunk_size);
+    }
+    REQUIRE(f_close(&file) == FR_OK);
+    double read_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+    REQUIRE(ff_diskio_get_cache_stats(pdrv, &after) == ESP_OK);
+    uint32_t read_cmds = after.disk_reads - before.disk_reads;
+
+    REQUIRE(memcmp(data, read, data_size) == 0);
+
+    uint32_t sectors = data_size / FF_MAX_SS + 1;
+    printf("diskio cache: %u sectors, write: %u commands (%.1f KB/s), read: %u commands (%.1f KB/s), hits=%u, misses=%u\n",
+           sectors, write_cmds, data_size / 1024.0 / (write_s > 0 ? write_s : 1e-6),
+           read_cmds, data_size / 1024.0 / (read_s > 0 ? read_s : 1e-6),
+           after.read_hits - before.read_hits, after.read_misses - before.read_misses);
+    // Without the cache every data sector is one command
+    REQUIRE(read_cmds < sectors / 2);
+    REQUIRE(write_cmds < sectors / 2);
+
+    REQUIRE(f_mount(0, drv, 0) == FR_OK);
+    ff_diskio_unregister(pdrv);
+
+    // Data must be on the disk after the drive is unregistered
+    REQUIRE(ff_diskio_register_wl_partition(pdrv, wl_handle) == ESP_OK);
+    REQUIRE(f_mount(&fs, drv, 1) == FR_OK);
+    REQUIRE(f_open(&file, path, FA_READ) == FR_OK);
+    memset(read, 0, data_size);
+    REQUIRE(f_read(&file, read, data_size, &bw) == FR_OK);
+    REQUIRE(bw == data_size);
+    REQUIRE(memcmp(data, read, data_size) == 0);
+    REQUIRE(f_close(&file) == FR_OK);
+    REQUIRE(f_mount(0, drv, 0) == FR_OK);
+    ff_diskio_unregister(pdrv);
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+
+    free(read);
+    free(data);
+}
+
+static BYTE s_ram_disk[16][FF_MAX_SS];
+static int s_ram_disk_writes;
+static bool s_ram_disk_fail_writes;
+
+static DSTATUS ram_disk_init(BYTE pdrv)
+{
+    return 0;
+}
+
+static DRESULT ram_disk_read(BYTE pdrv, BYTE* buff, uint32_t sector, UINT count)
+{
+    memcpy(buff, s_ram_disk[sector], count * FF_MAX_SS);
+    return RES_OK;
+}
+
+static DRESULT ram_disk_write(BYTE pdrv, const BYTE* buff, uint32_t sector, UINT count)
+{
+    if (s_ram_disk_fail_writes) {
+        return RES_ERROR;
+    }
+    s_ram_disk_writes++;
+    memcpy(s_ram_disk[sector], buff, count * FF_MAX_SS);
+    return RES_OK;
+}
+
+static DRESULT ram_disk_ioctl(BYTE pdrv, BYTE cmd, void* buff)
+{
+    switch (cmd) {
+    case GET_SECTOR_COUNT:
+        *((LBA_t*) buff) = sizeof(s_ram_disk) / FF_MAX_SS;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *((WORD*) buff) = FF_MAX_SS;
+        return RES_OK;
+    case CTRL_SYNC:
+    case CTRL_TRIM:
+        return RES_OK;
+    }
+    return RES_PARERR;
+}
+
+TEST_CASE("disk I/O cache drops trimmed sectors", "[fatfs]")
+{
+    const ff_diskio_impl_t ram_disk = {
+        .init = &ram_disk_init,
+        .status = &ram_disk_init,
+        .read = &ram_disk_read,
+        .write = &ram_disk_write,
+        .ioctl = &ram_disk_ioctl,
+    };
+    BYTE pdrv;
+    BYTE buf[FF_MAX_SS];
+    memset(s_ram_disk, 0, sizeof(s_ram_disk));
+    s_ram_disk_writes = 0;
+    s_ram_disk_fail_writes = false;
+
+    REQUIRE(ff_diskio_get_drive(&pdrv) == ESP_OK);
+    ff_diskio_register(pdrv, &ram_disk);
+    REQUIRE(ff_disk_initialize(pdrv) == 0);
+
+    // Sectors 4 and 5 are dirty in the cache, then 5..6 is trimmed
+    memset(buf, 0xa5, sizeof(buf));
+    REQUIRE(ff_disk_write(pdrv, buf, 4, 1) == RES_OK);
+    REQUIRE(ff_disk_write(pdrv, buf, 5, 1) == RES_OK);
+    LBA_t range[2] = {5, 6};
+    REQUIRE(ff_disk_ioctl(pdrv, CTRL_TRIM, range) == RES_OK);
+
+    // Only sector 4 is written back
+    REQUIRE(ff_disk_ioctl(pdrv, CTRL_SYNC, NULL) == RES_OK);
+    REQUIRE(s_ram_disk_writes == 1);
+    REQUIRE(s_ram_disk[4][0] == 0xa5);
+    REQUIRE(s_ram_disk[5][0] == 0);
+
+    // The trimmed sector is read from the disk, not from the cache
+    ff_diskio_cache_stats_t before, after;
+    REQUIRE(ff_diskio_get_cache_stats(pdrv, &before) == ESP_OK);
+    REQUIRE(ff_disk_read(pdrv, buf, 5, 1) == RES_OK);
+    REQUIRE(ff_diskio_get_cache_stats(pdrv, &after) == ESP_OK);
+    REQUIRE(after.disk_reads == before.disk_reads + 1);
+    REQUIRE(buf[0] == 0);
+
+    // A failed write back on unregister is reported, and the drive is released anyway
+    REQUIRE(ff_disk_write(pdrv, buf, 7, 1) == RES_OK);
+    s_ram_disk_fail_writes = true;
+    ff_diskio_unregister(pdrv);
+    BYTE free_pdrv;
+    REQUIRE(ff_diskio_get_drive(&free_pdrv) == ESP_OK);
+    REQUIRE(free_pdrv == pdrv);
+}
@@ -20,11 +20,12 @@ typedef struct {
     char fat_drive[8];  /* FAT drive name */
     char base_path[ESP_VFS_PATH_MAX];   /* base path in VFS where partition is registered */
     size_t max_files;   /* max number of simultaneously open files; size of files[] array */
-    _lock_t lock;       /* guard for access to this structure */
+    _lock_t lock;       /* guard for access to this structure (file table, path buffers) */
     FATFS fs;           /* fatfs library FS structure */
     char tmp_path_buf[FILENAME_MAX+3];  /* temporary buffer used to prepend drive name to the path */
     char tmp_path_buf2[FILENAME_MAX+3]; /* as above; used in functions which take two path arguments */
     bool *o_append;  /* O_APPEND is stored here for each max_files entries (because O_APPEND is not compatible with FA_OPEN_APPEND) */
+    _lock_t *file_locks;    /* guard for each of max_files entries, so that different files can be accessed in parallel */
     FIL files[0];   /* array with max_files entries; must be the final member of the structure */
 } vfs_fat_ctx_t;
 
@@ -164,18 +165,29 @@ esp_err_t esp_vfs_fat_register(const char* base_path, const char* fat_drive, siz
         return ESP_ERR_NO_MEM;
     }
     memset(fat_ctx->o_append, 0, max_files * sizeof(bool));
+    fat_ctx->file_locks = ff_memalloc(max_files * sizeof(_lock_t));
+    if (fat_ctx->file_locks == NULL) {
+        free(fat_ctx->o_append);
+        free(fat_ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    memset(fat_ctx->file_locks, 0, max_files * sizeof(_lock_t));
     fat_ctx->max_files = max_files;
     strlcpy(fat_ctx->fat_drive, fat_drive, sizeof(fat_ctx->fat_drive) - 1);
     strlcpy(fat_ctx->base_path, base_path, sizeof(fat_ctx->base_path) - 1);
 
     esp_err_t err = esp_vfs_register(base_path, &vfs, fat_ctx);
     if (err != ESP_OK) {
+        ff_memfree(fat_ctx->file_locks);
         free(fat_ctx->o_append);
         free(fat_ctx);
         return err;
     }
 
     _lock_init(&fat_ctx->lock);
+    for (size_t i = 0; i < max_files; i++) {
+        _lock_init(&fat_ctx->file_locks[i]);
+    }
     s_fat_ctxs[ctx] = fat_ctx;
 
     //compatibility
@@ -198,6 +210,10 @@ esp_err_t esp_vfs_fat_unregister_path(const char* base_path)
         return err;
     }
     _lock_close(&fat_ctx->lock);
+    for (size_t i = 0; i < fat_ctx->max_files; i++) {
+        _lock_close(&fat_ctx->file_locks[i]);
+    }
+    ff_memfree(fat_ctx->file_locks);
     free(fat_ctx->o_append);
     free(fat_ctx);
     s_fat_ctxs[ctx] = NULL;
@@ -396,8 +412,10 @@ static ssize_t vfs_fat_write(void* ctx, int fd, const void * data, size_t size)
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
     FRESULT res;
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     if (fat_ctx->o_append[fd]) {
         if ((res = f_lseek(file, f_size(file))) != FR_OK) {
+            _lock_release(&fat_ctx->file_locks[fd]);
             ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
             errno = fresult_to_errno(res);
             return -1;
@@ -405,6 +423,7 @@ static ssize_t vfs_fat_write(void* ctx, int fd, const void * data, size_t size)
     }
     unsigned written = 0;
     res = f_write(file, data, size, &written);
+    _lock_release(&fat_ctx->file_locks[fd]);
     if (((written == 0) && (size != 0)) && (res == 0)) {
         errno = ENOSPC;
         return -1;
@@ -424,7 +443,9 @@ static ssize_t vfs_fat_read(void* ctx, int fd, void * dst, size_t size)
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
     unsigned read = 0;
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FRESULT res = f_read(file, dst, size, &read);
+    _lock_release(&fat_ctx->file_locks[fd]);
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
@@ -439,7 +460,7 @@ static ssize_t vfs_fat_pread(void *ctx, int fd, void *dst, size_t size, off_t of
 {
     ssize_t ret = -1;
     vfs_fat_ctx_t *fat_ctx = (vfs_fat_ctx_t *) ctx;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL *file = &fat_ctx->files[fd];
     const off_t prev_pos = f_tell(file);
 
@@ -471,7 +492,7 @@ static ssize_t vfs_fat_pread(void *ctx, int fd, void *dst, size_t size, off_t of
     }
 
 pread_release:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 }
 
@@ -479,7 +500,7 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
 {
     ssize_t ret = -1;
     vfs_fat_ctx_t *fat_ctx = (vfs_fat_ctx_t *) ctx;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL *file = &fat_ctx->files[fd];
     const off_t prev_pos = f_tell(file);
 
@@ -495,7 +516,7 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
     f_res = f_write(file, src, size, &wr);
     if (((wr == 0) && (size != 0)) && (f_res == 0)) {
         errno = ENOSPC;
-        return -1;
+        goto pwrite_release;
     }
     if (f_res == FR_OK) {
         ret = wr;
@@ -515,17 +536,17 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
     }
 
 pwrite_release:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 }
 
 static int vfs_fat_fsync(void* ctx, int fd)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL* file = &fat_ctx->files[fd];
     FRESULT res = f_sync(file);
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     int rc = 0;
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
@@ -539,6 +560,8 @@ static int vfs_fat_close(void* ctx, int fd)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     _lock_acquire(&fat_ctx->lock);
+    // wait for operations on this file started by other tasks
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL* file = &fat_ctx->files[fd];
 
 #ifdef CONFIG_FATFS_USE_FASTSEEK
@@ -548,6 +571,7 @@ static int vfs_fat_close(void* ctx, int fd)
 
     FRESULT res = f_close(file);
     file_cleanup(fat_ctx, fd);
+    _lock_release(&fat_ctx->file_locks[fd]);
     _lock_release(&fat_ctx->lock);
     int rc = 0;
     if (res != FR_OK) {
@@ -563,6 +587,7 @@ static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
     off_t new_pos;
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     if (mode == SEEK_SET) {
         new_pos = offset;
     } else if (mode == SEEK_CUR) {
@@ -572,12 +597,14 @@ static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
         off_t size = f_size(file);
         new_pos = size + offset;
     } else {
+        _lock_release(&fat_ctx->file_locks[fd]);
         errno = EINVAL;
         return -1;
     }
 
     ESP_LOGD(TAG, "%s: offset=%ld, filesize:=%d", __func__, new_pos, f_size(file));
     FRESULT res = f_lseek(file, new_pos);
+    _lock_release(&fat_ctx->file_locks[fd]);
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
@@ -1019,7 +1046,7 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
         return ret;
     }
 
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     file = &fat_ctx->files[fd];
     if (file == NULL) {
         ESP_LOGD(TAG, "ftruncate NULL file pointer");
@@ -1053,7 +1080,7 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
     }
 
 out:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 }
 
@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/**
+ * @file esp_batch_input interface file
+ */
+
+#ifndef __LWIP_ESP_BATCH_INPUT_H__
+#define __LWIP_ESP_BATCH_INPUT_H__
+
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Pass a received frame to the TCPIP task, batched with the frames received before it
+ *
+ * The frame is queued, and the TCPIP task is notified only if it isn't about to process
+ * the queue already. Same as netif->input() if CONFIG_LWIP_BATCH_INPUT is disabled,
+ * or if the netif input function isn't tcpip_input().
+ *
+ * @param p     the received frame
+ * @param netif the netif which received the frame
+ *
+ * @return ERR_OK if the frame was queued, the caller still owns the pbuf otherwise
+ */
+err_t esp_batch_input(struct pbuf *p, struct netif *netif);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__LWIP_ESP_BATCH_INPUT_H__
@@ -11,6 +11,7 @@
 #define __LWIP_ESP_PBUF_REF_H__
 
 #include <stddef.h>
+#include <stdint.h>
 #include "lwip/pbuf.h"
 #include "esp_netif.h"
 
@@ -18,6 +19,24 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Specific pbuf structure for pbufs referencing a received L2 buffer
+ */
+typedef struct esp_custom_pbuf
+{
+    struct pbuf_custom p;
+    esp_netif_t *esp_netif;
+    void* l2_buf;
+} esp_custom_pbuf_t;
+
+/**
+ * @brief Counters of the custom pbuf pool
+ */
+typedef struct esp_pbuf_pool_stats {
+    uint32_t hits;      /*!< Custom pbufs taken from the pool */
+    uint32_t misses;    /*!< Custom pbufs allocated from the heap, the pool being empty */
+} esp_pbuf_pool_stats_t;
+
 /**
  * @brief Allocate custom pbuf containing pointer to a private l2-free function
  *
@@ -25,6 +44,29 @@ extern "C" {
  */
 struct pbuf* esp_pbuf_allocate(esp_netif_t *esp_netif, void *buffer, size_t len, void *l2_buff);
 
+/**
+ * @brief Take a custom pbuf structure from the pool, or from the heap if the pool is empty
+ *
+ * @note Safe to call from any task, the pool is lock-free
+ *
+ * @return custom pbuf structure to be released with esp_custom_pbuf_free(), NULL if out of memory
+ */
+esp_custom_pbuf_t* esp_custom_pbuf_alloc(void);
+
+/**
+ * @brief Release a custom pbuf structure returned by esp_custom_pbuf_alloc()
+ *
+ * @note To be called from the custom_free_function(), after freeing the L2 buffer
+ */
+void esp_custom_pbuf_free(esp_custom_pbuf_t *esp_pbuf);
+
+/**
+ * @brief Get the custom pbuf pool counters
+ *
+ * @param[out] stats pool hits and misses since boot
+ */
+void esp_pbuf_pool_get_stats(esp_pbuf_pool_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,157 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+/**
+ * @file esp_batch_input
+ * This file queues the frames received by the netif glue, so that a burst of frames
+ * is passed to the tcpip thread with a single mailbox message
+ */
+
+#include <stdatomic.h>
+#include "sdkconfig.h"
+#include "lwip/opt.h"
+#include "lwip/ip.h"
+#include "lwip/tcpip.h"
+#include "netif/ethernet.h"
+#include "netif/esp_batch_input.h"
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_LWIP_BATCH_INPUT
+
+#define BATCH_INPUT_QUEUE_SIZE  CONFIG_LWIP_BATCH_INPUT_QUEUE_SIZE
+
+typedef struct batch_input_frame {
+    struct pbuf *p;
+    struct netif *netif;
+} batch_input_frame_t;
+
+static batch_input_frame_t s_queue[BATCH_INPUT_QUEUE_SIZE];
+static unsigned int s_queue_head;
+static unsigned int s_queue_len;
+/* Set while s_msg is in the tcpip mailbox or being processed, so it's posted once per burst */
+static bool s_scheduled;
+static portMUX_TYPE s_queue_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct tcpip_callback_msg *_Atomic s_msg;
+
+static bool batch_input_pop(batch_input_frame_t *frame)
+{
+    bool ret = false;
+    portENTER_CRITICAL(&s_queue_lock);
+    if (s_queue_len > 0) {
+        *frame = s_queue[s_queue_head];
+        s_queue_head = (s_queue_head + 1) % BATCH_INPUT_QUEUE_SIZE;
+        s_queue_len--;
+        ret = true;
+    } else {
+        s_scheduled = false;
+    }
+    portEXIT_CRITICAL(&s_queue_lock);
+    return ret;
+}
+
+/**
+ * @brief Process the queued frames, in the tcpip thread
+ *
+ * At most one queue length is processed per message, so that a continuous stream
+ * of frames doesn't hold back the other messages of the tcpip mailbox. If the message
+ * can't be posted again, the queue is processed until it's empty instead.
+ */
+static void batch_input_process(void *ctx)
+{
+    batch_input_frame_t frame;
+    do {
+        for (int i = 0; i < BATCH_INPUT_QUEUE_SIZE; i++) {
+            if (!batch_input_pop(&frame)) {
+                return;
+            }
+            /* same dispatch as tcpip_input() */
+#if LWIP_ETHERNET
+            if (frame.netif->flags & (NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET)) {
+                if (ethernet_input(frame.p, frame.netif) != ERR_OK) {
+                    pbuf_free(frame.p);
+                }
+            } else
+#endif
+            if (ip_input(frame.p, frame.netif) != ERR_OK) {
+                pbuf_free(frame.p);
+            }
+        }
+        /* if the mailbox is full, nothing else would process the queue, so carry on here */
+    } while (tcpip_callbackmsg_trycallback(s_msg) != ERR_OK);
+}
+
+/**
+ * @brief Drop the queued frames, after failing to post the message which would process them
+ *
+ * The frames queued by other callers were accepted already, so they're freed here,
+ * except for the caller's own frame which is freed by the caller.
+ */
+static void batch_input_drop(struct pbuf *p)
+{
+    batch_input_frame_t frame;
+    while (batch_input_pop(&frame)) {
+        if (frame.p != p) {
+            pbuf_free(frame.p);
+        }
+    }
+}
+
+static struct tcpip_callback_msg *batch_input_msg(void)
+{
+    struct tcpip_callback_msg *msg = atomic_load(&s_msg);
+    if (msg == NULL) {
+        struct tcpip_callback_msg *expected = NULL;
+        msg = tcpip_callbackmsg_new(batch_input_process, NULL);
+        if (msg != NULL && !atomic_compare_exchange_strong(&s_msg, &expected, msg)) {
+            tcpip_callbackmsg_delete(msg);
+            msg = expected;
+        }
+    }
+    return msg;
+}
+
+err_t esp_batch_input(struct pbuf *p, struct netif *netif)
+{
+    if (netif->input != tcpip_input) {
+        return netif->input(p, netif);
+    }
+    struct tcpip_callback_msg *msg = batch_input_msg();
+    if (msg == NULL) {
+        return netif->input(p, netif);
+    }
+
+    bool post = false;
+    portENTER_CRITICAL(&s_queue_lock);
+    if (s_queue_len == BATCH_INPUT_QUEUE_SIZE) {
+        portEXIT_CRITICAL(&s_queue_lock);
+        return ERR_MEM;
+    }
+    s_queue[(s_queue_head + s_queue_len) % BATCH_INPUT_QUEUE_SIZE] = (batch_input_frame_t) {
+        .p = p,
+        .netif = netif,
+    };
+    s_queue_len++;
+    if (!s_scheduled) {
+        s_scheduled = true;
+        post = true;
+    }
+    portEXIT_CRITICAL(&s_queue_lock);
+
+    if (post && tcpip_callbackmsg_trycallback(msg) != ERR_OK) {
+        /* tcpip mailbox full, drop the frames as tcpip_input() would */
+        batch_input_drop(p);
+        return ERR_MEM;
+    }
+    return ERR_OK;
+}
+
+#else
+
+err_t esp_batch_input(struct pbuf *p, struct netif *netif)
+{
+    return netif->input(p, netif);
+}
+
+#endif /* CONFIG_LWIP_BATCH_INPUT */
@@ -9,20 +9,84 @@
  * and the L2 free function esp_netif_free_rx_buffer()
  */
 
+#include <stdatomic.h>
+#include "sdkconfig.h"
 #include "netif/esp_pbuf_ref.h"
 #include "esp_netif_net_stack.h"
 #include "lwip/mem.h"
 
+#if CONFIG_LWIP_ESP_PBUF_POOL_SIZE > 0
+#define ESP_PBUF_POOL_SIZE  CONFIG_LWIP_ESP_PBUF_POOL_SIZE
+
 /**
- * @brief Specific pbuf structure for pbufs allocated by ESP netif
- * of PBUF_REF type
+ * Preallocated custom pbufs, one is taken for every received frame.
+ *
+ * The free ones form a stack, linked by index + 1 through s_pool_next. The low half of
+ * s_pool_head is the index + 1 of the top (0 if empty), the high half counts the updates,
+ * so that a pop racing with a pop and push of the same entry fails its compare-exchange.
+ * Entries which were never used are handed out from s_pool_fresh, so the pool needs no init.
  */
-typedef struct esp_custom_pbuf
+static esp_custom_pbuf_t s_pool[ESP_PBUF_POOL_SIZE];
+static atomic_ushort s_pool_next[ESP_PBUF_POOL_SIZE];
+static atomic_uint s_pool_head;
+static atomic_uint s_pool_fresh;
+
+#define POOL_HEAD_INDEX(head)       ((head) & 0xffff)
+#define POOL_HEAD_NEXT(head, index) ((((head) + 0x10000) & 0xffff0000) | (index))
+#endif
+
+static atomic_uint s_pool_hits;
+static atomic_uint s_pool_misses;
+
+esp_custom_pbuf_t* esp_custom_pbuf_alloc(void)
+{
+#if CONFIG_LWIP_ESP_PBUF_POOL_SIZE > 0
+    unsigned int index;
+    unsigned int head = atomic_load(&s_pool_head);
+    do {
+        index = POOL_HEAD_INDEX(head);
+        if (index == 0) {
+            break;
+        }
+    } while (!atomic_compare_exchange_weak(&s_pool_head, &head, POOL_HEAD_NEXT(head, atomic_load_explicit(&s_pool_next[index - 1], memory_order_relaxed))));
+
+    if (index == 0) {
+        unsigned int fresh = atomic_load(&s_pool_fresh);
+        while (fresh < ESP_PBUF_POOL_SIZE && !atomic_compare_exchange_weak(&s_pool_fresh, &fresh, fresh + 1)) {
+        }
+        if (fresh < ESP_PBUF_POOL_SIZE) {
+            index = fresh + 1;
+        }
+    }
+    if (index != 0) {
+        atomic_fetch_add_explicit(&s_pool_hits, 1, memory_order_relaxed);
+        return &s_pool[index - 1];
+    }
+#endif
+    atomic_fetch_add_explicit(&s_pool_misses, 1, memory_order_relaxed);
+    return mem_malloc(sizeof(esp_custom_pbuf_t));
+}
+
+void esp_custom_pbuf_free(esp_custom_pbuf_t *esp_pbuf)
+{
+#if CONFIG_LWIP_ESP_PBUF_POOL_SIZE > 0
+    if (esp_pbuf >= s_pool && esp_pbuf < s_pool + ESP_PBUF_POOL_SIZE) {
+        unsigned int index = esp_pbuf - s_pool + 1;
+        unsigned int head = atomic_load(&s_pool_head);
+        do {
+            atomic_store_explicit(&s_pool_next[index - 1], POOL_HEAD_INDEX(head), memory_order_relaxed);
+        } while (!atomic_compare_exchange_weak(&s_pool_head, &head, POOL_HEAD_NEXT(head, index)));
+        return;
+    }
+#endif
+    mem_free(esp_pbuf);
+}
+
+void esp_pbuf_pool_get_stats(esp_pbuf_pool_stats_t *stats)
 {
-    struct pbuf_custom p;
-    esp_netif_t *esp_netif;
-    void* l2_buf;
-} esp_custom_pbuf_t;
+    stats->hits = atomic_load_explicit(&s_pool_hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&s_pool_misses, memory_order_relaxed);
+}
 
 /**
  * @brief Free custom pbuf containing the L2 layer buffer allocated in the driver
@@ -34,7 +98,7 @@ static void esp_pbuf_free(struct pbuf *pbuf)
 {
     esp_custom_pbuf_t* esp_pbuf = (esp_custom_pbuf_t*)pbuf;
     esp_netif_free_rx_buffer(esp_pbuf->esp_netif, esp_pbuf->l2_buf);
-    mem_free(pbuf);
+    esp_custom_pbuf_free(esp_pbuf);
 }
 
 
@@ -42,7 +106,7 @@ struct pbuf* esp_pbuf_allocate(esp_netif_t *esp_netif, void *buffer, size_t len,
 {
     struct pbuf *p;
 
-    esp_custom_pbuf_t* esp_pbuf  = mem_malloc(sizeof(esp_custom_pbuf_t));
+    esp_custom_pbuf_t* esp_pbuf  = esp_custom_pbuf_alloc();
     if (esp_pbuf == NULL) {
         return NULL;
     }
@@ -51,7 +115,7 @@ struct pbuf* esp_pbuf_allocate(esp_netif_t *esp_netif, void *buffer, size_t len,
     esp_pbuf->l2_buf = l2_buff;
     p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &esp_pbuf->p, buffer, len);
     if (p == NULL) {
-        mem_free(esp_pbuf);
+        esp_custom_pbuf_free(esp_pbuf);
         return NULL;
     }
     return p;
@@ -53,6 +53,7 @@
 #include "esp_netif_net_stack.h"
 #include "esp_compiler.h"
 #include "netif/esp_pbuf_ref.h"
+#include "netif/esp_batch_input.h"
 
 /* Define those to better describe your network interface. */
 #define IFNAME0 'e'
@@ -165,7 +166,7 @@ void ethernetif_input(void *h, void *buffer, size_t len, void *l2_buff)
         return;
     }
     /* full packet send to tcpip_thread to process */
-    if (unlikely(netif->input(p, netif) != ERR_OK)) {
+    if (unlikely(esp_batch_input(p, netif) != ERR_OK)) {
         LWIP_DEBUGF(NETIF_DEBUG, ("ethernetif_input: IP input error\n"));
         pbuf_free(p);
     }
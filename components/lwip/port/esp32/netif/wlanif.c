@@ -30,14 +30,9 @@
 #include "esp_netif_net_stack.h"
 #include "esp_compiler.h"
 #include "netif/esp_pbuf_ref.h"
+#include "netif/esp_batch_input.h"
 
 
-typedef struct wifi_custom_pbuf
-{
-    struct pbuf_custom p;
-    void* l2_buf;
-} wifi_custom_pbuf_t;
-
 static struct netif *s_wifi_netifs[2] = { NULL };
 
 
@@ -89,27 +84,28 @@ err_t set_wifi_netif(int wifi_inx, void* netif)
 
 static void wifi_pbuf_free(struct pbuf *p)
 {
-  wifi_custom_pbuf_t* wifi_pbuf = (wifi_custom_pbuf_t*)p;
+  esp_custom_pbuf_t* wifi_pbuf = (esp_custom_pbuf_t*)p;
   if (wifi_pbuf) {
     esp_wifi_internal_free_rx_buffer(wifi_pbuf->l2_buf);
+    esp_custom_pbuf_free(wifi_pbuf);
   }
-  mem_free(wifi_pbuf);
 }
 
 static inline struct pbuf* wifi_pbuf_allocate(struct netif *netif, void *buffer, size_t len, void *l2_buff)
 {
   struct pbuf *p;
 
-  wifi_custom_pbuf_t* esp_pbuf = mem_malloc(sizeof(wifi_custom_pbuf_t));
+  esp_custom_pbuf_t* esp_pbuf = esp_custom_pbuf_alloc();
 
   if (esp_pbuf == NULL) {
     return NULL;
   }
   esp_pbuf->p.custom_free_function = wifi_pbuf_free;
+  esp_pbuf->esp_netif = NULL;
   esp_pbuf->l2_buf = l2_buff;
   p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &esp_pbuf->p, buffer, len);
   if (p == NULL) {
-    mem_free(esp_pbuf);
+    esp_custom_pbuf_free(esp_pbuf);
     return NULL;
   }
   return p;
@@ -134,7 +130,7 @@ esp_err_t wifi_rxcb_sta(void *buffer, uint16_t len, void *l2_buff)
   }
 
   /* full packet send to tcpip_thread to process */
-  if (unlikely(netif->input(p, netif) != ERR_OK)) {
+  if (unlikely(esp_batch_input(p, netif) != ERR_OK)) {
     LWIP_DEBUGF(NETIF_DEBUG, ("wlanif_input: IP input error\n"));
     pbuf_free(p);
   }
@@ -160,7 +156,7 @@ esp_err_t wifi_rxcb_ap(void *buffer, uint16_t len, void *l2_buff)
   }
 
   /* full packet send to tcpip_thread to process */
-  if (unlikely(netif->input(p, netif) != ERR_OK)) {
+  if (unlikely(esp_batch_input(p, netif) != ERR_OK)) {
     LWIP_DEBUGF(NETIF_DEBUG, ("wlanif_input: IP input error\n"));
     pbuf_free(p);
   }
@@ -210,7 +206,7 @@ wlanif_input(void *h, void *buffer, size_t len, void* l2_buff)
 #endif
 
   /* full packet send to tcpip_thread to process */
-  if (unlikely(netif->input(p, netif) != ERR_OK)) {
+  if (unlikely(esp_batch_input(p, netif) != ERR_OK)) {
     LWIP_DEBUGF(NETIF_DEBUG, ("wlanif_input: IP input error\n"));
     pbuf_free(p);
   }
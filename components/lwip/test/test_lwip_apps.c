@@ -5,6 +5,9 @@
  */
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include <stdatomic.h>
+#include "esp_timer.h"
 #include "test_utils.h"
 #include "unity.h"
 #include "lwip/inet.h"
@@ -12,6 +15,9 @@
 #include "lwip/sockets.h"
 #include "ping/ping_sock.h"
 #include "dhcpserver/dhcpserver.h"
+#include "lwip/tcpip.h"
+#include "netif/esp_batch_input.h"
+#include "netif/esp_pbuf_ref.h"
 
 #define ETH_PING_END_BIT BIT(1)
 #define ETH_PING_DURATION_MS (5000)
@@ -142,3 +148,256 @@ TEST_CASE("dhcp server start/stop on localhost", "[lwip]")
     TEST_ASSERT(dhcps_stop(dhcps, netif) == ERR_OK);
     dhcps_delete(dhcps);
 }
+
+#define BATCH_INPUT_FRAMES (5000)
+
+static void test_input_done(void *ctx)
+{
+    xSemaphoreGive((SemaphoreHandle_t)ctx);
+}
+
+static uint32_t test_input_rate(struct netif *netif, bool batched, SemaphoreHandle_t done, int *dropped)
+{
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BATCH_INPUT_FRAMES; i++) {
+        struct pbuf *p = pbuf_alloc(PBUF_RAW, 20, PBUF_RAM);
+        TEST_ASSERT_NOT_NULL(p);
+        // IP version 0, so ip_input() drops it right away: only the handover to the tcpip task is measured
+        memset(p->payload, 0, p->len);
+        if ((batched ? esp_batch_input(p, netif) : netif->input(p, netif)) != ERR_OK) {
+            pbuf_free(p);
+            (*dropped)++;
+        }
+    }
+    // A batch may be posted again behind the first callback, never behind the second one
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT(tcpip_callback(test_input_done, done) == ERR_OK);
+        TEST_ASSERT(xSemaphoreTake(done, pdMS_TO_TICKS(5000)) == pdTRUE);
+    }
+    return (uint64_t)BATCH_INPUT_FRAMES * 1000000 / (esp_timer_get_time() - start);
+}
+
+TEST_CASE("batched input throughput on localhost", "[lwip]")
+{
+    test_case_uses_tcpip();
+    SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(done);
+    struct netif *netif;
+
+    NETIF_FOREACH(netif) {
+        if (netif->name[0] == 'l' && netif->name[1] == 'o') {
+            break;
+        }
+    }
+    TEST_ASSERT_NOT_NULL(netif);
+
+    int dropped = 0;
+    uint32_t rate = test_input_rate(netif, false, done, &dropped);
+    printf("netif input: %d frames/s, %d dropped\n", rate, dropped);
+    dropped = 0;
+    rate = test_input_rate(netif, true, done, &dropped);
+    printf("batched input: %d frames/s, %d dropped\n", rate, dropped);
+    vSemaphoreDelete(done);
+}
+
+#if CONFIG_LWIP_ESP_PBUF_POOL_SIZE > 0
+#define PBUF_POOL_TASK_ROUNDS   20000
+#define PBUF_POOL_TASK_PBUFS    4
+
+TEST_CASE("custom pbuf pool is used until exhausted and refilled", "[lwip]")
+{
+    esp_custom_pbuf_t *pbufs[CONFIG_LWIP_ESP_PBUF_POOL_SIZE + 1];
+    esp_pbuf_pool_stats_t before, after;
+
+    for (int round = 0; round < 2; round++) {
+        esp_pbuf_pool_get_stats(&before);
+        for (int i = 0; i < CONFIG_LWIP_ESP_PBUF_POOL_SIZE; i++) {
+            pbufs[i] = esp_custom_pbuf_alloc();
+            TEST_ASSERT_NOT_NULL(pbufs[i]);
+            for (int j = 0; j < i; j++) {
+                TEST_ASSERT_NOT_EQUAL(pbufs[j], pbufs[i]);
+            }
+        }
+        esp_pbuf_pool_get_stats(&after);
+        TEST_ASSERT_EQUAL(CONFIG_LWIP_ESP_PBUF_POOL_SIZE, after.hits - before.hits);
+        TEST_ASSERT_EQUAL(0, after.misses - before.misses);
+
+        /* The pool is empty, the next one comes from the heap */
+        pbufs[CONFIG_LWIP_ESP_PBUF_POOL_SIZE] = esp_custom_pbuf_alloc();
+        TEST_ASSERT_NOT_NULL(pbufs[CONFIG_LWIP_ESP_PBUF_POOL_SIZE]);
+        esp_pbuf_pool_get_stats(&after);
+        TEST_ASSERT_EQUAL(CONFIG_LWIP_ESP_PBUF_POOL_SIZE, after.hits - before.hits);
+        TEST_ASSERT_EQUAL(1, after.misses - before.misses);
+
+        /* Released in a different order, the second round takes them again */
+        for (int i = CONFIG_LWIP_ESP_PBUF_POOL_SIZE; i >= 0; i -= 2) {
+            esp_custom_pbuf_free(pbufs[i]);
+        }
+        for (int i = CONFIG_LWIP_ESP_PBUF_POOL_SIZE - 1; i >= 0; i -= 2) {
+            esp_custom_pbuf_free(pbufs[i]);
+        }
+    }
+}
+
+typedef struct {
+    SemaphoreHandle_t done;
+    int errors;
+} pbuf_pool_task_t;
+
+/* Takes a few pbufs at a time and marks them, a pbuf handed out twice gets the mark of the other task */
+static void pbuf_pool_task(void *arg)
+{
+    pbuf_pool_task_t *task = arg;
+    esp_custom_pbuf_t *pbufs[PBUF_POOL_TASK_PBUFS];
+    for (int round = 0; round < PBUF_POOL_TASK_ROUNDS; round++) {
+        for (int i = 0; i < PBUF_POOL_TASK_PBUFS; i++) {
+            pbufs[i] = esp_custom_pbuf_alloc();
+            if (pbufs[i] == NULL) {
+                task->errors++;
+                continue;
+            }
+            pbufs[i]->l2_buf = task;
+        }
+        for (int i = 0; i < PBUF_POOL_TASK_PBUFS; i++) {
+            if (pbufs[i] == NULL) {
+                continue;
+            }
+            if (pbufs[i]->l2_buf != task) {
+                task->errors++;
+            }
+            esp_custom_pbuf_free(pbufs[i]);
+        }
+        if (round % 1000 == 0) {
+            vTaskDelay(1);
+        }
+    }
+    xSemaphoreGive(task->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("custom pbuf pool is shared by concurrent tasks", "[lwip]")
+{
+    pbuf_pool_task_t tasks[2];
+    esp_pbuf_pool_stats_t before, after;
+
+    esp_pbuf_pool_get_stats(&before);
+    for (int i = 0; i < 2; i++) {
+        tasks[i].done = xSemaphoreCreateBinary();
+        TEST_ASSERT_NOT_NULL(tasks[i].done);
+        tasks[i].errors = 0;
+        xTaskCreatePinnedToCore(pbuf_pool_task, "pbuf_pool", 2048, &tasks[i], uxTaskPriorityGet(NULL),
+                                NULL, i % portNUM_PROCESSORS);
+    }
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT(xSemaphoreTake(tasks[i].done, pdMS_TO_TICKS(10000)) == pdTRUE);
+        vSemaphoreDelete(tasks[i].done);
+        TEST_ASSERT_EQUAL(0, tasks[i].errors);
+    }
+    esp_pbuf_pool_get_stats(&after);
+    TEST_ASSERT_EQUAL(2 * PBUF_POOL_TASK_ROUNDS * PBUF_POOL_TASK_PBUFS,
+                      (after.hits - before.hits) + (after.misses - before.misses));
+
+    /* None got lost, the whole pool is available again */
+    esp_custom_pbuf_t *pbufs[CONFIG_LWIP_ESP_PBUF_POOL_SIZE];
+    esp_pbuf_pool_get_stats(&before);
+    for (int i = 0; i < CONFIG_LWIP_ESP_PBUF_POOL_SIZE; i++) {
+        pbufs[i] = esp_custom_pbuf_alloc();
+    }
+    esp_pbuf_pool_get_stats(&after);
+    TEST_ASSERT_EQUAL(0, after.misses - before.misses);
+    for (int i = 0; i < CONFIG_LWIP_ESP_PBUF_POOL_SIZE; i++) {
+        esp_custom_pbuf_free(pbufs[i]);
+    }
+}
+#endif /* CONFIG_LWIP_ESP_PBUF_POOL_SIZE > 0 */
+
+#define BATCH_INPUT_FULL_FRAMES (64)
+
+typedef struct {
+    struct pbuf_custom pc;
+    uint8_t data[20];
+} test_input_frame_t;
+
+static atomic_int s_frames_freed;
+
+static void test_input_frame_free(struct pbuf *p)
+{
+    free(p);
+    atomic_fetch_add(&s_frames_freed, 1);
+}
+
+static void test_input_block(void *ctx)
+{
+    SemaphoreHandle_t *sem = ctx;
+    xSemaphoreGive(sem[0]);
+    xSemaphoreTake(sem[1], portMAX_DELAY);
+}
+
+static void test_input_noop(void *ctx)
+{
+}
+
+static int test_input_frames(struct netif *netif, int count)
+{
+    int dropped = 0;
+    for (int i = 0; i < count; i++) {
+        test_input_frame_t *frame = calloc(1, sizeof(test_input_frame_t));
+        TEST_ASSERT_NOT_NULL(frame);
+        frame->pc.custom_free_function = test_input_frame_free;
+        struct pbuf *p = pbuf_alloced_custom(PBUF_RAW, sizeof(frame->data), PBUF_REF, &frame->pc, frame->data, sizeof(frame->data));
+        TEST_ASSERT_NOT_NULL(p);
+        // freed as the drivers do, if not accepted
+        if (esp_batch_input(p, netif) != ERR_OK) {
+            pbuf_free(p);
+            dropped++;
+        }
+    }
+    return dropped;
+}
+
+TEST_CASE("batched input frames are delivered or freed when the tcpip mailbox is full", "[lwip]")
+{
+    test_case_uses_tcpip();
+    SemaphoreHandle_t sem[2] = { xSemaphoreCreateBinary(), xSemaphoreCreateBinary() };
+    SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    TEST_ASSERT(sem[0] && sem[1] && done);
+    struct netif *netif;
+
+    NETIF_FOREACH(netif) {
+        if (netif->name[0] == 'l' && netif->name[1] == 'o') {
+            break;
+        }
+    }
+    TEST_ASSERT_NOT_NULL(netif);
+    atomic_store(&s_frames_freed, 0);
+
+    // Block the tcpip task and fill its mailbox
+    TEST_ASSERT(tcpip_callback(test_input_block, sem) == ERR_OK);
+    TEST_ASSERT(xSemaphoreTake(sem[0], pdMS_TO_TICKS(5000)) == pdTRUE);
+    int filled = 0;
+    while (tcpip_try_callback(test_input_noop, NULL) == ERR_OK) {
+        filled++;
+    }
+    TEST_ASSERT_GREATER_THAN(0, filled);
+
+    int dropped = test_input_frames(netif, BATCH_INPUT_FULL_FRAMES);
+#if CONFIG_LWIP_BATCH_INPUT
+    // Nothing can process the queued frames, so they're all refused
+    TEST_ASSERT_EQUAL(BATCH_INPUT_FULL_FRAMES, dropped);
+#endif
+    TEST_ASSERT_EQUAL(dropped, atomic_load(&s_frames_freed));
+
+    // Once the mailbox drains, the frames are delivered again
+    xSemaphoreGive(sem[1]);
+    dropped += test_input_frames(netif, BATCH_INPUT_FULL_FRAMES);
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT(tcpip_callback(test_input_done, done) == ERR_OK);
+        TEST_ASSERT(xSemaphoreTake(done, pdMS_TO_TICKS(5000)) == pdTRUE);
+    }
+    printf("%d frames, %d dropped\n", 2 * BATCH_INPUT_FULL_FRAMES, dropped);
+    TEST_ASSERT_EQUAL(2 * BATCH_INPUT_FULL_FRAMES, atomic_load(&s_frames_freed));
+
+    vSemaphoreDelete(sem[0]);
+    vSemaphoreDelete(sem[1]);
+    vSemaphoreDelete(done);
+}
@@ -356,6 +356,27 @@ esp_err_t sdmmc_send_cmd_send_status(sdmmc_card_t* card, uint32_t* out_status)
     return ESP_OK;
 }
 
+/* Allocate a DMA-capable buffer for up to CONFIG_SDMMC_BOUNCE_BUFFER_SECTORS
+ * blocks. If memory is low, a smaller buffer is allocated.
+ * Returns the number of blocks which fit into the buffer.
+ */
+static size_t alloc_bounce_buffer(size_t block_size, size_t block_count, void** out_buf)
+{
+    size_t count = MIN(block_count, CONFIG_SDMMC_BOUNCE_BUFFER_SECTORS);
+    if (count == 0) {
+        count = 1;
+    }
+    *out_buf = NULL;
+    while (count > 0) {
+        *out_buf = heap_caps_malloc(count * block_size, MALLOC_CAP_DMA);
+        if (*out_buf != NULL) {
+            break;
+        }
+        count /= 2;
+    }
+    return count;
+}
+
 esp_err_t sdmmc_write_sectors(sdmmc_card_t* card, const void* src,
         size_t start_block, size_t block_count)
 {
@@ -364,20 +385,22 @@ esp_err_t sdmmc_write_sectors(sdmmc_card_t* card, const void* src,
     if (esp_ptr_dma_capable(src) && (intptr_t)src % 4 == 0) {
         err = sdmmc_write_sectors_dma(card, src, start_block, block_count);
     } else {
-        // SDMMC peripheral needs DMA-capable buffers. Split the write into
-        // separate single block writes, if needed, and allocate a temporary
-        // DMA-capable buffer.
-        void* tmp_buf = heap_caps_malloc(block_size, MALLOC_CAP_DMA);
+        // SDMMC peripheral needs DMA-capable buffers. Copy the data through
+        // a temporary DMA-capable buffer, several blocks at a time, so that
+        // multi-block writes are still used.
+        void* tmp_buf = NULL;
+        size_t tmp_blocks = alloc_bounce_buffer(block_size, block_count, &tmp_buf);
         if (tmp_buf == NULL) {
             return ESP_ERR_NO_MEM;
         }
         const uint8_t* cur_src = (const uint8_t*) src;
-        for (size_t i = 0; i < block_count; ++i) {
-            memcpy(tmp_buf, cur_src, block_size);
-            cur_src += block_size;
-            err = sdmmc_write_sectors_dma(card, tmp_buf, start_block + i, 1);
+        for (size_t i = 0; i < block_count; i += tmp_blocks) {
+            size_t count = MIN(tmp_blocks, block_count - i);
+            memcpy(tmp_buf, cur_src, count * block_size);
+            cur_src += count * block_size;
+            err = sdmmc_write_sectors_dma(card, tmp_buf, start_block + i, count);
             if (err != ESP_OK) {
-                ESP_LOGD(TAG, "%s: error 0x%x writing block %d+%d",
+                ESP_LOGD(TAG, "%s: error 0x%x writing blocks %d+%d",
                         __func__, err, start_block, i);
                 break;
             }
@@ -461,23 +484,25 @@ esp_err_t sdmmc_read_sectors(sdmmc_card_t* card, void* dst,
     if (esp_ptr_dma_capable(dst) && (intptr_t)dst % 4 == 0) {
         err = sdmmc_read_sectors_dma(card, dst, start_block, block_count);
     } else {
-        // SDMMC peripheral needs DMA-capable buffers. Split the read into
-        // separate single block reads, if needed, and allocate a temporary
-        // DMA-capable buffer.
-        void* tmp_buf = heap_caps_malloc(block_size, MALLOC_CAP_DMA);
+        // SDMMC peripheral needs DMA-capable buffers. Read the data into
+        // a temporary DMA-capable buffer, several blocks at a time, so that
+        // multi-block reads are still used.
+        void* tmp_buf = NULL;
+        size_t tmp_blocks = alloc_bounce_buffer(block_size, block_count, &tmp_buf);
         if (tmp_buf == NULL) {
             return ESP_ERR_NO_MEM;
         }
         uint8_t* cur_dst = (uint8_t*) dst;
-        for (size_t i = 0; i < block_count; ++i) {
-            err = sdmmc_read_sectors_dma(card, tmp_buf, start_block + i, 1);
+        for (size_t i = 0; i < block_count; i += tmp_blocks) {
+            size_t count = MIN(tmp_blocks, block_count - i);
+            err = sdmmc_read_sectors_dma(card, tmp_buf, start_block + i, count);
             if (err != ESP_OK) {
-                ESP_LOGD(TAG, "%s: error 0x%x writing block %d+%d",
+                ESP_LOGD(TAG, "%s: error 0x%x reading blocks %d+%d",
                         __func__, err, start_block, i);
                 break;
             }
-            memcpy(cur_dst, tmp_buf, block_size);
-            cur_dst += block_size;
+            memcpy(cur_dst, tmp_buf, count * block_size);
+            cur_dst += count * block_size;
         }
         free(tmp_buf);
     }
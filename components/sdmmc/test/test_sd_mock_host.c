@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "driver/sdmmc_defs.h"
+#include "driver/sdmmc_types.h"
+#include "sdmmc_cmd.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "soc/soc_memory_layout.h"
+
+/* Mock host which keeps the card contents in RAM and counts the commands
+ * issued by the protocol layer. Doesn't need any hardware.
+ */
+
+#define MOCK_CARD_BLOCK_SIZE    512
+#define MOCK_CARD_BLOCKS        256
+
+typedef struct {
+    uint8_t* data;
+    size_t single_reads;
+    size_t multi_reads;
+    size_t single_writes;
+    size_t multi_writes;
+    bool bad_buffer;
+} mock_card_t;
+
+static mock_card_t s_mock_card;
+
+static esp_err_t mock_do_transaction(int slot, sdmmc_command_t* cmd)
+{
+    (void) slot;
+    cmd->error = ESP_OK;
+    memset(cmd->response, 0, sizeof(cmd->response));
+    switch (cmd->opcode) {
+    case MMC_SEND_STATUS:
+        cmd->response[0] = MMC_R1_READY_FOR_DATA;
+        return ESP_OK;
+    case MMC_READ_BLOCK_SINGLE:
+    case MMC_READ_BLOCK_MULTIPLE:
+    case MMC_WRITE_BLOCK_SINGLE:
+    case MMC_WRITE_BLOCK_MULTIPLE:
+        break;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!esp_ptr_dma_capable(cmd->data) || (intptr_t) cmd->data % 4 != 0) {
+        s_mock_card.bad_buffer = true;
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t* card_data = s_mock_card.data + cmd->arg * MOCK_CARD_BLOCK_SIZE;
+    switch (cmd->opcode) {
+    case MMC_READ_BLOCK_SINGLE:
+        s_mock_card.single_reads++;
+        memcpy(cmd->data, card_data, cmd->datalen);
+        break;
+    case MMC_READ_BLOCK_MULTIPLE:
+        s_mock_card.multi_reads++;
+        memcpy(cmd->data, card_data, cmd->datalen);
+        break;
+    case MMC_WRITE_BLOCK_SINGLE:
+        s_mock_card.single_writes++;
+        memcpy(card_data, cmd->data, cmd->datalen);
+        break;
+    default:
+        s_mock_card.multi_writes++;
+        memcpy(card_data, cmd->data, cmd->datalen);
+        break;
+    }
+    return ESP_OK;
+}
+
+static void mock_card_init(sdmmc_card_t* card)
+{
+    memset(&s_mock_card, 0, sizeof(s_mock_card));
+    s_mock_card.data = calloc(MOCK_CARD_BLOCKS, MOCK_CARD_BLOCK_SIZE);
+    TEST_ASSERT_NOT_NULL(s_mock_card.data);
+
+    memset(card, 0, sizeof(*card));
+    card->host.flags = SDMMC_HOST_FLAG_4BIT;
+    card->host.do_transaction = &mock_do_transaction;
+    card->ocr = SD_OCR_SDHC_CAP;
+    card->csd.sector_size = MOCK_CARD_BLOCK_SIZE;
+    card->csd.capacity = MOCK_CARD_BLOCKS;
+}
+
+static void mock_card_reset_counters(void)
+{
+    s_mock_card.single_reads = 0;
+    s_mock_card.multi_reads = 0;
+    s_mock_card.single_writes = 0;
+    s_mock_card.multi_writes = 0;
+}
+
+TEST_CASE("unaligned buffers use multi-block transfers through bounce buffer", "[sd]")
+{
+    sdmmc_card_t card;
+    mock_card_init(&card);
+
+    const size_t block_count = 64;
+    const size_t start_block = 10;
+    const size_t buf_size = block_count * MOCK_CARD_BLOCK_SIZE;
+    uint8_t* src = heap_caps_malloc(buf_size + 1, MALLOC_CAP_DMA);
+    uint8_t* dst = heap_caps_malloc(buf_size + 1, MALLOC_CAP_DMA);
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(dst);
+    esp_fill_random(src, buf_size + 1);
+
+    /* Misaligned by one byte, so the protocol layer has to copy the data */
+    TEST_ESP_OK(sdmmc_write_sectors(&card, src + 1, start_block, block_count));
+    const size_t expected_cmds = (block_count + CONFIG_SDMMC_BOUNCE_BUFFER_SECTORS - 1) / CONFIG_SDMMC_BOUNCE_BUFFER_SECTORS;
+    printf("Wrote %d blocks: %d single-block, %d multi-block commands\n",
+            block_count, s_mock_card.single_writes, s_mock_card.multi_writes);
+    TEST_ASSERT_EQUAL(expected_cmds, s_mock_card.single_writes + s_mock_card.multi_writes);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(src + 1, s_mock_card.data + start_block * MOCK_CARD_BLOCK_SIZE, buf_size);
+
+    TEST_ESP_OK(sdmmc_read_sectors(&card, dst + 1, start_block, block_count));
+    printf("Read %d blocks: %d single-block, %d multi-block commands\n",
+            block_count, s_mock_card.single_reads, s_mock_card.multi_reads);
+    TEST_ASSERT_EQUAL(expected_cmds, s_mock_card.single_reads + s_mock_card.multi_reads);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(src + 1, dst + 1, buf_size);
+
+    /* Transfer which is not a multiple of the bounce buffer size */
+    mock_card_reset_counters();
+    TEST_ESP_OK(sdmmc_write_sectors(&card, src + 1, 0, CONFIG_SDMMC_BOUNCE_BUFFER_SECTORS + 1));
+    TEST_ESP_OK(sdmmc_read_sectors(&card, dst + 1, 0, CONFIG_SDMMC_BOUNCE_BUFFER_SECTORS + 1));
+    TEST_ASSERT_EQUAL(2, s_mock_card.single_writes + s_mock_card.multi_writes);
+    TEST_ASSERT_EQUAL(2, s_mock_card.single_reads + s_mock_card.multi_reads);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(src + 1, dst + 1, (CONFIG_SDMMC_BOUNCE_BUFFER_SECTORS + 1) * MOCK_CARD_BLOCK_SIZE);
+
+    /* Aligned DMA-capable buffers are passed to the host directly */
+    mock_card_reset_counters();
+    TEST_ESP_OK(sdmmc_write_sectors(&card, src, start_block, block_count));
+    TEST_ESP_OK(sdmmc_read_sectors(&card, dst, start_block, block_count));
+    TEST_ASSERT_EQUAL(1, s_mock_card.multi_writes);
+    TEST_ASSERT_EQUAL(1, s_mock_card.multi_reads);
+    TEST_ASSERT_FALSE(s_mock_card.bad_buffer);
+
+    free(src);
+    free(dst);
+    free(s_mock_card.data);
+}
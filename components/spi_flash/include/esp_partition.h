@@ -104,7 +104,7 @@ typedef struct esp_partition_iterator_opaque_* esp_partition_iterator_t;
  *
  * However, this is the format used by this API.
  */
-typedef struct {
+typedef struct esp_partition_t {
     esp_flash_t* flash_chip;            /*!< SPI flash chip on which the partition resides */
     esp_partition_type_t type;          /*!< partition type (app/data) */
     esp_partition_subtype_t subtype;    /*!< partition subtype */
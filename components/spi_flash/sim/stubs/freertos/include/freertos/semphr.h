@@ -16,6 +16,9 @@ extern "C" {
 #define xSemaphoreCreateMutex()                     ((void*)(1))
 #define xSemaphoreGive( xSemaphore )
 #define xSemaphoreTake( xSemaphore, xBlockTime )    pdTRUE
+#define xSemaphoreCreateRecursiveMutex()            ((void*)(1))
+#define xSemaphoreGiveRecursive( xSemaphore )
+#define xSemaphoreTakeRecursive( xSemaphore, xBlockTime )    pdTRUE
 
 typedef void* SemaphoreHandle_t;
 
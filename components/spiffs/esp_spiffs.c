@@ -92,6 +92,7 @@ static void esp_spiffs_free(esp_spiffs_t ** efs)
         SPIFFS_unmount(e->fs);
         free(e->fs);
     }
+    spiffs_index_deinit(&e->index);
     vSemaphoreDelete(e->lock);
     free(e->fds);
     free(e->cache);
@@ -217,7 +218,7 @@ static esp_err_t esp_spiffs_init(const esp_vfs_spiffs_conf_t* conf)
 
     efs->by_label = conf->partition_label != NULL;
 
-    efs->lock = xSemaphoreCreateMutex();
+    efs->lock = xSemaphoreCreateRecursiveMutex();
     if (efs->lock == NULL) {
         ESP_LOGE(TAG, "mutex lock could not be created");
         esp_spiffs_free(&efs);
@@ -283,6 +284,18 @@ static esp_err_t esp_spiffs_init(const esp_vfs_spiffs_conf_t* conf)
         esp_spiffs_free(&efs);
         return ESP_FAIL;
     }
+
+    if (spiffs_index_init(&efs->index, conf->index_size) != ESP_OK) {
+        ESP_LOGE(TAG, "name index could not be allocated");
+        esp_spiffs_free(&efs);
+        return ESP_ERR_NO_MEM;
+    }
+    res = spiffs_index_build(&efs->index, efs->fs);
+    if (res != SPIFFS_OK) {
+        // Not fatal, files which are not indexed are looked up by name
+        ESP_LOGW(TAG, "failed to build name index, %i", res);
+        SPIFFS_clearerr(efs->fs);
+    }
     _efs[index] = efs;
     return ESP_OK;
 }
@@ -372,6 +385,8 @@ esp_err_t esp_spiffs_format(const char* partition_label)
             SPIFFS_clearerr(_efs[index]->fs);
             return ESP_FAIL;
         }
+        (void) spiffs_index_build(&_efs[index]->index, _efs[index]->fs);
+        SPIFFS_clearerr(_efs[index]->fs);
     } else {
         esp_spiffs_free(&_efs[index]);
     }
@@ -528,7 +543,7 @@ static int vfs_spiffs_open(void* ctx, const char * path, int flags, int mode)
     assert(path);
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
     int spiffs_flags = spiffs_mode_conv(flags);
-    int fd = SPIFFS_open(efs->fs, path, spiffs_flags, mode);
+    int fd = spiffs_index_open(&efs->index, efs->fs, path, spiffs_flags, mode);
     if (fd < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -567,7 +582,7 @@ static ssize_t vfs_spiffs_read(void* ctx, int fd, void * dst, size_t size)
 static int vfs_spiffs_close(void* ctx, int fd)
 {
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    int res = SPIFFS_close(efs->fs, fd);
+    int res = spiffs_index_close(&efs->index, efs->fs, fd);
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -616,7 +631,7 @@ static int vfs_spiffs_stat(void* ctx, const char * path, struct stat * st)
     assert(st);
     spiffs_stat s;
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    off_t res = SPIFFS_stat(efs->fs, path, &s);
+    off_t res = spiffs_index_stat(&efs->index, efs->fs, path, &s);
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -637,7 +652,7 @@ static int vfs_spiffs_rename(void* ctx, const char *src, const char *dst)
     assert(src);
     assert(dst);
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    int res = SPIFFS_rename(efs->fs, src, dst);
+    int res = spiffs_index_rename(&efs->index, efs->fs, src, dst);
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -650,7 +665,7 @@ static int vfs_spiffs_unlink(void* ctx, const char *path)
 {
     assert(path);
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    int res = SPIFFS_remove(efs->fs, path);
+    int res = spiffs_index_remove(&efs->index, efs->fs, path);
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -707,6 +722,24 @@ static struct dirent* vfs_spiffs_readdir(void* ctx, DIR* pdir)
     return out_dirent;
 }
 
+/* Read the next entry of the directory. The error code of SPIFFS is shared by all tasks,
+ * so it is read and cleared under the filesystem lock: the end of the directory is then
+ * not confused with an error of another task, and the other task doesn't lose its error.
+ */
+static struct spiffs_dirent* vfs_spiffs_readdir_entry(esp_spiffs_t * efs, spiffs_DIR * d,
+                                                      struct spiffs_dirent* e, int* err)
+{
+    SPIFFS_LOCK(efs->fs);
+    struct spiffs_dirent* res = SPIFFS_readdir(d, e);
+    *err = 0;
+    if (res == NULL) {
+        *err = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
+        SPIFFS_clearerr(efs->fs);
+    }
+    SPIFFS_UNLOCK(efs->fs);
+    return res;
+}
+
 static int vfs_spiffs_readdir_r(void* ctx, DIR* pdir, struct dirent* entry,
                                 struct dirent** out_dirent)
 {
@@ -717,9 +750,9 @@ static int vfs_spiffs_readdir_r(void* ctx, DIR* pdir, struct dirent* entry,
     size_t plen;
     char * item_name;
     do {
-        if (SPIFFS_readdir(&dir->d, &out) == 0) {
-            errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
-            SPIFFS_clearerr(efs->fs);
+        int err;
+        if (vfs_spiffs_readdir_entry(efs, &dir->d, &out, &err) == NULL) {
+            errno = err;
             if (!errno) {
                 *out_dirent = NULL;
             }
@@ -768,9 +801,9 @@ static void vfs_spiffs_seekdir(void* ctx, DIR* pdir, long offset)
         dir->offset = 0;
     }
     while (dir->offset < offset) {
-        if (SPIFFS_readdir(&dir->d, &tmp) == 0) {
-            errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
-            SPIFFS_clearerr(efs->fs);
+        int err;
+        if (vfs_spiffs_readdir_entry(efs, &dir->d, &tmp, &err) == NULL) {
+            errno = err;
             return;
         }
         size_t plen = strlen(dir->path);
@@ -799,7 +832,7 @@ static int vfs_spiffs_truncate(void* ctx, const char *path, off_t length)
 {
     assert(path);
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    int fd = SPIFFS_open(efs->fs, path, SPIFFS_WRONLY, 0);
+    int fd = spiffs_index_open(&efs->index, efs->fs, path, SPIFFS_WRONLY, 0);
     if (fd < 0) {
         goto err;
     }
@@ -810,7 +843,7 @@ static int vfs_spiffs_truncate(void* ctx, const char *path, off_t length)
         goto err;
     }
 
-    res = SPIFFS_close(efs->fs, fd);
+    res = spiffs_index_close(&efs->index, efs->fs, fd);
     if (res < 0) {
        goto err;
     }
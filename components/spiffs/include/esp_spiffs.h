@@ -22,6 +22,9 @@ typedef struct {
         const char* partition_label;    /*!< Optional, label of SPIFFS partition to use. If set to NULL, first partition with subtype=spiffs will be used. */
         size_t max_files;               /*!< Maximum files that could be open at the same time. */
         bool format_if_mount_failed;    /*!< If true, it will format the file system if it fails to mount. */
+        size_t index_size;              /*!< Optional, number of files kept in the RAM name index (16 bytes per file).
+                                             Indexed files are opened without reading the headers of all files.
+                                             If set to 0, the index is disabled. */
 } esp_vfs_spiffs_conf_t;
 
 /**
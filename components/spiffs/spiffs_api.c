@@ -15,12 +15,12 @@ static const char* TAG = "SPIFFS";
 
 void spiffs_api_lock(spiffs *fs)
 {
-    (void) xSemaphoreTake(((esp_spiffs_t *)(fs->user_data))->lock, portMAX_DELAY);
+    (void) xSemaphoreTakeRecursive(((esp_spiffs_t *)(fs->user_data))->lock, portMAX_DELAY);
 }
 
 void spiffs_api_unlock(spiffs *fs)
 {
-    xSemaphoreGive(((esp_spiffs_t *)(fs->user_data))->lock);
+    xSemaphoreGiveRecursive(((esp_spiffs_t *)(fs->user_data))->lock);
 }
 
 s32_t spiffs_api_read(spiffs *fs, uint32_t addr, uint32_t size, uint8_t *dst)
@@ -14,6 +14,7 @@
 #include "spiffs.h"
 #include "esp_vfs.h"
 #include "esp_compiler.h"
+#include "spiffs_index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,7 +25,7 @@ extern "C" {
  */
 typedef struct {
     spiffs *fs;                             /*!< Handle to the underlying SPIFFS */
-    SemaphoreHandle_t lock;                 /*!< FS lock */
+    SemaphoreHandle_t lock;                 /*!< FS lock, recursive so that a SPIFFS call and reading its error code can be done under it */
     const esp_partition_t* partition;       /*!< The partition on which SPIFFS is located */
     char base_path[ESP_VFS_PATH_MAX+1];     /*!< Mount point */
     bool by_label;                          /*!< Partition was mounted by label */
@@ -34,6 +35,7 @@ typedef struct {
     uint32_t fds_sz;                        /*!< File Descriptor Buffer Length */
     uint8_t *cache;                         /*!< Cache Buffer */
     uint32_t cache_sz;                      /*!< Cache Buffer Length */
+    spiffs_index_t index;                   /*!< Name to object id index */
 } esp_spiffs_t;
 
 s32_t spiffs_api_read(spiffs *fs, uint32_t addr, uint32_t size, uint8_t *dst);
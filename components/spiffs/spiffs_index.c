@@ -0,0 +1,411 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "spiffs.h"
+#include "spiffs_nucleus.h"
+#include "spiffs_index.h"
+
+static const char* TAG = "SPIFFS";
+
+/* Number of entries with the same hash which are tried before falling back to SPIFFS_open */
+#define SPIFFS_INDEX_MAX_CANDIDATES     4
+
+static uint32_t index_hash(const char *path)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*path) {
+        hash ^= (uint8_t) *path++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline bool index_enabled(const spiffs_index_t *index)
+{
+    return index->max_count > 0;
+}
+
+static inline void index_lock(spiffs_index_t *index)
+{
+    (void) xSemaphoreTake(index->lock, portMAX_DELAY);
+}
+
+static inline void index_unlock(spiffs_index_t *index)
+{
+    xSemaphoreGive(index->lock);
+}
+
+static void index_set_incomplete(spiffs_index_t *index)
+{
+    index_lock(index);
+    index->complete = false;
+    index_unlock(index);
+}
+
+/* Find the slot of the given object, or the empty slot where it should be inserted.
+ * Must be called with the index locked.
+ */
+static size_t index_find_slot(const spiffs_index_t *index, uint32_t hash, spiffs_obj_id obj_id)
+{
+    const size_t mask = index->slots - 1;
+    size_t i = hash & mask;
+    while (index->entries[i].obj_id != SPIFFS_OBJ_ID_FREE) {
+        if (index->entries[i].hash == hash && index->entries[i].obj_id == obj_id) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static void index_put(spiffs_index_t *index, uint32_t hash, spiffs_obj_id obj_id, spiffs_page_ix pix)
+{
+    index_lock(index);
+    size_t i = index_find_slot(index, hash, obj_id);
+    if (index->entries[i].obj_id == SPIFFS_OBJ_ID_FREE) {
+        if (index->count == index->max_count) {
+            // From now on, a name missing in the index doesn't mean that the file doesn't exist
+            index->complete = false;
+            index_unlock(index);
+            return;
+        }
+        index->count++;
+    }
+    index->entries[i] = (spiffs_index_entry_t) {
+        .hash = hash,
+        .obj_id = obj_id,
+        .pix = pix,
+    };
+    index_unlock(index);
+}
+
+static void index_del(spiffs_index_t *index, uint32_t hash, spiffs_obj_id obj_id)
+{
+    index_lock(index);
+    const size_t mask = index->slots - 1;
+    size_t i = index_find_slot(index, hash, obj_id);
+    if (index->entries[i].obj_id == SPIFFS_OBJ_ID_FREE) {
+        index_unlock(index);
+        return;
+    }
+    index->count--;
+    // Backward shift deletion: move the following entries of the cluster
+    // which can't be reached from their home slot once slot i is emptied.
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (index->entries[j].obj_id == SPIFFS_OBJ_ID_FREE) {
+            break;
+        }
+        size_t home = index->entries[j].hash & mask;
+        bool reachable = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!reachable) {
+            index->entries[i] = index->entries[j];
+            i = j;
+        }
+    }
+    index->entries[i].obj_id = SPIFFS_OBJ_ID_FREE;
+    index_unlock(index);
+}
+
+/* Get the entries which may correspond to the given name.
+ * Returns the number of candidates, or -1 if there are too many of them.
+ */
+static int index_get_candidates(spiffs_index_t *index, uint32_t hash, spiffs_index_entry_t *out)
+{
+    int count = 0;
+    index_lock(index);
+    const size_t mask = index->slots - 1;
+    for (size_t i = hash & mask; index->entries[i].obj_id != SPIFFS_OBJ_ID_FREE; i = (i + 1) & mask) {
+        if (index->entries[i].hash != hash) {
+            continue;
+        }
+        if (count == SPIFFS_INDEX_MAX_CANDIDATES) {
+            count = -1;
+            break;
+        }
+        out[count++] = index->entries[i];
+    }
+    index_unlock(index);
+    return count;
+}
+
+/* Update the index entry of an open file */
+static void index_update_fd(spiffs_index_t *index, spiffs *fs, spiffs_file fd)
+{
+    spiffs_stat s;
+    if (SPIFFS_fstat(fs, fd, &s) != SPIFFS_OK) {
+        // The file exists but can't be indexed, a name missing in the index may exist too
+        SPIFFS_clearerr(fs);
+        index_set_incomplete(index);
+        return;
+    }
+    index_put(index, index_hash((const char *) s.name), s.obj_id & ~SPIFFS_OBJ_ID_IX_FLAG, s.pix);
+}
+
+/* Open the object of the index entry read-only, and check that it still has the given name.
+ * Sets *stale if the entry doesn't point to the object index header of its object anymore.
+ */
+static spiffs_file index_open_entry(spiffs *fs, const spiffs_index_entry_t *entry, const char *path, spiffs_stat *s, bool *stale)
+{
+    spiffs_file fd = SPIFFS_open_by_page(fs, entry->pix, SPIFFS_O_RDONLY, 0);
+    if (fd < 0) {
+        SPIFFS_clearerr(fs);
+        *stale = true;
+        return -1;
+    }
+    if (SPIFFS_fstat(fs, fd, s) != SPIFFS_OK ||
+            (s->obj_id & ~SPIFFS_OBJ_ID_IX_FLAG) != entry->obj_id) {
+        *stale = true;
+    } else if (strcmp((const char *) s->name, path) == 0) {
+        return fd;
+    }
+    // Otherwise it is another file with the same hash
+    SPIFFS_clearerr(fs);
+    SPIFFS_close(fs, fd);
+    return -1;
+}
+
+/* Whether the file was opened for writing. Only then its object index header may have moved. */
+static bool index_fd_writable(spiffs *fs, spiffs_file fd)
+{
+    spiffs_fd *fd_p;
+    bool writable = false;
+    // Descriptors are shared by all tasks using the filesystem, same as in spiffs_hydrogen.c
+    SPIFFS_LOCK(fs);
+    if (spiffs_fd_get(fs, SPIFFS_FH_UNOFFS(fs, fd), &fd_p) == SPIFFS_OK) {
+        writable = (fd_p->flags & SPIFFS_O_WRONLY) != 0;
+    }
+    SPIFFS_UNLOCK(fs);
+    return writable;
+}
+
+/* Look the file up in the index and open it read-only.
+ * Returns the file descriptor, SPIFFS_ERR_NOT_FOUND if the file surely doesn't exist,
+ * or SPIFFS_ERR_INTERNAL if the index can't tell.
+ */
+static spiffs_file index_lookup(spiffs_index_t *index, spiffs *fs, const char *path, spiffs_stat *s)
+{
+    const uint32_t hash = index_hash(path);
+    spiffs_index_entry_t candidates[SPIFFS_INDEX_MAX_CANDIDATES];
+    int count = index_get_candidates(index, hash, candidates);
+    if (count < 0) {
+        return SPIFFS_ERR_INTERNAL;
+    }
+    // A stale entry means that the object index header was moved, e.g. by the garbage collection.
+    // It may belong to another file with the same hash, so it is kept: the caller looks the name
+    // up in flash and updates the entry of the file found, if any.
+    bool stale = false;
+    for (int i = 0; i < count; ++i) {
+        spiffs_file fd = index_open_entry(fs, &candidates[i], path, s, &stale);
+        if (fd >= 0) {
+            return fd;
+        }
+    }
+    index_lock(index);
+    bool complete = index->complete;
+    index_unlock(index);
+    return (complete && !stale) ? SPIFFS_ERR_NOT_FOUND : SPIFFS_ERR_INTERNAL;
+}
+
+esp_err_t spiffs_index_init(spiffs_index_t *index, size_t max_count)
+{
+    memset(index, 0, sizeof(*index));
+    if (max_count == 0) {
+        return ESP_OK;
+    }
+    // Keep the load factor at or below 1/2, so that probe sequences stay short
+    size_t slots = 1;
+    while (slots < max_count * 2) {
+        slots <<= 1;
+    }
+    index->entries = malloc(slots * sizeof(spiffs_index_entry_t));
+    if (index->entries == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    index->lock = xSemaphoreCreateMutex();
+    if (index->lock == NULL) {
+        free(index->entries);
+        index->entries = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < slots; ++i) {
+        index->entries[i].obj_id = SPIFFS_OBJ_ID_FREE;
+    }
+    index->slots = slots;
+    index->max_count = max_count;
+    return ESP_OK;
+}
+
+void spiffs_index_deinit(spiffs_index_t *index)
+{
+    if (!index_enabled(index)) {
+        return;
+    }
+    vSemaphoreDelete(index->lock);
+    free(index->entries);
+    memset(index, 0, sizeof(*index));
+}
+
+s32_t spiffs_index_build(spiffs_index_t *index, spiffs *fs)
+{
+    if (!index_enabled(index)) {
+        return SPIFFS_OK;
+    }
+    index_lock(index);
+    for (size_t i = 0; i < index->slots; ++i) {
+        index->entries[i].obj_id = SPIFFS_OBJ_ID_FREE;
+    }
+    index->count = 0;
+    index->complete = true;
+    index_unlock(index);
+
+    spiffs_DIR d;
+    struct spiffs_dirent e;
+    if (SPIFFS_opendir(fs, "/", &d) == NULL) {
+        index_set_incomplete(index);
+        return SPIFFS_errno(fs);
+    }
+    while (SPIFFS_readdir(&d, &e) != NULL) {
+        index_put(index, index_hash((const char *) e.name), e.obj_id & ~SPIFFS_OBJ_ID_IX_FLAG, e.pix);
+    }
+    s32_t res = SPIFFS_errno(fs);
+    SPIFFS_closedir(&d);
+    if (res != SPIFFS_OK && res != SPIFFS_VIS_END) {
+        index_set_incomplete(index);
+        return res;
+    }
+    SPIFFS_clearerr(fs);
+    ESP_LOGD(TAG, "indexed %d objects, complete=%d", index->count, index->complete);
+    return SPIFFS_OK;
+}
+
+spiffs_file spiffs_index_open(spiffs_index_t *index, spiffs *fs, const char *path, spiffs_flags flags, spiffs_mode mode)
+{
+    if (!index_enabled(index)) {
+        return SPIFFS_open(fs, path, flags, mode);
+    }
+    spiffs_stat s;
+    spiffs_file fd = index_lookup(index, fs, path, &s);
+    if (fd >= 0) {
+        if ((flags & SPIFFS_O_CREAT) && (flags & SPIFFS_O_EXCL)) {
+            SPIFFS_close(fs, fd);
+            fs->err_code = SPIFFS_ERR_FILE_EXISTS;
+            return SPIFFS_ERR_FILE_EXISTS;
+        }
+        if ((flags & (SPIFFS_O_WRONLY | SPIFFS_O_TRUNC)) == 0) {
+            return fd;
+        }
+        // The object is verified now, reopen it with the requested flags
+        SPIFFS_close(fs, fd);
+        return SPIFFS_open_by_page(fs, s.pix, flags & ~(SPIFFS_O_CREAT | SPIFFS_O_EXCL), mode);
+    }
+    if (fd == SPIFFS_ERR_NOT_FOUND && !(flags & SPIFFS_O_CREAT)) {
+        fs->err_code = SPIFFS_ERR_NOT_FOUND;
+        return SPIFFS_ERR_NOT_FOUND;
+    }
+    fd = SPIFFS_open(fs, path, flags, mode);
+    if (fd >= 0) {
+        index_update_fd(index, fs, fd);
+    }
+    return fd;
+}
+
+s32_t spiffs_index_close(spiffs_index_t *index, spiffs *fs, spiffs_file fd)
+{
+    if (index_enabled(index) && index_fd_writable(fs, fd)) {
+        // Writing the file moves its object index header, flush it to learn the new page
+        if (SPIFFS_fflush(fs, fd) == SPIFFS_OK) {
+            index_update_fd(index, fs, fd);
+        }
+        SPIFFS_clearerr(fs);
+    }
+    return SPIFFS_close(fs, fd);
+}
+
+s32_t spiffs_index_stat(spiffs_index_t *index, spiffs *fs, const char *path, spiffs_stat *s)
+{
+    if (!index_enabled(index)) {
+        return SPIFFS_stat(fs, path, s);
+    }
+    spiffs_file fd = index_lookup(index, fs, path, s);
+    if (fd >= 0) {
+        SPIFFS_close(fs, fd);
+        return SPIFFS_OK;
+    }
+    if (fd == SPIFFS_ERR_NOT_FOUND) {
+        fs->err_code = SPIFFS_ERR_NOT_FOUND;
+        return SPIFFS_ERR_NOT_FOUND;
+    }
+    s32_t res = SPIFFS_stat(fs, path, s);
+    if (res == SPIFFS_OK) {
+        index_put(index, index_hash(path), s->obj_id & ~SPIFFS_OBJ_ID_IX_FLAG, s->pix);
+    }
+    return res;
+}
+
+s32_t spiffs_index_remove(spiffs_index_t *index, spiffs *fs, const char *path)
+{
+    if (!index_enabled(index)) {
+        return SPIFFS_remove(fs, path);
+    }
+    spiffs_file fd = spiffs_index_open(index, fs, path, SPIFFS_O_RDWR, 0);
+    if (fd < 0) {
+        return fd;
+    }
+    spiffs_stat s;
+    s32_t res = SPIFFS_fstat(fs, fd, &s);
+    if (res != SPIFFS_OK) {
+        SPIFFS_close(fs, fd);
+        return res;
+    }
+    res = SPIFFS_fremove(fs, fd);
+    if (res == SPIFFS_OK) {
+        index_del(index, index_hash(path), s.obj_id & ~SPIFFS_OBJ_ID_IX_FLAG);
+    }
+    return res;
+}
+
+s32_t spiffs_index_rename(spiffs_index_t *index, spiffs *fs, const char *old_path, const char *new_path)
+{
+    if (!index_enabled(index)) {
+        return SPIFFS_rename(fs, old_path, new_path);
+    }
+    spiffs_stat s;
+    spiffs_file fd = index_lookup(index, fs, old_path, &s);
+    if (fd == SPIFFS_ERR_NOT_FOUND) {
+        fs->err_code = SPIFFS_ERR_NOT_FOUND;
+        return SPIFFS_ERR_NOT_FOUND;
+    }
+    spiffs_obj_id obj_id = SPIFFS_OBJ_ID_FREE;
+    if (fd >= 0) {
+        obj_id = s.obj_id & ~SPIFFS_OBJ_ID_IX_FLAG;
+        SPIFFS_close(fs, fd);
+    }
+    s32_t res = SPIFFS_rename(fs, old_path, new_path);
+    if (res != SPIFFS_OK) {
+        return res;
+    }
+    if (obj_id == SPIFFS_OBJ_ID_FREE) {
+        // The index couldn't tell which object was renamed, look the new name up in flash
+        if (SPIFFS_stat(fs, new_path, &s) == SPIFFS_OK) {
+            index_put(index, index_hash(new_path), s.obj_id & ~SPIFFS_OBJ_ID_IX_FLAG, s.pix);
+        } else {
+            SPIFFS_clearerr(fs);
+            index_set_incomplete(index);
+        }
+        return SPIFFS_OK;
+    }
+    index_del(index, index_hash(old_path), obj_id);
+    // Renaming rewrites the object index header to a new page. Keep the previous one rather than
+    // searching for it: the first lookup of the new name finds the entry stale and indexes it again.
+    index_put(index, index_hash(new_path), obj_id, s.pix);
+    return SPIFFS_OK;
+}
@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "spiffs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Entry of the name index
+ */
+typedef struct {
+    uint32_t hash;              /*!< Hash of the object name */
+    spiffs_obj_id obj_id;       /*!< Object id, without SPIFFS_OBJ_ID_IX_FLAG. SPIFFS_OBJ_ID_FREE if the slot is empty */
+    spiffs_page_ix pix;         /*!< Last known page of the object index header */
+} spiffs_index_entry_t;
+
+/**
+ * @brief RAM index which maps object names to object ids
+ *
+ * SPIFFS looks files up by name by reading the object index header of every
+ * object in the filesystem. The index allows opening a file by reading only
+ * its own object index header. Entries don't store names, every hit is verified
+ * against the name stored in flash, so a stale entry only costs a fallback lookup.
+ */
+typedef struct {
+    spiffs_index_entry_t *entries;  /*!< Hash table, open addressing with linear probing */
+    size_t slots;                   /*!< Number of slots in the table, power of 2 */
+    size_t max_count;               /*!< Maximum number of indexed objects, 0 if the index is disabled */
+    size_t count;                   /*!< Number of indexed objects */
+    bool complete;                  /*!< All objects of the filesystem are in the index */
+    SemaphoreHandle_t lock;         /*!< Protects the table */
+} spiffs_index_t;
+
+/**
+ * @brief Allocate the index
+ *
+ * @param index      index to initialize
+ * @param max_count  maximum number of objects to index, 0 to disable the index
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM
+ */
+esp_err_t spiffs_index_init(spiffs_index_t *index, size_t max_count);
+
+/**
+ * @brief Free the memory used by the index
+ */
+void spiffs_index_deinit(spiffs_index_t *index);
+
+/**
+ * @brief Fill the index with all objects of the mounted filesystem
+ *
+ * @return SPIFFS_OK or SPIFFS error code
+ */
+s32_t spiffs_index_build(spiffs_index_t *index, spiffs *fs);
+
+/**
+ * @brief Open a file by name, same as SPIFFS_open
+ *
+ * Falls back to SPIFFS_open if the file can't be found using the index.
+ */
+spiffs_file spiffs_index_open(spiffs_index_t *index, spiffs *fs, const char *path, spiffs_flags flags, spiffs_mode mode);
+
+/**
+ * @brief Close a file, same as SPIFFS_close, and update the index entry of the file
+ */
+s32_t spiffs_index_close(spiffs_index_t *index, spiffs *fs, spiffs_file fd);
+
+/**
+ * @brief Get file status by name, same as SPIFFS_stat
+ */
+s32_t spiffs_index_stat(spiffs_index_t *index, spiffs *fs, const char *path, spiffs_stat *s);
+
+/**
+ * @brief Remove a file by name, same as SPIFFS_remove
+ */
+s32_t spiffs_index_remove(spiffs_index_t *index, spiffs *fs, const char *path);
+
+/**
+ * @brief Rename a file, same as SPIFFS_rename
+ */
+s32_t spiffs_index_rename(spiffs_index_t *index, spiffs *fs, const char *old_path, const char *new_path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,6 +11,7 @@
 #include <fcntl.h>
 #include <sys/time.h>
 #include <sys/unistd.h>
+#include <errno.h>
 #include "unity.h"
 #include "test_utils.h"
 #include "esp_log.h"
@@ -492,6 +493,97 @@ done:
     vTaskDelete(NULL);
 }
 
+typedef struct {
+    const char* dir_prefix;
+    const char* missing_file;
+    int n_files;
+    int iterations;
+    SemaphoreHandle_t done;
+    int result;
+} readdir_test_arg_t;
+
+static void list_dir_task(void* param)
+{
+    readdir_test_arg_t* args = (readdir_test_arg_t*) param;
+    args->result = ESP_OK;
+    for (int i = 0; i < args->iterations && args->result == ESP_OK; ++i) {
+        DIR* dir = opendir(args->dir_prefix);
+        if (!dir) {
+            args->result = ESP_ERR_NOT_FOUND;
+            break;
+        }
+        int count = 0;
+        errno = 0;
+        while (readdir(dir) != NULL) {
+            ++count;
+        }
+        if (errno != 0 || count != args->n_files) {
+            esp_rom_printf("E(l): i=%d, count=%d errno=%d\n", i, count, errno);
+            args->result = ESP_FAIL;
+        }
+        closedir(dir);
+    }
+    xSemaphoreGive(args->done);
+    vTaskDelay(1);
+    vTaskDelete(NULL);
+}
+
+static void open_missing_task(void* param)
+{
+    readdir_test_arg_t* args = (readdir_test_arg_t*) param;
+    args->result = ESP_OK;
+    for (int i = 0; i < args->iterations * 10; ++i) {
+        if (open(args->missing_file, O_RDONLY) >= 0) {
+            args->result = ESP_FAIL;
+            break;
+        }
+    }
+    xSemaphoreGive(args->done);
+    vTaskDelay(1);
+    vTaskDelete(NULL);
+}
+
+void test_spiffs_readdir_concurrent(const char* dir_prefix)
+{
+    const int n_files = 20;
+    char file_name[ESP_VFS_PATH_MAX + CONFIG_SPIFFS_OBJ_NAME_LEN];
+    for (int f = 0; f < n_files; ++f) {
+        snprintf(file_name, sizeof(file_name), "%s/%d.txt", dir_prefix, f);
+        test_spiffs_create_file_with_text(file_name, file_name);
+    }
+    snprintf(file_name, sizeof(file_name), "%s/missing.txt", dir_prefix);
+
+    /* Two tasks list the directory, while a third one keeps failing to open a file.
+     * The end of the directory must not be reported as the error of the other task.
+     */
+    readdir_test_arg_t args[3];
+    for (int i = 0; i < 3; ++i) {
+        args[i] = (readdir_test_arg_t) {
+            .dir_prefix = dir_prefix,
+            .missing_file = file_name,
+            .n_files = n_files,
+            .iterations = 20,
+            .done = xSemaphoreCreateBinary(),
+        };
+    }
+    const uint32_t stack_size = 3072;
+    const int cpuid_0 = 0;
+    const int cpuid_1 = portNUM_PROCESSORS - 1;
+    xTaskCreatePinnedToCore(&list_dir_task, "ls1", stack_size, &args[0], 3, NULL, cpuid_0);
+    xTaskCreatePinnedToCore(&list_dir_task, "ls2", stack_size, &args[1], 3, NULL, cpuid_1);
+    xTaskCreatePinnedToCore(&open_missing_task, "open", stack_size, &args[2], 3, NULL, cpuid_1);
+    for (int i = 0; i < 3; ++i) {
+        xSemaphoreTake(args[i].done, portMAX_DELAY);
+        TEST_ASSERT_EQUAL(ESP_OK, args[i].result);
+        vSemaphoreDelete(args[i].done);
+    }
+
+    for (int f = 0; f < n_files; ++f) {
+        snprintf(file_name, sizeof(file_name), "%s/%d.txt", dir_prefix, f);
+        TEST_ASSERT_EQUAL(0, unlink(file_name));
+    }
+}
+
 void test_spiffs_concurrent(const char* filename_prefix)
 {
     char names[4][64];
@@ -718,6 +810,13 @@ TEST_CASE("readdir with large number of files", "[spiffs][timeout=30]")
     test_teardown();
 }
 
+TEST_CASE("multiple tasks can read the same directory", "[spiffs][timeout=30]")
+{
+    test_setup();
+    test_spiffs_readdir_concurrent("/spiffs/dir3");
+    test_teardown();
+}
+
 TEST_CASE("multiple tasks can use same volume", "[spiffs]")
 {
     test_setup();
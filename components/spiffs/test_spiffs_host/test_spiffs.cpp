@@ -13,11 +13,13 @@
 #include <dirent.h>
 #include <limits.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "esp_partition.h"
 #include "spiffs.h"
 #include "spiffs_nucleus.h"
 #include "spiffs_api.h"
+#include "spiffs_index.h"
 
 #include "catch.hpp"
 
@@ -216,6 +218,125 @@ TEST_CASE("format disk, open file, write and read file", "[spiffs]")
     free(data);
 }
 
+TEST_CASE("name index speeds up opening files by name", "[spiffs]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    spiffs fs;
+    s32_t spiffs_res;
+    spiffs_file fd;
+    spiffs_stat stat;
+    char name[SPIFFS_OBJ_NAME_LEN];
+    uint32_t val;
+
+    init_spiffs(&fs, 5);
+
+    const uint32_t file_count = 1000;
+    for (uint32_t i = 0; i < file_count; ++i) {
+        snprintf(name, sizeof(name), "/file%u.txt", i);
+        fd = SPIFFS_open(&fs, name, SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR, 0);
+        REQUIRE(fd >= SPIFFS_OK);
+        REQUIRE(SPIFFS_write(&fs, fd, &i, sizeof(i)) == sizeof(i));
+        REQUIRE(SPIFFS_close(&fs, fd) >= SPIFFS_OK);
+    }
+
+    spiffs_index_t index;
+    REQUIRE(spiffs_index_init(&index, file_count + 10) == ESP_OK);
+    REQUIRE(spiffs_index_build(&index, &fs) == SPIFFS_OK);
+    REQUIRE(index.complete);
+    REQUIRE(index.count == file_count);
+
+    // Open every file by name, without and with the index
+    clock_t start = clock();
+    for (uint32_t i = 0; i < file_count; ++i) {
+        snprintf(name, sizeof(name), "/file%u.txt", i);
+        fd = SPIFFS_open(&fs, name, SPIFFS_O_RDONLY, 0);
+        REQUIRE(fd >= SPIFFS_OK);
+        REQUIRE(SPIFFS_read(&fs, fd, &val, sizeof(val)) == sizeof(val));
+        REQUIRE(val == i);
+        REQUIRE(SPIFFS_close(&fs, fd) >= SPIFFS_OK);
+    }
+    double name_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (uint32_t i = 0; i < file_count; ++i) {
+        snprintf(name, sizeof(name), "/file%u.txt", i);
+        fd = spiffs_index_open(&index, &fs, name, SPIFFS_O_RDONLY, 0);
+        REQUIRE(fd >= SPIFFS_OK);
+        REQUIRE(SPIFFS_read(&fs, fd, &val, sizeof(val)) == sizeof(val));
+        REQUIRE(val == i);
+        REQUIRE(spiffs_index_close(&index, &fs, fd) >= SPIFFS_OK);
+    }
+    double index_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (uint32_t i = 0; i < file_count; ++i) {
+        snprintf(name, sizeof(name), "/file%u.txt", i);
+        REQUIRE(spiffs_index_stat(&index, &fs, name, &stat) == SPIFFS_OK);
+        REQUIRE(stat.size == sizeof(val));
+    }
+    double stat_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%u files, open: %.1f us by name, %.1f us with index, stat: %.1f us with index\n",
+           file_count, name_s * 1e6 / file_count, index_s * 1e6 / file_count, stat_s * 1e6 / file_count);
+    REQUIRE(index_s < name_s);
+
+    // Rewriting a file moves its object index header
+    fd = spiffs_index_open(&index, &fs, "/file1.txt", SPIFFS_O_RDWR | SPIFFS_O_TRUNC, 0);
+    REQUIRE(fd >= SPIFFS_OK);
+    val = 0xdeadbeef;
+    REQUIRE(SPIFFS_write(&fs, fd, &val, sizeof(val)) == sizeof(val));
+    REQUIRE(spiffs_index_close(&index, &fs, fd) >= SPIFFS_OK);
+    fd = spiffs_index_open(&index, &fs, "/file1.txt", SPIFFS_O_RDONLY, 0);
+    REQUIRE(fd >= SPIFFS_OK);
+    REQUIRE(SPIFFS_read(&fs, fd, &val, sizeof(val)) == sizeof(val));
+    REQUIRE(val == 0xdeadbeef);
+    REQUIRE(spiffs_index_close(&index, &fs, fd) >= SPIFFS_OK);
+
+    // Missing files are reported without scanning the filesystem
+    REQUIRE(spiffs_index_open(&index, &fs, "/missing.txt", SPIFFS_O_RDONLY, 0) == SPIFFS_ERR_NOT_FOUND);
+    SPIFFS_clearerr(&fs);
+
+    // Creating, renaming and removing files keeps the index up to date
+    fd = spiffs_index_open(&index, &fs, "/new.txt", SPIFFS_O_CREAT | SPIFFS_O_RDWR, 0);
+    REQUIRE(fd >= SPIFFS_OK);
+    REQUIRE(spiffs_index_close(&index, &fs, fd) >= SPIFFS_OK);
+    REQUIRE(index.count == file_count + 1);
+    REQUIRE(spiffs_index_open(&index, &fs, "/new.txt", SPIFFS_O_CREAT | SPIFFS_O_EXCL | SPIFFS_O_RDWR, 0) == SPIFFS_ERR_FILE_EXISTS);
+    SPIFFS_clearerr(&fs);
+
+    REQUIRE(spiffs_index_rename(&index, &fs, "/file0.txt", "/renamed.txt") == SPIFFS_OK);
+    REQUIRE(spiffs_index_stat(&index, &fs, "/file0.txt", &stat) == SPIFFS_ERR_NOT_FOUND);
+    SPIFFS_clearerr(&fs);
+    fd = spiffs_index_open(&index, &fs, "/renamed.txt", SPIFFS_O_RDONLY, 0);
+    REQUIRE(fd >= SPIFFS_OK);
+    REQUIRE(SPIFFS_read(&fs, fd, &val, sizeof(val)) == sizeof(val));
+    REQUIRE(val == 0);
+    REQUIRE(spiffs_index_close(&index, &fs, fd) >= SPIFFS_OK);
+
+    REQUIRE(spiffs_index_remove(&index, &fs, "/renamed.txt") == SPIFFS_OK);
+    REQUIRE(spiffs_index_stat(&index, &fs, "/renamed.txt", &stat) == SPIFFS_ERR_NOT_FOUND);
+    SPIFFS_clearerr(&fs);
+    REQUIRE(SPIFFS_stat(&fs, "/renamed.txt", &stat) < SPIFFS_OK);
+    SPIFFS_clearerr(&fs);
+    REQUIRE(index.count == file_count);
+
+    // Files rewritten without the index are found again, also when renamed
+    fd = SPIFFS_open(&fs, "/file2.txt", SPIFFS_O_RDWR | SPIFFS_O_TRUNC, 0);
+    REQUIRE(fd >= SPIFFS_OK);
+    val = 2;
+    REQUIRE(SPIFFS_write(&fs, fd, &val, sizeof(val)) == sizeof(val));
+    REQUIRE(SPIFFS_close(&fs, fd) >= SPIFFS_OK);
+    REQUIRE(spiffs_index_rename(&index, &fs, "/file2.txt", "/moved.txt") == SPIFFS_OK);
+    REQUIRE(spiffs_index_stat(&index, &fs, "/moved.txt", &stat) == SPIFFS_OK);
+    REQUIRE(stat.size == sizeof(val));
+    REQUIRE(spiffs_index_stat(&index, &fs, "/file2.txt", &stat) == SPIFFS_ERR_NOT_FOUND);
+    SPIFFS_clearerr(&fs);
+
+    spiffs_index_deinit(&index);
+    deinit_spiffs(&fs);
+}
+
 TEST_CASE("can read spiffs image", "[spiffs]")
 {
     _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
@@ -173,6 +173,31 @@ void esp_transport_ssl_set_ds_data(esp_transport_handle_t t, void *ds_data);
  */
 void esp_transport_ssl_set_psk_key_hint(esp_transport_handle_t t, const psk_hint_key_t* psk_hint_key);
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+/**
+ * @brief      Set the client session to resume on the next connection
+ *             Important notes:
+ *             - This function stores the pointer to the session, rather than making a copy.
+ *             So it must remain valid until the connection is established, or set back to NULL
+ *             - ESP_TLS_CLIENT_SESSION_TICKETS config option must be enabled in menuconfig
+ *
+ * @param      t               ssl transport
+ * @param[in]  client_session  session obtained by esp_transport_ssl_get_client_session(), NULL to do a full handshake
+ */
+void esp_transport_ssl_set_client_session(esp_transport_handle_t t, esp_tls_client_session_t *client_session);
+
+/**
+ * @brief      Get the session of the established connection, to resume it later
+ *
+ * @param      t     ssl transport
+ *
+ * @return
+ *             - Session which must be freed with esp_tls_free_client_session()
+ *             - NULL if the transport is not connected or on failure
+ */
+esp_tls_client_session_t *esp_transport_ssl_get_client_session(esp_transport_handle_t t);
+#endif
+
 /**
  * @brief      Set keep-alive status in current ssl context
  *
@@ -47,6 +47,24 @@ void esp_transport_tcp_set_interface_name(esp_transport_handle_t t, struct ifreq
  */
 esp_transport_handle_t esp_transport_tcp_init(void);
 
+/**
+ * @brief      Move an established connection from one transport to another
+ *
+ *             Both transports must be created by the same function, either esp_transport_tcp_init()
+ *             or esp_transport_ssl_init(). Any connection of `dst` is closed first. After the call
+ *             `src` is closed, without the connection being shut down, and `dst` reads and writes
+ *             on the connection as if it had connected itself.
+ *
+ * @param[in]  dst   The transport which takes over the connection
+ * @param[in]  src   The connected transport
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG if the transports are of different or unsupported types
+ *     - ESP_ERR_NO_MEM
+ */
+esp_err_t esp_transport_tcp_move_connection(esp_transport_handle_t dst, esp_transport_handle_t src);
+
 
 #ifdef __cplusplus
 }
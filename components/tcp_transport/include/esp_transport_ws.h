@@ -172,6 +172,25 @@ int esp_transport_ws_get_read_payload_len(esp_transport_handle_t t);
  */
 int esp_transport_ws_poll_connection_closed(esp_transport_handle_t t, int timeout_ms);
 
+/**
+ * @brief               Applies a WebSocket masking key to payload data
+ *
+ * XORs the data with the masking key as defined in RFC 6455, section 5.3, a machine
+ * word at a time. Masking and unmasking are the same operation. The data is processed
+ * in place if dst and src are the same buffer.
+ *
+ * This is available regardless of CONFIG_WS_TRANSPORT, and is used by the WebSocket
+ * server of esp_http_server as well.
+ *
+ * @param[out] dst      Buffer for the masked data, may be the same as src
+ * @param[in]  src      Data to be masked
+ * @param[in]  len      Length of the data
+ * @param[in]  mask_key Masking key of the frame
+ * @param[in]  offset   Position of the data within the frame payload, for data that is
+ *                      masked in parts
+ */
+void esp_transport_ws_mask(uint8_t *dst, const uint8_t *src, size_t len, const uint8_t mask_key[4], size_t offset);
+
 #ifdef __cplusplus
 }
 #endif
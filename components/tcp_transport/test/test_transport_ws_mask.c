@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_transport_ws.h"
+
+#define MASK_BENCH_LEN      (32 * 1024)
+#define MASK_BENCH_ROUNDS   16
+
+static const uint8_t s_mask_key[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+static void mask_bytewise(uint8_t *dst, const uint8_t *src, size_t len, const uint8_t *mask_key, size_t offset)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = src[i] ^ mask_key[(offset + i) % 4];
+    }
+}
+
+TEST_CASE("ws_mask: matches byte-wise masking for any alignment and offset", "[tcp_transport][leaks=0]")
+{
+    uint8_t src[80 + 8];
+    uint8_t expected[80];
+    uint8_t dst[80 + 8];
+    esp_fill_random(src, sizeof(src));
+
+    for (int src_align = 0; src_align < 4; src_align++) {
+        for (int dst_align = 0; dst_align < 4; dst_align++) {
+            for (int offset = 0; offset < 4; offset++) {
+                for (int len = 0; len <= 80; len++) {
+                    mask_bytewise(expected, src + src_align, len, s_mask_key, offset);
+                    memset(dst, 0, sizeof(dst));
+                    esp_transport_ws_mask(dst + dst_align, src + src_align, len, s_mask_key, offset);
+                    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, dst + dst_align, len);
+                    /* Nothing written past the end */
+                    TEST_ASSERT_EQUAL(0, dst[dst_align + len]);
+                }
+            }
+        }
+    }
+
+    /* In place, and masking twice restores the data */
+    memcpy(dst, src, sizeof(src));
+    esp_transport_ws_mask(dst + 1, dst + 1, 77, s_mask_key, 3);
+    mask_bytewise(expected, src + 1, 77, s_mask_key, 3);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, dst + 1, 77);
+    esp_transport_ws_mask(dst + 1, dst + 1, 77, s_mask_key, 3);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(src, dst, sizeof(src));
+
+    /* Masking in parts gives the same result as masking at once */
+    mask_bytewise(expected, src, 80, s_mask_key, 0);
+    esp_transport_ws_mask(dst, src, 13, s_mask_key, 0);
+    esp_transport_ws_mask(dst + 13, src + 13, 80 - 13, s_mask_key, 13);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, dst, 80);
+}
+
+TEST_CASE("ws_mask: performance compared to byte-wise masking", "[tcp_transport][leaks=0]")
+{
+    uint8_t *src = malloc(MASK_BENCH_LEN + 1);
+    uint8_t *dst = malloc(MASK_BENCH_LEN + 1);
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(dst);
+    esp_fill_random(src, MASK_BENCH_LEN + 1);
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < MASK_BENCH_ROUNDS; i++) {
+        mask_bytewise(dst, src, MASK_BENCH_LEN, s_mask_key, 0);
+    }
+    int64_t bytewise_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < MASK_BENCH_ROUNDS; i++) {
+        esp_transport_ws_mask(dst, src, MASK_BENCH_LEN, s_mask_key, 0);
+    }
+    int64_t aligned_us = esp_timer_get_time() - start;
+
+    /* Source and destination with different alignment, as for a frame received after the header */
+    start = esp_timer_get_time();
+    for (int i = 0; i < MASK_BENCH_ROUNDS; i++) {
+        esp_transport_ws_mask(dst, src + 1, MASK_BENCH_LEN, s_mask_key, 0);
+    }
+    int64_t unaligned_us = esp_timer_get_time() - start;
+
+    const double mbytes = (double) MASK_BENCH_LEN * MASK_BENCH_ROUNDS / (1024 * 1024);
+    printf("byte-wise: %.1f MB/s, word-wise: %.1f MB/s, word-wise unaligned source: %.1f MB/s\n",
+           mbytes * 1000000 / bytewise_us, mbytes * 1000000 / aligned_us, mbytes * 1000000 / unaligned_us);
+    TEST_ASSERT_LESS_THAN(bytewise_us, aligned_us);
+
+    free(src);
+    free(dst);
+}
@@ -451,6 +451,23 @@ void esp_transport_ssl_set_ds_data(esp_transport_handle_t t, void *ds_data)
 }
 #endif
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+void esp_transport_ssl_set_client_session(esp_transport_handle_t t, esp_tls_client_session_t *client_session)
+{
+    GET_SSL_FROM_TRANSPORT_OR_RETURN(ssl, t);
+    ssl->cfg.client_session = client_session;
+}
+
+esp_tls_client_session_t *esp_transport_ssl_get_client_session(esp_transport_handle_t t)
+{
+    transport_esp_tls_t *ssl = ssl_get_context_data(t);
+    if (ssl == NULL || ssl->tls == NULL) {
+        return NULL;
+    }
+    return esp_tls_get_client_session(ssl->tls);
+}
+#endif
+
 void esp_transport_ssl_set_keep_alive(esp_transport_handle_t t, esp_transport_keep_alive_t *keep_alive_cfg)
 {
     GET_SSL_FROM_TRANSPORT_OR_RETURN(ssl, t);
@@ -511,3 +528,30 @@ void esp_transport_tcp_set_interface_name(esp_transport_handle_t t, struct ifreq
 {
     return esp_transport_ssl_set_interface_name(t, if_name);
 }
+
+esp_err_t esp_transport_tcp_move_connection(esp_transport_handle_t dst, esp_transport_handle_t src)
+{
+    if (dst == NULL || src == NULL || dst->_connect != src->_connect ||
+            (src->_connect != tcp_connect && src->_connect != ssl_connect)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    transport_esp_tls_t *from = ssl_get_context_data(src);
+    transport_esp_tls_t *to = ssl_get_context_data(dst);
+    if (from == NULL || to == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (from == to) {
+        // both transports share the foundation context, the connection is already there
+        return ESP_OK;
+    }
+    esp_transport_close(dst);
+    to->tls = from->tls;
+    to->ssl_initialized = from->ssl_initialized;
+    to->conn_state = from->conn_state;
+    to->sockfd = from->sockfd;
+    from->tls = NULL;
+    from->ssl_initialized = false;
+    from->conn_state = TRANS_SSL_INIT;
+    from->sockfd = INVALID_SOCKET;
+    return ESP_OK;
+}
@@ -19,6 +19,8 @@
 #include <assert.h>
 
 #include "esp_transport_utils.h"
+#include "esp_transport_ws.h"
+#include "esp_ws_mask.h"
 
 struct timeval* esp_transport_utils_ms_to_timeval(int timeout_ms, struct timeval *tv)
 {
@@ -29,3 +31,8 @@ struct timeval* esp_transport_utils_ms_to_timeval(int timeout_ms, struct timeval
     tv->tv_usec = (timeout_ms - (tv->tv_sec * 1000)) * 1000;
     return tv;
 }
+
+void esp_transport_ws_mask(uint8_t *dst, const uint8_t *src, size_t len, const uint8_t mask_key[4], size_t offset)
+{
+    esp_ws_mask(dst, src, len, mask_key, offset);
+}
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -9,6 +9,7 @@
 #include <ctype.h>
 #include <sys/random.h>
 #include <sys/socket.h>
+#include <sys/param.h>
 #include "esp_log.h"
 #include "esp_transport.h"
 #include "esp_transport_tcp.h"
@@ -254,13 +255,47 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
     return 0;
 }
 
+/* Masks the payload into the transport buffer, so the caller's data is left untouched, and
+ * sends it in parts of the buffer size. The header is sent together with the first part */
+static int ws_write_masked(transport_ws_t *ws, const char *header, int header_len, const char *b, int len,
+                           const uint8_t *mask_key, int timeout_ms)
+{
+    char *buffer = ws->buffer;
+    if (!buffer) {
+        /* Buffer was freed after connect, with CONFIG_WS_DYNAMIC_BUFFER */
+        buffer = malloc(WS_BUFFER_SIZE);
+        if (!buffer) {
+            ESP_LOGE(TAG, "Cannot allocate buffer for write, need-%d", WS_BUFFER_SIZE);
+            return -1;
+        }
+    }
+
+    memcpy(buffer, header, header_len);
+    int offset = header_len;
+    int sent = 0;
+    do {
+        int part_len = MIN(len - sent, WS_BUFFER_SIZE - offset);
+        esp_transport_ws_mask((uint8_t *)buffer + offset, (const uint8_t *)b + sent, part_len, mask_key, sent);
+        if (esp_transport_write(ws->parent, buffer, offset + part_len, timeout_ms) != offset + part_len) {
+            ESP_LOGE(TAG, "Error write %s", sent ? "data" : "header");
+            sent = -1;
+            break;
+        }
+        sent += part_len;
+        offset = 0;
+    } while (sent < len);
+
+    if (buffer != ws->buffer) {
+        free(buffer);
+    }
+    return sent;
+}
+
 static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const char *b, int len, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
-    char *buffer = (char *)b;
     char ws_header[MAX_WEBSOCKET_HEADER_SIZE];
-    char *mask;
-    int header_len = 0, i;
+    int header_len = 0;
 
     int poll_write;
     if ((poll_write = esp_transport_poll_write(ws->parent, timeout_ms)) <= 0) {
@@ -289,13 +324,10 @@ static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const
     }
 
     if (mask_flag) {
-        mask = &ws_header[header_len];
-        getrandom(ws_header + header_len, 4, 0);
+        uint8_t *mask_key = (uint8_t *)&ws_header[header_len];
+        getrandom(mask_key, 4, 0);
         header_len += 4;
-
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
-        }
+        return ws_write_masked(ws, ws_header, header_len, b, len, mask_key, timeout_ms);
     }
 
     if (esp_transport_write(ws->parent, ws_header, header_len, timeout_ms) != header_len) {
@@ -305,17 +337,7 @@ static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const
     if (len == 0) {
         return 0;
     }
-
-    int ret = esp_transport_write(ws->parent, buffer, len, timeout_ms);
-    // in case of masked transport we have to revert back to the original data, as ws layer
-    // does not create its own copy of data to be sent
-    if (mask_flag) {
-        mask = &ws_header[header_len - 4];
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
-        }
-    }
-    return ret;
+    return esp_transport_write(ws->parent, b, len, timeout_ms);
 }
 
 int esp_transport_ws_send_raw(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, int timeout_ms)
@@ -348,6 +370,8 @@ static int ws_read_payload(esp_transport_handle_t t, char *buffer, int len, int
 
     int bytes_to_read;
     int rlen = 0;
+    /* Position of the data to be read within the payload */
+    int offset = ws->frame_state.payload_len - ws->frame_state.bytes_remaining;
 
     if (ws->frame_state.bytes_remaining > len) {
         ESP_LOGD(TAG, "Actual data to receive (%d) are longer than ws buffer (%d)", ws->frame_state.bytes_remaining, len);
@@ -364,11 +388,7 @@ static int ws_read_payload(esp_transport_handle_t t, char *buffer, int len, int
     }
     ws->frame_state.bytes_remaining -= rlen;
 
-    if (ws->frame_state.mask_key) {
-        for (int i = 0; i < bytes_to_read; i++) {
-            buffer[i] = (buffer[i] ^ ws->frame_state.mask_key[i % 4]);
-        }
-    }
+    esp_transport_ws_mask((uint8_t *)buffer, (uint8_t *)buffer, rlen, (uint8_t *)ws->frame_state.mask_key, offset);
     return rlen;
 }
 
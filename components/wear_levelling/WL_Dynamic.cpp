@@ -0,0 +1,486 @@
+/*
+ * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_random.h"
+#include "esp_log.h"
+#include "WL_Dynamic.h"
+#include "crc32.h"
+
+static const char *TAG = "wl_dynamic";
+
+#ifndef WL_CFG_CRC_CONST
+#define WL_CFG_CRC_CONST UINT32_MAX
+#endif // WL_CFG_CRC_CONST
+
+#define WL_DYN_MAGIC 0x4E59444C // "LDYN"
+#define WL_DYN_FREE_SECTOR UINT32_MAX
+// Minimum space reserved for the record log in every state copy
+#define WL_DYN_MIN_LOG_SIZE (64 * sizeof(wl_dyn_record_t))
+
+#ifdef CONFIG_WL_DYNAMIC_SPARE_SECTORS
+#define WL_DYN_SPARE_SECTORS CONFIG_WL_DYNAMIC_SPARE_SECTORS
+#else
+#define WL_DYN_SPARE_SECTORS 4
+#endif // CONFIG_WL_DYNAMIC_SPARE_SECTORS
+
+#ifdef CONFIG_WL_DYNAMIC_STATIC_THRESHOLD
+#define WL_DYN_STATIC_THRESHOLD CONFIG_WL_DYNAMIC_STATIC_THRESHOLD
+#else
+#define WL_DYN_STATIC_THRESHOLD 64
+#endif // CONFIG_WL_DYNAMIC_STATIC_THRESHOLD
+
+#define WL_RESULT_CHECK(result) \
+    if (result != ESP_OK) { \
+        ESP_LOGE(TAG,"%s(%d): result = 0x%08x", __FUNCTION__, __LINE__, result); \
+        return (result); \
+    }
+
+WL_Dynamic::WL_Dynamic()
+{
+}
+
+WL_Dynamic::~WL_Dynamic()
+{
+    free(this->erase_counts);
+    free(this->sector_owner);
+}
+
+esp_err_t WL_Dynamic::config(wl_config_t *cfg, Flash_Access *flash_drv)
+{
+    esp_err_t result = ESP_OK;
+    if ((cfg == NULL) || (flash_drv == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ESP_LOGV(TAG, "%s start_addr=0x%08x, full_mem_size=0x%08x, sector_size=0x%08x, temp_buff_size=0x%08x", __func__,
+             (uint32_t) cfg->start_addr,
+             cfg->full_mem_size,
+             cfg->sector_size,
+             (uint32_t) cfg->temp_buff_size);
+
+    cfg->crc = crc32::crc32_le(WL_CFG_CRC_CONST, (const unsigned char *)cfg, offsetof(wl_config_t, crc));
+    memcpy(&this->cfg, cfg, sizeof(wl_config_t));
+    this->configured = false;
+    this->flash_drv = flash_drv;
+    if (this->cfg.temp_buff_size < sizeof(wl_dyn_record_t)) {
+        this->cfg.temp_buff_size = sizeof(wl_dyn_record_t);
+    }
+    // Sectors are remapped one by one, so a page must be exactly one sector
+    if ((this->cfg.page_size != this->cfg.sector_size) || ((this->cfg.sector_size % this->cfg.temp_buff_size) != 0)) {
+        result = ESP_ERR_INVALID_ARG;
+    }
+    WL_RESULT_CHECK(result);
+
+    size_t sector_size = this->cfg.sector_size;
+    this->cfg_size = (sizeof(wl_config_t) + sector_size - 1) / sector_size * sector_size;
+
+    // Find the largest amount of logical sectors which fits into the partition together
+    // with the spare sectors, two state copies and the configuration.
+    uint32_t total_sectors = this->cfg.full_mem_size / sector_size;
+    int32_t logical = (int32_t)total_sectors - WL_DYN_SPARE_SECTORS - 3;
+    size_t table_size = 0;
+    for (; logical > 0; logical--) {
+        uint32_t physical = logical + WL_DYN_SPARE_SECTORS;
+        table_size = (sizeof(uint32_t) * (physical + logical) + 15) & ~15;
+        this->copy_size = (sizeof(wl_dyn_state_t) + table_size + WL_DYN_MIN_LOG_SIZE + sector_size - 1) / sector_size * sector_size;
+        if (physical * sector_size + this->copy_size * 2 + this->cfg_size <= this->cfg.full_mem_size) {
+            break;
+        }
+    }
+    if (logical <= 0) {
+        result = ESP_ERR_INVALID_ARG;
+    }
+    WL_RESULT_CHECK(result);
+
+    this->logical_count = logical;
+    this->physical_count = logical + WL_DYN_SPARE_SECTORS;
+    this->state_size = this->copy_size;
+    this->flash_size = this->logical_count * sector_size;
+    this->log_offset = sizeof(wl_dyn_state_t) + table_size;
+    this->log_capacity = (this->copy_size - this->log_offset) / sizeof(wl_dyn_record_t);
+
+    this->addr_cfg = this->cfg.start_addr + this->cfg.full_mem_size - this->cfg_size;
+    this->addr_copy[0] = this->addr_cfg - this->copy_size * 2;
+    this->addr_copy[1] = this->addr_cfg - this->copy_size;
+
+    ESP_LOGD(TAG, "%s - config result: logical_count=%i, physical_count=%i, copy_size=0x%08x, addr_copy1=0x%08x, addr_copy2=0x%08x, log_capacity=%i", __func__,
+             this->logical_count,
+             this->physical_count,
+             (uint32_t) this->copy_size,
+             (uint32_t) this->addr_copy[0],
+             (uint32_t) this->addr_copy[1],
+             (uint32_t) this->log_capacity);
+
+    // Erase counters and the map are stored in one buffer, so they can be written with one call
+    this->erase_counts = (uint32_t *)malloc(table_size);
+    this->sector_owner = (uint32_t *)malloc(this->physical_count * sizeof(uint32_t));
+    this->temp_buff = (uint8_t *)malloc(this->cfg.temp_buff_size);
+    if ((this->erase_counts == NULL) || (this->sector_owner == NULL) || (this->temp_buff == NULL)) {
+        result = ESP_ERR_NO_MEM;
+    }
+    WL_RESULT_CHECK(result);
+    memset(this->erase_counts, 0xff, table_size);
+    this->sector_map = this->erase_counts + this->physical_count;
+
+    this->configured = true;
+    return ESP_OK;
+}
+
+esp_err_t WL_Dynamic::init()
+{
+    esp_err_t result = ESP_OK;
+    if (this->configured == false) {
+        ESP_LOGW(TAG, "WL_Dynamic: not configured, call config() first");
+        return ESP_ERR_INVALID_STATE;
+    }
+    this->initialized = false;
+
+    // Check headers of both copies and try the newest one first
+    wl_dyn_state_t headers[2];
+    bool valid[2];
+    for (int i = 0; i < 2; i++) {
+        result = this->flash_drv->read(this->addr_copy[i], &headers[i], sizeof(wl_dyn_state_t));
+        WL_RESULT_CHECK(result);
+        uint32_t crc = crc32::crc32_le(WL_CFG_CRC_CONST, (uint8_t *)&headers[i], offsetof(wl_dyn_state_t, crc));
+        valid[i] = (crc == headers[i].crc)
+                   && (headers[i].magic == WL_DYN_MAGIC)
+                   && (headers[i].version == this->cfg.version)
+                   && (headers[i].logical_count == this->logical_count)
+                   && (headers[i].physical_count == this->physical_count);
+    }
+    int first = 0;
+    if (valid[0] && valid[1]) {
+        first = ((int32_t)(headers[1].seq - headers[0].seq) > 0) ? 1 : 0;
+    } else if (valid[1]) {
+        first = 1;
+    }
+
+    result = ESP_FAIL;
+    if (valid[first]) {
+        result = this->loadCopy(first);
+    }
+    if ((result != ESP_OK) && valid[1 - first]) {
+        result = this->loadCopy(1 - first);
+    }
+    if (result == ESP_OK) {
+        result = this->replayRecords();
+        WL_RESULT_CHECK(result);
+    } else {
+        ESP_LOGD(TAG, "%s: no valid state, init flash sections", __func__);
+        result = this->formatSections();
+        WL_RESULT_CHECK(result);
+    }
+    this->rebuildOwners();
+
+    this->initialized = true;
+    ESP_LOGD(TAG, "%s - seq=%i, copy=%i, log_pos=%i", __func__, this->dyn_state.seq, this->current_copy, (uint32_t)this->log_pos);
+    return ESP_OK;
+}
+
+esp_err_t WL_Dynamic::loadCopy(int copy)
+{
+    esp_err_t result = this->flash_drv->read(this->addr_copy[copy], &this->dyn_state, sizeof(wl_dyn_state_t));
+    WL_RESULT_CHECK(result);
+    size_t table_size = this->log_offset - sizeof(wl_dyn_state_t);
+    result = this->flash_drv->read(this->addr_copy[copy] + sizeof(wl_dyn_state_t), this->erase_counts, table_size);
+    WL_RESULT_CHECK(result);
+    uint32_t table_crc = crc32::crc32_le(WL_CFG_CRC_CONST, (uint8_t *)this->erase_counts, sizeof(uint32_t) * (this->physical_count + this->logical_count));
+    if (table_crc != this->dyn_state.table_crc) {
+        ESP_LOGW(TAG, "%s - copy %i has broken tables", __func__, copy);
+        return ESP_FAIL;
+    }
+    for (uint32_t i = 0; i < this->logical_count; i++) {
+        if (this->sector_map[i] >= this->physical_count) {
+            return ESP_FAIL;
+        }
+    }
+    this->current_copy = copy;
+    return ESP_OK;
+}
+
+esp_err_t WL_Dynamic::replayRecords()
+{
+    esp_err_t result = ESP_OK;
+    wl_dyn_record_t record;
+    for (this->log_pos = 0; this->log_pos < this->log_capacity; this->log_pos++) {
+        result = this->flash_drv->read(this->addr_copy[this->current_copy] + this->log_offset + this->log_pos * sizeof(wl_dyn_record_t), &record, sizeof(wl_dyn_record_t));
+        WL_RESULT_CHECK(result);
+        if ((this->recordCrc(&record) != record.crc) || (record.logical >= this->logical_count) || (record.physical >= this->physical_count)) {
+            break; // end of the log
+        }
+        this->sector_map[record.logical] = record.physical;
+        this->erase_counts[record.physical] = record.erase_count;
+    }
+    ESP_LOGV(TAG, "%s - replayed %i records", __func__, (uint32_t)this->log_pos);
+    return result;
+}
+
+esp_err_t WL_Dynamic::formatSections()
+{
+    esp_err_t result = ESP_OK;
+    for (uint32_t i = 0; i < this->physical_count; i++) {
+        this->erase_counts[i] = 0;
+    }
+    for (uint32_t i = 0; i < this->logical_count; i++) {
+        this->sector_map[i] = i;
+    }
+    this->dyn_state.seq = 1;
+    this->dyn_state.device_id = esp_random();
+
+    // The second copy could contain a valid state of previous instance, which must not survive
+    result = this->flash_drv->erase_range(this->addr_copy[1], this->copy_size);
+    WL_RESULT_CHECK(result);
+    result = this->writeSnapshot(0);
+    WL_RESULT_CHECK(result);
+
+    result = this->flash_drv->erase_range(this->addr_cfg, this->cfg_size);
+    WL_RESULT_CHECK(result);
+    result = this->flash_drv->write(this->addr_cfg, &this->cfg, sizeof(wl_config_t));
+    WL_RESULT_CHECK(result);
+    return result;
+}
+
+esp_err_t WL_Dynamic::writeSnapshot(int copy)
+{
+    esp_err_t result = ESP_OK;
+    this->dyn_state.magic = WL_DYN_MAGIC;
+    this->dyn_state.version = this->cfg.version;
+    this->dyn_state.logical_count = this->logical_count;
+    this->dyn_state.physical_count = this->physical_count;
+    this->dyn_state.table_crc = crc32::crc32_le(WL_CFG_CRC_CONST, (uint8_t *)this->erase_counts, sizeof(uint32_t) * (this->physical_count + this->logical_count));
+    this->dyn_state.crc = crc32::crc32_le(WL_CFG_CRC_CONST, (uint8_t *)&this->dyn_state, offsetof(wl_dyn_state_t, crc));
+
+    result = this->flash_drv->erase_range(this->addr_copy[copy], this->copy_size);
+    WL_RESULT_CHECK(result);
+    // Tables first: the copy becomes valid only when the header is written
+    result = this->flash_drv->write(this->addr_copy[copy] + sizeof(wl_dyn_state_t), this->erase_counts, this->log_offset - sizeof(wl_dyn_state_t));
+    WL_RESULT_CHECK(result);
+    result = this->flash_drv->write(this->addr_copy[copy], &this->dyn_state, sizeof(wl_dyn_state_t));
+    WL_RESULT_CHECK(result);
+
+    this->current_copy = copy;
+    this->log_pos = 0;
+    ESP_LOGD(TAG, "%s - copy=%i, seq=%i", __func__, copy, this->dyn_state.seq);
+    return result;
+}
+
+uint32_t WL_Dynamic::recordCrc(const wl_dyn_record_t *record)
+{
+    // Seed with the sequence number, so records of an older snapshot are never accepted
+    return crc32::crc32_le(this->dyn_state.seq ^ this->dyn_state.device_id, (const uint8_t *)record, offsetof(wl_dyn_record_t, crc));
+}
+
+esp_err_t WL_Dynamic::appendRecord(uint32_t logical)
+{
+    if (this->log_pos >= this->log_capacity) {
+        // Log is full: the snapshot of the current state replaces the log
+        this->dyn_state.seq++;
+        return this->writeSnapshot(1 - this->current_copy);
+    }
+    wl_dyn_record_t record;
+    record.logical = logical;
+    record.physical = this->sector_map[logical];
+    record.erase_count = this->erase_counts[record.physical];
+    record.crc = this->recordCrc(&record);
+    esp_err_t result = this->flash_drv->write(this->addr_copy[this->current_copy] + this->log_offset + this->log_pos * sizeof(wl_dyn_record_t), &record, sizeof(wl_dyn_record_t));
+    WL_RESULT_CHECK(result);
+    this->log_pos++;
+    return result;
+}
+
+void WL_Dynamic::rebuildOwners()
+{
+    for (uint32_t i = 0; i < this->physical_count; i++) {
+        this->sector_owner[i] = WL_DYN_FREE_SECTOR;
+    }
+    for (uint32_t i = 0; i < this->logical_count; i++) {
+        this->sector_owner[this->sector_map[i]] = i;
+    }
+}
+
+uint32_t WL_Dynamic::findFreeSector()
+{
+    uint32_t result = WL_DYN_FREE_SECTOR;
+    for (uint32_t i = 0; i < this->physical_count; i++) {
+        if ((this->sector_owner[i] == WL_DYN_FREE_SECTOR)
+                && ((result == WL_DYN_FREE_SECTOR) || (this->erase_counts[i] < this->erase_counts[result]))) {
+            result = i;
+        }
+    }
+    return result;
+}
+
+esp_err_t WL_Dynamic::moveSector(uint32_t logical, bool copy_data)
+{
+    esp_err_t result = ESP_OK;
+    uint32_t old_sector = this->sector_map[logical];
+    uint32_t new_sector = this->findFreeSector();
+    size_t old_addr = this->cfg.start_addr + old_sector * this->cfg.sector_size;
+    size_t new_addr = this->cfg.start_addr + new_sector * this->cfg.sector_size;
+
+    result = this->flash_drv->erase_range(new_addr, this->cfg.sector_size);
+    WL_RESULT_CHECK(result);
+    this->erase_counts[new_sector]++;
+    if (copy_data) {
+        for (size_t i = 0; i < this->cfg.sector_size; i += this->cfg.temp_buff_size) {
+            result = this->flash_drv->read(old_addr + i, this->temp_buff, this->cfg.temp_buff_size);
+            WL_RESULT_CHECK(result);
+            result = this->flash_drv->write(new_addr + i, this->temp_buff, this->cfg.temp_buff_size);
+            WL_RESULT_CHECK(result);
+        }
+    }
+    // Until the record is stored, the old sector keeps the logical sector after power off
+    this->sector_map[logical] = new_sector;
+    this->sector_owner[new_sector] = logical;
+    this->sector_owner[old_sector] = WL_DYN_FREE_SECTOR;
+    result = this->appendRecord(logical);
+    ESP_LOGV(TAG, "%s - logical=%i, 0x%08x -> 0x%08x, erase_count=%i, result=0x%08x", __func__,
+             logical, (uint32_t)old_addr, (uint32_t)new_addr, this->erase_counts[new_sector], result);
+    return result;
+}
+
+esp_err_t WL_Dynamic::levelStatic()
+{
+    // Find the least worn sector with data. If it is far behind the free sectors,
+    // it holds static data: move the data away, so the sector can take the hot data.
+    uint32_t cold = WL_DYN_FREE_SECTOR;
+    for (uint32_t i = 0; i < this->physical_count; i++) {
+        if ((this->sector_owner[i] != WL_DYN_FREE_SECTOR)
+                && ((cold == WL_DYN_FREE_SECTOR) || (this->erase_counts[i] < this->erase_counts[cold]))) {
+            cold = i;
+        }
+    }
+    uint32_t free_sector = this->findFreeSector();
+    if ((cold == WL_DYN_FREE_SECTOR) || (free_sector == WL_DYN_FREE_SECTOR)) {
+        return ESP_OK;
+    }
+    if (this->erase_counts[free_sector] - this->erase_counts[cold] <= WL_DYN_STATIC_THRESHOLD) {
+        return ESP_OK;
+    }
+    ESP_LOGD(TAG, "%s - move static sector %i, erase_count=%i, free erase_count=%i", __func__,
+             cold, this->erase_counts[cold], this->erase_counts[free_sector]);
+    return this->moveSector(this->sector_owner[cold], true);
+}
+
+size_t WL_Dynamic::chip_size()
+{
+    if (!this->configured) {
+        return 0;
+    }
+    return this->flash_size;
+}
+
+size_t WL_Dynamic::sector_size()
+{
+    if (!this->configured) {
+        return 0;
+    }
+    return this->cfg.sector_size;
+}
+
+esp_err_t WL_Dynamic::erase_sector(size_t sector)
+{
+    esp_err_t result = ESP_OK;
+    if (!this->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sector >= this->logical_count) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGD(TAG, "%s - sector= 0x%08x", __func__, (uint32_t) sector);
+    // Erased data is not needed anymore, so the sector is just remapped to the least worn free one
+    result = this->moveSector(sector, false);
+    WL_RESULT_CHECK(result);
+    result = this->levelStatic();
+    WL_RESULT_CHECK(result);
+    return result;
+}
+
+esp_err_t WL_Dynamic::erase_range(size_t start_address, size_t size)
+{
+    esp_err_t result = ESP_OK;
+    if (!this->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_LOGD(TAG, "%s - start_address= 0x%08x, size= 0x%08x", __func__, (uint32_t) start_address, (uint32_t) size);
+    size_t erase_count = (size + this->cfg.sector_size - 1) / this->cfg.sector_size;
+    size_t start_sector = start_address / this->cfg.sector_size;
+    for (size_t i = 0; i < erase_count; i++) {
+        result = this->erase_sector(start_sector + i);
+        WL_RESULT_CHECK(result);
+    }
+    return result;
+}
+
+esp_err_t WL_Dynamic::write(size_t dest_addr, const void *src, size_t size)
+{
+    esp_err_t result = ESP_OK;
+    if (!this->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if ((dest_addr > this->flash_size) || (size > this->flash_size - dest_addr)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGD(TAG, "%s - dest_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) dest_addr, (uint32_t) size);
+    const uint8_t *data = (const uint8_t *)src;
+    while (size > 0) {
+        size_t offset = dest_addr % this->cfg.sector_size;
+        size_t chunk = this->cfg.sector_size - offset;
+        if (chunk > size) {
+            chunk = size;
+        }
+        size_t phys_addr = this->cfg.start_addr + this->sector_map[dest_addr / this->cfg.sector_size] * this->cfg.sector_size + offset;
+        result = this->flash_drv->write(phys_addr, data, chunk);
+        WL_RESULT_CHECK(result);
+        dest_addr += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+    return result;
+}
+
+esp_err_t WL_Dynamic::read(size_t src_addr, void *dest, size_t size)
+{
+    esp_err_t result = ESP_OK;
+    if (!this->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if ((src_addr > this->flash_size) || (size > this->flash_size - src_addr)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ESP_LOGD(TAG, "%s - src_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) src_addr, (uint32_t) size);
+    uint8_t *data = (uint8_t *)dest;
+    while (size > 0) {
+        size_t offset = src_addr % this->cfg.sector_size;
+        size_t chunk = this->cfg.sector_size - offset;
+        if (chunk > size) {
+            chunk = size;
+        }
+        size_t phys_addr = this->cfg.start_addr + this->sector_map[src_addr / this->cfg.sector_size] * this->cfg.sector_size + offset;
+        result = this->flash_drv->read(phys_addr, data, chunk);
+        WL_RESULT_CHECK(result);
+        src_addr += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+    return result;
+}
+
+esp_err_t WL_Dynamic::flush()
+{
+    // Every remap is stored to the record log immediately, nothing to do here
+    return ESP_OK;
+}
+
+uint32_t WL_Dynamic::get_erase_count(size_t physical_sector)
+{
+    if (!this->configured || (physical_sector >= this->physical_count)) {
+        return 0;
+    }
+    return this->erase_counts[physical_sector];
+}
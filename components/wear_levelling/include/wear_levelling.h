@@ -21,6 +21,14 @@ typedef int32_t wl_handle_t;
 
 #define WL_INVALID_HANDLE -1
 
+/**
+* @brief wear levelling algorithm
+*/
+typedef enum {
+    WL_ALGORITHM_ROTATING = 0,  /*!< One dummy block is rotated through the whole partition. Used by wl_mount */
+    WL_ALGORITHM_DYNAMIC,       /*!< Erase counters are kept for every sector, erased sectors are remapped to the least worn free ones */
+} wl_algorithm_t;
+
 /**
 * @brief Mount WL for defined partition
 *
@@ -34,6 +42,29 @@ typedef int32_t wl_handle_t;
 */
 esp_err_t wl_mount(const esp_partition_t *partition, wl_handle_t *out_handle);
 
+/**
+* @brief Mount WL for defined partition using the selected wear levelling algorithm
+*
+* The dynamic algorithm keeps an erase counter for every physical sector in the state area
+* and remaps each erased sector to the least worn free sector, so a frequently rewritten
+* sector does not cause moving of the other data. Sectors holding static data are moved
+* when their erase counter falls behind by more than CONFIG_WL_DYNAMIC_STATIC_THRESHOLD.
+*
+* @note The on-flash layouts of the algorithms are not compatible. A partition must always
+*       be mounted with the same algorithm, otherwise it will be formatted again.
+*
+* @param partition that will be used for access
+* @param algorithm wear levelling algorithm
+* @param out_handle handle of the WL instance
+*
+* @return
+*       - ESP_OK, if the allocation was successfully;
+*       - ESP_ERR_INVALID_ARG, if WL allocation was unsuccessful;
+*       - ESP_ERR_NO_MEM, if there was no memory to allocate WL components;
+*       - ESP_ERR_NOT_SUPPORTED, if the algorithm is not supported with the configured sector size;
+*/
+esp_err_t wl_mount_with_algorithm(const esp_partition_t *partition, wl_algorithm_t algorithm, wl_handle_t *out_handle);
+
 /**
 * @brief Unmount WL for defined partition
 *
@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef _WL_Dynamic_H_
+#define _WL_Dynamic_H_
+
+#include "WL_Flash.h"
+
+/**
+* @brief This structure is the header of the dynamic wear levelling state copy.
+*        The header is followed by the erase counter table (one entry per physical sector),
+*        the logical -> physical map (one entry per logical sector) and the record log.
+*
+*/
+typedef struct ALIGNED_(32) WL_Dyn_State_s {
+    uint32_t magic;          /*!< WL_DYN_MAGIC, identifies the dynamic wear levelling layout*/
+    uint32_t version;        /*!< version of the configuration used to format the partition*/
+    uint32_t seq;            /*!< sequence number of the snapshot. Valid copy with the higher number is used*/
+    uint32_t logical_count;  /*!< amount of sectors visible to the user*/
+    uint32_t physical_count; /*!< amount of sectors in the data area (logical sectors + spare sectors)*/
+    uint32_t device_id;      /*!< ID of current WL instance*/
+    uint32_t table_crc;      /*!< CRC of the erase counter table and the map table*/
+    uint32_t crc;            /*!< CRC of structure*/
+} wl_dyn_state_t;
+
+/**
+* @brief One entry of the record log: logical sector now lives in physical sector,
+*        which has been erased erase_count times.
+*
+*/
+typedef struct WL_Dyn_Record_s {
+    uint32_t logical;       /*!< logical sector number*/
+    uint32_t physical;      /*!< physical sector number*/
+    uint32_t erase_count;   /*!< erase counter of the physical sector*/
+    uint32_t crc;           /*!< CRC of the record*/
+} wl_dyn_record_t;
+
+#ifndef _MSC_VER // MSVS has different format for this define
+static_assert(sizeof(wl_dyn_state_t) % 16 == 0, "Size of wl_dyn_state_t structure should be compatible with flash encryption");
+static_assert(sizeof(wl_dyn_record_t) % 16 == 0, "Size of wl_dyn_record_t structure should be compatible with flash encryption");
+#endif // _MSC_VER
+
+/**
+* @brief This class implements dynamic wear levelling. Every physical sector has an erase counter
+*        which is stored in the state area. When a logical sector is erased, it is remapped to the
+*        least worn free physical sector. If the least worn sector holds static data, the data is
+*        moved to a free sector, so the worn out sectors will not stay in the free pool forever.
+*        Unlike WL_Flash, the erase of a sector never causes a shift of other data blocks.
+*        The erase counter of a sector is stored with the record of the remap, after the erase.
+*        If the power is lost in between, that erase is not counted, so a counter may fall
+*        behind the real amount of erases by one erase per power loss.
+*
+*/
+class WL_Dynamic : public WL_Flash
+{
+public :
+    WL_Dynamic();
+    ~WL_Dynamic() override;
+
+    esp_err_t config(wl_config_t *cfg, Flash_Access *flash_drv) override;
+    esp_err_t init() override;
+
+    size_t chip_size() override;
+    size_t sector_size() override;
+
+    esp_err_t erase_sector(size_t sector) override;
+    esp_err_t erase_range(size_t start_address, size_t size) override;
+
+    esp_err_t write(size_t dest_addr, const void *src, size_t size) override;
+    esp_err_t read(size_t src_addr, void *dest, size_t size) override;
+
+    esp_err_t flush() override;
+
+    uint32_t get_erase_count(size_t physical_sector);
+
+protected:
+    wl_dyn_state_t dyn_state;
+
+    uint32_t logical_count = 0;
+    uint32_t physical_count = 0;
+    uint32_t *erase_counts = NULL;  // erase counter of every physical sector
+    uint32_t *sector_map = NULL;    // physical sector of every logical sector
+    uint32_t *sector_owner = NULL;  // logical sector of every physical sector, WL_DYN_FREE_SECTOR if not used
+
+    size_t copy_size;
+    size_t addr_copy[2];
+    size_t log_offset;
+    size_t log_capacity;
+    size_t log_pos;
+    int current_copy;
+
+    esp_err_t formatSections();
+    esp_err_t loadCopy(int copy);
+    esp_err_t writeSnapshot(int copy);
+    esp_err_t appendRecord(uint32_t logical);
+    esp_err_t replayRecords();
+    esp_err_t moveSector(uint32_t logical, bool copy_data);
+    esp_err_t levelStatic();
+    uint32_t findFreeSector();
+    uint32_t recordCrc(const wl_dyn_record_t *record);
+    void rebuildOwners();
+};
+
+#endif // _WL_Dynamic_H_
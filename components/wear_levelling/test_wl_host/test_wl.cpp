@@ -6,11 +6,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 #include "spi_flash_mmap.h"
 #include "esp_partition.h"
 #include "wear_levelling.h"
 #include "WL_Flash.h"
+#include "WL_Dynamic.h"
+#include "Partition.h"
 #include "SpiFlash.h"
 
 #include "catch.hpp"
@@ -213,3 +216,213 @@ TEST_CASE("power down test", "[wear_levelling]")
     result = wl_unmount(wl_handle);
     REQUIRE(result == ESP_OK);
 }
+
+TEST_CASE("dynamic wear levelling spreads erases of one hot sector", "[wear_levelling]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    wl_handle_t wl_handle;
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    REQUIRE(wl_mount_with_algorithm(partition, WL_ALGORITHM_DYNAMIC, &wl_handle) == ESP_OK);
+
+    size_t sector_size = wl_sector_size(wl_handle);
+    int32_t sectors_count = wl_size(wl_handle) / sector_size;
+    REQUIRE(sectors_count > 0);
+    uint32_t *sector_data = new uint32_t[sector_size / sizeof(uint32_t)];
+
+    // Fill partition with check data
+    for (int32_t i = 0; i < sectors_count; i++) {
+        REQUIRE(wl_erase_range(wl_handle, i * sector_size, sector_size) == ESP_OK);
+        for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+            sector_data[m] = i * sector_size + m;
+        }
+        REQUIRE(wl_write(wl_handle, i * sector_size, sector_data, sector_size) == ESP_OK);
+    }
+
+    // Rewrite the first sector many times, remounting from time to time
+    const int32_t hot_count = 2000;
+    spiflash.reset_erase_cycles();
+    for (int32_t k = 0; k < hot_count; k++) {
+        REQUIRE(wl_erase_range(wl_handle, 0, sector_size) == ESP_OK);
+        for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+            sector_data[m] = k + m;
+        }
+        REQUIRE(wl_write(wl_handle, 0, sector_data, sector_size) == ESP_OK);
+        if (k % 300 == 0) {
+            REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+            REQUIRE(wl_mount_with_algorithm(partition, WL_ALGORITHM_DYNAMIC, &wl_handle) == ESP_OK);
+        }
+    }
+
+    // Erases of the hot sector must be spread over the data area
+    uint32_t max_cycles = 0;
+    uint32_t total_cycles = 0;
+    for (uint32_t s = 0; s < partition->size / sector_size; s++) {
+        uint32_t cycles = spiflash.get_erase_cycles((partition->address / sector_size) + s);
+        total_cycles += cycles;
+        if (cycles > max_cycles) {
+            max_cycles = cycles;
+        }
+    }
+    printf("dynamic WL: hot erases=%d, total flash erases=%d, max erases of one sector=%d\n", hot_count, total_cycles, max_cycles);
+    REQUIRE(max_cycles < hot_count / 10);
+    // Static data moves and state updates must stay a small overhead
+    REQUIRE(total_cycles < hot_count * 2);
+
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+    REQUIRE(wl_mount_with_algorithm(partition, WL_ALGORITHM_DYNAMIC, &wl_handle) == ESP_OK);
+
+    // All data is still in place after the remount
+    for (int32_t i = 0; i < sectors_count; i++) {
+        REQUIRE(wl_read(wl_handle, i * sector_size, sector_data, sector_size) == ESP_OK);
+        for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+            uint32_t expected = (i == 0) ? (hot_count - 1 + m) : (i * sector_size + m);
+            REQUIRE(expected == sector_data[m]);
+        }
+    }
+
+    delete[] sector_data;
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+}
+
+class WL_Dynamic_Test : public WL_Dynamic
+{
+public:
+    uint32_t get_physical_count()
+    {
+        return this->physical_count;
+    }
+};
+
+// Reads the erase counters stored by WL_Dynamic for every physical sector of the data area
+static void read_dynamic_erase_counts(const esp_partition_t *partition, std::vector<uint32_t> &counts)
+{
+    Partition part(partition);
+    WL_Dynamic_Test wl;
+    wl_config_t cfg = {};
+    cfg.full_mem_size = partition->size;
+    cfg.start_addr = 0;
+    cfg.version = 2;
+    cfg.sector_size = SPI_FLASH_SEC_SIZE;
+    cfg.page_size = SPI_FLASH_SEC_SIZE;
+    cfg.updaterate = 16;
+    cfg.temp_buff_size = 32;
+    cfg.wr_size = 16;
+    REQUIRE(wl.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl.init() == ESP_OK);
+    counts.clear();
+    for (size_t s = 0; s < wl.get_physical_count(); s++) {
+        counts.push_back(wl.get_erase_count(s));
+    }
+}
+
+TEST_CASE("dynamic wear levelling power down test", "[wear_levelling]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    wl_handle_t wl_handle;
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    REQUIRE(wl_mount_with_algorithm(partition, WL_ALGORITHM_DYNAMIC, &wl_handle) == ESP_OK);
+
+    size_t sector_size = wl_sector_size(wl_handle);
+    int32_t sectors_count = wl_size(wl_handle) / sector_size;
+    uint32_t *sector_data = new uint32_t[sector_size / sizeof(uint32_t)];
+
+    // Fill partition with check data
+    for (int32_t i = 0; i < sectors_count; i++) {
+        REQUIRE(wl_erase_range(wl_handle, i * sector_size, sector_size) == ESP_OK);
+        for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+            sector_data[m] = i * sector_size + m;
+        }
+        REQUIRE(wl_write(wl_handle, i * sector_size, sector_data, sector_size) == ESP_OK);
+    }
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+
+    uint32_t partition_sector = partition->address / sector_size;
+    std::vector<uint32_t> counts_before;
+    std::vector<uint32_t> cycles_before;
+    read_dynamic_erase_counts(partition, counts_before);
+    for (size_t s = 0; s < counts_before.size(); s++) {
+        cycles_before.push_back(spiflash.get_erase_cycles(partition_sector + s));
+    }
+
+    REQUIRE(wl_mount_with_algorithm(partition, WL_ALGORITHM_DYNAMIC, &wl_handle) == ESP_OK);
+
+    // Cut the power after an increasing amount of erases, which moves the power loss through
+    // the erase, the data copy, the record log and the snapshot of the state
+    int32_t max_count = 1;
+    int32_t power_losses = 0;
+    for (int32_t k = 0; k < TEST_COUNT_MAX; k++) {
+        spiflash.set_total_erase_cycles_limit(max_count);
+
+        int32_t err_sector = -1;
+        for (int32_t i = 0; i < sectors_count; i++) {
+            // Rewrite the first sectors more often, so static data is moved as well
+            int32_t sector = (i % 2 == 0) ? (i % 3) : i;
+            if (wl_erase_range(wl_handle, sector * sector_size, sector_size) != ESP_OK) {
+                err_sector = sector;
+                break;
+            }
+            for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                sector_data[m] = sector * sector_size + m;
+            }
+            if (wl_write(wl_handle, sector * sector_size, sector_data, sector_size) != ESP_OK) {
+                err_sector = sector;
+                break;
+            }
+        }
+
+        if (err_sector >= 0) {
+            power_losses++;
+            max_count++;
+        } else {
+            max_count = 1;
+        }
+
+        spiflash.set_total_erase_cycles_limit(0);
+        REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+        REQUIRE(wl_mount_with_algorithm(partition, WL_ALGORITHM_DYNAMIC, &wl_handle) == ESP_OK);
+
+        // All the sectors but the one being rewritten keep their data
+        for (int32_t i = 0; i < sectors_count; i++) {
+            if (i == err_sector) {
+                continue;
+            }
+            REQUIRE(wl_read(wl_handle, i * sector_size, sector_data, sector_size) == ESP_OK);
+            for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                REQUIRE(i * sector_size + m == sector_data[m]);
+            }
+        }
+
+        if (err_sector >= 0) {
+            REQUIRE(wl_erase_range(wl_handle, err_sector * sector_size, sector_size) == ESP_OK);
+            for (uint32_t m = 0; m < sector_size / sizeof(uint32_t); m++) {
+                sector_data[m] = err_sector * sector_size + m;
+            }
+            REQUIRE(wl_write(wl_handle, err_sector * sector_size, sector_data, sector_size) == ESP_OK);
+        }
+
+        spiflash.reset_total_erase_cycles();
+    }
+    REQUIRE(power_losses > 0);
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+
+    // An erase interrupted before its record is written is not counted, so the counters
+    // may only fall behind the real erases by one erase per power loss
+    std::vector<uint32_t> counts_after;
+    read_dynamic_erase_counts(partition, counts_after);
+    int32_t not_counted = 0;
+    for (size_t s = 0; s < counts_after.size(); s++) {
+        uint32_t cycles = spiflash.get_erase_cycles(partition_sector + s) - cycles_before[s];
+        uint32_t counted = counts_after[s] - counts_before[s];
+        if (cycles > counted) {
+            not_counted += cycles - counted;
+        }
+    }
+    printf("dynamic WL: power losses=%d, erases not counted=%d\n", power_losses, not_counted);
+    REQUIRE(not_counted <= power_losses);
+
+    delete[] sector_data;
+}
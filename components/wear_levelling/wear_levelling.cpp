@@ -13,6 +13,7 @@
 #include "WL_Flash.h"
 #include "WL_Ext_Perf.h"
 #include "WL_Ext_Safe.h"
+#include "WL_Dynamic.h"
 #include "SPI_Flash.h"
 #include "Partition.h"
 
@@ -52,6 +53,11 @@ static const char *TAG = "wear_levelling";
 static esp_err_t check_handle(wl_handle_t handle, const char *func);
 
 esp_err_t wl_mount(const esp_partition_t *partition, wl_handle_t *out_handle)
+{
+    return wl_mount_with_algorithm(partition, WL_ALGORITHM_ROTATING, out_handle);
+}
+
+esp_err_t wl_mount_with_algorithm(const esp_partition_t *partition, wl_algorithm_t algorithm, wl_handle_t *out_handle)
 {
     // Initialize variables before the first jump to cleanup label
     void *wl_flash_ptr = NULL;
@@ -86,6 +92,18 @@ esp_err_t wl_mount(const esp_partition_t *partition, wl_handle_t *out_handle)
         result = ESP_ERR_NO_MEM;
         goto out;
     }
+    if (algorithm != WL_ALGORITHM_ROTATING && algorithm != WL_ALGORITHM_DYNAMIC) {
+        ESP_LOGE(TAG, "%s: unknown algorithm %d", __func__, algorithm);
+        result = ESP_ERR_INVALID_ARG;
+        goto out;
+    }
+#if CONFIG_WL_SECTOR_SIZE != 4096
+    if (algorithm == WL_ALGORITHM_DYNAMIC) {
+        ESP_LOGE(TAG, "%s: dynamic wear levelling requires CONFIG_WL_SECTOR_SIZE=4096", __func__);
+        result = ESP_ERR_NOT_SUPPORTED;
+        goto out;
+    }
+#endif // CONFIG_WL_SECTOR_SIZE
 
     // Allocate memory for a Partition object, and then initialize the object
     // using placement new operator. This way we can recover from out of
@@ -121,14 +139,25 @@ esp_err_t wl_mount(const esp_partition_t *partition, wl_handle_t *out_handle)
 #endif // CONFIG_WL_SECTOR_MODE
 #endif // CONFIG_WL_SECTOR_SIZE
 #if CONFIG_WL_SECTOR_SIZE == 4096
-    wl_flash_ptr = malloc(sizeof(WL_Flash));
+    if (algorithm == WL_ALGORITHM_DYNAMIC) {
+        wl_flash_ptr = malloc(sizeof(WL_Dynamic));
 
-    if (wl_flash_ptr == NULL) {
-        result = ESP_ERR_NO_MEM;
-        ESP_LOGE(TAG, "%s: can't allocate WL_Flash", __func__);
-        goto out;
+        if (wl_flash_ptr == NULL) {
+            result = ESP_ERR_NO_MEM;
+            ESP_LOGE(TAG, "%s: can't allocate WL_Dynamic", __func__);
+            goto out;
+        }
+        wl_flash = new (wl_flash_ptr) WL_Dynamic();
+    } else {
+        wl_flash_ptr = malloc(sizeof(WL_Flash));
+
+        if (wl_flash_ptr == NULL) {
+            result = ESP_ERR_NO_MEM;
+            ESP_LOGE(TAG, "%s: can't allocate WL_Flash", __func__);
+            goto out;
+        }
+        wl_flash = new (wl_flash_ptr) WL_Flash();
     }
-    wl_flash = new (wl_flash_ptr) WL_Flash();
 #endif // CONFIG_WL_SECTOR_SIZE
 
     result = wl_flash->config(&cfg, part);
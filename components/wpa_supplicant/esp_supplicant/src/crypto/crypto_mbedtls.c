@@ -20,6 +20,7 @@
 #include "mbedtls/aes.h"
 #include "mbedtls/bignum.h"
 #include "mbedtls/pkcs5.h"
+#include "mbedtls/sha1.h"
 #include "mbedtls/cmac.h"
 #include "mbedtls/nist_kw.h"
 #include "mbedtls/des.h"
@@ -753,6 +754,12 @@ cleanup:
 	return ret;
 }
 
+#if CONFIG_IDF_TARGET_ESP32 && CONFIG_MBEDTLS_HARDWARE_SHA
+/*
+ * The ESP32 SHA engine can't load a saved state, so cloned SHA-1 contexts are
+ * finished in software. Restarting the HMAC in hardware every iteration is
+ * faster there.
+ */
 int pbkdf2_sha1(const char *passphrase, const u8 *ssid, size_t ssid_len,
 		int iterations, u8 *buf, size_t buflen)
 {
@@ -776,7 +783,7 @@ int pbkdf2_sha1(const char *passphrase, const u8 *ssid, size_t ssid_len,
 
 	ret = mbedtls_pkcs5_pbkdf2_hmac(&sha1_ctx, (const u8 *) passphrase,
 					os_strlen(passphrase) , ssid,
-					ssid_len, iterations, 32, buf);
+					ssid_len, iterations, buflen, buf);
 	if (ret != 0) {
 		ret = -1;
 		goto cleanup;
@@ -787,6 +794,134 @@ cleanup:
 	return ret;
 }
 
+#else /* CONFIG_IDF_TARGET_ESP32 && CONFIG_MBEDTLS_HARDWARE_SHA */
+
+/*
+ * HMAC-SHA1 continuing from the precomputed state of the ipad or opad block,
+ * so that only the message is hashed (one compression for 20 octets)
+ */
+static int pbkdf2_sha1_hmac(const mbedtls_sha1_context *pad_ctx,
+			    mbedtls_sha1_context *ctx, const u8 *data,
+			    size_t data_len, u8 *mac)
+{
+	mbedtls_sha1_clone(ctx, pad_ctx);
+	if (mbedtls_sha1_update(ctx, data, data_len) != 0 ||
+	    mbedtls_sha1_finish(ctx, mac) != 0) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * SHA-1 state after the ipad or opad block
+ */
+static int pbkdf2_sha1_pad_state(mbedtls_sha1_context *pad_ctx,
+				 const u8 *k_pad, size_t k_pad_len)
+{
+	mbedtls_sha1_context ctx;
+	int ret;
+
+	mbedtls_sha1_init(&ctx);
+	ret = mbedtls_sha1_starts(&ctx);
+	if (ret == 0) {
+		ret = mbedtls_sha1_update(&ctx, k_pad, k_pad_len);
+	}
+	if (ret == 0) {
+		mbedtls_sha1_clone(pad_ctx, &ctx);
+	}
+	mbedtls_sha1_free(&ctx);
+	return ret;
+}
+
+/*
+ * mbedtls_pkcs5_pbkdf2_hmac() restarts HMAC with mbedtls_md_hmac_reset() in
+ * every iteration, which hashes the ipad and opad blocks again. These only
+ * depend on the passphrase, so their SHA-1 states are computed once here and
+ * cloned, halving the compressions per iteration. The SHA-1 calls use the
+ * hardware accelerator on targets which can resume from a saved state.
+ */
+int pbkdf2_sha1(const char *passphrase, const u8 *ssid, size_t ssid_len,
+		int iterations, u8 *buf, size_t buflen)
+{
+	mbedtls_sha1_context ictx, octx, ctx;
+	u8 k_pad[64], tmp[SHA1_MAC_LEN], digest[SHA1_MAC_LEN], count_buf[4];
+	size_t passphrase_len = os_strlen(passphrase);
+	const u8 *key = (const u8 *) passphrase;
+	unsigned int count = 0;
+	size_t plen, i;
+	int iter, ret = -1;
+
+	mbedtls_sha1_init(&ictx);
+	mbedtls_sha1_init(&octx);
+	mbedtls_sha1_init(&ctx);
+
+	/* keys longer than the block are hashed first, as in HMAC */
+	if (passphrase_len > sizeof(k_pad)) {
+		if (mbedtls_sha1(key, passphrase_len, digest) != 0) {
+			goto cleanup;
+		}
+		key = digest;
+		passphrase_len = SHA1_MAC_LEN;
+	}
+
+	os_memset(k_pad, 0, sizeof(k_pad));
+	os_memcpy(k_pad, key, passphrase_len);
+	for (i = 0; i < sizeof(k_pad); i++) {
+		k_pad[i] ^= 0x36;
+	}
+	if (pbkdf2_sha1_pad_state(&ictx, k_pad, sizeof(k_pad)) != 0) {
+		goto cleanup;
+	}
+	for (i = 0; i < sizeof(k_pad); i++) {
+		k_pad[i] ^= 0x36 ^ 0x5c;
+	}
+	if (pbkdf2_sha1_pad_state(&octx, k_pad, sizeof(k_pad)) != 0) {
+		goto cleanup;
+	}
+
+	while (buflen > 0) {
+		count++;
+		WPA_PUT_BE32(count_buf, count);
+
+		/* U1 = PRF(P, S || i) */
+		mbedtls_sha1_clone(&ctx, &ictx);
+		if (mbedtls_sha1_update(&ctx, ssid, ssid_len) != 0 ||
+		    mbedtls_sha1_update(&ctx, count_buf, sizeof(count_buf)) != 0 ||
+		    mbedtls_sha1_finish(&ctx, tmp) != 0 ||
+		    pbkdf2_sha1_hmac(&octx, &ctx, tmp, SHA1_MAC_LEN, tmp) != 0) {
+			goto cleanup;
+		}
+		os_memcpy(digest, tmp, SHA1_MAC_LEN);
+
+		/* Uc = PRF(P, Uc-1) */
+		for (iter = 1; iter < iterations; iter++) {
+			if (pbkdf2_sha1_hmac(&ictx, &ctx, tmp, SHA1_MAC_LEN, tmp) != 0 ||
+			    pbkdf2_sha1_hmac(&octx, &ctx, tmp, SHA1_MAC_LEN, tmp) != 0) {
+				goto cleanup;
+			}
+			for (i = 0; i < SHA1_MAC_LEN; i++) {
+				digest[i] ^= tmp[i];
+			}
+		}
+
+		plen = buflen > SHA1_MAC_LEN ? SHA1_MAC_LEN : buflen;
+		os_memcpy(buf, digest, plen);
+		buf += plen;
+		buflen -= plen;
+	}
+	ret = 0;
+
+cleanup:
+	mbedtls_sha1_free(&ictx);
+	mbedtls_sha1_free(&octx);
+	mbedtls_sha1_free(&ctx);
+	os_memset(k_pad, 0, sizeof(k_pad));
+	os_memset(tmp, 0, sizeof(tmp));
+	os_memset(digest, 0, sizeof(digest));
+	return ret;
+}
+#endif /* CONFIG_IDF_TARGET_ESP32 && CONFIG_MBEDTLS_HARDWARE_SHA */
+
 #ifdef MBEDTLS_DES_C
 int des_encrypt(const u8 *clear, const u8 *key, u8 *cypher)
 {
@@ -8,16 +8,137 @@
 
 #include "common/sae.h"
 #include "common/ieee802_11_defs.h"
+#include "crypto/crypto.h"
+#include "crypto/sha256.h"
 #include "esp_wifi_driver.h"
 #include "rsn_supp/wpa.h"
+#ifdef CONFIG_WPA_SAE_PT_NVS_CACHE
+#include "nvs.h"
+#endif
 
 static struct sae_pt *g_sae_pt;
+static u8 g_sae_pt_key[SHA256_MAC_LEN];
 static struct sae_data g_sae_data;
 static struct wpabuf *g_sae_token = NULL;
 static struct wpabuf *g_sae_commit = NULL;
 static struct wpabuf *g_sae_confirm = NULL;
 int g_allowed_groups[] = { IANA_SECP256R1, 0 };
 
+/*
+ * The password element (PT) for hash-to-element only depends on the SSID,
+ * the password and the groups, so it's kept across connections and derived
+ * again only when the profile changes. The key identifying the cached PT is
+ * a hash of the SSID and password.
+ */
+static int wpa3_sae_pt_key(const struct wifi_ssid *ssid, const u8 *pw, u8 *key)
+{
+    u8 ssid_len = ssid->len;
+    const u8 *addr[3] = { &ssid_len, ssid->ssid, pw };
+    size_t len[3] = { 1, ssid->len, os_strlen((const char *)pw) };
+
+    return sha256_vector(3, addr, len, key);
+}
+
+#ifdef CONFIG_WPA_SAE_PT_NVS_CACHE
+#define SAE_PT_NVS_NAMESPACE "wpa3_sae"
+#define SAE_PT_NVS_KEY "pt"
+
+struct wpa3_sae_pt_blob {
+    u8 key[SHA256_MAC_LEN];
+    u16 group;
+    u8 pt[2 * SAE_MAX_ECC_PRIME_LEN];
+};
+
+static struct sae_pt *wpa3_sae_pt_load(const u8 *key)
+{
+    struct wpa3_sae_pt_blob *blob;
+    struct sae_pt *pt = NULL;
+    size_t len = sizeof(*blob);
+    nvs_handle_t handle;
+
+    if (nvs_open(SAE_PT_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return NULL;
+    }
+    blob = os_malloc(sizeof(*blob));
+    if (blob && nvs_get_blob(handle, SAE_PT_NVS_KEY, blob, &len) == ESP_OK &&
+            len == sizeof(*blob) && blob->group == g_allowed_groups[0] &&
+            os_memcmp_const(blob->key, key, SHA256_MAC_LEN) == 0) {
+        pt = os_zalloc(sizeof(*pt));
+        if (pt) {
+            pt->group = blob->group;
+            pt->ec = crypto_ec_init(pt->group);
+            if (pt->ec) {
+                pt->ecc_pt = crypto_ec_point_from_bin(pt->ec, blob->pt);
+            }
+            if (!pt->ecc_pt || !crypto_ec_point_is_on_curve(pt->ec, pt->ecc_pt)) {
+                wpa_printf(MSG_INFO, "wpa3: invalid PT in NVS");
+                sae_deinit_pt(pt);
+                pt = NULL;
+            }
+        }
+    }
+    nvs_close(handle);
+    bin_clear_free(blob, sizeof(*blob));
+    return pt;
+}
+
+static void wpa3_sae_pt_store(const struct sae_pt *pt, const u8 *key)
+{
+    struct wpa3_sae_pt_blob *blob;
+    nvs_handle_t handle;
+    size_t prime_len;
+
+    /* the station uses a single ECC group */
+    if (!pt->ec || pt->next) {
+        return;
+    }
+    blob = os_zalloc(sizeof(*blob));
+    if (!blob) {
+        return;
+    }
+    prime_len = crypto_ec_prime_len(pt->ec);
+    os_memcpy(blob->key, key, SHA256_MAC_LEN);
+    blob->group = pt->group;
+    if (crypto_ec_point_to_bin(pt->ec, pt->ecc_pt, blob->pt, blob->pt + prime_len) == 0 &&
+            nvs_open(SAE_PT_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        if (nvs_set_blob(handle, SAE_PT_NVS_KEY, blob, sizeof(*blob)) != ESP_OK ||
+                nvs_commit(handle) != ESP_OK) {
+            wpa_printf(MSG_INFO, "wpa3: failed to store PT in NVS");
+        }
+        nvs_close(handle);
+    }
+    bin_clear_free(blob, sizeof(*blob));
+}
+#endif /* CONFIG_WPA_SAE_PT_NVS_CACHE */
+
+static void wpa3_sae_update_pt(const struct wifi_ssid *ssid, const u8 *pw)
+{
+    u8 key[SHA256_MAC_LEN];
+
+    if (wpa3_sae_pt_key(ssid, pw, key) < 0) {
+        return;
+    }
+    if (g_sae_pt && os_memcmp_const(key, g_sae_pt_key, sizeof(key)) == 0) {
+        goto out;
+    }
+
+    sae_deinit_pt(g_sae_pt);
+#ifdef CONFIG_WPA_SAE_PT_NVS_CACHE
+    g_sae_pt = wpa3_sae_pt_load(key);
+    if (!g_sae_pt) {
+        g_sae_pt = sae_derive_pt(g_allowed_groups, ssid->ssid, ssid->len, pw, os_strlen((const char *)pw), NULL);
+        if (g_sae_pt) {
+            wpa3_sae_pt_store(g_sae_pt, key);
+        }
+    }
+#else
+    g_sae_pt = sae_derive_pt(g_allowed_groups, ssid->ssid, ssid->len, pw, os_strlen((const char *)pw), NULL);
+#endif
+    os_memcpy(g_sae_pt_key, key, sizeof(key));
+out:
+    forced_memzero(key, sizeof(key));
+}
+
 static esp_err_t wpa3_build_sae_commit(u8 *bssid)
 {
     int default_group = IANA_SECP256R1;
@@ -27,8 +148,8 @@ static esp_err_t wpa3_build_sae_commit(u8 *bssid)
     struct wifi_ssid *ssid = esp_wifi_sta_get_prof_ssid_internal();
     uint8_t use_pt = esp_wifi_get_use_h2e_internal();
 
-    if (use_pt && !g_sae_pt) {
-        g_sae_pt = sae_derive_pt(g_allowed_groups, ssid->ssid, ssid->len, pw, strlen((const char *)pw), NULL);
+    if (use_pt) {
+        wpa3_sae_update_pt(ssid, pw);
     }
 
     if (wpa_sta_cur_pmksa_matches_akm()) {
@@ -135,10 +256,13 @@ void esp_wpa3_free_sae_data(void)
         g_sae_confirm = NULL;
     }
     sae_clear_data(&g_sae_data);
-    if (g_sae_pt) {
-        sae_deinit_pt(g_sae_pt);
-        g_sae_pt = NULL;
-    }
+}
+
+void esp_wpa3_free_sae_pt(void)
+{
+    sae_deinit_pt(g_sae_pt);
+    g_sae_pt = NULL;
+    forced_memzero(g_sae_pt_key, sizeof(g_sae_pt_key));
 }
 
 static u8 *wpa3_build_sae_msg(u8 *bssid, u32 sae_msg_type, size_t *sae_msg_len)
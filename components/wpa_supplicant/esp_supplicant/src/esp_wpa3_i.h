@@ -22,6 +22,7 @@
 
 void esp_wifi_register_wpa3_cb(struct wpa_funcs *wpa_cb);
 void esp_wpa3_free_sae_data(void);
+void esp_wpa3_free_sae_pt(void);
 
 #else /* CONFIG_WPA3_SAE */
 
@@ -35,5 +36,9 @@ static inline void esp_wpa3_free_sae_data(void)
 {
 }
 
+static inline void esp_wpa3_free_sae_pt(void)
+{
+}
+
 #endif /* CONFIG_WPA3_SAE */
 #endif /* ESP_WPA3_H */
@@ -366,6 +366,7 @@ int esp_supplicant_init(void)
 
 int esp_supplicant_deinit(void)
 {
+    esp_wpa3_free_sae_pt();
     esp_supplicant_common_deinit();
     eloop_destroy();
     return esp_wifi_unregister_wpa_cb_internal();
@@ -10,47 +10,69 @@
 
 #include "common.h"
 #include "sha1.h"
+#include "sha1_i.h"
+#include "crypto.h"
 
-static int pbkdf2_sha1_f(const char *passphrase, const u8 *ssid,
+/*
+ * HMAC-SHA1 of a 20 octet message, i.e., one compression continuing from the
+ * precomputed state of the ipad or opad block. The message fits into the
+ * final block together with the padding and the length of (64 + 20) octets.
+ */
+static void pbkdf2_sha1_hmac_20(const u32 pad_state[5], const u8 *msg,
+				u8 *mac)
+{
+	u8 block[64];
+	u32 state[5];
+	int i;
+
+	os_memcpy(block, msg, SHA1_MAC_LEN);
+	block[SHA1_MAC_LEN] = 0x80;
+	os_memset(block + SHA1_MAC_LEN + 1, 0, 64 - SHA1_MAC_LEN - 1 - 4);
+	WPA_PUT_BE32(block + 60, (64 + SHA1_MAC_LEN) * 8);
+	os_memcpy(state, pad_state, sizeof(state));
+	SHA1Transform(state, block);
+	for (i = 0; i < 5; i++)
+		WPA_PUT_BE32(mac + 4 * i, state[i]);
+}
+
+
+static int pbkdf2_sha1_f(const struct SHA1Context *ictx,
+			 const struct SHA1Context *octx, const u8 *ssid,
 			 size_t ssid_len, int iterations, unsigned int count,
 			 u8 *digest)
 {
-	unsigned char tmp[SHA1_MAC_LEN], tmp2[SHA1_MAC_LEN];
+	struct SHA1Context ctx;
+	unsigned char tmp[SHA1_MAC_LEN];
 	int i, j;
 	unsigned char count_buf[4];
-	const u8 *addr[2];
-	size_t len[2];
-	size_t passphrase_len = os_strlen(passphrase);
-
-	addr[0] = ssid;
-	len[0] = ssid_len;
-	addr[1] = count_buf;
-	len[1] = 4;
 
 	/* F(P, S, c, i) = U1 xor U2 xor ... Uc
 	 * U1 = PRF(P, S || i)
 	 * U2 = PRF(P, U1)
 	 * Uc = PRF(P, Uc-1)
+	 *
+	 * The ipad and opad blocks of PRF(P, .) are the same in each
+	 * iteration, so only the compressions of the message blocks are
+	 * done here, two per iteration instead of four.
 	 */
 
-	count_buf[0] = (count >> 24) & 0xff;
-	count_buf[1] = (count >> 16) & 0xff;
-	count_buf[2] = (count >> 8) & 0xff;
-	count_buf[3] = count & 0xff;
-	if (hmac_sha1_vector((u8 *) passphrase, passphrase_len, 2, addr, len,
-			     tmp))
-		return -1;
+	WPA_PUT_BE32(count_buf, count);
+	os_memcpy(&ctx, ictx, sizeof(ctx));
+	SHA1Update(&ctx, ssid, ssid_len);
+	SHA1Update(&ctx, count_buf, 4);
+	SHA1Final(tmp, &ctx);
+	pbkdf2_sha1_hmac_20(octx->state, tmp, tmp);
 	os_memcpy(digest, tmp, SHA1_MAC_LEN);
 
 	for (i = 1; i < iterations; i++) {
-		if (hmac_sha1((u8 *) passphrase, passphrase_len, tmp,
-			      SHA1_MAC_LEN, tmp2))
-			return -1;
-		os_memcpy(tmp, tmp2, SHA1_MAC_LEN);
+		pbkdf2_sha1_hmac_20(ictx->state, tmp, tmp);
+		pbkdf2_sha1_hmac_20(octx->state, tmp, tmp);
 		for (j = 0; j < SHA1_MAC_LEN; j++)
-			digest[j] ^= tmp2[j];
+			digest[j] ^= tmp[j];
 	}
 
+	os_memset(&ctx, 0, sizeof(ctx));
+	os_memset(tmp, 0, sizeof(tmp));
 	return 0;
 }
 
@@ -76,10 +98,35 @@ int pbkdf2_sha1(const char *passphrase, const u8 *ssid, size_t ssid_len,
 	unsigned char *pos = buf;
 	size_t left = buflen, plen;
 	unsigned char digest[SHA1_MAC_LEN];
+	struct SHA1Context ictx, octx;
+	unsigned char k_pad[64];
+	size_t passphrase_len = os_strlen(passphrase);
+	const u8 *key = (const u8 *) passphrase;
+	size_t i;
+
+	/* keys longer than the block are hashed first, as in HMAC */
+	if (passphrase_len > 64) {
+		if (sha1_vector(1, &key, &passphrase_len, digest))
+			return -1;
+		key = digest;
+		passphrase_len = SHA1_MAC_LEN;
+	}
+
+	os_memset(k_pad, 0, sizeof(k_pad));
+	os_memcpy(k_pad, key, passphrase_len);
+	for (i = 0; i < 64; i++)
+		k_pad[i] ^= 0x36;
+	SHA1Init(&ictx);
+	SHA1Update(&ictx, k_pad, 64);
+	for (i = 0; i < 64; i++)
+		k_pad[i] ^= 0x36 ^ 0x5c;
+	SHA1Init(&octx);
+	SHA1Update(&octx, k_pad, 64);
+	os_memset(k_pad, 0, sizeof(k_pad));
 
 	while (left > 0) {
 		count++;
-		if (pbkdf2_sha1_f(passphrase, ssid, ssid_len, iterations,
+		if (pbkdf2_sha1_f(&ictx, &octx, ssid, ssid_len, iterations,
 				  count, digest))
 			return -1;
 		plen = left > SHA1_MAC_LEN ? SHA1_MAC_LEN : left;
@@ -88,5 +135,8 @@ int pbkdf2_sha1(const char *passphrase, const u8 *ssid, size_t ssid_len,
 		left -= plen;
 	}
 
+	os_memset(&ictx, 0, sizeof(ictx));
+	os_memset(&octx, 0, sizeof(octx));
+	os_memset(digest, 0, sizeof(digest));
 	return 0;
 }
@@ -13,6 +13,8 @@
 #include "utils/common.h"
 #include "utils/includes.h"
 #include "crypto/crypto.h"
+#include "crypto/sha1.h"
+#include "esp_timer.h"
 
 #include "mbedtls/ecp.h"
 #include "test_utils.h"
@@ -541,3 +543,42 @@ TEST_CASE("Test crypto lib ECC apis", "[wpa_crypto]")
 
 }
 #endif //!TEMPORARY_DISABLED_FOR_TARGETS(ESP32C2)
+
+TEST_CASE("Test PBKDF2-SHA1 key derivation", "[wpa_crypto]")
+{
+    static const struct {
+        const char *passphrase;
+        const char *ssid;
+        int iterations;
+        size_t len;
+        uint8_t psk[32];
+    } vectors[] = {
+        /* IEEE Std 802.11-2016, J.4.2 */
+        { "password", "IEEE", 4096, 32,
+          { 0xf4, 0x2c, 0x6f, 0xc5, 0x2d, 0xf0, 0xeb, 0xef, 0x9e, 0xbb, 0x4b, 0x90, 0xb3, 0x8a, 0x5f, 0x90,
+            0x2e, 0x83, 0xfe, 0x1b, 0x13, 0x5a, 0x70, 0xe2, 0x3a, 0xed, 0x76, 0x2e, 0x97, 0x10, 0xa1, 0x2e } },
+        { "ThisIsAPassword", "ThisIsASSID", 4096, 32,
+          { 0x0d, 0xc0, 0xd6, 0xeb, 0x90, 0x55, 0x5e, 0xd6, 0x41, 0x97, 0x56, 0xb9, 0xa1, 0x5e, 0xc3, 0xe3,
+            0x20, 0x9b, 0x63, 0xdf, 0x70, 0x7d, 0xd5, 0x08, 0xd1, 0x45, 0x81, 0xf8, 0x98, 0x27, 0x21, 0xaf } },
+        /* RFC 6070 */
+        { "password", "salt", 2, 20,
+          { 0xea, 0x6c, 0x01, 0x4d, 0xc7, 0x2d, 0x6f, 0x8c, 0xcd, 0x1e, 0xd9, 0x2a, 0xce, 0x1d, 0x41, 0xf0,
+            0xd8, 0xde, 0x89, 0x57 } },
+        { "passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096, 25,
+          { 0x3d, 0x2e, 0xec, 0x4f, 0xe4, 0x1c, 0x84, 0x9b, 0x80, 0xc8, 0xd8, 0x36, 0x62, 0xc0, 0xe4, 0x4a,
+            0x8b, 0x29, 0x1a, 0x96, 0x4c, 0xf2, 0xf0, 0x70, 0x38 } },
+    };
+    uint8_t psk[33];
+
+    for (int i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        memset(psk, 0xa5, sizeof(psk));
+        int64_t start = esp_timer_get_time();
+        TEST_ASSERT_EQUAL(0, pbkdf2_sha1(vectors[i].passphrase, (const u8 *)vectors[i].ssid, strlen(vectors[i].ssid),
+                                         vectors[i].iterations, psk, vectors[i].len));
+        printf("PBKDF2-SHA1 %d iterations, %d bytes: %lld us\n", vectors[i].iterations, (int)vectors[i].len,
+               esp_timer_get_time() - start);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(vectors[i].psk, psk, vectors[i].len);
+        /* nothing written past the requested length */
+        TEST_ASSERT_EQUAL_HEX8(0xa5, psk[vectors[i].len]);
+    }
+}
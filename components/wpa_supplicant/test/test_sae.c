@@ -19,6 +19,7 @@
 #include "../src/common/sae.h"
 #include "utils/wpabuf.h"
 #include "test_utils.h"
+#include "esp_timer.h"
 
 #if !TEMPORARY_DISABLED_FOR_TARGETS(ESP32C2)
 //IDF-5046
@@ -261,6 +262,40 @@ TEST_CASE("Test SAE functionality with ECC group", "[wpa3_sae]")
     ESP_LOGI("SAE Test", "=========== Complete ============");
 
 }
+
+TEST_CASE("Test SAE commit preparation time", "[wpa3_sae]")
+{
+    u8 addr1[ETH_ALEN] = {0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0x11};
+    u8 addr2[ETH_ALEN] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    u8 ssid[] = "ESP32-WPA3";
+    u8 pwd[] = "ESP32-WPA3";
+    int default_groups[] = { IANA_SECP256R1, 0 };
+    struct sae_data sae;
+    struct sae_pt *pt;
+    int64_t start;
+
+    /* hunting-and-pecking, depends on both addresses so it runs for each connection */
+    memset(&sae, 0, sizeof(sae));
+    TEST_ASSERT(sae_set_group(&sae, IANA_SECP256R1) == 0);
+    start = esp_timer_get_time();
+    TEST_ASSERT(sae_prepare_commit(addr1, addr2, pwd, strlen((const char *)pwd), &sae) == 0);
+    ESP_LOGI("SAE Test", "sae_prepare_commit: %lld us", esp_timer_get_time() - start);
+    sae_clear_data(&sae);
+
+    /* hash-to-element, the PT only depends on SSID and password and is cached by the station */
+    start = esp_timer_get_time();
+    pt = sae_derive_pt(default_groups, ssid, strlen((const char *)ssid), pwd, strlen((const char *)pwd), NULL);
+    TEST_ASSERT_NOT_NULL(pt);
+    ESP_LOGI("SAE Test", "sae_derive_pt: %lld us", esp_timer_get_time() - start);
+
+    memset(&sae, 0, sizeof(sae));
+    TEST_ASSERT(sae_set_group(&sae, IANA_SECP256R1) == 0);
+    start = esp_timer_get_time();
+    TEST_ASSERT(sae_prepare_commit_pt(&sae, pt, addr1, addr2, NULL) == 0);
+    ESP_LOGI("SAE Test", "sae_prepare_commit_pt: %lld us", esp_timer_get_time() - start);
+    sae_clear_data(&sae);
+    sae_deinit_pt(pt);
+}
 #endif //!TEMPORARY_DISABLED_FOR_TARGETS(ESP32C2)
 
 #endif /* CONFIG_WPA3_SAE */